@@ -1,4 +1,4 @@
-QT       += core gui sql multimedia
+QT       += core gui sql multimedia concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,15 +9,67 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    album_art_cache.cpp \
+    catalog_cache.cpp \
+    catalog_change_listener.cpp \
+    catalog_normalizer.cpp \
+    database_executor.cpp \
     database_manager.cpp \
+    diagnostics_dialog.cpp \
+    dsp_chain.cpp \
+    dsp_kernels.cpp \
+    latency_histogram.cpp \
+    library_importer.cpp \
+    library_snapshot.cpp \
+    library_snapshot_writer.cpp \
+    loudness_meter.cpp \
+    loudness_scanner.cpp \
     main.cpp \
     mainwindow.cpp \
-    music_player.cpp
+    music_player.cpp \
+    name_id_cache.cpp \
+    pcm_playback_engine.cpp \
+    playback_history_writer.cpp \
+    playback_telemetry.cpp \
+    query_metrics.cpp \
+    schema_migrator.cpp \
+    search_index.cpp \
+    song_list_model.cpp \
+    tag_reader.cpp \
+    waveform_data.cpp \
+    waveform_seek_bar.cpp
 
 HEADERS += \
+    album_art_cache.h \
+    catalog_cache.h \
+    catalog_change_listener.h \
+    catalog_normalizer.h \
+    database_executor.h \
     database_manager.h \
+    diagnostics_dialog.h \
+    dsp_chain.h \
+    dsp_kernels.h \
+    latency_histogram.h \
+    library_importer.h \
+    library_snapshot.h \
+    library_snapshot_writer.h \
+    loudness_meter.h \
+    loudness_scanner.h \
     mainwindow.h \
-    music_player.h
+    music_player.h \
+    name_id_cache.h \
+    pcm_playback_engine.h \
+    pcm_ring_buffer.h \
+    playback_history_writer.h \
+    playback_telemetry.h \
+    query_metrics.h \
+    schema_migrator.h \
+    search_index.h \
+    song_list_model.h \
+    sql_row_mapper.h \
+    tag_reader.h \
+    waveform_data.h \
+    waveform_seek_bar.h
 
 FORMS += \
     mainwindow.ui
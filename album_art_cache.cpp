@@ -0,0 +1,188 @@
+#include "album_art_cache.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFuture>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrentRun>
+
+namespace {
+
+// Больше обложек в текущей сессии почти не встречается; предел только страхует память
+const int maxRememberedImages = 256;
+
+// Временный ключ QImage, хэш пикселей которого еще не посчитан
+const QLatin1String pendingImagePrefix("image:");
+
+struct LoadedArt {
+    QString key;  // ключ содержимого
+    QImage image;
+};
+
+QString contentKey(const QImage &image)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(image.width()) + 'x' + QByteArray::number(image.height())
+                 + '/' + QByteArray::number(int(image.format())));
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(image.constBits()), image.sizeInBytes()));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString diskPathFor(const QString &diskDir, const QString &key, const QSize &size)
+{
+    return QDir(diskDir).filePath(QString("%1_%2x%3.png").arg(key).arg(size.width()).arg(size.height()));
+}
+
+// LRU по времени изменения: при каждом чтении с диска файл "трогается", поэтому
+// время изменения — это время последнего использования
+void trimDiskCache(const QString &diskDir, qint64 limitBytes)
+{
+    if (limitBytes <= 0) {
+        return;
+    }
+    const QFileInfoList files = QDir(diskDir).entryInfoList({"*.png"}, QDir::Files, QDir::Time);
+    qint64 total = 0;
+    for (const QFileInfo &info : files) {
+        total += info.size();
+        if (total > limitBytes && !QFile::remove(info.filePath())) {
+            qDebug() << "Не удалось удалить обложку из кэша:" << info.filePath();
+        }
+    }
+}
+
+LoadedArt loadScaledArt(const QString &key, const QVariant &artData, const QString &diskDir,
+                        const QSize &size, qint64 diskLimit)
+{
+    LoadedArt result;
+    result.key = key;
+    QImage source;
+    if (artData.metaType() == QMetaType::fromType<QImage>()) {
+        source = artData.value<QImage>();
+        if (key.startsWith(pendingImagePrefix)) {
+            result.key = contentKey(source);
+        }
+    }
+
+    // Уже уменьшенная копия с диска: PNG нужного размера читается быстрее исходного JPEG
+    const QString diskPath = diskPathFor(diskDir, result.key, size);
+    if (result.image.load(diskPath, "PNG")) {
+        QFile file(diskPath);
+        if (file.open(QIODevice::ReadWrite)) {
+            file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+        }
+        return result;
+    }
+
+    if (source.isNull()) {
+        // Формат определяется по сигнатуре данных, без перебора JPG/PNG
+        source = QImage::fromData(artData.toByteArray());
+    }
+    if (source.isNull()) {
+        qDebug() << "Не удалось декодировать обложку альбома";
+        return result;
+    }
+
+    result.image = source.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    QSaveFile file(diskPath);
+    if (file.open(QIODevice::WriteOnly) && result.image.save(&file, "PNG") && file.commit()) {
+        trimDiskCache(diskDir, diskLimit);
+    } else {
+        qDebug() << "Не удалось сохранить обложку в кэш:" << diskPath;
+    }
+    return result;
+}
+
+} // namespace
+
+AlbumArtCache::AlbumArtCache(QObject *parent)
+    : QObject(parent)
+{
+    m_diskDir = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("album_art");
+    QDir().mkpath(m_diskDir);
+    setMemoryLimit(32 * 1024);
+    setDiskLimit(QSettings().value("cache/albumArtDiskMb", 64).toLongLong() * 1024 * 1024);
+}
+
+QString AlbumArtCache::keyFor(const QVariant &artData)
+{
+    if (!artData.isValid()) {
+        return QString();
+    }
+
+    if (artData.metaType() == QMetaType::fromType<QImage>()) {
+        const QImage image = artData.value<QImage>();
+        if (image.isNull()) {
+            return QString();
+        }
+        // Один и тот же QImage приходит повторно при каждом metaDataChanged трека.
+        // Пиксели несжатые (мегабайты), поэтому в GUI-потоке они не хэшируются
+        const QString known = m_keyByImage.value(image.cacheKey());
+        return known.isEmpty() ? pendingImagePrefix + QString::number(image.cacheKey()) : known;
+    }
+
+    const QByteArray bytes = artData.toByteArray();
+    if (bytes.isEmpty()) {
+        return QString();
+    }
+    return QString::fromLatin1(QCryptographicHash::hash(bytes, QCryptographicHash::Sha1).toHex());
+}
+
+QPixmap AlbumArtCache::pixmap(const QString &key, const QVariant &artData, const QSize &size)
+{
+    const QString cacheKey = memoryKey(key, size);
+    if (const QPixmap *cached = m_pixmaps.object(cacheKey)) {
+        return *cached;
+    }
+    if (key.isEmpty() || m_loading.contains(cacheKey)) {
+        return QPixmap();
+    }
+
+    m_loading.insert(cacheKey);
+    const qint64 imageKey = artData.metaType() == QMetaType::fromType<QImage>() ? artData.value<QImage>().cacheKey() : 0;
+    QtConcurrent::run(loadScaledArt, key, artData, m_diskDir, size, m_diskLimit)
+        .then(this, [this, key, cacheKey, imageKey, size](const LoadedArt &loaded) {
+            m_loading.remove(cacheKey);
+            if (loaded.image.isNull()) {
+                emit artReady(key, size, QPixmap());
+                return;
+            }
+            if (key != loaded.key) {
+                // Временный ключ QImage: дальше этот QImage сразу получает ключ содержимого
+                if (m_keyByImage.size() >= maxRememberedImages) {
+                    m_keyByImage.clear();
+                }
+                m_keyByImage.insert(imageKey, loaded.key);
+            }
+            // Другой QImage той же обложки мог уже попасть в память под ключом содержимого
+            const QString contentCacheKey = memoryKey(loaded.key, size);
+            if (const QPixmap *cached = m_pixmaps.object(contentCacheKey)) {
+                emit artReady(key, size, *cached);
+                return;
+            }
+            // QPixmap можно создавать только в GUI-потоке, поэтому пул возвращает QImage
+            const QPixmap result = QPixmap::fromImage(loaded.image);
+            m_pixmaps.insert(contentCacheKey, new QPixmap(result), qMax(1, int(loaded.image.sizeInBytes() / 1024)));
+            emit artReady(key, size, result);
+        });
+    return QPixmap();
+}
+
+void AlbumArtCache::setMemoryLimit(int kilobytes)
+{
+    m_pixmaps.setMaxCost(kilobytes);
+}
+
+void AlbumArtCache::setDiskLimit(qint64 bytes)
+{
+    m_diskLimit = bytes;
+    QtConcurrent::run(trimDiskCache, m_diskDir, m_diskLimit);
+}
+
+QString AlbumArtCache::memoryKey(const QString &key, const QSize &size)
+{
+    return QString("%1@%2x%3").arg(key).arg(size.width()).arg(size.height());
+}
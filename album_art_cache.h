@@ -0,0 +1,56 @@
+#ifndef ALBUM_ART_CACHE_H
+#define ALBUM_ART_CACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QSet>
+#include <QSize>
+#include <QString>
+#include <QVariant>
+
+// Двухуровневый кэш обложек. Ключ — хэш содержимого картинки, поэтому одна обложка
+// у всех треков альбома занимает одну запись независимо от пути к файлу.
+//  1. Память: LRU готовых QPixmap, уже уменьшенных под размер области обложки.
+//  2. Диск: уменьшенные копии в PNG (<кэш>/album_art/<хэш>_<ширина>x<высота>.png),
+//     не больше cache/albumArtDiskMb (по умолчанию 64 МБ); вытесняются давно не читанные.
+// Промах по памяти обслуживается в пуле потоков: хэширование пикселей, чтение с диска
+// или декодирование и масштабирование исходника; GUI-поток получает готовую картинку
+// через artReady().
+class AlbumArtCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AlbumArtCache(QObject *parent = nullptr);
+
+    // Ключ для данных из QMediaMetaData (QImage или закодированные байты); пустая строка,
+    // если обложки нет. Закодированные байты хэшируются сразу (они в разы меньше пикселей).
+    // Для еще не встречавшегося QImage ключ временный: хэш пикселей считает пул потоков,
+    // а artReady() придет с тем ключом, который вернул этот метод
+    QString keyFor(const QVariant &artData);
+
+    // Готовая картинка из памяти или пустой QPixmap; при промахе запускается фоновая
+    // загрузка, по окончании которой придет artReady(key, size, pixmap)
+    QPixmap pixmap(const QString &key, const QVariant &artData, const QSize &size);
+
+    void setMemoryLimit(int kilobytes);
+    // Предел каталога обложек на диске; лишнее удаляется в пуле потоков
+    void setDiskLimit(qint64 bytes);
+
+signals:
+    void artReady(const QString &key, const QSize &size, const QPixmap &pixmap);
+
+private:
+    static QString memoryKey(const QString &key, const QSize &size);
+
+    QString m_diskDir;
+    qint64 m_diskLimit = 0;
+    QCache<QString, QPixmap> m_pixmaps;      // стоимость записи — размер в КБ
+    QSet<QString> m_loading;                 // уже запрошенные у пула потоков
+    QHash<qint64, QString> m_keyByImage;     // QImage::cacheKey() -> ключ содержимого, посчитанный пулом
+};
+
+#endif // ALBUM_ART_CACHE_H
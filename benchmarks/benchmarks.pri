@@ -0,0 +1,17 @@
+# Общие настройки бенчмарков: исходники программы берутся из корня репозитория.
+# multimedia нужен заголовкам: database_manager.h подключает dsp_chain.h (QAudioFormat)
+
+QT       += core sql multimedia testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+APP_DIR = $$PWD/..
+INCLUDEPATH += $$APP_DIR $$PWD
+DEPENDPATH += $$APP_DIR $$PWD
+
+SOURCES += \
+    $$PWD/synthetic_library.cpp
+
+HEADERS += \
+    $$PWD/synthetic_library.h
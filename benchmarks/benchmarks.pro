@@ -0,0 +1,18 @@
+# Бенчмарки QBENCHMARK для БД, модели списка, снимка библиотеки, поиска и DSP.
+#
+#   qmake benchmarks/benchmarks.pro && make
+#   make check TESTARGS="-o results.xml,xml"       # или -o results.csv,csv
+#
+# Размер синтетической библиотеки задает BENCH_SIZES (через запятую, по умолчанию
+# 10000,100000,1000000), набор СУБД — BENCH_BACKENDS (postgresql,sqlite). Для PostgreSQL
+# поднимается временный сервер initdb/pg_ctl во временном каталоге; каталог программ
+# PostgreSQL можно указать в PG_BINDIR. Результаты одного размера сравнимы между версиями:
+# данные генерируются детерминированно.
+
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    database \
+    dsp \
+    search \
+    snapshot
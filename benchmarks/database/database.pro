@@ -0,0 +1,24 @@
+include(../benchmarks.pri)
+
+TARGET = tst_bench_database
+
+SOURCES += \
+    $$APP_DIR/database_executor.cpp \
+    $$APP_DIR/database_manager.cpp \
+    $$APP_DIR/latency_histogram.cpp \
+    $$APP_DIR/name_id_cache.cpp \
+    $$APP_DIR/query_metrics.cpp \
+    $$APP_DIR/schema_migrator.cpp \
+    $$APP_DIR/song_list_model.cpp \
+    temporary_postgres.cpp \
+    tst_bench_database.cpp
+
+HEADERS += \
+    $$APP_DIR/database_executor.h \
+    $$APP_DIR/database_manager.h \
+    $$APP_DIR/latency_histogram.h \
+    $$APP_DIR/name_id_cache.h \
+    $$APP_DIR/query_metrics.h \
+    $$APP_DIR/schema_migrator.h \
+    $$APP_DIR/song_list_model.h \
+    temporary_postgres.h
@@ -0,0 +1,133 @@
+#include "temporary_postgres.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStandardPaths>
+
+TemporaryPostgres::TemporaryPostgres()
+    : m_dir(QDir::tempPath() + "/mp-bench-XXXXXX") // путь к сокету ограничен ~100 байтами
+{
+}
+
+TemporaryPostgres::~TemporaryPostgres()
+{
+    if (m_running) {
+        runProgram("pg_ctl", {"-D", m_dir.filePath("data"), "-m", "fast", "-w", "stop"}, 60000);
+    }
+}
+
+QString TemporaryPostgres::hostName() const
+{
+    return m_dir.path();
+}
+
+QString TemporaryPostgres::findProgram(const QString &name) const
+{
+    const QString binDir = qEnvironmentVariable("PG_BINDIR");
+    if (!binDir.isEmpty()) {
+        return QDir(binDir).filePath(name);
+    }
+    const QString inPath = QStandardPaths::findExecutable(name);
+    if (!inPath.isEmpty()) {
+        return inPath;
+    }
+
+    QProcess pgConfig;
+    pgConfig.start("pg_config", {"--bindir"});
+    if (pgConfig.waitForFinished(5000) && pgConfig.exitCode() == 0) {
+        const QString fromConfig = QDir(QString::fromLocal8Bit(pgConfig.readAllStandardOutput()).trimmed()).filePath(name);
+        if (QFileInfo(fromConfig).isExecutable()) {
+            return fromConfig;
+        }
+    }
+
+    // Debian/Ubuntu не кладут initdb и pg_ctl в PATH; берем самую новую версию
+    QDir versions("/usr/lib/postgresql");
+    const QStringList installed = versions.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name | QDir::Reversed);
+    for (const QString &version : installed) {
+        const QString candidate = versions.filePath(version + "/bin/" + name);
+        if (QFileInfo(candidate).isExecutable()) {
+            return candidate;
+        }
+    }
+    return QString();
+}
+
+bool TemporaryPostgres::runProgram(const QString &name, const QStringList &arguments, int timeoutMs)
+{
+    const QString program = findProgram(name);
+    if (program.isEmpty()) {
+        m_error = QString("%1 не найден (укажите PG_BINDIR)").arg(name);
+        return false;
+    }
+    QProcess process;
+    process.setProcessChannelMode(QProcess::MergedChannels);
+    process.start(program, arguments);
+    if (!process.waitForFinished(timeoutMs) || process.exitStatus() != QProcess::NormalExit
+        || process.exitCode() != 0) {
+        m_error = QString("%1: %2").arg(name, QString::fromLocal8Bit(process.readAll()).trimmed());
+        if (process.state() != QProcess::NotRunning) {
+            process.kill();
+            process.waitForFinished();
+        }
+        return false;
+    }
+    return true;
+}
+
+bool TemporaryPostgres::start()
+{
+    if (m_running) {
+        return true;
+    }
+    if (!m_dir.isValid()) {
+        m_error = "Не удалось создать временный каталог: " + m_dir.errorString();
+        return false;
+    }
+
+    const QString dataDir = m_dir.filePath("data");
+    // C-локаль: порядок строк совпадает с побайтовым, как у SQLite и снимка библиотеки
+    if (!runProgram("initdb", {"-D", dataDir, "-U", userName(), "--auth=trust", "-E", "UTF8",
+                               "--no-locale", "--no-sync"}, 120000)) {
+        return false;
+    }
+
+    // Только Unix-сокет в нашем каталоге; настройки долговечности — по умолчанию,
+    // чтобы вставки измерялись так же, как на настоящем сервере
+    const QString options = QString("-p %1 -k %2 -c listen_addresses=''").arg(port()).arg(m_dir.path());
+    if (!runProgram("pg_ctl", {"-D", dataDir, "-l", m_dir.filePath("server.log"), "-o", options,
+                               "-w", "start"}, 120000)) {
+        return false;
+    }
+    m_running = true;
+    return true;
+}
+
+bool TemporaryPostgres::createDatabase(const QString &name)
+{
+    const QString connectionName = "temporary_postgres_admin";
+    bool created = false;
+    {
+        QSqlDatabase admin = QSqlDatabase::addDatabase("QPSQL", connectionName);
+        admin.setHostName(hostName());
+        admin.setPort(port());
+        admin.setUserName(userName());
+        admin.setDatabaseName("postgres");
+        if (!admin.open()) {
+            m_error = admin.lastError().text();
+        } else {
+            QSqlQuery query(admin);
+            created = query.exec(QString("CREATE DATABASE %1").arg(name));
+            if (!created) {
+                m_error = query.lastError().text();
+            }
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return created;
+}
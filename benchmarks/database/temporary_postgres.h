@@ -0,0 +1,40 @@
+#ifndef TEMPORARY_POSTGRES_H
+#define TEMPORARY_POSTGRES_H
+
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+
+// Одноразовый сервер PostgreSQL для бенчмарков: initdb во временный каталог и pg_ctl start
+// только на Unix-сокете в том же каталоге, поэтому порт не конфликтует с системным сервером.
+// Останавливается и удаляется вместе с объектом. Программы ищутся в PG_BINDIR, в PATH,
+// через pg_config --bindir и в /usr/lib/postgresql/*/bin.
+// initdb отказывается работать от root — тогда start() вернет false.
+class TemporaryPostgres
+{
+public:
+    TemporaryPostgres();
+    ~TemporaryPostgres();
+
+    bool start();
+    bool isRunning() const { return m_running; }
+    QString errorString() const { return m_error; }
+
+    // Параметры для DatabaseManager::setConnectionParameters: хост — каталог сокета
+    QString hostName() const;
+    int port() const { return 5432; }
+    QString userName() const { return "bench"; }
+
+    bool createDatabase(const QString &name);
+
+private:
+    QString findProgram(const QString &name) const;
+    bool runProgram(const QString &name, const QStringList &arguments, int timeoutMs);
+
+    QTemporaryDir m_dir;
+    QString m_binDir;
+    bool m_running = false;
+    QString m_error;
+};
+
+#endif // TEMPORARY_POSTGRES_H
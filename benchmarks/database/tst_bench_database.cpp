@@ -0,0 +1,631 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QLoggingCategory>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <memory>
+#include "database_executor.h"
+#include "database_manager.h"
+#include "song_list_model.h"
+#include "sql_row_mapper.h"
+#include "synthetic_library.h"
+#include "temporary_postgres.h"
+
+namespace {
+
+// Своя структура, чтобы не дублировать сопоставление SongInfo из database_manager.cpp
+struct MappedSong : SongInfo {};
+
+const int pageSize = 200; // как у MainWindow::loadAllSongs
+const int bulkInsertSize = 1000;
+const QString insertPrefix = "/bench/insert/";
+
+bool waitForLoad(SongListModel &model)
+{
+    if (model.isLoading()) {
+        QEventLoop loop;
+        QObject::connect(&model, &SongListModel::loadFinished, &loop, &QEventLoop::quit);
+        QTimer::singleShot(600000, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    return !model.isLoading();
+}
+
+} // namespace
+
+template <>
+struct SqlRowMapping<MappedSong> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &SongInfo::id),
+        sqlColumn("title", &SongInfo::title),
+        sqlColumn("artist", &SongInfo::artist),
+        sqlColumn("album", &SongInfo::album),
+        sqlColumn("file_path", &SongInfo::filePath),
+        sqlColumn("duration_ms", &SongInfo::durationMs));
+};
+
+// Запросы DatabaseManager и заполнение модели библиотеки на синтетических библиотеках
+// из BENCH_SIZES в PostgreSQL (временный сервер) и SQLite (временный файл).
+// Строки данных — "СУБД/размер"; каждая база заполняется один раз при первом обращении.
+class DatabaseBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void cleanup();
+
+    // Запуск без снимка: соединение, проверка схемы и первая страница библиотеки
+    void coldStartFirstPage_data();
+    void coldStartFirstPage();
+    void loadSongs_data();
+    void loadSongs();
+    // Разбор строк: SqlRowMapper против value("имя") для каждого поля каждой строки
+    void rowMapping_data();
+    void rowMapping();
+    void getSongsInPlaylist_data();
+    void getSongsInPlaylist();
+    void getSongsForGenre_data();
+    void getSongsForGenre();
+    void getPlaybackHistory_data();
+    void getPlaybackHistory();
+    void searchSongs_data();
+    void searchSongs();
+
+    // loadAllSongs: первая страница через DatabaseExecutor и прокрутка до конца
+    void modelFirstPage_data();
+    void modelFirstPage();
+    void modelPopulation_data();
+    void modelPopulation();
+    void modelSetSongs_data();
+    void modelSetSongs();
+
+    // Вставки идут последними: добавленные песни удаляются в cleanup()
+    void singleInsert_data();
+    void singleInsert();
+    void bulkInsert_data();
+    void bulkInsert();
+
+private:
+    void addRows(const QStringList &variants = {});
+    bool openRow();
+    bool isAvailable(const QString &backend);
+    bool prepare(const QString &backend, int size);
+    bool populate(int songCount);
+    void closeDatabase();
+    SongListModel::PageFetcher libraryFetcher() const;
+
+    TemporaryPostgres m_postgres;
+    bool m_postgresTried = false;
+    QTemporaryDir m_sqliteDir;
+    QString m_error;
+
+    QString m_current; // "СУБД/размер" открытой базы
+    int m_size = 0; // число песен в ней
+    QSet<QString> m_populated;
+    std::unique_ptr<DatabaseManager> m_db;
+    std::unique_ptr<DatabaseExecutor> m_executor;
+    int m_userId = -1;
+    int m_playlistId = -1;
+    int m_genreId = -1;
+    bool m_hasSearchIndex = false;
+    int m_inserted = 0;
+    bool m_insertedSongs = false;
+};
+
+void DatabaseBenchmark::initTestCase()
+{
+    // Сообщения qDebug из DatabaseManager (по одному на вставку) искажали бы замеры
+    QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false"));
+    QVERIFY(m_sqliteDir.isValid());
+}
+
+void DatabaseBenchmark::cleanupTestCase()
+{
+    closeDatabase();
+}
+
+void DatabaseBenchmark::cleanup()
+{
+    if (!m_insertedSongs || !m_db) {
+        return;
+    }
+    m_db->releaseStatements();
+    QSqlQuery query(QSqlDatabase::database());
+    if (!query.exec(QString("DELETE FROM Songs WHERE file_path LIKE '%1%';").arg(insertPrefix))) {
+        qWarning() << "Не удалось удалить добавленные песни:" << query.lastError().text();
+    }
+    m_insertedSongs = false;
+}
+
+void DatabaseBenchmark::addRows(const QStringList &variants)
+{
+    QTest::addColumn<QString>("backend");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<QString>("variant");
+
+    const QStringList backends = qEnvironmentVariable("BENCH_BACKENDS", "postgresql,sqlite")
+                                     .split(u',', Qt::SkipEmptyParts);
+    const QList<int> sizes = SyntheticLibrary::sizes("BENCH_SIZES", {10000, 100000, 1000000});
+    for (const QString &backend : backends) {
+        for (int size : sizes) {
+            const QString row = backend.trimmed() + u'/' + SyntheticLibrary::sizeTag(size);
+            if (variants.isEmpty()) {
+                QTest::newRow(qPrintable(row)) << backend.trimmed() << size << QString();
+            }
+            for (const QString &variant : variants) {
+                QTest::newRow(qPrintable(row + u'/' + variant)) << backend.trimmed() << size << variant;
+            }
+        }
+    }
+}
+
+// Общее начало замеров: строка пропускается без СУБД и проваливается, если базу не удалось
+// подготовить. Пропуск и провал здесь не прерывают сам замер, поэтому false — сигнал
+// ему завершиться
+bool DatabaseBenchmark::openRow()
+{
+    QFETCH(QString, backend);
+    QFETCH(int, size);
+    if (!isAvailable(backend)) {
+        QTest::qSkip(qPrintable(m_error), __FILE__, __LINE__);
+        return false;
+    }
+    return QTest::qVerify(prepare(backend, size), "prepare(backend, size)", qPrintable(m_error), __FILE__, __LINE__);
+}
+
+bool DatabaseBenchmark::isAvailable(const QString &backend)
+{
+    if (backend == "sqlite") {
+        m_error = "Нет драйвера QSQLITE";
+        return QSqlDatabase::isDriverAvailable("QSQLITE");
+    }
+    if (backend != "postgresql") {
+        m_error = "Неизвестная СУБД: " + backend;
+        return false;
+    }
+    if (!QSqlDatabase::isDriverAvailable("QPSQL")) {
+        m_error = "Нет драйвера QPSQL";
+        return false;
+    }
+    // Сервер поднимается один раз; если не вышло, строки PostgreSQL пропускаются
+    if (!m_postgresTried) {
+        m_postgresTried = true;
+        if (!m_postgres.start()) {
+            qWarning() << "Временный PostgreSQL не запущен:" << m_postgres.errorString();
+        }
+    }
+    m_error = "Временный PostgreSQL не запущен: " + m_postgres.errorString();
+    return m_postgres.isRunning();
+}
+
+bool DatabaseBenchmark::prepare(const QString &backend, int size)
+{
+    const QString key = backend + u'/' + SyntheticLibrary::sizeTag(size);
+    if (key == m_current) {
+        return true;
+    }
+    closeDatabase();
+
+    const bool sqlite = backend == "sqlite";
+    const QString databaseName = QString("bench_%1").arg(size);
+    m_db = std::make_unique<DatabaseManager>(sqlite ? DatabaseBackend::Sqlite : DatabaseBackend::PostgreSql);
+    if (sqlite) {
+        m_db->setDatabaseFile(m_sqliteDir.filePath(databaseName + ".db"));
+    } else {
+        if (!m_populated.contains(key) && !m_postgres.createDatabase(databaseName)) {
+            m_error = m_postgres.errorString();
+            closeDatabase();
+            return false;
+        }
+        m_db->setConnectionParameters(m_postgres.hostName(), m_postgres.port(), databaseName,
+                                      m_postgres.userName(), QString());
+    }
+    if (!m_db->open() || !m_db->migrateSchema()) {
+        m_error = "Не удалось открыть базу " + key;
+        closeDatabase();
+        return false;
+    }
+
+    if (!m_populated.contains(key)) {
+        QElapsedTimer timer;
+        timer.start();
+        if (!populate(size)) {
+            m_error = "Не удалось заполнить базу " + key;
+            closeDatabase();
+            return false;
+        }
+        qInfo().noquote() << "База" << key << "заполнена за" << timer.elapsed() << "мс";
+        m_populated.insert(key);
+    }
+
+    m_userId = m_db->getUser("bench").id;
+    m_playlistId = m_db->loadPlaylists().value(0).id;
+    m_genreId = m_db->getGenreId("Genre 1");
+    m_hasSearchIndex = !sqlite && m_db->hasSearchIndex();
+    m_executor = std::make_unique<DatabaseExecutor>();
+    m_executor->start();
+    m_current = key;
+    m_size = size;
+    return true;
+}
+
+bool DatabaseBenchmark::populate(int songCount)
+{
+    // Песни — через addSongs пачками, как при импорте папки
+    const int batchSize = 50000;
+    QList<int> songIds;
+    songIds.reserve(songCount);
+    for (int first = 0; first < songCount; first += batchSize) {
+        const QList<int> ids = m_db->addSongs(SyntheticLibrary::songs(qMin(batchSize, songCount - first), first));
+        if (ids.contains(-1)) {
+            return false;
+        }
+        songIds += ids;
+    }
+
+    QList<int> playlistIds;
+    for (int i = 1; i <= SyntheticLibrary::PlaylistCount; ++i) {
+        const int playlistId = m_db->createPlaylist(QString("Playlist %1").arg(i));
+        if (playlistId == -1) {
+            return false;
+        }
+        playlistIds.append(playlistId);
+    }
+    QStringList genreNames;
+    for (int i = 1; i <= SyntheticLibrary::GenreCount; ++i) {
+        genreNames.append(QString("Genre %1").arg(i));
+    }
+    const QHash<QString, int> genreIds = m_db->resolveGenreIds(genreNames);
+    const int userId = m_db->addUser("bench", "bench", "bench@example.com");
+    if (genreIds.size() != genreNames.size() || userId == -1) {
+        return false;
+    }
+
+    // Состав плейлистов и жанров — по одному запросу INSERT ... SELECT на плейлист и жанр
+    m_db->releaseStatements();
+    QSqlDatabase connection = QSqlDatabase::database();
+    QSqlQuery query(connection);
+    if (!connection.transaction()) {
+        return false;
+    }
+    query.prepare("INSERT INTO PlaylistSongs (playlist_id, song_id, song_order) "
+                  "SELECT CAST(:playlist_id AS INTEGER), id, CAST(id AS BIGINT) * 65536 FROM Songs WHERE id % :count = :remainder;");
+    for (int i = 0; i < playlistIds.size(); ++i) {
+        query.bindValue(":playlist_id", playlistIds.at(i));
+        query.bindValue(":count", SyntheticLibrary::PlaylistCount);
+        query.bindValue(":remainder", i);
+        if (!query.exec()) {
+            qWarning() << "Ошибка заполнения плейлистов:" << query.lastError().text();
+            connection.rollback();
+            return false;
+        }
+    }
+    // Основной жанр id % GenreCount, у каждой третьей песни еще и следующий за ним
+    query.prepare("INSERT INTO SongGenres (song_id, genre_id) "
+                  "SELECT id, CAST(:genre_id AS INTEGER) FROM Songs WHERE id % :count = :remainder "
+                  "OR (id % 3 = 0 AND (id + 1) % :count2 = :remainder2);");
+    for (int i = 0; i < genreNames.size(); ++i) {
+        query.bindValue(":genre_id", genreIds.value(genreNames.at(i)));
+        query.bindValue(":count", SyntheticLibrary::GenreCount);
+        query.bindValue(":remainder", i);
+        query.bindValue(":count2", SyntheticLibrary::GenreCount);
+        query.bindValue(":remainder2", i);
+        if (!query.exec()) {
+            qWarning() << "Ошибка заполнения жанров:" << query.lastError().text();
+            connection.rollback();
+            return false;
+        }
+    }
+    if (!connection.commit()) {
+        return false;
+    }
+
+    // История: по прослушиванию на каждые две песни, раз в минуту
+    QList<PlaybackEntryInfo> history;
+    history.reserve(songCount / 2);
+    const QDateTime start(QDate(2024, 1, 1), QTime(0, 0));
+    for (int i = 0; i < songCount / 2; ++i) {
+        PlaybackEntryInfo entry{};
+        entry.userId = userId;
+        entry.songId = songIds.at(int((qint64(i) * 7919) % songCount));
+        entry.playedAt = start.addSecs(qint64(i) * 60);
+        history.append(entry);
+    }
+    if (!m_db->addPlaybackEntries(history)) {
+        return false;
+    }
+
+    return query.exec("ANALYZE;");
+}
+
+void DatabaseBenchmark::closeDatabase()
+{
+    // Исполнитель дорабатывает очередь и закрывает свое соединение до основного.
+    // Кэш справочников сбрасывается, чтобы следующая база заполнялась с нуля
+    m_executor.reset();
+    if (m_db) {
+        m_db->clearNameIdCache();
+    }
+    m_db.reset();
+    QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
+    m_current.clear();
+    m_size = 0;
+}
+
+SongListModel::PageFetcher DatabaseBenchmark::libraryFetcher() const
+{
+    DatabaseExecutor *executor = m_executor.get();
+    return [executor](const SongInfo *last, int limit) {
+        const QString afterTitle = last ? last->title : QString();
+        const int afterId = last ? last->id : -1;
+        return executor->submit([afterTitle, afterId, limit](DatabaseManager &db) {
+            return db.loadSongsPage(afterTitle, afterId, limit);
+        });
+    };
+}
+
+void DatabaseBenchmark::coldStartFirstPage_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::coldStartFirstPage()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    QBENCHMARK {
+        DatabaseManager database(QString("bench_cold_start"));
+        QVERIFY(database.open());
+        QVERIFY(database.migrateSchema());
+        QCOMPARE(database.loadSongsPage(QString(), -1, pageSize).size(), qMin(pageSize, m_size));
+    }
+}
+
+void DatabaseBenchmark::loadSongs_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::loadSongs()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    qsizetype rows = 0;
+    QBENCHMARK {
+        rows = m_db->loadSongs().size();
+    }
+    QCOMPARE(rows, qsizetype(m_size));
+}
+
+void DatabaseBenchmark::rowMapping_data()
+{
+    addRows({"mapper", "byName"});
+}
+
+void DatabaseBenchmark::rowMapping()
+{
+    if (!openRow()) {
+        return;
+    }
+    QFETCH(QString, variant);
+
+    m_db->releaseStatements();
+    QSqlQuery query(QSqlDatabase::database());
+    query.setForwardOnly(true);
+    QVERIFY(query.prepare("SELECT id, title, artist, album, file_path, duration_ms FROM Songs ORDER BY title, id;"));
+
+    const bool byName = variant == "byName";
+    qsizetype rows = 0;
+    QBENCHMARK {
+        QVERIFY(query.exec());
+        if (byName) {
+            // Так строки читались до SqlRowMapper: поиск колонки по имени на каждое поле
+            QList<SongInfo> songs;
+            while (query.next()) {
+                SongInfo song;
+                song.id = query.value("id").toInt();
+                song.title = query.value("title").toString();
+                song.artist = query.value("artist").toString();
+                song.album = query.value("album").toString();
+                song.filePath = query.value("file_path").toString();
+                song.durationMs = query.value("duration_ms").toInt();
+                songs.append(song);
+            }
+            rows = songs.size();
+        } else {
+            rows = SqlRowMapper::readAll<MappedSong>(query).size();
+        }
+        query.finish();
+    }
+    QCOMPARE(rows, qsizetype(m_size));
+}
+
+void DatabaseBenchmark::getSongsInPlaylist_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::getSongsInPlaylist()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    qsizetype rows = 0;
+    QBENCHMARK {
+        rows = m_db->getSongsInPlaylist(m_playlistId).size();
+    }
+    QVERIFY(rows >= m_size / SyntheticLibrary::PlaylistCount);
+}
+
+void DatabaseBenchmark::getSongsForGenre_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::getSongsForGenre()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    qsizetype rows = 0;
+    QBENCHMARK {
+        rows = m_db->getSongsForGenre(m_genreId).size();
+    }
+    QVERIFY(rows >= m_size / SyntheticLibrary::GenreCount);
+}
+
+void DatabaseBenchmark::getPlaybackHistory_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::getPlaybackHistory()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    qsizetype rows = 0;
+    QBENCHMARK {
+        rows = m_db->getPlaybackHistory(m_userId, 100).size();
+    }
+    QCOMPARE(rows, qMin<qsizetype>(100, m_size / 2));
+}
+
+void DatabaseBenchmark::searchSongs_data()
+{
+    addRows({"word", "prefix", "twoWords"});
+}
+
+void DatabaseBenchmark::searchSongs()
+{
+    if (!openRow()) {
+        return;
+    }
+    QFETCH(QString, variant);
+    if (!m_hasSearchIndex) {
+        QSKIP("Триграммный индекс pg_trgm недоступен (в SQLite поиск только в памяти)");
+    }
+
+    const QString text = variant == "word" ? "midnight" : (variant == "prefix" ? "ni" : "night fire");
+    QBENCHMARK {
+        m_db->searchSongs(text, 50);
+    }
+}
+
+void DatabaseBenchmark::modelFirstPage_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::modelFirstPage()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    SongListModel model;
+    QBENCHMARK {
+        model.setPageFetcher(libraryFetcher());
+        QVERIFY(waitForLoad(model));
+    }
+    QCOMPARE(model.rowCount(), qMin(pageSize, m_size));
+}
+
+void DatabaseBenchmark::modelPopulation_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::modelPopulation()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    int rows = 0;
+    QBENCHMARK {
+        SongListModel model;
+        model.setPageFetcher(libraryFetcher());
+        QVERIFY(waitForLoad(model));
+        while (model.canFetchMore(QModelIndex())) {
+            model.fetchMore(QModelIndex());
+            QVERIFY(waitForLoad(model));
+        }
+        rows = model.rowCount();
+    }
+    QCOMPARE(rows, m_size);
+}
+
+void DatabaseBenchmark::modelSetSongs_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::modelSetSongs()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    // Вся библиотека одним списком — путь без постраничной загрузки
+    const QList<SongInfo> songs = m_db->loadSongs();
+    QBENCHMARK {
+        SongListModel model;
+        model.setSongs(songs);
+    }
+}
+
+void DatabaseBenchmark::singleInsert_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::singleInsert()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    m_insertedSongs = true;
+    QBENCHMARK {
+        const SongInfo song = SyntheticLibrary::songs(1, m_inserted++, insertPrefix).first();
+        QVERIFY(m_db->addSong(song.filePath, song.title, song.artist, song.album, song.durationMs) != -1);
+    }
+}
+
+void DatabaseBenchmark::bulkInsert_data()
+{
+    addRows();
+}
+
+void DatabaseBenchmark::bulkInsert()
+{
+    if (!openRow()) {
+        return;
+    }
+
+    m_insertedSongs = true;
+    QBENCHMARK {
+        const QList<SongInfo> songs = SyntheticLibrary::songs(bulkInsertSize, m_inserted, insertPrefix);
+        m_inserted += bulkInsertSize;
+        QVERIFY(!m_db->addSongs(songs).contains(-1));
+    }
+}
+
+QTEST_GUILESS_MAIN(DatabaseBenchmark)
+
+#include "tst_bench_database.moc"
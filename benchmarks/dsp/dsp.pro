@@ -0,0 +1,12 @@
+include(../benchmarks.pri)
+
+TARGET = tst_bench_dsp
+
+SOURCES += \
+    $$APP_DIR/dsp_chain.cpp \
+    $$APP_DIR/dsp_kernels.cpp \
+    tst_bench_dsp.cpp
+
+HEADERS += \
+    $$APP_DIR/dsp_chain.h \
+    $$APP_DIR/dsp_kernels.h
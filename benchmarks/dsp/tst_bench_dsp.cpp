@@ -0,0 +1,196 @@
+#include <QtTest>
+#include <QAudioFormat>
+#include <QElapsedTimer>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "dsp_chain.h"
+#include "dsp_kernels.h"
+
+namespace {
+
+const int blockFrames = 4096; // стерео, как типичный буфер аудиоустройства
+const int bandCount = 10;
+const qint64 minimumNs = 200 * 1000 * 1000;
+
+// Вызывает block(), пока не наберется minimumNs, и возвращает кадров в секунду
+// на одном ядре: результат записывается в вывод теста метрикой FramesPerSecond
+template <typename Block>
+qreal framesPerSecond(Block block)
+{
+    block(); // прогрев кэшей и предсказателя ветвлений
+    QElapsedTimer timer;
+    timer.start();
+    qint64 frames = 0;
+    do {
+        for (int i = 0; i < 16; ++i) {
+            block();
+        }
+        frames += 16 * blockFrames;
+    } while (timer.nsecsElapsed() < minimumNs);
+    return qreal(frames) * 1e9 / qreal(timer.nsecsElapsed());
+}
+
+QList<EqBand> tenBandEqualizer()
+{
+    QList<EqBand> bands;
+    const double frequencies[bandCount] = {31, 62, 125, 250, 500, 1000, 2000, 4000, 8000, 16000};
+    for (int i = 0; i < bandCount; ++i) {
+        EqBand band;
+        band.type = i == 0 ? EqBand::LowShelf : (i == bandCount - 1 ? EqBand::HighShelf : EqBand::Peaking);
+        band.frequencyHz = frequencies[i];
+        band.gainDb = (i % 2 == 0) ? 3.0 : -2.0;
+        band.q = 1.0;
+        bands.append(band);
+    }
+    return bands;
+}
+
+// Синус 440 Гц с амплитудой выше порога лимитера, чтобы работала его медленная ветка
+QVector<float> testSignal()
+{
+    QVector<float> samples(blockFrames * 2);
+    for (int frame = 0; frame < blockFrames; ++frame) {
+        const float value = 0.98f * float(std::sin(2.0 * M_PI * 440.0 * frame / 48000.0));
+        samples[frame * 2] = value;
+        samples[frame * 2 + 1] = -value;
+    }
+    return samples;
+}
+
+} // namespace
+
+// Пропускная способность ядер DSP (scalar/SSE2/AVX2/NEON — все, что доступны на этом
+// процессоре) и всей цепочки DspChain в кадрах стерео в секунду на одно ядро.
+// Поделив результат на частоту дискретизации, получаем число потоков на ядро.
+class DspBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void kernels_data();
+    void kernels();
+    void chain_data();
+    void chain();
+};
+
+void DspBenchmark::kernels_data()
+{
+    QTest::addColumn<int>("kernelSet");
+    QTest::addColumn<QString>("operation");
+
+    const QStringList operations = {"int16ToFloat", "int32ToFloat", "floatToInt16", "floatToInt32",
+                                    "applyGain", "softLimit", "biquadStereo10"};
+    const QList<const DspKernels *> sets = DspKernels::available();
+    for (int i = 0; i < sets.size(); ++i) {
+        for (const QString &operation : operations) {
+            QTest::newRow(qPrintable(QString("%1/%2").arg(sets.at(i)->name, operation))) << i << operation;
+        }
+    }
+}
+
+void DspBenchmark::kernels()
+{
+    QFETCH(int, kernelSet);
+    QFETCH(QString, operation);
+    const DspKernels &k = *DspKernels::available().at(kernelSet);
+
+    const QVector<float> signal = testSignal();
+    const qsizetype count = signal.size();
+    QVector<float> data = signal;
+    QVector<qint16> int16(count);
+    QVector<qint32> int32(count);
+    k.floatToInt16(signal.constData(), int16.data(), count);
+    k.floatToInt32(signal.constData(), int32.data(), count);
+
+    BiquadCoefficients coefficients[bandCount];
+    const QList<EqBand> bands = tenBandEqualizer();
+    for (int i = 0; i < bandCount; ++i) {
+        coefficients[i] = DspChain::biquadFor(bands.at(i), 48000);
+    }
+    QVector<float> state(bandCount * 2 * 2, 0.0f);
+
+    qreal result = 0;
+    if (operation == "int16ToFloat") {
+        result = framesPerSecond([&] { k.int16ToFloat(int16.constData(), data.data(), count); });
+    } else if (operation == "int32ToFloat") {
+        result = framesPerSecond([&] { k.int32ToFloat(int32.constData(), data.data(), count); });
+    } else if (operation == "floatToInt16") {
+        result = framesPerSecond([&] { k.floatToInt16(signal.constData(), int16.data(), count); });
+    } else if (operation == "floatToInt32") {
+        result = framesPerSecond([&] { k.floatToInt32(signal.constData(), int32.data(), count); });
+    } else if (operation == "applyGain") {
+        // Коэффициент 1.0 сохраняет сигнал неизменным от итерации к итерации
+        result = framesPerSecond([&] { k.applyGain(data.data(), count, 1.0f); });
+    } else if (operation == "softLimit") {
+        result = framesPerSecond([&] {
+            std::copy(signal.cbegin(), signal.cend(), data.begin());
+            k.softLimit(data.data(), count, 0.891f);
+        });
+    } else {
+        result = framesPerSecond([&] {
+            std::copy(signal.cbegin(), signal.cend(), data.begin());
+            k.biquadStereo(data.data(), blockFrames, coefficients, bandCount, state.data());
+        });
+    }
+    QVERIFY(result > 0);
+    QTest::setBenchmarkResult(result, QTest::FramesPerSecond);
+}
+
+void DspBenchmark::chain_data()
+{
+    QTest::addColumn<int>("sampleFormat");
+    QTest::addColumn<bool>("equalizer");
+
+    QTest::newRow("int16/volume+limiter") << int(QAudioFormat::Int16) << false;
+    QTest::newRow("int16/eq10+volume+limiter") << int(QAudioFormat::Int16) << true;
+    QTest::newRow("int32/eq10+volume+limiter") << int(QAudioFormat::Int32) << true;
+    QTest::newRow("float/volume+limiter") << int(QAudioFormat::Float) << false;
+    QTest::newRow("float/eq10+volume+limiter") << int(QAudioFormat::Float) << true;
+}
+
+void DspBenchmark::chain()
+{
+    QFETCH(int, sampleFormat);
+    QFETCH(bool, equalizer);
+
+    QAudioFormat format;
+    format.setSampleRate(48000);
+    format.setChannelCount(2);
+    format.setSampleFormat(QAudioFormat::SampleFormat(sampleFormat));
+
+    // Цепочка с активным набором ядер, как в PcmPlaybackEngine
+    DspChain chain(format);
+    chain.setVolume(0.8f);
+    chain.setLimiter(true);
+    if (equalizer) {
+        chain.setEqualizer(tenBandEqualizer());
+    }
+
+    const QVector<float> signal = testSignal();
+    QByteArray source(blockFrames * format.bytesPerFrame(), Qt::Uninitialized);
+    if (format.sampleFormat() == QAudioFormat::Int16) {
+        DspKernels::active().floatToInt16(signal.constData(), reinterpret_cast<qint16 *>(source.data()), signal.size());
+    } else if (format.sampleFormat() == QAudioFormat::Int32) {
+        DspKernels::active().floatToInt32(signal.constData(), reinterpret_cast<qint32 *>(source.data()), signal.size());
+    } else {
+        std::memcpy(source.data(), signal.constData(), source.size());
+    }
+    QByteArray buffer = source;
+
+    const qreal result = framesPerSecond([&] {
+        std::memcpy(buffer.data(), source.constData(), source.size());
+        chain.process(buffer.data(), blockFrames);
+    });
+    QVERIFY(result > 0);
+    qInfo().noquote() << QString("%1: %2 потоков 48 кГц на ядро (%3)")
+                             .arg(QTest::currentDataTag())
+                             .arg(result / 48000.0, 0, 'f', 0)
+                             .arg(DspKernels::active().name);
+    QTest::setBenchmarkResult(result, QTest::FramesPerSecond);
+}
+
+QTEST_GUILESS_MAIN(DspBenchmark)
+
+#include "tst_bench_dsp.moc"
@@ -0,0 +1,12 @@
+include(../benchmarks.pri)
+
+TARGET = tst_bench_search
+
+SOURCES += \
+    $$APP_DIR/latency_histogram.cpp \
+    $$APP_DIR/search_index.cpp \
+    tst_bench_search.cpp
+
+HEADERS += \
+    $$APP_DIR/latency_histogram.h \
+    $$APP_DIR/search_index.h
@@ -0,0 +1,158 @@
+#include <QtTest>
+#include <memory>
+#include "latency_histogram.h"
+#include "search_index.h"
+#include "synthetic_library.h"
+
+namespace {
+
+// Как SearchResultLimit в MainWindow: столько результатов запрашивает строка поиска
+const int resultLimit = 1000;
+
+QStringList benchmarkQueries()
+{
+    // Частое слово, начало слова из двух букв, два слова, кириллица и исполнитель с номером
+    return {"midnight", "ni", "night fire", "город", "artist 42", "ri"};
+}
+
+} // namespace
+
+// Поиск в памяти (SearchIndex) на библиотеках из BENCH_SIZES: построение индекса
+// при запуске и запросы, которые выполняются на каждое нажатие клавиши в строке поиска
+class SearchBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void build_data();
+    void build();
+    void search_data();
+    void search();
+    void searchLatency_data();
+    void searchLatency();
+    void update_data();
+    void update();
+
+private:
+    void addRows(const QStringList &queries = {});
+    const SearchIndex &index(int size);
+
+    // Индекс последнего запрошенного размера: на миллионе песен он занимает сотни мегабайт
+    int m_indexSize = 0;
+    std::unique_ptr<SearchIndex> m_index;
+};
+
+void SearchBenchmark::addRows(const QStringList &queries)
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<QString>("query");
+    for (int size : SyntheticLibrary::sizes("BENCH_SIZES", {10000, 100000, 1000000})) {
+        const QString tag = SyntheticLibrary::sizeTag(size);
+        if (queries.isEmpty()) {
+            QTest::newRow(qPrintable(tag)) << size << QString();
+        }
+        for (const QString &query : queries) {
+            QTest::newRow(qPrintable(tag + u'/' + query)) << size << query;
+        }
+    }
+}
+
+const SearchIndex &SearchBenchmark::index(int size)
+{
+    if (m_indexSize != size) {
+        m_index.reset();
+        m_index = std::make_unique<SearchIndex>();
+        const QList<SongInfo> songs = SyntheticLibrary::songs(size);
+        m_index->reserve(songs.size());
+        for (int i = 0; i < songs.size(); ++i) {
+            m_index->addOrUpdate(i + 1, songs.at(i).title, songs.at(i).artist, songs.at(i).album);
+        }
+        m_indexSize = size;
+    }
+    return *m_index;
+}
+
+void SearchBenchmark::build_data()
+{
+    addRows();
+}
+
+void SearchBenchmark::build()
+{
+    QFETCH(int, size);
+    const QList<SongInfo> songs = SyntheticLibrary::songs(size);
+
+    QBENCHMARK {
+        SearchIndex built;
+        built.reserve(songs.size());
+        for (int i = 0; i < songs.size(); ++i) {
+            built.addOrUpdate(i + 1, songs.at(i).title, songs.at(i).artist, songs.at(i).album);
+        }
+        QCOMPARE(built.size(), qsizetype(size));
+    }
+}
+
+void SearchBenchmark::search_data()
+{
+    addRows(benchmarkQueries());
+}
+
+void SearchBenchmark::search()
+{
+    QFETCH(int, size);
+    QFETCH(QString, query);
+    const SearchIndex &songs = index(size);
+
+    QBENCHMARK {
+        songs.search(query, resultLimit);
+    }
+}
+
+void SearchBenchmark::searchLatency_data()
+{
+    addRows(benchmarkQueries());
+}
+
+// QBENCHMARK показывает среднее, а строка поиска не должна подтормаживать ни на одном
+// нажатии: здесь — хвост распределения по отдельным запросам
+void SearchBenchmark::searchLatency()
+{
+    QFETCH(int, size);
+    QFETCH(QString, query);
+    const SearchIndex &songs = index(size);
+
+    const int runs = 500;
+    LatencyHistogram latency;
+    for (int i = 0; i < runs; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        songs.search(query, resultLimit);
+        latency.add(timer.nsecsElapsed() / 1e6);
+    }
+    qInfo("p50 %.3f ms, p99 %.3f ms, max %.3f ms", latency.quantile(0.50), latency.quantile(0.99), latency.max());
+}
+
+void SearchBenchmark::update_data()
+{
+    addRows();
+}
+
+void SearchBenchmark::update()
+{
+    QFETCH(int, size);
+    index(size);
+
+    // Переименование песни при редактировании метаданных: снятие старых ключей и новые
+    int round = 0;
+    QBENCHMARK {
+        const int songId = 1 + int((qint64(round) * 7919) % size);
+        m_index->addOrUpdate(songId, QString("Renamed %1").arg(round), "Artist 1", "Album 1-0");
+        ++round;
+    }
+    // Индекс изменен: при следующем запросе он будет построен заново
+    m_indexSize = 0;
+}
+
+QTEST_GUILESS_MAIN(SearchBenchmark)
+
+#include "tst_bench_search.moc"
@@ -0,0 +1,12 @@
+include(../benchmarks.pri)
+
+TARGET = tst_bench_snapshot
+
+SOURCES += \
+    $$APP_DIR/library_snapshot.cpp \
+    $$APP_DIR/song_list_model.cpp \
+    tst_bench_snapshot.cpp
+
+HEADERS += \
+    $$APP_DIR/library_snapshot.h \
+    $$APP_DIR/song_list_model.h
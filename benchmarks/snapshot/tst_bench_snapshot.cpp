@@ -0,0 +1,200 @@
+#include <QtTest>
+#include <QEventLoop>
+#include <QLoggingCategory>
+#include <QPromise>
+#include <QTemporaryDir>
+#include <QTimer>
+#include "library_snapshot.h"
+#include "song_list_model.h"
+#include "synthetic_library.h"
+
+namespace {
+
+const int pageSize = 200; // как у MainWindow::loadAllSongs
+
+QFuture<QList<SongInfo>> readyPage(const QList<SongInfo> &songs)
+{
+    QPromise<QList<SongInfo>> promise;
+    promise.start();
+    promise.addResult(songs);
+    promise.finish();
+    return promise.future();
+}
+
+bool waitForLoad(SongListModel &model)
+{
+    if (model.isLoading()) {
+        QEventLoop loop;
+        QObject::connect(&model, &SongListModel::loadFinished, &loop, &QEventLoop::quit);
+        QTimer::singleShot(60000, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    return !model.isLoading();
+}
+
+} // namespace
+
+// Запуск со снимка библиотеки (LibrarySnapshot) на библиотеках из BENCH_SIZES.
+// Файл после первого открытия лежит в кэше страниц ОС, поэтому замеры открытия — «теплые»:
+// они показывают стоимость разбора, а не чтения с диска.
+class SnapshotBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void build_data();
+    void build();
+    // Показ библиотеки при запуске: открытие снимка и первая страница в модели
+    void startupFirstPage_data();
+    void startupFirstPage();
+    void pageThroughLibrary_data();
+    void pageThroughLibrary();
+    void rowOfSongId_data();
+    void rowOfSongId();
+
+private:
+    void addRows();
+    QString snapshotPath(int size);
+    const QList<SongInfo> &songs(int size);
+
+    QTemporaryDir m_dir;
+    QHash<int, QString> m_paths;
+    int m_songsSize = 0;
+    QList<SongInfo> m_songs; // библиотека последнего запрошенного размера
+};
+
+void SnapshotBenchmark::initTestCase()
+{
+    QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false"));
+    QVERIFY(m_dir.isValid());
+}
+
+void SnapshotBenchmark::addRows()
+{
+    QTest::addColumn<int>("size");
+    for (int size : SyntheticLibrary::sizes("BENCH_SIZES", {100000, 1000000})) {
+        QTest::newRow(qPrintable(SyntheticLibrary::sizeTag(size))) << size;
+    }
+}
+
+const QList<SongInfo> &SnapshotBenchmark::songs(int size)
+{
+    if (m_songsSize != size) {
+        m_songs = SyntheticLibrary::librarySongs(size);
+        m_songsSize = size;
+    }
+    return m_songs;
+}
+
+QString SnapshotBenchmark::snapshotPath(int size)
+{
+    if (!m_paths.contains(size)) {
+        LibrarySnapshotBuilder builder(1);
+        builder.reserve(size);
+        for (const SongInfo &song : songs(size)) {
+            builder.addSong(song);
+        }
+        const QString path = m_dir.filePath(QString("library_%1.snapshot").arg(size));
+        if (!builder.save(path)) {
+            return QString();
+        }
+        m_paths.insert(size, path);
+    }
+    return m_paths.value(size);
+}
+
+void SnapshotBenchmark::build_data()
+{
+    addRows();
+}
+
+void SnapshotBenchmark::build()
+{
+    QFETCH(int, size);
+    const QList<SongInfo> &library = songs(size);
+    const QString path = m_dir.filePath("build.snapshot");
+
+    QBENCHMARK {
+        LibrarySnapshotBuilder builder(1);
+        builder.reserve(library.size());
+        for (const SongInfo &song : library) {
+            builder.addSong(song);
+        }
+        QVERIFY(builder.save(path));
+    }
+}
+
+void SnapshotBenchmark::startupFirstPage_data()
+{
+    addRows();
+}
+
+void SnapshotBenchmark::startupFirstPage()
+{
+    QFETCH(int, size);
+    const QString path = snapshotPath(size);
+    QVERIFY(!path.isEmpty());
+
+    SongListModel model;
+    QBENCHMARK {
+        const std::shared_ptr<const LibrarySnapshot> snapshot = LibrarySnapshot::open(path);
+        QVERIFY(snapshot);
+        model.setPageFetcher([snapshot](const SongInfo *last, int limit) {
+            return readyPage(snapshot->page(last, limit));
+        }, pageSize);
+        QVERIFY(waitForLoad(model));
+    }
+    QCOMPARE(model.rowCount(), qMin(pageSize, size));
+}
+
+void SnapshotBenchmark::pageThroughLibrary_data()
+{
+    addRows();
+}
+
+void SnapshotBenchmark::pageThroughLibrary()
+{
+    QFETCH(int, size);
+    const std::shared_ptr<const LibrarySnapshot> snapshot = LibrarySnapshot::open(snapshotPath(size));
+    QVERIFY(snapshot);
+
+    int rows = 0;
+    QBENCHMARK {
+        rows = 0;
+        QList<SongInfo> page = snapshot->page(nullptr, pageSize);
+        while (!page.isEmpty()) {
+            rows += page.size();
+            const SongInfo last = page.last();
+            page = snapshot->page(&last, pageSize);
+        }
+    }
+    QCOMPARE(rows, size);
+}
+
+void SnapshotBenchmark::rowOfSongId_data()
+{
+    addRows();
+}
+
+void SnapshotBenchmark::rowOfSongId()
+{
+    QFETCH(int, size);
+    const std::shared_ptr<const LibrarySnapshot> snapshot = LibrarySnapshot::open(snapshotPath(size));
+    QVERIFY(snapshot);
+
+    // 1000 поисков по id вразброс за итерацию
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        for (int i = 0; i < 1000; ++i) {
+            found += snapshot->rowOfSongId(1 + int((qint64(i) * 7919) % size)) >= 0;
+        }
+    }
+    QCOMPARE(found, 1000);
+}
+
+QTEST_GUILESS_MAIN(SnapshotBenchmark)
+
+#include "tst_bench_snapshot.moc"
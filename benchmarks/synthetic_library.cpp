@@ -0,0 +1,99 @@
+#include "synthetic_library.h"
+
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+
+const char *const words[] = {
+    "love", "night", "fire", "river", "dream", "light", "heart", "city", "rain", "summer",
+    "shadow", "gold", "echo", "winter", "storm", "blue", "road", "silver", "home", "sky",
+    "ночь", "город", "дорога", "небо", "звезда", "ветер", "море", "осень", "песня", "огонь",
+    "midnight", "forever", "electric", "paradise", "wonder", "ocean", "mirror", "glass",
+};
+const int wordCount = int(sizeof(words) / sizeof(words[0]));
+
+// Простой перемешивающий хэш: соседние номера дают несвязанные слова
+quint32 mix(quint32 value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return value;
+}
+
+QString word(quint32 hash)
+{
+    return QString::fromUtf8(words[hash % wordCount]);
+}
+
+} // namespace
+
+namespace SyntheticLibrary {
+
+QList<SongInfo> songs(int count, int first, const QString &pathPrefix)
+{
+    QList<SongInfo> result;
+    result.reserve(count);
+    for (int i = first; i < first + count; ++i) {
+        const quint32 hash = mix(quint32(i));
+        QString title = word(hash);
+        title[0] = title.at(0).toUpper();
+        title += u' ' + word(hash >> 8);
+        if (hash & 0x10000) {
+            title += u' ' + word(hash >> 17);
+        }
+        const int artist = int(mix(quint32(i / 10)) % 100000);
+
+        SongInfo song{};
+        song.title = title;
+        song.artist = QString("Artist %1").arg(artist);
+        song.album = QString("Album %1-%2").arg(artist).arg(i % 2);
+        song.filePath = pathPrefix + QString::number(i) + ".mp3";
+        song.durationMs = 120000 + int(hash % 240000);
+        result.append(song);
+    }
+    return result;
+}
+
+QList<SongInfo> librarySongs(int count)
+{
+    QList<SongInfo> result = songs(count);
+    for (int i = 0; i < result.size(); ++i) {
+        result[i].id = i + 1;
+    }
+    std::sort(result.begin(), result.end(), [](const SongInfo &a, const SongInfo &b) {
+        const int order = QString::compare(a.title, b.title);
+        return order != 0 ? order < 0 : a.id < b.id;
+    });
+    return result;
+}
+
+QList<int> sizes(const char *variable, const QList<int> &defaults)
+{
+    const QString value = qEnvironmentVariable(variable);
+    QList<int> result;
+    for (const QString &part : value.split(u',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const int size = part.trimmed().toInt(&ok);
+        if (ok && size > 0) {
+            result.append(size);
+        }
+    }
+    return result.isEmpty() ? defaults : result;
+}
+
+QString sizeTag(int count)
+{
+    if (count >= 1000000 && count % 1000000 == 0) {
+        return QString("%1M").arg(count / 1000000);
+    }
+    if (count >= 1000 && count % 1000 == 0) {
+        return QString("%1k").arg(count / 1000);
+    }
+    return QString::number(count);
+}
+
+} // namespace SyntheticLibrary
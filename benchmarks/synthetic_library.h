@@ -0,0 +1,29 @@
+#ifndef SYNTHETIC_LIBRARY_H
+#define SYNTHETIC_LIBRARY_H
+
+#include <QList>
+#include <QString>
+#include "database_manager.h"
+
+// Детерминированная синтетическая библиотека для бенчмарков: один и тот же размер
+// всегда дает одни и те же песни, поэтому результаты разных версий программы сравнимы.
+// Названия собираются из небольшого словаря (в том числе русских слов), так что поиск
+// находит и частые, и редкие слова; на исполнителя приходится около 10 песен.
+namespace SyntheticLibrary {
+
+constexpr int PlaylistCount = 20; // песня с id попадает в плейлист номер id % PlaylistCount
+constexpr int GenreCount = 25;    // основной жанр id % GenreCount, у каждой третьей — второй
+
+// Песни с номерами [first, first + count); у пути префикс pathPrefix
+QList<SongInfo> songs(int count, int first = 0, const QString &pathPrefix = "/bench/library/");
+// Те же песни, упорядоченные как список библиотеки (title, id), с id = номер + 1
+QList<SongInfo> librarySongs(int count);
+
+// Размеры из переменной окружения ("10000,100000"), иначе defaults
+QList<int> sizes(const char *variable, const QList<int> &defaults);
+// "10k", "1M" — для имен строк данных
+QString sizeTag(int count);
+
+} // namespace SyntheticLibrary
+
+#endif // SYNTHETIC_LIBRARY_H
@@ -0,0 +1,205 @@
+#include "catalog_cache.h"
+#include "catalog_change_listener.h"
+#include "database_executor.h"
+
+#include <algorithm>
+
+CatalogCache::CatalogCache(DatabaseExecutor *executor, QObject *parent)
+    : QObject(parent)
+    , m_executor(executor)
+{
+}
+
+CatalogCache::~CatalogCache()
+{
+    if (m_listener) {
+        m_listener->quit();
+        m_listener->wait();
+    }
+}
+
+void CatalogCache::start()
+{
+    if (!m_listener) {
+        m_listener = new CatalogChangeListener(this);
+        connect(m_listener, &CatalogChangeListener::subscribed, this, [this] {
+            m_subscribed = true;
+        });
+        connect(m_listener, &CatalogChangeListener::changesReceived, this, &CatalogCache::handleChanges);
+        connect(m_listener, &CatalogChangeListener::resyncRequired, this, [this] {
+            reload();
+            emit resyncRequired();
+        });
+        // Поток завершается сам, только если подписаться не удалось
+        connect(m_listener, &QThread::finished, this, [this] {
+            m_subscribed = false;
+        });
+        m_listener->start(QThread::LowPriority);
+    }
+    reload();
+}
+
+void CatalogCache::reload()
+{
+    if (m_loading) {
+        return;
+    }
+    m_loading = true;
+
+    struct Snapshot {
+        QList<PlaylistInfo> playlists;
+        QList<QPair<int, int>> membership;
+    };
+    m_executor->submit([](DatabaseManager &db) {
+        return Snapshot{db.loadPlaylists(), db.loadPlaylistMembership()};
+    }).then(this, [this](const Snapshot &snapshot) {
+        m_loading = false;
+        m_loaded = true;
+        m_playlists = snapshot.playlists;
+        m_membership.clear();
+        m_membership.reserve(snapshot.membership.size());
+        for (const auto &entry : snapshot.membership) {
+            m_membership.insert(membershipKey(entry.first, entry.second));
+        }
+        emit playlistsChanged();
+
+        // Уведомления описывают состояние строки после изменения, поэтому повтор по порядку
+        // поверх снимка дает актуальное состояние, даже если снимок их уже учел
+        if (!m_deferred.isEmpty()) {
+            const QStringList deferred = m_deferred;
+            m_deferred.clear();
+            handleChanges(deferred);
+        }
+    });
+}
+
+bool CatalogCache::isLive() const
+{
+    return m_subscribed && m_loaded;
+}
+
+QList<PlaylistInfo> CatalogCache::playlists() const
+{
+    return m_playlists;
+}
+
+QString CatalogCache::playlistName(int playlistId) const
+{
+    for (const PlaylistInfo &playlist : m_playlists) {
+        if (playlist.id == playlistId) {
+            return playlist.name;
+        }
+    }
+    return QString();
+}
+
+bool CatalogCache::containsSong(int playlistId, int songId) const
+{
+    return m_membership.contains(membershipKey(playlistId, songId));
+}
+
+void CatalogCache::insertPlaylist(const PlaylistInfo &playlist)
+{
+    for (PlaylistInfo &existing : m_playlists) {
+        if (existing.id == playlist.id) {
+            if (existing.name == playlist.name) {
+                return;
+            }
+            existing.name = playlist.name;
+            sortPlaylists();
+            emit playlistsChanged();
+            return;
+        }
+    }
+    m_playlists.append(playlist);
+    sortPlaylists();
+    emit playlistsChanged();
+}
+
+void CatalogCache::removePlaylist(int playlistId)
+{
+    const auto removed = std::remove_if(m_playlists.begin(), m_playlists.end(), [playlistId](const PlaylistInfo &playlist) {
+        return playlist.id == playlistId;
+    });
+    if (removed == m_playlists.end()) {
+        return;
+    }
+    m_playlists.erase(removed, m_playlists.end());
+    emit playlistsChanged();
+}
+
+quint64 CatalogCache::membershipKey(int playlistId, int songId)
+{
+    return (quint64(quint32(playlistId)) << 32) | quint32(songId);
+}
+
+void CatalogCache::handleChanges(const QStringList &payloads)
+{
+    if (m_loading) {
+        m_deferred.append(payloads);
+        return;
+    }
+
+    CatalogChanges changes;
+    QSet<int> playlistsToLoad;
+    for (const QString &payload : payloads) {
+        playlistsToLoad.unite(applyChange(payload, changes));
+    }
+    if (changes.isEmpty()) {
+        return;
+    }
+
+    // Созданные и переименованные плейлисты дочитываются одним запросом
+    if (!playlistsToLoad.isEmpty()) {
+        const QList<int> playlistIds = playlistsToLoad.values();
+        m_executor->submit([playlistIds](DatabaseManager &db) {
+            return db.loadPlaylistsByIds(playlistIds);
+        }).then(this, [this](const QList<PlaylistInfo> &playlists) {
+            for (const PlaylistInfo &playlist : playlists) {
+                insertPlaylist(playlist);
+            }
+        });
+    }
+    emit catalogChanged(changes);
+}
+
+QSet<int> CatalogCache::applyChange(const QString &payload, CatalogChanges &changes)
+{
+    // "таблица:I|U|D:id" или "playlistsongs:I|U|D:playlist_id:song_id"
+    const QStringList parts = payload.split(u':');
+    if (parts.size() < 3) {
+        qDebug() << "Неизвестное уведомление каталога:" << payload;
+        return {};
+    }
+    const QString &table = parts.at(0);
+    const bool deleted = parts.at(1) == QLatin1String("D");
+    const int id = parts.at(2).toInt();
+
+    if (table == QLatin1String("songs")) {
+        changes.songs.insert(id);
+    } else if (table == QLatin1String("playlists")) {
+        changes.playlists.insert(id);
+        if (!deleted) {
+            return {id};
+        }
+        removePlaylist(id);
+    } else if (table == QLatin1String("playlistsongs") && parts.size() == 4) {
+        const int songId = parts.at(3).toInt();
+        if (deleted) {
+            m_membership.remove(membershipKey(id, songId));
+        } else {
+            m_membership.insert(membershipKey(id, songId));
+        }
+        changes.playlistSongs[id].insert(songId);
+    } else {
+        qDebug() << "Неизвестное уведомление каталога:" << payload;
+    }
+    return {};
+}
+
+void CatalogCache::sortPlaylists()
+{
+    std::sort(m_playlists.begin(), m_playlists.end(), [](const PlaylistInfo &a, const PlaylistInfo &b) {
+        return a.name.localeAwareCompare(b.name) < 0;
+    });
+}
@@ -0,0 +1,77 @@
+#ifndef CATALOG_CACHE_H
+#define CATALOG_CACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QSet>
+#include <QStringList>
+#include "database_manager.h"
+
+class CatalogChangeListener;
+class DatabaseExecutor;
+
+// Что изменилось в каталоге по пачке уведомлений
+struct CatalogChanges {
+    QSet<int> songs;                     // песни добавлены, изменены или удалены
+    QSet<int> playlists;                 // плейлисты созданы, переименованы или удалены
+    QHash<int, QSet<int>> playlistSongs; // плейлист -> песни, добавленные, перемещенные или убранные
+
+    bool isEmpty() const { return songs.isEmpty() && playlists.isEmpty() && playlistSongs.isEmpty(); }
+};
+
+// Локальная копия плейлистов и их состава для GUI-потока. Снимок загружается один раз,
+// дальше копия поддерживается построчными уведомлениями триггеров (CatalogChangeListener),
+// в том числе об изменениях, сделанных другими копиями программы. Об изменениях песен
+// кэш только сообщает: строки списков обновляют сами представления.
+// Пока нет подписки (isLive() == false), вызывающий код перечитывает данные по-старому.
+class CatalogCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CatalogCache(DatabaseExecutor *executor, QObject *parent = nullptr);
+    // Останавливает поток подписки
+    ~CatalogCache() override;
+
+    // Загружает снимок и подписывается на изменения
+    void start();
+    // Перечитывает снимок (например, после потери уведомлений)
+    void reload();
+    bool isLive() const;
+
+    // Отсортированы по названию, как в loadPlaylists()
+    QList<PlaylistInfo> playlists() const;
+    QString playlistName(int playlistId) const;
+    bool containsSong(int playlistId, int songId) const;
+
+    // Собственные изменения применяются сразу, не дожидаясь уведомления
+    void insertPlaylist(const PlaylistInfo &playlist);
+    void removePlaylist(int playlistId);
+
+signals:
+    void playlistsChanged();
+    void catalogChanged(const CatalogChanges &changes);
+    // Уведомления могли потеряться: данные представлений нужно перечитать целиком
+    void resyncRequired();
+
+private:
+    static quint64 membershipKey(int playlistId, int songId);
+
+    void handleChanges(const QStringList &payloads);
+    // Возвращает плейлисты, которые нужно дочитать из БД
+    QSet<int> applyChange(const QString &payload, CatalogChanges &changes);
+    void sortPlaylists();
+
+    DatabaseExecutor *m_executor;
+    QPointer<CatalogChangeListener> m_listener;
+    QList<PlaylistInfo> m_playlists;
+    QSet<quint64> m_membership;    // membershipKey(playlist_id, song_id)
+    bool m_subscribed = false;
+    bool m_loaded = false;
+    bool m_loading = false;
+    QStringList m_deferred;        // уведомления, пришедшие во время загрузки снимка
+};
+
+#endif // CATALOG_CACHE_H
@@ -0,0 +1,62 @@
+#include "catalog_change_listener.h"
+#include "database_manager.h"
+
+#include <QTimer>
+
+CatalogChangeListener::CatalogChangeListener(QObject *parent)
+    : QThread(parent)
+{
+}
+
+void CatalogChangeListener::run()
+{
+    // Соединение и его драйвер живут в этом потоке: QSqlDriver::notification
+    // доставляется циклом событий потока, в котором открыто соединение
+    DatabaseManager database(QString("catalog_change_listener_%1").arg(quintptr(this)));
+    if (!database.open() || !database.subscribe(Channel)) {
+        return;
+    }
+
+    QStringList pending;
+    QTimer batchTimer;
+    batchTimer.setSingleShot(true);
+    batchTimer.setInterval(BatchDelayMs);
+    connect(&batchTimer, &QTimer::timeout, [this, &pending] {
+        emit changesReceived(pending);
+        pending.clear();
+    });
+    connect(database.driver(), &QSqlDriver::notification,
+            [&pending, &batchTimer](const QString &name, QSqlDriver::NotificationSource, const QVariant &payload) {
+        if (name != QLatin1String(Channel)) {
+            return;
+        }
+        pending.append(payload.toString());
+        if (!batchTimer.isActive()) {
+            batchTimer.start();
+        }
+    });
+
+    // Оборванное соединение уведомлений не присылает и само об этом не сообщает
+    bool listening = true;
+    QTimer healthTimer;
+    healthTimer.setInterval(HealthCheckMs);
+    connect(&healthTimer, &QTimer::timeout, [this, &database, &listening] {
+        bool reconnected = false;
+        if (!database.ensureConnected(&reconnected)) {
+            listening = false;
+            return;
+        }
+        if (reconnected) {
+            listening = false;
+        }
+        if (!listening && database.subscribe(Channel)) {
+            listening = true;
+            qDebug() << "Подписка на изменения каталога восстановлена";
+            emit resyncRequired();
+        }
+    });
+    healthTimer.start();
+
+    emit subscribed();
+    exec();
+}
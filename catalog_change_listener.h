@@ -0,0 +1,35 @@
+#ifndef CATALOG_CHANGE_LISTENER_H
+#define CATALOG_CHANGE_LISTENER_H
+
+#include <QStringList>
+#include <QThread>
+
+// Слушает канал catalog_changes (LISTEN) через собственное соединение. Уведомления
+// приходят через цикл событий этого потока и отдаются пачками раз в BatchDelayMs,
+// чтобы массовые изменения (импорт, удаление плейлиста) не будили GUI на каждую строку.
+// Соединение периодически проверяется; после переподключения уведомления за время
+// обрыва потеряны, о чем сообщает resyncRequired(). Останавливается через quit().
+class CatalogChangeListener : public QThread
+{
+    Q_OBJECT
+
+public:
+    static constexpr const char *Channel = "catalog_changes";
+
+    explicit CatalogChangeListener(QObject *parent = nullptr);
+
+signals:
+    void subscribed();
+    // Полезные нагрузки уведомлений в порядке получения, см. notify_catalog_change()
+    void changesReceived(const QStringList &payloads);
+    void resyncRequired();
+
+protected:
+    void run() override;
+
+private:
+    static constexpr int BatchDelayMs = 50;
+    static constexpr int HealthCheckMs = 10000;
+};
+
+#endif // CATALOG_CHANGE_LISTENER_H
@@ -0,0 +1,34 @@
+#include "catalog_normalizer.h"
+#include "database_manager.h"
+
+CatalogNormalizer::CatalogNormalizer(QObject *parent)
+    : QThread(parent)
+{
+}
+
+void CatalogNormalizer::run()
+{
+    // Соединение QSqlDatabase можно использовать только в создавшем его потоке
+    DatabaseManager database(QString("catalog_normalizer_%1").arg(quintptr(this)));
+    if (!database.open()) {
+        emit normalizationFinished(0);
+        return;
+    }
+
+    // Проход по ID вперед: песни, которые не удалось связать, не выбираются повторно
+    int linkedSongs = 0;
+    int afterId = 0;
+    while (!isInterruptionRequested()) {
+        int linked = 0;
+        const int lastId = database.linkSongsToCatalog(afterId, BatchSize, &linked);
+        if (lastId <= 0) {
+            break;
+        }
+        linkedSongs += linked;
+        afterId = lastId;
+    }
+    if (linkedSongs > 0) {
+        qDebug() << "Песен связано со справочниками исполнителей и альбомов:" << linkedSongs;
+    }
+    emit normalizationFinished(linkedSongs);
+}
@@ -0,0 +1,27 @@
+#ifndef CATALOG_NORMALIZER_H
+#define CATALOG_NORMALIZER_H
+
+#include <QThread>
+
+// Фоновое связывание песен со справочниками: для строк Songs без artist_id/album_id
+// исполнители и альбомы находятся или создаются пачками (DatabaseManager::resolve*),
+// по одному запросу на пачку имен, и ID записываются одним UPDATE на пачку песен.
+// Работает через собственное соединение; прерывание сохраняет уже обработанные пачки.
+class CatalogNormalizer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit CatalogNormalizer(QObject *parent = nullptr);
+
+signals:
+    void normalizationFinished(int linkedSongs);
+
+protected:
+    void run() override;
+
+private:
+    static constexpr int BatchSize = 500;
+};
+
+#endif // CATALOG_NORMALIZER_H
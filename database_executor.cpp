@@ -0,0 +1,59 @@
+#include "database_executor.h"
+#include "database_manager.h"
+
+DatabaseExecutor::DatabaseExecutor(QObject *parent)
+    : QThread(parent)
+{
+}
+
+DatabaseExecutor::~DatabaseExecutor()
+{
+    shutdown();
+    wait();
+}
+
+void DatabaseExecutor::shutdown()
+{
+    QMutexLocker locker(&m_mutex);
+    m_stopping = true;
+    m_jobAdded.wakeAll();
+}
+
+bool DatabaseExecutor::enqueue(Job job)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_stopping) {
+        qDebug() << "Исполнитель БД остановлен, задание отклонено";
+        return false; // задание уничтожится вместе с QPromise, и future станет отмененным
+    }
+    m_jobs.enqueue(std::move(job));
+    m_jobAdded.wakeOne();
+    return true;
+}
+
+void DatabaseExecutor::run()
+{
+    // Соединение QSqlDatabase можно использовать только в создавшем его потоке
+    DatabaseManager database(QString("database_executor_%1").arg(quintptr(this)));
+
+    forever {
+        Job job;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_jobs.isEmpty() && !m_stopping) {
+                m_jobAdded.wait(&m_mutex);
+            }
+            if (m_jobs.isEmpty()) {
+                break; // остановка и очередь пуста
+            }
+            job = m_jobs.dequeue();
+        }
+
+        // Соединение открывается при первом задании и после неудачной попытки;
+        // если БД недоступна, запросы просто вернут ошибку, как и синхронные вызовы
+        database.open();
+        job(database);
+        // Между заданиями соединение не держит ни результатов, ни (в SQLite) транзакций
+        database.releaseStatements();
+    }
+}
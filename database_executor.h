@@ -0,0 +1,77 @@
+#ifndef DATABASE_EXECUTOR_H
+#define DATABASE_EXECUTOR_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QFuture>
+#include <QPromise>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+class DatabaseManager;
+
+// Выполняет запросы к БД в отдельном потоке со своим соединением, чтобы GUI-поток
+// никогда не ждал базу. Задания выполняются строго в порядке отправки одним потоком,
+// поэтому записи не обгоняют друг друга, а чтение видит все записи, отправленные до него.
+// Результат приходит через QFuture; future.cancel() отменяет задание, которое еще не начало
+// выполняться (уже идущий запрос доработает, но его результат будет отброшен).
+class DatabaseExecutor : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit DatabaseExecutor(QObject *parent = nullptr);
+    // Дожидается выполнения уже поставленных заданий (в том числе записей) и останавливает поток
+    ~DatabaseExecutor() override;
+
+    // job вызывается в потоке исполнителя как job(DatabaseManager &) и не должен
+    // обращаться к объектам GUI; результат удобно забирать через future.then(context, ...)
+    template <typename Function>
+    auto submit(Function job) -> QFuture<std::invoke_result_t<Function, DatabaseManager &>>;
+
+    // Новые задания больше не принимаются, очередь дорабатывает до конца
+    void shutdown();
+
+protected:
+    void run() override;
+
+private:
+    using Job = std::function<void(DatabaseManager &)>;
+
+    bool enqueue(Job job);
+
+    QMutex m_mutex;
+    QWaitCondition m_jobAdded;
+    QQueue<Job> m_jobs;
+    bool m_stopping = false;
+};
+
+template <typename Function>
+auto DatabaseExecutor::submit(Function job) -> QFuture<std::invoke_result_t<Function, DatabaseManager &>>
+{
+    using Result = std::invoke_result_t<Function, DatabaseManager &>;
+
+    // std::function требует копируемости, поэтому QPromise живет в shared_ptr.
+    // Если задание так и не выполнится, деструктор QPromise переведет future в отмененное состояние.
+    auto promise = std::make_shared<QPromise<Result>>();
+    QFuture<Result> future = promise->future();
+    enqueue([promise, job = std::move(job)](DatabaseManager &database) mutable {
+        if (promise->isCanceled()) {
+            promise->finish();
+            return;
+        }
+        promise->start();
+        if constexpr (std::is_void_v<Result>) {
+            job(database);
+        } else {
+            promise->addResult(job(database));
+        }
+        promise->finish();
+    });
+    return future;
+}
+
+#endif // DATABASE_EXECUTOR_H
@@ -1,21 +1,185 @@
 #include "database_manager.h"
 #include <QCryptographicHash> // Для хэширования паролей, если потребуется
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QRegularExpression>
+#include <QSqlDriver>
+#include <QSqlField>
+#include <QStringList>
+#include <QVersionNumber>
+#include "sql_row_mapper.h"
+#include "schema_migrator.h"
+#include "dsp_chain.h"
+#include "query_metrics.h"
+#include <cmath>
 
-DatabaseManager::DatabaseManager()
+// Колонки результатов запросов для каждой структуры, описанные один раз
+template <>
+struct SqlRowMapping<SongInfo> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &SongInfo::id),
+        sqlColumn("title", &SongInfo::title),
+        sqlColumn("artist", &SongInfo::artist),
+        sqlColumn("album", &SongInfo::album),
+        sqlColumn("file_path", &SongInfo::filePath),
+        sqlColumn("duration_ms", &SongInfo::durationMs),
+        sqlColumn("song_order", &SongInfo::playlistOrder));
+};
+
+template <>
+struct SqlRowMapping<PlaylistInfo> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &PlaylistInfo::id),
+        sqlColumn("name", &PlaylistInfo::name));
+};
+
+template <>
+struct SqlRowMapping<ArtistInfo> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &ArtistInfo::id),
+        sqlColumn("name", &ArtistInfo::name),
+        sqlColumn("bio", &ArtistInfo::bio));
+};
+
+template <>
+struct SqlRowMapping<AlbumInfo> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &AlbumInfo::id),
+        sqlColumn("title", &AlbumInfo::title),
+        sqlColumn("artist_id", &AlbumInfo::artistId),
+        sqlColumn("release_year", &AlbumInfo::releaseYear));
+};
+
+template <>
+struct SqlRowMapping<GenreInfo> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &GenreInfo::id),
+        sqlColumn("name", &GenreInfo::name));
+};
+
+template <>
+struct SqlRowMapping<UserInfo> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &UserInfo::id),
+        sqlColumn("username", &UserInfo::username),
+        sqlColumn("email", &UserInfo::email));
+};
+
+template <>
+struct SqlRowMapping<SongScanState> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &SongScanState::id),
+        sqlColumn("file_path", &SongScanState::filePath),
+        sqlColumn("album", &SongScanState::album),
+        sqlColumn("artist", &SongScanState::artist),
+        sqlColumn("file_mtime", &SongScanState::fileMtime),
+        sqlColumn("file_size", &SongScanState::fileSize),
+        sqlColumn("has_loudness", &SongScanState::hasLoudness));
+};
+
+template <>
+struct SqlRowMapping<SongLoudnessInfo> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &SongLoudnessInfo::songId),
+        sqlColumn("loudness_lufs", &SongLoudnessInfo::integratedLufs),
+        sqlColumn("loudness_range_lu", &SongLoudnessInfo::rangeLu),
+        sqlColumn("true_peak_dbtp", &SongLoudnessInfo::truePeakDbtp),
+        sqlColumn("replaygain_track_db", &SongLoudnessInfo::replayGainDb),
+        sqlColumn("loudness_histogram", &SongLoudnessInfo::histogram));
+};
+
+template <>
+struct SqlRowMapping<AlbumLoudnessInfo> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("album", &AlbumLoudnessInfo::album),
+        sqlColumn("artist", &AlbumLoudnessInfo::artist));
+};
+
+template <>
+struct SqlRowMapping<PlaybackEntryInfo> {
+    static constexpr auto columns = std::make_tuple(
+        sqlColumn("id", &PlaybackEntryInfo::id),
+        sqlColumn("user_id", &PlaybackEntryInfo::userId),
+        sqlColumn("song_id", &PlaybackEntryInfo::songId),
+        sqlColumn("played_at", &PlaybackEntryInfo::playedAt));
+};
+
+namespace {
+
+// Общая часть upsert'а песни по пути к файлу для addSong и addSongs. Строка переписывается,
+// только если поля действительно отличаются (иначе UPDATE создает новую версию строки
+// и WAL впустую). Нулевая длительность означает "еще неизвестна" и не затирает сохраненную.
+// Смена исполнителя или альбома сбрасывает artist_id/album_id: связь восстановит
+// CatalogNormalizer
+const char songUpsertConflict[] =
+    "ON CONFLICT (file_path) DO UPDATE SET title = EXCLUDED.title, artist = EXCLUDED.artist, album = EXCLUDED.album, "
+    "artist_id = CASE WHEN Songs.artist IS DISTINCT FROM EXCLUDED.artist THEN NULL ELSE Songs.artist_id END, "
+    "album_id = CASE WHEN (Songs.artist, Songs.album) IS DISTINCT FROM (EXCLUDED.artist, EXCLUDED.album) THEN NULL ELSE Songs.album_id END, "
+    "duration_ms = COALESCE(NULLIF(EXCLUDED.duration_ms, 0), Songs.duration_ms) "
+    "WHERE (Songs.title, Songs.artist, Songs.album, Songs.duration_ms) IS DISTINCT FROM "
+    "(EXCLUDED.title, EXCLUDED.artist, EXCLUDED.album, COALESCE(NULLIF(EXCLUDED.duration_ms, 0), Songs.duration_ms))";
+
+// IS DISTINCT FROM появился в SQLite 3.39, RETURNING — в 3.35, UPDATE ... FROM — в 3.33
+const QVersionNumber minimumSqliteVersion(3, 39);
+
+// Размер следующей пачки многострочного запроса: полная пачка, а хвост — наибольшей
+// помещающейся в него степенью двойки. Так у запроса не больше log2(maxRows) + 2 вариантов
+// текста, и каждый новый размер хвоста не добавляет в кэш еще один PREPARE
+int chunkRows(int remaining, int maxRows)
+{
+    if (remaining >= maxRows) {
+        return maxRows;
+    }
+    int rows = 1;
+    while (rows * 2 <= remaining) {
+        rows *= 2;
+    }
+    return rows;
+}
+
+// INSERT/UPDATE/DELETE в тексте (в том числе в WITH и SELECT ... FOR UPDATE): такой запрос
+// пишет или блокирует строки
+bool modifiesData(const QString &sql)
+{
+    static const QRegularExpression writeKeyword("\\b(INSERT|UPDATE|DELETE|MERGE)\\b",
+                                                 QRegularExpression::CaseInsensitiveOption);
+    return writeKeyword.match(sql).hasMatch();
+}
+
+} // namespace
+
+DatabaseManager::DatabaseManager(DatabaseBackend backend)
+    : m_backend(backend)
+{
+    db = QSqlDatabase::addDatabase(backend == DatabaseBackend::Sqlite ? "QSQLITE" : "QPSQL");
+}
+
+DatabaseManager::DatabaseManager(const QString &connectionName)
+    : m_connectionName(connectionName)
 {
-    db = QSqlDatabase::addDatabase("QPSQL"); // Можно сделать тип БД параметризуемым
+    // Копируем тип драйвера и параметры подключения основного соединения
+    db = QSqlDatabase::cloneDatabase(QSqlDatabase::defaultConnection, connectionName);
+    m_backend = db.driverName() == "QSQLITE" ? DatabaseBackend::Sqlite : DatabaseBackend::PostgreSql;
 }
 
 DatabaseManager::~DatabaseManager()
 {
+    clearStatementCache();
+    QueryMetrics::instance().removeStatementCacheStats(statementCacheStats().connection);
     if (db.isOpen()) {
         db.close();
     }
+    if (!m_connectionName.isEmpty()) {
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
 }
 
-bool DatabaseManager::connectToDatabase(const QString& hostName, int port,
-                                        const QString& dbName, const QString& userName,
-                                        const QString& password)
+void DatabaseManager::setConnectionParameters(const QString& hostName, int port,
+                                              const QString& dbName, const QString& userName,
+                                              const QString& password)
 {
     db.setHostName(hostName);
     db.setPort(port);
@@ -25,126 +189,441 @@ bool DatabaseManager::connectToDatabase(const QString& hostName, int port,
 
     // НОВОЕ: Установка кодировки клиента для соединения с PostgreSQL
     db.setConnectOptions("client_encoding=UTF8");
+}
+
+void DatabaseManager::setDatabaseFile(const QString &path)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    db.setDatabaseName(path);
+    // Пока другое соединение пишет, запись ждет до 5 с вместо немедленного SQLITE_BUSY
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+}
+
+bool DatabaseManager::connectToDatabase(const QString& hostName, int port,
+                                        const QString& dbName, const QString& userName,
+                                        const QString& password)
+{
+    setConnectionParameters(hostName, port, dbName, userName, password);
 
+    // Подготовленные запросы принадлежат старому соединению
+    clearStatementCache();
     if (!db.open()) {
         qDebug() << "Ошибка подключения к базе данных:" << db.lastError().text();
         return false;
-    } else {
-        qDebug() << "Успешное подключение к базе данных!";
+    }
+    if (!configureConnection()) {
+        db.close();
+        return false;
+    }
+    qDebug() << "Успешное подключение к базе данных!";
+    return true;
+}
+
+bool DatabaseManager::open()
+{
+    if (db.isOpen()) {
         return true;
     }
+    clearStatementCache();
+    if (!db.open()) {
+        qDebug() << "Ошибка открытия соединения" << m_connectionName << ":" << db.lastError().text();
+        return false;
+    }
+    if (!configureConnection()) {
+        db.close();
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::configureConnection()
+{
+    if (!isSqlite()) {
+        return true;
+    }
+    QSqlQuery query(db);
+    if (!query.exec("SELECT sqlite_version();") || !query.next()) {
+        qDebug() << "Ошибка чтения версии SQLite:" << query.lastError().text();
+        return false;
+    }
+    const QString version = query.value(0).toString();
+    if (QVersionNumber::fromString(version) < minimumSqliteVersion) {
+        qDebug() << "Нужен SQLite" << minimumSqliteVersion.toString() << "или новее, драйвер собран с" << version;
+        return false;
+    }
+    query.finish();
+
+    // WAL: читатели не ждут писателя, а фиксация — это дописывание в журнал, поэтому
+    // synchronous=NORMAL достаточно (после сбоя питания теряется лишь последняя транзакция).
+    // Файл отображается в память, временные таблицы сортировок держатся в ней же
+    const QStringList pragmas = {
+        "PRAGMA journal_mode = WAL;",
+        "PRAGMA synchronous = NORMAL;",
+        "PRAGMA foreign_keys = ON;",
+        "PRAGMA mmap_size = 268435456;",
+        "PRAGMA cache_size = -16000;",
+        "PRAGMA temp_store = MEMORY;",
+    };
+    for (const QString &pragma : pragmas) {
+        if (!query.exec(pragma)) {
+            qDebug() << "Ошибка настройки соединения SQLite:" << pragma << query.lastError().text();
+            return false;
+        }
+        query.finish();
+    }
+    return true;
 }
 
 void DatabaseManager::disconnectFromDatabase()
 {
+    clearStatementCache();
     if (db.isOpen()) {
         db.close();
     }
 }
 
-bool DatabaseManager::createTables()
+QString DatabaseManager::connectionName() const
 {
-    QSqlQuery query(db);
-    bool success = true;
-
-    // Таблица Songs
-    if (!query.exec("CREATE TABLE IF NOT EXISTS Songs ("
-                    "id SERIAL PRIMARY KEY,"
-                    "title VARCHAR(255) NOT NULL,"
-                    "artist VARCHAR(255),"
-                    "album VARCHAR(255),"
-                    "file_path TEXT NOT NULL UNIQUE,"
-                    "duration_ms INTEGER"
-                    ");")) {
-        qDebug() << "Ошибка создания таблицы Songs:" << query.lastError().text();
-        success = false;
-    }
-
-    // Таблица Playlists
-    if (!query.exec("CREATE TABLE IF NOT EXISTS Playlists ("
-                    "id SERIAL PRIMARY KEY,"
-                    "name VARCHAR(255) NOT NULL UNIQUE"
-                    ");")) {
-        qDebug() << "Ошибка создания таблицы Playlists:" << query.lastError().text();
-        success = false;
-    }
-
-    // Таблица PlaylistSongs
-    if (!query.exec("CREATE TABLE IF NOT EXISTS PlaylistSongs ("
-                    "playlist_id INTEGER REFERENCES Playlists(id) ON DELETE CASCADE,"
-                    "song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,"
-                    "song_order INTEGER,"
-                    "PRIMARY KEY (playlist_id, song_id)"
-                    ");")) {
-        qDebug() << "Ошибка создания таблицы PlaylistSongs:" << query.lastError().text();
-        success = false;
-    }
-
-    // Новые таблицы
-    // Таблица Artists
-    if (!query.exec("CREATE TABLE IF NOT EXISTS Artists ("
-                    "id SERIAL PRIMARY KEY,"
-                    "name VARCHAR(255) NOT NULL UNIQUE,"
-                    "bio TEXT"
-                    ");")) {
-        qDebug() << "Ошибка создания таблицы Artists:" << query.lastError().text();
-        success = false;
-    }
-
-    // Таблица Albums
-    if (!query.exec("CREATE TABLE IF NOT EXISTS Albums ("
-                    "id SERIAL PRIMARY KEY,"
-                    "title VARCHAR(255) NOT NULL,"
-                    "artist_id INTEGER REFERENCES Artists(id) ON DELETE SET NULL,"
-                    "release_year INTEGER,"
-                    "UNIQUE(title, artist_id)"
-                    ");")) {
-        qDebug() << "Ошибка создания таблицы Albums:" << query.lastError().text();
-        success = false;
-    }
-
-    // Таблица Genres
-    if (!query.exec("CREATE TABLE IF NOT EXISTS Genres ("
-                    "id SERIAL PRIMARY KEY,"
-                    "name VARCHAR(255) NOT NULL UNIQUE"
-                    ");")) {
-        qDebug() << "Ошибка создания таблицы Genres:" << query.lastError().text();
-        success = false;
-    }
-
-    // Таблица SongGenres
-    if (!query.exec("CREATE TABLE IF NOT EXISTS SongGenres ("
-                    "song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,"
-                    "genre_id INTEGER REFERENCES Genres(id) ON DELETE CASCADE,"
-                    "PRIMARY KEY (song_id, genre_id)"
-                    ");")) {
-        qDebug() << "Ошибка создания таблицы SongGenres:" << query.lastError().text();
-        success = false;
-    }
-
-    // Таблица Users
-    if (!query.exec("CREATE TABLE IF NOT EXISTS Users ("
-                    "id SERIAL PRIMARY KEY,"
-                    "username VARCHAR(255) NOT NULL UNIQUE,"
-                    "password_hash TEXT NOT NULL,"
-                    "email VARCHAR(255) UNIQUE"
-                    ");")) {
-        qDebug() << "Ошибка создания таблицы Users:" << query.lastError().text();
-        success = false;
-    }
-
-    // Таблица PlaybackHistory
-    if (!query.exec("CREATE TABLE IF NOT EXISTS PlaybackHistory ("
-                    "id SERIAL PRIMARY KEY,"
-                    "user_id INTEGER REFERENCES Users(id) ON DELETE CASCADE,"
-                    "song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,"
-                    "played_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP"
-                    ");")) {
-        qDebug() << "Ошибка создания таблицы PlaybackHistory:" << query.lastError().text();
-        success = false;
-    }
-
-    return success;
+    return m_connectionName;
+}
+
+DatabaseBackend DatabaseManager::backend() const
+{
+    return m_backend;
+}
+
+StatementCacheStats DatabaseManager::statementCacheStats() const
+{
+    StatementCacheStats stats = m_statementStats;
+    stats.connection = m_connectionName.isEmpty() ? QStringLiteral("main") : m_connectionName;
+    stats.size = int(m_statements.size());
+    return stats;
+}
+
+void DatabaseManager::releaseStatements()
+{
+    if (m_lastStatement) {
+        m_lastStatement->finish();
+        m_lastStatement = nullptr;
+    }
+    capturePendingPlan();
+}
+
+// --- Кэш подготовленных запросов ---
+// Каждый запрос готовится один раз на соединение (в QPSQL это серверный PREPARE)
+// и дальше только получает новые значения параметров.
+// Методы читают результат запроса до конца, прежде чем взять следующий, поэтому
+// результат предыдущего запроса здесь закрывается
+QSqlQuery &DatabaseManager::statement(const QString &id, const QString &sql)
+{
+    PreparedStatement *entry = m_statements.value(id);
+    if (!entry) {
+        if (m_statements.size() >= MaxCachedStatements) {
+            evictStatement();
+        }
+        entry = new PreparedStatement{id, sql, QSqlQuery(db), false};
+        m_statements.insert(id, entry);
+        m_statementsByQuery.insert(&entry->query, entry);
+    }
+    entry->lastUse = ++m_statementUses;
+    if (m_lastStatement != &entry->query) {
+        releaseStatements();
+        m_lastStatement = &entry->query;
+    }
+
+    if (entry->prepared) {
+        ++m_statementStats.hits;
+        entry->query.finish(); // освобождаем результат предыдущего выполнения
+        return entry->query;
+    }
+
+    ++m_statementStats.misses;
+    entry->query.setForwardOnly(true);
+    entry->prepared = entry->query.prepare(entry->sql);
+    if (!entry->prepared) {
+        qDebug() << "Ошибка подготовки запроса" << id << ":" << entry->query.lastError().text();
+    }
+    return entry->query;
+}
+
+// Удаление QSqlQuery освобождает и серверный PREPARE. Недавно взятые запросы (на них
+// еще могут ссылаться вызывающие методы) до вытеснения не доходят
+void DatabaseManager::evictStatement()
+{
+    PreparedStatement *oldest = nullptr;
+    for (PreparedStatement *entry : std::as_const(m_statements)) {
+        if (&entry->query != m_lastStatement && (!oldest || entry->lastUse < oldest->lastUse)) {
+            oldest = entry;
+        }
+    }
+    if (!oldest) {
+        return;
+    }
+    m_statementsByQuery.remove(&oldest->query);
+    m_statements.remove(oldest->id);
+    delete oldest;
+    ++m_statementStats.evictions;
+}
+
+bool DatabaseManager::execStatement(QSqlQuery &query)
+{
+    capturePendingPlan();
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = execWithReconnect(query);
+    const qint64 elapsedNs = timer.nsecsElapsed();
+
+    const PreparedStatement *entry = m_statementsByQuery.value(&query);
+    if (!entry) {
+        return ok;
+    }
+    QueryMetrics &metrics = QueryMetrics::instance();
+    const QString name = QueryMetrics::metricName(entry->id);
+    if (metrics.record(name, elapsedNs, ok)) {
+        m_pendingPlanStatement = name;
+        m_pendingPlanSql = inlineParameters(query, entry->sql);
+        // RETURNING делает isSelect() истинным и у записи, поэтому смотрим и на текст
+        m_pendingPlanAnalyze = query.isSelect() && !modifiesData(entry->sql);
+    }
+    metrics.setStatementCacheStats(statementCacheStats());
+    // Строки выборки считаются при чтении (readRows), в SQLite numRowsAffected()
+    // для SELECT вернул бы счетчик предыдущей записи
+    if (ok && !query.isSelect()) {
+        metrics.addRows(name, query.numRowsAffected());
+    }
+    return ok;
+}
+
+bool DatabaseManager::execWithReconnect(QSqlQuery &query)
+{
+    if (query.exec()) {
+        return true;
+    }
+
+    // Повторяем один раз, если ошибка вызвана потерей соединения, а не самим запросом.
+    // Внутри транзакции повтор невозможен: ее начало осталось на старом соединении.
+    PreparedStatement *entry = m_statementsByQuery.value(&query);
+    if (!entry || m_inTransaction || isConnectionAlive()) {
+        return false;
+    }
+    const QVariantList values = query.boundValues();
+    qDebug() << "Соединение с БД потеряно, переподключение...";
+    if (!reconnect()) {
+        return false;
+    }
+
+    ++m_statementStats.misses;
+    entry->query.setForwardOnly(true);
+    entry->prepared = entry->query.prepare(entry->sql);
+    for (int i = 0; i < values.size(); ++i) {
+        entry->query.bindValue(i, values.at(i));
+    }
+    return entry->prepared && entry->query.exec();
+}
+
+bool DatabaseManager::isConnectionAlive()
+{
+    QSqlQuery ping(db);
+    return ping.exec("SELECT 1");
+}
+
+bool DatabaseManager::reconnect()
+{
+    db.close();
+    if (!db.open() || !configureConnection()) {
+        qDebug() << "Не удалось переподключиться к базе данных:" << db.lastError().text();
+        return false;
+    }
+    // Объекты запросов остаются на месте (на них могут ссылаться вызывающие методы),
+    // но привязываются к новому соединению и будут подготовлены заново при обращении
+    for (PreparedStatement *entry : std::as_const(m_statements)) {
+        entry->query = QSqlQuery(db);
+        entry->prepared = false;
+    }
+    ++m_statementStats.rebuilds;
+    return true;
+}
+
+template <typename Struct>
+QList<Struct> DatabaseManager::readRows(QSqlQuery &query, qsizetype sizeHint)
+{
+    QList<Struct> rows = SqlRowMapper::readAll<Struct>(query, sizeHint);
+    countRows(query, rows.size());
+    return rows;
+}
+
+void DatabaseManager::countRows(const QSqlQuery &query, qsizetype rows)
+{
+    if (const PreparedStatement *entry = m_statementsByQuery.value(&query)) {
+        QueryMetrics::instance().addRows(QueryMetrics::metricName(entry->id), rows);
+    }
+}
+
+// EXPLAIN нельзя подготовить (PREPARE в PostgreSQL принимает только SELECT, INSERT,
+// UPDATE, DELETE и VALUES), поэтому значения параметров подставляются в текст литералами
+QString DatabaseManager::inlineParameters(const QSqlQuery &query, const QString &sql) const
+{
+    const auto literal = [this](const QVariant &value) {
+        QSqlField field(QString(), value.metaType());
+        field.setValue(value);
+        return db.driver()->formatValue(field);
+    };
+
+    QString result;
+    result.reserve(sql.size() + 64);
+    int position = 0;
+    bool quoted = false;
+    for (qsizetype i = 0; i < sql.size(); ++i) {
+        const QChar ch = sql.at(i);
+        if (ch == u'\'') {
+            quoted = !quoted;
+        } else if (!quoted && ch == u'?') {
+            result += literal(query.boundValue(position++));
+            continue;
+        } else if (!quoted && ch == u':' && i + 1 < sql.size()
+                   && (sql.at(i + 1).isLetter() || sql.at(i + 1) == u'_')
+                   && (i == 0 || sql.at(i - 1) != u':')) {
+            qsizetype end = i + 1;
+            while (end < sql.size() && (sql.at(end).isLetterOrNumber() || sql.at(end) == u'_')) {
+                ++end;
+            }
+            result += literal(query.boundValue(sql.mid(i, end - i)));
+            i = end - 1;
+            continue;
+        }
+        result += ch;
+    }
+    return result;
+}
+
+void DatabaseManager::capturePendingPlan()
+{
+    if (m_pendingPlanSql.isEmpty() || !db.isOpen()) {
+        return;
+    }
+    // EXPLAIN ANALYZE выполняет запрос еще раз: внутри транзакции вызывающего метода он
+    // продлил бы ее блокировки, поэтому план ждет первого запроса после ее завершения
+    if (!isSqlite() && m_inTransaction) {
+        return;
+    }
+    const QString statementId = std::exchange(m_pendingPlanStatement, QString());
+    const QString sql = std::exchange(m_pendingPlanSql, QString());
+
+    // Запись повторно не выполняется: даже откаченная, она снова взяла бы блокировки строк,
+    // потратила значения последовательностей и всю работу записи. Для нее — план без ANALYZE.
+    // Чтение выполняется в отдельной откатываемой транзакции. SQLite умеет только
+    // EXPLAIN QUERY PLAN, который ничего не выполняет
+    const bool analyze = !isSqlite() && m_pendingPlanAnalyze;
+    QSqlQuery control(db);
+    if (analyze && !control.exec("BEGIN;")) {
+        qDebug() << "Не удалось снять план запроса" << statementId << ":" << control.lastError().text();
+        return;
+    }
+    QStringList lines;
+    {
+        QSqlQuery explain(db);
+        explain.setForwardOnly(true);
+        const QString prefix = isSqlite() ? "EXPLAIN QUERY PLAN " : (analyze ? "EXPLAIN (ANALYZE, BUFFERS) " : "EXPLAIN ");
+        if (explain.exec(prefix + sql)) {
+            const int column = isSqlite() ? explain.record().indexOf("detail") : 0;
+            while (explain.next()) {
+                lines.append(explain.value(column).toString());
+            }
+        } else {
+            qDebug() << "Не удалось снять план запроса" << statementId << ":" << explain.lastError().text();
+        }
+    }
+    if (analyze) {
+        control.exec("ROLLBACK;");
+    }
+    if (!lines.isEmpty()) {
+        qDebug() << "Медленный запрос" << statementId << ", план сохранен в метриках";
+        QueryMetrics::instance().setPlan(statementId, lines.join(u'\n'));
+    }
+}
+
+void DatabaseManager::clearStatementCache()
+{
+    m_lastStatement = nullptr;
+    m_pendingPlanStatement.clear();
+    m_pendingPlanSql.clear();
+    m_pendingPlanAnalyze = false;
+    m_statementsByQuery.clear();
+    qDeleteAll(m_statements);
+    m_statements.clear();
+}
+
+bool DatabaseManager::beginTransaction()
+{
+    releaseStatements();
+    if (isSqlite()) {
+        // Блокировка записи берется сразу: отложенная транзакция, успев прочитать данные,
+        // при первой записи получила бы SQLITE_BUSY без ожидания busy_timeout
+        QSqlQuery query(db);
+        if (!query.exec("BEGIN IMMEDIATE;")) {
+            qDebug() << "Не удалось начать транзакцию:" << query.lastError().text();
+            return false;
+        }
+    } else if (!db.transaction()) {
+        qDebug() << "Не удалось начать транзакцию:" << db.lastError().text();
+        return false;
+    }
+    m_inTransaction = true;
+    return true;
+}
+
+bool DatabaseManager::commitTransaction()
+{
+    // Сначала закрываем запросы; план медленного запроса из транзакции снимается
+    // уже после ее завершения
+    releaseStatements();
+    m_inTransaction = false;
+    const bool committed = db.commit();
+    if (!committed) {
+        qDebug() << "Ошибка фиксации транзакции:" << db.lastError().text();
+        db.rollback();
+    }
+    capturePendingPlan();
+    return committed;
+}
+
+void DatabaseManager::rollbackTransaction()
+{
+    releaseStatements();
+    m_inTransaction = false;
+    db.rollback();
+    capturePendingPlan();
+}
+
+// Список ID одним параметром: массив PostgreSQL "{1,2}" для CAST(? AS INTEGER[])
+// или массив JSON "[1,2]" для json_each в SQLite
+QString DatabaseManager::idList(const QList<int> &values) const
+{
+    QStringList items;
+    items.reserve(values.size());
+    for (int value : values) {
+        items.append(QString::number(value));
+    }
+    return isSqlite() ? "[" + items.join(',') + "]" : "{" + items.join(',') + "}";
+}
+
+QString DatabaseManager::idListContains(const QString &expr, const QString &param) const
+{
+    return isSqlite() ? expr + " IN (SELECT value FROM json_each(" + param + "))"
+                      : expr + " = ANY (CAST(" + param + " AS INTEGER[]))";
+}
+
+QString DatabaseManager::idListExcludes(const QString &expr, const QString &param) const
+{
+    return isSqlite() ? expr + " NOT IN (SELECT value FROM json_each(" + param + "))"
+                      : expr + " <> ALL (CAST(" + param + " AS INTEGER[]))";
+}
+
+bool DatabaseManager::migrateSchema()
+{
+    // При актуальной схеме это одна проверка версии, а не создание всех таблиц заново
+    return SchemaMigrator(db).migrate();
 }
 
 // НОВОЕ: Реализация функции для заполнения БД начальными данными
@@ -164,39 +643,69 @@ bool DatabaseManager::seedDatabase()
 QList<SongInfo> DatabaseManager::loadSongs()
 {
     QList<SongInfo> songs;
-    QSqlQuery query(db);
-    if (query.exec("SELECT id, title, artist, album, file_path, duration_ms FROM Songs ORDER BY title")) {
-        while (query.next()) {
-            SongInfo song;
-            song.id = query.value("id").toInt();
-            song.title = query.value("title").toString();
-            song.artist = query.value("artist").toString();
-            song.album = query.value("album").toString();
-            song.filePath = query.value("file_path").toString();
-            song.durationMs = query.value("duration_ms").toInt();
-            songs.append(song);
-        }
+    QSqlQuery &query = statement("loadSongs", "SELECT id, title, artist, album, file_path, duration_ms FROM Songs ORDER BY title, id");
+    if (execStatement(query)) {
+        songs = readRows<SongInfo>(query);
     } else {
         qDebug() << "Ошибка загрузки песен из БД:" << query.lastError().text();
     }
     return songs;
 }
 
+QList<SongInfo> DatabaseManager::loadSongsPage(const QString &afterTitle, int afterId, int limit)
+{
+    QList<SongInfo> songs;
+    QSqlQuery *query = nullptr;
+    if (afterId == -1) {
+        query = &statement("loadSongsPage/first",
+                           "SELECT id, title, artist, album, file_path, duration_ms FROM Songs "
+                           "ORDER BY title, id LIMIT :limit;");
+    } else {
+        // Сравнение кортежей продолжает выборку с места остановки без OFFSET
+        query = &statement("loadSongsPage/after",
+                           "SELECT id, title, artist, album, file_path, duration_ms FROM Songs "
+                           "WHERE (title, id) > (:after_title, :after_id) "
+                           "ORDER BY title, id LIMIT :limit;");
+        query->bindValue(":after_title", afterTitle);
+        query->bindValue(":after_id", afterId);
+    }
+    query->bindValue(":limit", limit);
+    if (execStatement(*query)) {
+        songs = readRows<SongInfo>(*query, limit);
+    } else {
+        qDebug() << "Ошибка постраничной загрузки песен из БД:" << query->lastError().text();
+    }
+    return songs;
+}
+
 int DatabaseManager::addSong(const QString &filePath, const QString &title,
                              const QString &artist, const QString &album, int durationMs)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO Songs (title, artist, album, file_path, duration_ms) "
-                  "VALUES (:title, :artist, :album, :file_path, :duration_ms) "
-                  "ON CONFLICT (file_path) DO UPDATE SET title = EXCLUDED.title, artist = EXCLUDED.artist, album = EXCLUDED.album, duration_ms = EXCLUDED.duration_ms "
-                  "RETURNING id;");
+    if (isSqlite()) {
+        const int songId = addSongSqlite({-1, title, artist, album, filePath, durationMs});
+        if (songId != -1) {
+            qDebug() << "Песня добавлена/обновлена в БД с ID:" << songId;
+        }
+        return songId;
+    }
+    // Пропущенный UPDATE ничего не возвращает, поэтому ID существующей строки берем вторым SELECT
+    QSqlQuery &query = statement("addSong",
+                                 QString("WITH upsert AS ("
+                                         "INSERT INTO Songs (title, artist, album, file_path, duration_ms) "
+                                         "VALUES (:title, :artist, :album, :file_path, :duration_ms) ")
+                                 + songUpsertConflict +
+                                 " RETURNING id) "
+                                 "SELECT id FROM upsert "
+                                 "UNION ALL "
+                                 "SELECT id FROM Songs WHERE file_path = :lookup_file_path AND NOT EXISTS (SELECT 1 FROM upsert);");
     query.bindValue(":title", title);
     query.bindValue(":artist", artist);
     query.bindValue(":album", album);
     query.bindValue(":file_path", filePath);
     query.bindValue(":duration_ms", durationMs);
+    query.bindValue(":lookup_file_path", filePath);
 
-    if (query.exec()) {
+    if (execStatement(query)) {
         if (query.next()) {
             int songId = query.value(0).toInt();
             qDebug() << "Песня добавлена/обновлена в БД с ID:" << songId;
@@ -208,13 +717,148 @@ int DatabaseManager::addSong(const QString &filePath, const QString &title,
     return -1;
 }
 
+int DatabaseManager::addSongSqlite(const SongInfo &song)
+{
+    // SQLite не допускает изменение данных внутри WITH: upsert и чтение ID — два запроса
+    QSqlQuery &upsert = statement("addSong/upsert",
+                                  QString("INSERT INTO Songs (title, artist, album, file_path, duration_ms) "
+                                          "VALUES (:title, :artist, :album, :file_path, :duration_ms) ")
+                                  + songUpsertConflict + ";");
+    upsert.bindValue(":title", song.title);
+    upsert.bindValue(":artist", song.artist);
+    upsert.bindValue(":album", song.album);
+    upsert.bindValue(":file_path", song.filePath);
+    upsert.bindValue(":duration_ms", song.durationMs);
+    if (!execStatement(upsert)) {
+        qDebug() << "Ошибка при добавлении песни в БД:" << upsert.lastError().text();
+        return -1;
+    }
+
+    QSqlQuery &lookup = statement("songIdByPath", "SELECT id FROM Songs WHERE file_path = :file_path;");
+    lookup.bindValue(":file_path", song.filePath);
+    if (!execStatement(lookup) || !lookup.next()) {
+        qDebug() << "Ошибка чтения ID песни:" << song.filePath << lookup.lastError().text();
+        return -1;
+    }
+    return lookup.value(0).toInt();
+}
+
+QList<int> DatabaseManager::addSongs(const QList<SongInfo> &songs,
+                                     const std::function<void(int, int)> &progress)
+{
+    // 5 параметров на строку: 500 строк держат запрос далеко от лимита PostgreSQL в 65535 параметров
+    const int chunkSize = 500;
+
+    QList<int> ids(songs.size(), -1);
+    if (songs.isEmpty()) {
+        return ids;
+    }
+
+    // PostgreSQL не дает одному INSERT ... ON CONFLICT обновить строку дважды,
+    // поэтому из повторяющихся путей в пачку попадает только последнее вхождение
+    QHash<QString, int> lastIndexByPath;
+    lastIndexByPath.reserve(songs.size());
+    for (int i = 0; i < songs.size(); ++i) {
+        lastIndexByPath.insert(songs.at(i).filePath, i);
+    }
+    QList<int> uniqueIndexes;
+    uniqueIndexes.reserve(lastIndexByPath.size());
+    for (int i = 0; i < songs.size(); ++i) {
+        if (lastIndexByPath.value(songs.at(i).filePath) == i) {
+            uniqueIndexes.append(i);
+        }
+    }
+
+    if (!beginTransaction()) {
+        return ids;
+    }
+
+    QHash<QString, int> idByPath;
+    idByPath.reserve(uniqueIndexes.size());
+    if (isSqlite()) {
+        // Без сетевых обходов подготовленный upsert на строку внутри одной транзакции
+        // не медленнее многострочного
+        for (int i = 0; i < uniqueIndexes.size(); ++i) {
+            const SongInfo &song = songs.at(uniqueIndexes.at(i));
+            const int songId = addSongSqlite(song);
+            if (songId == -1) {
+                rollbackTransaction();
+                return QList<int>(songs.size(), -1);
+            }
+            idByPath.insert(song.filePath, songId);
+            if (progress && ((i + 1) % chunkSize == 0 || i + 1 == uniqueIndexes.size())) {
+                progress(i + 1, uniqueIndexes.size());
+            }
+        }
+    } else {
+        for (int start = 0, count = 0; start < uniqueIndexes.size(); start += count) {
+            count = chunkRows(int(uniqueIndexes.size()) - start, chunkSize);
+
+            QStringList rows;
+            rows.reserve(count);
+            for (int i = 0; i < count; ++i) {
+                rows.append(QStringLiteral("(CAST(? AS TEXT), CAST(? AS TEXT), CAST(? AS TEXT), CAST(? AS TEXT), CAST(? AS INTEGER))"));
+            }
+
+            // Полные пачки имеют одинаковый текст и переиспользуют один подготовленный запрос.
+            // Как и в addSong, неизменившиеся строки не переписываются, а их ID
+            // добираются из таблицы по путям пачки.
+            QSqlQuery &query = statement(QString("addSongs/%1").arg(count),
+                                         "WITH input (title, artist, album, file_path, duration_ms) AS (VALUES "
+                                         + rows.join(", ") +
+                                         "), upsert AS ("
+                                         "INSERT INTO Songs (title, artist, album, file_path, duration_ms) "
+                                         "SELECT title, artist, album, file_path, duration_ms FROM input "
+                                         + songUpsertConflict +
+                                         " RETURNING id, file_path) "
+                                         "SELECT id, file_path FROM upsert "
+                                         "UNION ALL "
+                                         "SELECT s.id, s.file_path FROM Songs s JOIN input i ON s.file_path = i.file_path "
+                                         "WHERE NOT EXISTS (SELECT 1 FROM upsert u WHERE u.file_path = s.file_path);");
+            for (int i = start; i < start + count; ++i) {
+                const SongInfo &song = songs.at(uniqueIndexes.at(i));
+                query.addBindValue(song.title);
+                query.addBindValue(song.artist);
+                query.addBindValue(song.album);
+                query.addBindValue(song.filePath);
+                query.addBindValue(song.durationMs);
+            }
+
+            if (!execStatement(query)) {
+                qDebug() << "Ошибка массового добавления песен:" << query.lastError().text();
+                rollbackTransaction();
+                return QList<int>(songs.size(), -1);
+            }
+            // Порядок строк RETURNING не гарантирован, поэтому сопоставляем по пути к файлу
+            const qsizetype known = idByPath.size();
+            while (query.next()) {
+                idByPath.insert(query.value(1).toString(), query.value(0).toInt());
+            }
+            countRows(query, idByPath.size() - known);
+
+            if (progress) {
+                progress(start + count, uniqueIndexes.size());
+            }
+        }
+    }
+
+    if (!commitTransaction()) {
+        return ids;
+    }
+
+    for (int i = 0; i < songs.size(); ++i) {
+        ids[i] = idByPath.value(songs.at(i).filePath, -1);
+    }
+    qDebug() << "Массовый импорт завершен, песен в библиотеке:" << idByPath.size();
+    return ids;
+}
+
 bool DatabaseManager::deleteSong(int songId)
 {
-    QSqlQuery query(db);
-    query.prepare("DELETE FROM Songs WHERE id = :id;");
+    QSqlQuery &query = statement("deleteSong", "DELETE FROM Songs WHERE id = :id;");
     query.bindValue(":id", songId);
 
-    if (query.exec()) {
+    if (execStatement(query)) {
         return query.numRowsAffected() > 0;
     } else {
         qDebug() << "Ошибка при удалении песни из БД:" << query.lastError().text();
@@ -226,14 +870,9 @@ bool DatabaseManager::deleteSong(int songId)
 QList<PlaylistInfo> DatabaseManager::loadPlaylists()
 {
     QList<PlaylistInfo> playlists;
-    QSqlQuery query(db);
-    if (query.exec("SELECT id, name FROM Playlists ORDER BY name")) {
-        while (query.next()) {
-            PlaylistInfo playlist;
-            playlist.id = query.value("id").toInt();
-            playlist.name = query.value("name").toString();
-            playlists.append(playlist);
-        }
+    QSqlQuery &query = statement("loadPlaylists", "SELECT id, name FROM Playlists ORDER BY name");
+    if (execStatement(query)) {
+        playlists = readRows<PlaylistInfo>(query);
     } else {
         qDebug() << "Ошибка загрузки плейлистов из БД:" << query.lastError().text();
     }
@@ -242,10 +881,9 @@ QList<PlaylistInfo> DatabaseManager::loadPlaylists()
 
 int DatabaseManager::createPlaylist(const QString &name)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO Playlists (name) VALUES (:name) RETURNING id;");
+    QSqlQuery &query = statement("createPlaylist", "INSERT INTO Playlists (name) VALUES (:name) RETURNING id;");
     query.bindValue(":name", name);
-    if (query.exec()) {
+    if (execStatement(query)) {
         if (query.next()) {
             return query.value(0).toInt();
         }
@@ -255,56 +893,312 @@ int DatabaseManager::createPlaylist(const QString &name)
     return -1;
 }
 
-bool DatabaseManager::addSongToPlaylist(int playlistId, int songId, int songOrder)
+bool DatabaseManager::addSongToPlaylist(int playlistId, int songId, int beforeSongId)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO PlaylistSongs (playlist_id, song_id, song_order) "
-                  "VALUES (:playlist_id, :song_id, :song_order) "
-                  "ON CONFLICT (playlist_id, song_id) DO UPDATE SET song_order = EXCLUDED.song_order;");
+    if (beforeSongId == -1) {
+        // В конец: ключ после последнего, одна строка и один запрос
+        QSqlQuery &query = statement("addSongToPlaylist",
+                                     "INSERT INTO PlaylistSongs (playlist_id, song_id, song_order) "
+                                     "SELECT :playlist_id, :song_id, COALESCE(MAX(song_order), 0) + :gap "
+                                     "FROM PlaylistSongs WHERE playlist_id = :order_playlist_id "
+                                     "ON CONFLICT (playlist_id, song_id) DO NOTHING RETURNING song_id;");
+        query.bindValue(":playlist_id", playlistId);
+        query.bindValue(":song_id", songId);
+        query.bindValue(":gap", PlaylistOrderGap);
+        query.bindValue(":order_playlist_id", playlistId);
+        if (!execStatement(query)) {
+            qDebug() << "Ошибка при добавлении песни в плейлист:" << query.lastError().text();
+            return false;
+        }
+        return query.next(); // false — песня уже в плейлисте
+    }
+
+    if (!beginTransaction()) {
+        return false;
+    }
+    QList<qint64> keys;
+    if (!lockPlaylist(playlistId) || !playlistOrderKeys(playlistId, beforeSongId, {songId}, 1, &keys)) {
+        rollbackTransaction();
+        return false;
+    }
+    QSqlQuery &query = statement("insertSongIntoPlaylist",
+                                 "INSERT INTO PlaylistSongs (playlist_id, song_id, song_order) "
+                                 "VALUES (:playlist_id, :song_id, :song_order) "
+                                 "ON CONFLICT (playlist_id, song_id) DO NOTHING RETURNING song_id;");
     query.bindValue(":playlist_id", playlistId);
     query.bindValue(":song_id", songId);
-    query.bindValue(":song_order", songOrder);
-    if (!query.exec()) {
-        qDebug() << "Ошибка при добавлении песни в плейлист:" << query.lastError().text();
+    query.bindValue(":song_order", keys.first());
+    if (!execStatement(query) || !query.next()) {
+        qDebug() << "Ошибка при вставке песни в плейлист:" << query.lastError().text();
+        rollbackTransaction();
         return false;
     }
-    return true;
+    return commitTransaction();
 }
 
-QList<SongInfo> DatabaseManager::getSongsInPlaylist(int playlistId)
+bool DatabaseManager::moveSongsInPlaylist(int playlistId, const QList<int> &songIds, int beforeSongId)
 {
-    QList<SongInfo> songs;
-    QSqlQuery query(db);
-    query.prepare("SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms "
-                  "FROM Songs s "
-                  "JOIN PlaylistSongs ps ON s.id = ps.song_id "
-                  "WHERE ps.playlist_id = :playlist_id "
-                  "ORDER BY ps.song_order;");
-    query.bindValue(":playlist_id", playlistId);
-    if (query.exec()) {
-        while (query.next()) {
-            SongInfo song;
-            song.id = query.value("id").toInt();
-            song.title = query.value("title").toString();
-            song.artist = query.value("artist").toString();
-            song.album = query.value("album").toString();
-            song.filePath = query.value("file_path").toString();
-            song.durationMs = query.value("duration_ms").toInt();
-            songs.append(song);
-        }
-    } else {
-        qDebug() << "Ошибка загрузки песен из плейлиста:" << query.lastError().text();
-    }
-    return songs;
-}
+    // Два значения на строку
+    const int chunkSize = 1000;
 
-bool DatabaseManager::removeSongFromPlaylist(int playlistId, int songId)
-{
-    QSqlQuery query(db);
-    query.prepare("DELETE FROM PlaylistSongs WHERE playlist_id = :playlist_id AND song_id = :song_id;");
+    if (songIds.isEmpty()) {
+        return true;
+    }
+    if (songIds.contains(beforeSongId)) {
+        qDebug() << "Песню нельзя переместить перед самой собой";
+        return false;
+    }
+    if (!beginTransaction()) {
+        return false;
+    }
+    QList<qint64> keys;
+    if (!lockPlaylist(playlistId) || !playlistOrderKeys(playlistId, beforeSongId, songIds, int(songIds.size()), &keys)) {
+        rollbackTransaction();
+        return false;
+    }
+
+    // Переписываются только перемещаемые строки
+    for (int start = 0, count = 0; start < songIds.size(); start += count) {
+        count = chunkRows(int(songIds.size()) - start, chunkSize);
+        QStringList rows;
+        rows.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            rows.append(QStringLiteral("(CAST(? AS INTEGER), CAST(? AS BIGINT))"));
+        }
+        // Список значений — в WITH: имена колонок у VALUES в FROM SQLite не поддерживает
+        QSqlQuery &query = statement(QString("moveSongsInPlaylist/%1").arg(count),
+                                     "WITH v (song_id, song_order) AS (VALUES " + rows.join(", ") + ") "
+                                     "UPDATE PlaylistSongs AS ps SET song_order = v.song_order FROM v "
+                                     "WHERE ps.playlist_id = CAST(? AS INTEGER) AND ps.song_id = v.song_id;");
+        for (int i = start; i < start + count; ++i) {
+            query.addBindValue(songIds.at(i));
+            query.addBindValue(keys.at(i));
+        }
+        query.addBindValue(playlistId);
+        if (!execStatement(query) || query.numRowsAffected() != count) {
+            qDebug() << "Ошибка перемещения песен в плейлисте:" << query.lastError().text();
+            rollbackTransaction();
+            return false;
+        }
+    }
+    return commitTransaction();
+}
+
+bool DatabaseManager::rebalancePlaylist(int playlistId)
+{
+    if (!beginTransaction()) {
+        return false;
+    }
+    if (!lockPlaylist(playlistId) || !renumberPlaylist(playlistId)) {
+        rollbackTransaction();
+        return false;
+    }
+    return commitTransaction();
+}
+
+int DatabaseManager::rebalanceCrowdedPlaylists()
+{
+    // Плейлисты, где соседние ключи сблизились после многих вставок в одно место
+    QList<int> playlistIds;
+    QSqlQuery &query = statement("loadCrowdedPlaylists",
+                                 "SELECT playlist_id FROM ("
+                                 "SELECT playlist_id, song_order - LAG(song_order) OVER "
+                                 "(PARTITION BY playlist_id ORDER BY song_order, song_id) AS gap "
+                                 "FROM PlaylistSongs) g "
+                                 "GROUP BY playlist_id HAVING MIN(gap) < :min_gap;");
+    query.bindValue(":min_gap", PlaylistMinGap);
+    if (!execStatement(query)) {
+        qDebug() << "Ошибка поиска плейлистов для перенумерации:" << query.lastError().text();
+        return 0;
+    }
+    while (query.next()) {
+        playlistIds.append(query.value(0).toInt());
+    }
+    countRows(query, playlistIds.size());
+
+    int rebalanced = 0;
+    for (int playlistId : std::as_const(playlistIds)) {
+        if (rebalancePlaylist(playlistId)) {
+            ++rebalanced;
+        }
+    }
+    return rebalanced;
+}
+
+bool DatabaseManager::lockPlaylist(int playlistId)
+{
+    // Изменения порядка одного плейлиста из разных соединений идут по очереди. В SQLite
+    // FOR UPDATE нет: транзакция BEGIN IMMEDIATE уже держит блокировку записи всей базы
+    QSqlQuery &query = statement("lockPlaylist", isSqlite() ? "SELECT id FROM Playlists WHERE id = :playlist_id;"
+                                                            : "SELECT id FROM Playlists WHERE id = :playlist_id FOR UPDATE;");
+    query.bindValue(":playlist_id", playlistId);
+    if (!execStatement(query) || !query.next()) {
+        qDebug() << "Плейлист не найден или не заблокирован:" << playlistId << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::renumberPlaylist(int playlistId)
+{
+    // Ключи снова идут с шагом PlaylistOrderGap; уже стоящие на месте строки не переписываются
+    QSqlQuery &query = statement("renumberPlaylist",
+                                 "UPDATE PlaylistSongs AS ps SET song_order = r.position * :gap "
+                                 "FROM (SELECT song_id, ROW_NUMBER() OVER (ORDER BY song_order, song_id) AS position "
+                                 "FROM PlaylistSongs WHERE playlist_id = :playlist_id) r "
+                                 "WHERE ps.playlist_id = :update_playlist_id AND ps.song_id = r.song_id "
+                                 "AND ps.song_order <> r.position * :compare_gap;");
+    query.bindValue(":gap", PlaylistOrderGap);
+    query.bindValue(":playlist_id", playlistId);
+    query.bindValue(":update_playlist_id", playlistId);
+    query.bindValue(":compare_gap", PlaylistOrderGap);
+    if (!execStatement(query)) {
+        qDebug() << "Ошибка перенумерации плейлиста:" << query.lastError().text();
+        return false;
+    }
+    qDebug() << "Плейлист" << playlistId << "перенумерован, строк:" << query.numRowsAffected();
+    return true;
+}
+
+bool DatabaseManager::playlistOrderKeys(int playlistId, int beforeSongId, const QList<int> &movedSongIds,
+                                        int count, QList<qint64> *keys)
+{
+    // Соседи места вставки без учета перемещаемых строк: сверху — beforeSongId
+    // (или конец плейлиста), снизу — строка перед ним
+    const QString moved = idList(movedSongIds);
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool hasLower = false;
+        bool hasUpper = false;
+        qint64 lower = 0;
+        qint64 upper = 0;
+        if (beforeSongId != -1) {
+            QSqlQuery &target = statement("playlistOrderOf",
+                                          "SELECT song_order FROM PlaylistSongs "
+                                          "WHERE playlist_id = :playlist_id AND song_id = :song_id;");
+            target.bindValue(":playlist_id", playlistId);
+            target.bindValue(":song_id", beforeSongId);
+            if (!execStatement(target) || !target.next()) {
+                qDebug() << "Песня" << beforeSongId << "не найдена в плейлисте" << playlistId;
+                return false;
+            }
+            upper = target.value(0).toLongLong();
+            hasUpper = true;
+
+            QSqlQuery &previous = statement("playlistOrderBefore",
+                                            "SELECT song_order FROM PlaylistSongs WHERE playlist_id = :playlist_id "
+                                            "AND (song_order, song_id) < (CAST(:song_order AS BIGINT), CAST(:song_id AS INTEGER)) "
+                                            "AND " + idListExcludes("song_id", ":moved") + " "
+                                            "ORDER BY song_order DESC, song_id DESC LIMIT 1;");
+            previous.bindValue(":playlist_id", playlistId);
+            previous.bindValue(":song_order", upper);
+            previous.bindValue(":song_id", beforeSongId);
+            previous.bindValue(":moved", moved);
+            if (!execStatement(previous)) {
+                qDebug() << "Ошибка чтения порядка плейлиста:" << previous.lastError().text();
+                return false;
+            }
+            if (previous.next()) {
+                lower = previous.value(0).toLongLong();
+                hasLower = true;
+            }
+        } else {
+            QSqlQuery &last = statement("playlistOrderLast",
+                                        "SELECT MAX(song_order) FROM PlaylistSongs WHERE playlist_id = :playlist_id "
+                                        "AND " + idListExcludes("song_id", ":moved") + ";");
+            last.bindValue(":playlist_id", playlistId);
+            last.bindValue(":moved", moved);
+            if (!execStatement(last) || !last.next()) {
+                qDebug() << "Ошибка чтения порядка плейлиста:" << last.lastError().text();
+                return false;
+            }
+            if (!last.value(0).isNull()) {
+                lower = last.value(0).toLongLong();
+                hasLower = true;
+            }
+        }
+
+        // С края плейлиста место не ограничено: ключи идут с обычным шагом
+        if (!hasUpper) {
+            upper = lower + PlaylistOrderGap * (count + 1);
+        } else if (!hasLower) {
+            lower = upper - PlaylistOrderGap * (count + 1);
+        }
+        const qint64 step = (upper - lower) / (count + 1);
+        if (step >= 1) {
+            keys->clear();
+            keys->reserve(count);
+            for (int i = 1; i <= count; ++i) {
+                keys->append(lower + step * i);
+            }
+            return true;
+        }
+        // Между соседями не осталось места: перенумеровываем плейлист и считаем заново
+        if (attempt == 0 && !renumberPlaylist(playlistId)) {
+            return false;
+        }
+    }
+    qDebug() << "Не удалось выделить ключи порядка в плейлисте" << playlistId;
+    return false;
+}
+
+QList<SongInfo> DatabaseManager::getSongsInPlaylist(int playlistId)
+{
+    QList<SongInfo> songs;
+    QSqlQuery &query = statement("getSongsInPlaylist",
+                                 "SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms, ps.song_order "
+                                 "FROM Songs s "
+                                 "JOIN PlaylistSongs ps ON s.id = ps.song_id "
+                                 "WHERE ps.playlist_id = :playlist_id "
+                                 "ORDER BY ps.song_order, ps.song_id;");
+    query.bindValue(":playlist_id", playlistId);
+    if (execStatement(query)) {
+        songs = readRows<SongInfo>(query);
+    } else {
+        qDebug() << "Ошибка загрузки песен из плейлиста:" << query.lastError().text();
+    }
+    return songs;
+}
+
+QList<SongInfo> DatabaseManager::getSongsInPlaylistPage(int playlistId, qint64 afterOrder, int afterSongId, int limit)
+{
+    QList<SongInfo> songs;
+    QSqlQuery *query = nullptr;
+    if (afterSongId == -1) {
+        query = &statement("getSongsInPlaylistPage/first",
+                           "SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms, ps.song_order "
+                           "FROM Songs s "
+                           "JOIN PlaylistSongs ps ON s.id = ps.song_id "
+                           "WHERE ps.playlist_id = :playlist_id "
+                           "ORDER BY ps.song_order, ps.song_id LIMIT :limit;");
+    } else {
+        // Курсор — ключ последней загруженной строки, а не текущая запись этой песни:
+        // ее могли удалить из плейлиста или перетащить, а продолжить нужно с того же места
+        query = &statement("getSongsInPlaylistPage/after",
+                           "SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms, ps.song_order "
+                           "FROM Songs s "
+                           "JOIN PlaylistSongs ps ON s.id = ps.song_id "
+                           "WHERE ps.playlist_id = :playlist_id "
+                           "AND (ps.song_order, ps.song_id) > (:after_order, :after_song_id) "
+                           "ORDER BY ps.song_order, ps.song_id LIMIT :limit;");
+        query->bindValue(":after_order", afterOrder);
+        query->bindValue(":after_song_id", afterSongId);
+    }
+    query->bindValue(":playlist_id", playlistId);
+    query->bindValue(":limit", limit);
+    if (execStatement(*query)) {
+        songs = readRows<SongInfo>(*query, limit);
+    } else {
+        qDebug() << "Ошибка постраничной загрузки песен из плейлиста:" << query->lastError().text();
+    }
+    return songs;
+}
+
+bool DatabaseManager::removeSongFromPlaylist(int playlistId, int songId)
+{
+    QSqlQuery &query = statement("removeSongFromPlaylist", "DELETE FROM PlaylistSongs WHERE playlist_id = :playlist_id AND song_id = :song_id;");
     query.bindValue(":playlist_id", playlistId);
     query.bindValue(":song_id", songId);
-    if (!query.exec()) {
+    if (!execStatement(query)) {
         qDebug() << "Ошибка при удалении песни из плейлиста:" << query.lastError().text();
         return false;
     }
@@ -313,11 +1207,10 @@ bool DatabaseManager::removeSongFromPlaylist(int playlistId, int songId)
 
 bool DatabaseManager::deletePlaylist(int playlistId) // РЕАЛИЗАЦИЯ НОВОГО МЕТОДА
 {
-    QSqlQuery query(db);
-    query.prepare("DELETE FROM Playlists WHERE id = :id;");
+    QSqlQuery &query = statement("deletePlaylist", "DELETE FROM Playlists WHERE id = :id;");
     query.bindValue(":id", playlistId);
 
-    if (query.exec()) {
+    if (execStatement(query)) {
         // Если удаление прошло успешно, возвращаем true, если была затронута хотя бы одна строка
         return query.numRowsAffected() > 0;
     } else {
@@ -330,14 +1223,18 @@ bool DatabaseManager::deletePlaylist(int playlistId) // РЕАЛИЗАЦИЯ Н
 // --- Новые методы для Artists ---
 int DatabaseManager::addArtist(const QString &name, const QString &bio)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO Artists (name, bio) VALUES (:name, :bio) "
-                  "ON CONFLICT (name) DO UPDATE SET bio = EXCLUDED.bio RETURNING id;");
+    QSqlQuery &query = statement("addArtist",
+                                 "INSERT INTO Artists (name, bio) VALUES (:name, :bio) "
+                                 "ON CONFLICT (name) DO UPDATE SET bio = EXCLUDED.bio RETURNING id;");
     query.bindValue(":name", name);
     query.bindValue(":bio", bio);
-    if (query.exec()) {
+    if (execStatement(query)) {
         if (query.next()) {
-            return query.value(0).toInt();
+            const int artistId = query.value(0).toInt();
+            if (!m_inTransaction) {
+                nameIds().insert(NameIdCache::Artists, name, artistId);
+            }
+            return artistId;
         }
     } else {
         qDebug() << "Ошибка при добавлении исполнителя:" << query.lastError().text();
@@ -348,15 +1245,9 @@ int DatabaseManager::addArtist(const QString &name, const QString &bio)
 QList<ArtistInfo> DatabaseManager::loadArtists()
 {
     QList<ArtistInfo> artists;
-    QSqlQuery query(db);
-    if (query.exec("SELECT id, name, bio FROM Artists ORDER BY name")) {
-        while (query.next()) {
-            ArtistInfo artist;
-            artist.id = query.value("id").toInt();
-            artist.name = query.value("name").toString();
-            artist.bio = query.value("bio").toString();
-            artists.append(artist);
-        }
+    QSqlQuery &query = statement("loadArtists", "SELECT id, name, bio FROM Artists ORDER BY name");
+    if (execStatement(query)) {
+        artists = readRows<ArtistInfo>(query);
     } else {
         qDebug() << "Ошибка загрузки исполнителей:" << query.lastError().text();
     }
@@ -365,29 +1256,26 @@ QList<ArtistInfo> DatabaseManager::loadArtists()
 
 int DatabaseManager::getArtistId(const QString &name)
 {
-    QSqlQuery query(db);
-    query.prepare("SELECT id FROM Artists WHERE name = :name;");
-    query.bindValue(":name", name);
-    if (query.exec() && query.next()) {
-        return query.value(0).toInt();
-    } else {
-        // Если исполнитель не найден, добавляем его
-        return addArtist(name);
-    }
+    // Из кэша процесса; иначе поиск или добавление одним запросом
+    return resolveArtistIds({name}).value(name, -1);
 }
 
 // --- Новые методы для Albums ---
 int DatabaseManager::addAlbum(const QString &title, int artistId, int releaseYear)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO Albums (title, artist_id, release_year) VALUES (:title, :artist_id, :release_year) "
-                  "ON CONFLICT (title, artist_id) DO UPDATE SET release_year = EXCLUDED.release_year RETURNING id;");
+    QSqlQuery &query = statement("addAlbum",
+                                 "INSERT INTO Albums (title, artist_id, release_year) VALUES (:title, :artist_id, :release_year) "
+                                 "ON CONFLICT (title, artist_id) DO UPDATE SET release_year = EXCLUDED.release_year RETURNING id;");
     query.bindValue(":title", title);
     query.bindValue(":artist_id", artistId);
     query.bindValue(":release_year", releaseYear);
-    if (query.exec()) {
+    if (execStatement(query)) {
         if (query.next()) {
-            return query.value(0).toInt();
+            const int albumId = query.value(0).toInt();
+            if (!m_inTransaction) {
+                nameIds().insert(NameIdCache::Albums, NameIdCache::albumKey(title, artistId), albumId);
+            }
+            return albumId;
         }
     } else {
         qDebug() << "Ошибка при добавлении альбома:" << query.lastError().text();
@@ -398,16 +1286,9 @@ int DatabaseManager::addAlbum(const QString &title, int artistId, int releaseYea
 QList<AlbumInfo> DatabaseManager::loadAlbums()
 {
     QList<AlbumInfo> albums;
-    QSqlQuery query(db);
-    if (query.exec("SELECT id, title, artist_id, release_year FROM Albums ORDER BY title")) {
-        while (query.next()) {
-            AlbumInfo album;
-            album.id = query.value("id").toInt();
-            album.title = query.value("title").toString();
-            album.artistId = query.value("artist_id").toInt();
-            album.releaseYear = query.value("release_year").toInt();
-            albums.append(album);
-        }
+    QSqlQuery &query = statement("loadAlbums", "SELECT id, title, artist_id, release_year FROM Albums ORDER BY title");
+    if (execStatement(query)) {
+        albums = readRows<AlbumInfo>(query);
     } else {
         qDebug() << "Ошибка загрузки альбомов:" << query.lastError().text();
     }
@@ -416,27 +1297,21 @@ QList<AlbumInfo> DatabaseManager::loadAlbums()
 
 int DatabaseManager::getAlbumId(const QString &title, int artistId)
 {
-    QSqlQuery query(db);
-    query.prepare("SELECT id FROM Albums WHERE title = :title AND artist_id = :artist_id;");
-    query.bindValue(":title", title);
-    query.bindValue(":artist_id", artistId);
-    if (query.exec() && query.next()) {
-        return query.value(0).toInt();
-    } else {
-        // Если альбом не найден, добавляем его
-        return addAlbum(title, artistId);
-    }
+    return resolveAlbumIds({{title, artistId}}).value(NameIdCache::albumKey(title, artistId), -1);
 }
 
 // --- Новые методы для Genres ---
 int DatabaseManager::addGenre(const QString &name)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO Genres (name) VALUES (:name) ON CONFLICT (name) DO NOTHING RETURNING id;");
+    QSqlQuery &query = statement("addGenre", "INSERT INTO Genres (name) VALUES (:name) ON CONFLICT (name) DO NOTHING RETURNING id;");
     query.bindValue(":name", name);
-    if (query.exec()) {
+    if (execStatement(query)) {
         if (query.next()) {
-            return query.value(0).toInt();
+            const int genreId = query.value(0).toInt();
+            if (!m_inTransaction) {
+                nameIds().insert(NameIdCache::Genres, name, genreId);
+            }
+            return genreId;
         } else {
             // Если конфликт произошел и ничего не было вставлено, значит запись уже существует.
             // Получим ID существующей записи.
@@ -451,14 +1326,9 @@ int DatabaseManager::addGenre(const QString &name)
 QList<GenreInfo> DatabaseManager::loadGenres()
 {
     QList<GenreInfo> genres;
-    QSqlQuery query(db);
-    if (query.exec("SELECT id, name FROM Genres ORDER BY name")) {
-        while (query.next()) {
-            GenreInfo genre;
-            genre.id = query.value("id").toInt();
-            genre.name = query.value("name").toString();
-            genres.append(genre);
-        }
+    QSqlQuery &query = statement("loadGenres", "SELECT id, name FROM Genres ORDER BY name");
+    if (execStatement(query)) {
+        genres = readRows<GenreInfo>(query);
     } else {
         qDebug() << "Ошибка загрузки жанров:" << query.lastError().text();
     }
@@ -467,25 +1337,16 @@ QList<GenreInfo> DatabaseManager::loadGenres()
 
 int DatabaseManager::getGenreId(const QString &name)
 {
-    QSqlQuery query(db);
-    query.prepare("SELECT id FROM Genres WHERE name = :name;");
-    query.bindValue(":name", name);
-    if (query.exec() && query.next()) {
-        return query.value(0).toInt();
-    } else {
-        // Если жанр не найден, добавляем его
-        return addGenre(name);
-    }
+    return resolveGenreIds({name}).value(name, -1);
 }
 
 // --- Новые методы для SongGenres ---
 bool DatabaseManager::addSongGenre(int songId, int genreId)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO SongGenres (song_id, genre_id) VALUES (:song_id, :genre_id) ON CONFLICT (song_id, genre_id) DO NOTHING;");
+    QSqlQuery &query = statement("addSongGenre", "INSERT INTO SongGenres (song_id, genre_id) VALUES (:song_id, :genre_id) ON CONFLICT (song_id, genre_id) DO NOTHING;");
     query.bindValue(":song_id", songId);
     query.bindValue(":genre_id", genreId);
-    if (!query.exec()) {
+    if (!execStatement(query)) {
         qDebug() << "Ошибка при привязке жанра к песне:" << query.lastError().text();
         return false;
     }
@@ -495,16 +1356,10 @@ bool DatabaseManager::addSongGenre(int songId, int genreId)
 QList<GenreInfo> DatabaseManager::getGenresForSong(int songId)
 {
     QList<GenreInfo> genres;
-    QSqlQuery query(db);
-    query.prepare("SELECT g.id, g.name FROM Genres g JOIN SongGenres sg ON g.id = sg.genre_id WHERE sg.song_id = :song_id;");
+    QSqlQuery &query = statement("getGenresForSong", "SELECT g.id, g.name FROM Genres g JOIN SongGenres sg ON g.id = sg.genre_id WHERE sg.song_id = :song_id;");
     query.bindValue(":song_id", songId);
-    if (query.exec()) {
-        while (query.next()) {
-            GenreInfo genre;
-            genre.id = query.value("id").toInt();
-            genre.name = query.value("name").toString();
-            genres.append(genre);
-        }
+    if (execStatement(query)) {
+        genres = readRows<GenreInfo>(query);
     } else {
         qDebug() << "Ошибка загрузки жанров для песни:" << query.lastError().text();
     }
@@ -514,21 +1369,12 @@ QList<GenreInfo> DatabaseManager::getGenresForSong(int songId)
 QList<SongInfo> DatabaseManager::getSongsForGenre(int genreId)
 {
     QList<SongInfo> songs;
-    QSqlQuery query(db);
-    query.prepare("SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms "
-                  "FROM Songs s JOIN SongGenres sg ON s.id = sg.song_id WHERE sg.genre_id = :genre_id;");
+    QSqlQuery &query = statement("getSongsForGenre",
+                                 "SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms "
+                                 "FROM Songs s JOIN SongGenres sg ON s.id = sg.song_id WHERE sg.genre_id = :genre_id;");
     query.bindValue(":genre_id", genreId);
-    if (query.exec()) {
-        while (query.next()) {
-            SongInfo song;
-            song.id = query.value("id").toInt();
-            song.title = query.value("title").toString();
-            song.artist = query.value("artist").toString();
-            song.album = query.value("album").toString();
-            song.filePath = query.value("file_path").toString();
-            song.durationMs = query.value("duration_ms").toInt();
-            songs.append(song);
-        }
+    if (execStatement(query)) {
+        songs = readRows<SongInfo>(query);
     } else {
         qDebug() << "Ошибка загрузки песен для жанра:" << query.lastError().text();
     }
@@ -538,13 +1384,13 @@ QList<SongInfo> DatabaseManager::getSongsForGenre(int genreId)
 // --- Новые методы для Users ---
 int DatabaseManager::addUser(const QString &username, const QString &passwordHash, const QString &email)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO Users (username, password_hash, email) VALUES (:username, :password_hash, :email) "
-                  "ON CONFLICT (username) DO NOTHING RETURNING id;"); // Предполагаем, что username уникален
+    QSqlQuery &query = statement("addUser",
+                                 "INSERT INTO Users (username, password_hash, email) VALUES (:username, :password_hash, :email) "
+                                 "ON CONFLICT (username) DO NOTHING RETURNING id;"); // Предполагаем, что username уникален
     query.bindValue(":username", username);
     query.bindValue(":password_hash", passwordHash); // Хэш пароля должен быть передан извне
     query.bindValue(":email", email);
-    if (query.exec()) {
+    if (execStatement(query)) {
         if (query.next()) {
             return query.value(0).toInt();
         }
@@ -558,14 +1404,9 @@ UserInfo DatabaseManager::getUser(const QString &username)
 {
     UserInfo user;
     user.id = -1; // Устанавливаем невалидный ID по умолчанию
-    QSqlQuery query(db);
-    query.prepare("SELECT id, username, email FROM Users WHERE username = :username;");
+    QSqlQuery &query = statement("getUser", "SELECT id, username, email FROM Users WHERE username = :username;");
     query.bindValue(":username", username);
-    if (query.exec() && query.next()) {
-        user.id = query.value("id").toInt();
-        user.username = query.value("username").toString();
-        user.email = query.value("email").toString();
-    } else {
+    if (!execStatement(query) || !SqlRowMapper::readOne(query, user)) {
         qDebug() << "Пользователь не найден или ошибка при загрузке пользователя:" << query.lastError().text();
     }
     return user;
@@ -573,11 +1414,10 @@ UserInfo DatabaseManager::getUser(const QString &username)
 
 bool DatabaseManager::verifyUser(const QString &username, const QString &passwordHash)
 {
-    QSqlQuery query(db);
-    query.prepare("SELECT id FROM Users WHERE username = :username AND password_hash = :password_hash;");
+    QSqlQuery &query = statement("verifyUser", "SELECT id FROM Users WHERE username = :username AND password_hash = :password_hash;");
     query.bindValue(":username", username);
     query.bindValue(":password_hash", passwordHash);
-    if (query.exec() && query.next()) {
+    if (execStatement(query) && query.next()) {
         return true; // Пользователь найден и пароль совпадает
     } else {
         qDebug() << "Ошибка верификации пользователя или неверные учетные данные:" << query.lastError().text();
@@ -588,35 +1428,842 @@ bool DatabaseManager::verifyUser(const QString &username, const QString &passwor
 // --- Новые методы для PlaybackHistory ---
 bool DatabaseManager::addPlaybackEntry(int userId, int songId)
 {
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO PlaybackHistory (user_id, song_id, played_at) VALUES (:user_id, :song_id, CURRENT_TIMESTAMP);");
+    QSqlQuery &query = statement("addPlaybackEntry", "INSERT INTO PlaybackHistory (user_id, song_id, played_at) VALUES (:user_id, :song_id, CURRENT_TIMESTAMP);");
     query.bindValue(":user_id", userId);
     query.bindValue(":song_id", songId);
-    if (!query.exec()) {
+    if (!execStatement(query)) {
         qDebug() << "Ошибка при добавлении записи в историю прослушиваний:" << query.lastError().text();
         return false;
     }
     return true;
 }
 
+bool DatabaseManager::addPlaybackEntries(const QList<PlaybackEntryInfo> &entries)
+{
+    // 3 параметра на строку, как и в addSongs держимся далеко от лимита параметров
+    const int chunkSize = 1000;
+
+    if (entries.isEmpty()) {
+        return true;
+    }
+    if (!beginTransaction()) {
+        return false;
+    }
+    // В SQLite время хранится текстом ISO 8601: приведение к TIMESTAMP (числовое) его бы испортило
+    const QString row = isSqlite() ? QStringLiteral("(CAST(? AS INTEGER), CAST(? AS INTEGER), CAST(? AS TEXT))")
+                                   : QStringLiteral("(CAST(? AS INTEGER), CAST(? AS INTEGER), CAST(? AS TIMESTAMP))");
+    for (int start = 0, count = 0; start < entries.size(); start += count) {
+        count = chunkRows(int(entries.size()) - start, chunkSize);
+
+        QStringList rows;
+        rows.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            rows.append(row);
+        }
+        // Записи копятся до отправки, и песню за это время могут удалить; такие строки
+        // отбрасываем, иначе ошибка внешнего ключа откатит всю пачку
+        QSqlQuery &query = statement(QString("addPlaybackEntries/%1").arg(count),
+                                     "WITH v (user_id, song_id, played_at) AS (VALUES "
+                                     + rows.join(", ") +
+                                     ") INSERT INTO PlaybackHistory (user_id, song_id, played_at) "
+                                     "SELECT v.user_id, v.song_id, v.played_at FROM v "
+                                     "WHERE EXISTS (SELECT 1 FROM Songs s WHERE s.id = v.song_id);");
+        for (int i = start; i < start + count; ++i) {
+            const PlaybackEntryInfo &entry = entries.at(i);
+            // Без авторизации пользователь неизвестен: пишем NULL
+            query.addBindValue(entry.userId > 0 ? QVariant(entry.userId) : QVariant(QMetaType::fromType<int>()));
+            query.addBindValue(entry.songId);
+            query.addBindValue(entry.playedAt);
+        }
+        if (!execStatement(query)) {
+            qDebug() << "Ошибка пакетной записи истории прослушиваний:" << query.lastError().text();
+            rollbackTransaction();
+            return false;
+        }
+    }
+    return commitTransaction();
+}
+
 QList<PlaybackEntryInfo> DatabaseManager::getPlaybackHistory(int userId, int limit)
 {
     QList<PlaybackEntryInfo> history;
-    QSqlQuery query(db);
-    query.prepare("SELECT id, user_id, song_id, played_at FROM PlaybackHistory WHERE user_id = :user_id ORDER BY played_at DESC LIMIT :limit;");
+    QSqlQuery &query = statement("getPlaybackHistory", "SELECT id, user_id, song_id, played_at FROM PlaybackHistory WHERE user_id = :user_id ORDER BY played_at DESC LIMIT :limit;");
     query.bindValue(":user_id", userId);
     query.bindValue(":limit", limit);
-    if (query.exec()) {
-        while (query.next()) {
-            PlaybackEntryInfo entry;
-            entry.id = query.value("id").toInt();
-            entry.userId = query.value("user_id").toInt();
-            entry.songId = query.value("song_id").toInt();
-            entry.playedAt = query.value("played_at").toDateTime();
-            history.append(entry);
-        }
+    if (execStatement(query)) {
+        history = readRows<PlaybackEntryInfo>(query, limit);
     } else {
         qDebug() << "Ошибка загрузки истории прослушиваний:" << query.lastError().text();
     }
     return history;
 }
+
+// --- Громкость (LoudnessScanner) ---
+QList<SongScanState> DatabaseManager::loadSongScanStates()
+{
+    QList<SongScanState> states;
+    // Порядок по альбому: прерванный анализ оставляет меньше недосчитанных альбомов
+    QSqlQuery &query = statement("loadSongScanStates",
+                                 "SELECT id, file_path, COALESCE(album, '') AS album, COALESCE(artist, '') AS artist, "
+                                 "COALESCE(file_mtime, -1) AS file_mtime, COALESCE(file_size, -1) AS file_size, "
+                                 "(loudness_lufs IS NOT NULL) AS has_loudness "
+                                 "FROM Songs ORDER BY album, artist, id;");
+    if (execStatement(query)) {
+        states = readRows<SongScanState>(query);
+    } else {
+        qDebug() << "Ошибка загрузки состояния анализа громкости:" << query.lastError().text();
+    }
+    return states;
+}
+
+bool DatabaseManager::updateSongLoudness(const QList<SongLoudnessInfo> &songs)
+{
+    // 8 параметров на строку
+    const int chunkSize = 500;
+
+    if (songs.isEmpty()) {
+        return true;
+    }
+    if (!beginTransaction()) {
+        return false;
+    }
+    const QVariant nullReal(QMetaType::fromType<double>());
+    const QString row = QString("(CAST(? AS INTEGER), CAST(? AS BIGINT), CAST(? AS BIGINT), CAST(? AS REAL), "
+                                "CAST(? AS REAL), CAST(? AS REAL), CAST(? AS REAL), CAST(? AS %1))")
+                            .arg(isSqlite() ? "BLOB" : "BYTEA");
+    for (int start = 0, count = 0; start < songs.size(); start += count) {
+        count = chunkRows(int(songs.size()) - start, chunkSize);
+
+        QStringList rows;
+        rows.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            rows.append(row);
+        }
+        QSqlQuery &query = statement(QString("updateSongLoudness/%1").arg(count),
+                                     "WITH v (id, file_mtime, file_size, lufs, range_lu, peak, gain, histogram) AS (VALUES "
+                                     + rows.join(", ") +
+                                     ") UPDATE Songs SET file_mtime = v.file_mtime, file_size = v.file_size, "
+                                     "loudness_lufs = v.lufs, loudness_range_lu = v.range_lu, true_peak_dbtp = v.peak, "
+                                     "replaygain_track_db = v.gain, loudness_histogram = v.histogram, "
+                                     "replaygain_album_db = NULL, album_true_peak_dbtp = NULL, "
+                                     "loudness_scanned_at = CURRENT_TIMESTAMP FROM v "
+                                     "WHERE Songs.id = v.id;");
+        for (int i = start; i < start + count; ++i) {
+            const SongLoudnessInfo &song = songs.at(i);
+            query.addBindValue(song.songId);
+            query.addBindValue(song.fileMtime);
+            query.addBindValue(song.fileSize);
+            query.addBindValue(song.valid ? QVariant(song.integratedLufs) : nullReal);
+            query.addBindValue(song.valid ? QVariant(song.rangeLu) : nullReal);
+            query.addBindValue(song.valid ? QVariant(song.truePeakDbtp) : nullReal);
+            query.addBindValue(song.valid ? QVariant(song.replayGainDb) : nullReal);
+            query.addBindValue(song.valid ? QVariant(song.histogram) : QVariant(QMetaType::fromType<QByteArray>()));
+        }
+        if (!execStatement(query)) {
+            qDebug() << "Ошибка записи громкости песен:" << query.lastError().text();
+            rollbackTransaction();
+            return false;
+        }
+    }
+    return commitTransaction();
+}
+
+QList<AlbumLoudnessInfo> DatabaseManager::loadAlbumsPendingLoudness()
+{
+    QList<AlbumLoudnessInfo> albums;
+    QSqlQuery &query = statement("loadAlbumsPendingLoudness",
+                                 "SELECT DISTINCT COALESCE(album, '') AS album, COALESCE(artist, '') AS artist FROM Songs "
+                                 "WHERE loudness_histogram IS NOT NULL AND replaygain_album_db IS NULL "
+                                 "AND COALESCE(album, '') <> '';");
+    if (execStatement(query)) {
+        albums = readRows<AlbumLoudnessInfo>(query);
+    } else {
+        qDebug() << "Ошибка загрузки альбомов для анализа громкости:" << query.lastError().text();
+    }
+    return albums;
+}
+
+QList<SongLoudnessInfo> DatabaseManager::getAlbumSongLoudness(const QString &album, const QString &artist)
+{
+    QList<SongLoudnessInfo> songs;
+    QSqlQuery &query = statement("getAlbumSongLoudness",
+                                 "SELECT id, true_peak_dbtp, loudness_histogram FROM Songs "
+                                 "WHERE COALESCE(album, '') = :album AND COALESCE(artist, '') = :artist "
+                                 "AND loudness_histogram IS NOT NULL;");
+    query.bindValue(":album", album);
+    query.bindValue(":artist", artist);
+    if (execStatement(query)) {
+        songs = readRows<SongLoudnessInfo>(query);
+        for (SongLoudnessInfo &song : songs) {
+            song.valid = true;
+        }
+    } else {
+        qDebug() << "Ошибка загрузки громкости песен альбома:" << query.lastError().text();
+    }
+    return songs;
+}
+
+bool DatabaseManager::updateAlbumLoudness(const AlbumLoudnessInfo &album)
+{
+    if (!beginTransaction()) {
+        return false;
+    }
+    // Песни без исполнителя попадают в альбом с artist_id = NULL; UNIQUE(title, artist_id)
+    // такие строки не различает, поэтому вместо ON CONFLICT — обновление или вставка
+    const int artistId = album.artist.isEmpty() ? -1 : getArtistId(album.artist);
+    const QVariant artistValue = artistId > 0 ? QVariant(artistId) : QVariant(QMetaType::fromType<int>());
+    if (isSqlite()) {
+        // UPDATE внутри WITH SQLite не поддерживает: вставка идет, если обновлять было нечего.
+        // Транзакция держит блокировку записи, поэтому между запросами строку никто не вставит
+        QSqlQuery &update = statement("updateAlbumLoudness/update",
+                                      "UPDATE Albums SET loudness_lufs = :lufs, loudness_range_lu = :range_lu, "
+                                      "true_peak_dbtp = :peak, replaygain_db = :gain "
+                                      "WHERE title = :title AND artist_id IS NOT DISTINCT FROM CAST(:artist_id AS INTEGER);");
+        update.bindValue(":lufs", album.integratedLufs);
+        update.bindValue(":range_lu", album.rangeLu);
+        update.bindValue(":peak", album.truePeakDbtp);
+        update.bindValue(":gain", album.replayGainDb);
+        update.bindValue(":title", album.album);
+        update.bindValue(":artist_id", artistValue);
+        if (!execStatement(update)) {
+            qDebug() << "Ошибка записи громкости альбома:" << update.lastError().text();
+            rollbackTransaction();
+            return false;
+        }
+        if (update.numRowsAffected() == 0) {
+            QSqlQuery &insert = statement("updateAlbumLoudness/insert",
+                                          "INSERT INTO Albums (title, artist_id, loudness_lufs, loudness_range_lu, true_peak_dbtp, replaygain_db) "
+                                          "VALUES (:title, CAST(:artist_id AS INTEGER), :lufs, :range_lu, :peak, :gain);");
+            insert.bindValue(":title", album.album);
+            insert.bindValue(":artist_id", artistValue);
+            insert.bindValue(":lufs", album.integratedLufs);
+            insert.bindValue(":range_lu", album.rangeLu);
+            insert.bindValue(":peak", album.truePeakDbtp);
+            insert.bindValue(":gain", album.replayGainDb);
+            if (!execStatement(insert)) {
+                qDebug() << "Ошибка записи громкости альбома:" << insert.lastError().text();
+                rollbackTransaction();
+                return false;
+            }
+        }
+    } else {
+        QSqlQuery &albumQuery = statement("updateAlbumLoudness",
+                                          "WITH updated AS ("
+                                          "UPDATE Albums SET loudness_lufs = :lufs, loudness_range_lu = :range_lu, "
+                                          "true_peak_dbtp = :peak, replaygain_db = :gain "
+                                          "WHERE title = :title AND artist_id IS NOT DISTINCT FROM CAST(:artist_id AS INTEGER) "
+                                          "RETURNING id) "
+                                          "INSERT INTO Albums (title, artist_id, loudness_lufs, loudness_range_lu, true_peak_dbtp, replaygain_db) "
+                                          "SELECT :new_title, CAST(:new_artist_id AS INTEGER), :new_lufs, :new_range_lu, :new_peak, :new_gain "
+                                          "WHERE NOT EXISTS (SELECT 1 FROM updated);");
+        albumQuery.bindValue(":lufs", album.integratedLufs);
+        albumQuery.bindValue(":range_lu", album.rangeLu);
+        albumQuery.bindValue(":peak", album.truePeakDbtp);
+        albumQuery.bindValue(":gain", album.replayGainDb);
+        albumQuery.bindValue(":title", album.album);
+        albumQuery.bindValue(":artist_id", artistValue);
+        albumQuery.bindValue(":new_title", album.album);
+        albumQuery.bindValue(":new_artist_id", artistValue);
+        albumQuery.bindValue(":new_lufs", album.integratedLufs);
+        albumQuery.bindValue(":new_range_lu", album.rangeLu);
+        albumQuery.bindValue(":new_peak", album.truePeakDbtp);
+        albumQuery.bindValue(":new_gain", album.replayGainDb);
+        if (!execStatement(albumQuery)) {
+            qDebug() << "Ошибка записи громкости альбома:" << albumQuery.lastError().text();
+            rollbackTransaction();
+            return false;
+        }
+    }
+
+    QSqlQuery &songsQuery = statement("updateAlbumSongsLoudness",
+                                      "UPDATE Songs SET replaygain_album_db = :gain, album_true_peak_dbtp = :peak "
+                                      "WHERE COALESCE(album, '') = :album AND COALESCE(artist, '') = :artist;");
+    songsQuery.bindValue(":gain", album.replayGainDb);
+    songsQuery.bindValue(":peak", album.truePeakDbtp);
+    songsQuery.bindValue(":album", album.album);
+    songsQuery.bindValue(":artist", album.artist);
+    if (!execStatement(songsQuery)) {
+        qDebug() << "Ошибка записи альбомной поправки песен:" << songsQuery.lastError().text();
+        rollbackTransaction();
+        return false;
+    }
+    return commitTransaction();
+}
+
+QHash<QString, ReplayGainValues> DatabaseManager::loadLibraryReplayGain()
+{
+    QHash<QString, ReplayGainValues> gains;
+    QSqlQuery &query = statement("loadLibraryReplayGain",
+                                 "SELECT file_path, replaygain_track_db, true_peak_dbtp, replaygain_album_db, album_true_peak_dbtp "
+                                 "FROM Songs WHERE replaygain_track_db IS NOT NULL;");
+    if (!execStatement(query)) {
+        qDebug() << "Ошибка загрузки ReplayGain библиотеки:" << query.lastError().text();
+        return gains;
+    }
+    while (query.next()) {
+        ReplayGainValues values;
+        values.hasTrackGain = true;
+        values.trackGainDb = query.value(1).toFloat();
+        values.trackPeak = std::pow(10.0f, query.value(2).toFloat() / 20.0f);
+        if (!query.value(3).isNull()) {
+            values.hasAlbumGain = true;
+            values.albumGainDb = query.value(3).toFloat();
+            values.albumPeak = std::pow(10.0f, query.value(4).toFloat() / 20.0f);
+        }
+        gains.insert(query.value(0).toString(), values);
+    }
+    countRows(query, gains.size());
+    return gains;
+}
+
+// --- Поиск ---
+QList<SongInfo> DatabaseManager::loadSongSearchFields()
+{
+    QList<SongInfo> songs;
+    QSqlQuery &query = statement("loadSongSearchFields",
+                                 "SELECT id, title, COALESCE(artist, '') AS artist, COALESCE(album, '') AS album FROM Songs;");
+    if (execStatement(query)) {
+        songs = readRows<SongInfo>(query);
+    } else {
+        qDebug() << "Ошибка загрузки полей для поиска:" << query.lastError().text();
+    }
+    return songs;
+}
+
+QList<SongInfo> DatabaseManager::loadSongsByIds(const QList<int> &songIds)
+{
+    QList<SongInfo> songs;
+    if (songIds.isEmpty()) {
+        return songs;
+    }
+    // Строки возвращаются в порядке входного списка (например, по рангу поиска);
+    // в SQLite порядковый номер элемента массива JSON — key из json_each
+    QSqlQuery &query = statement("loadSongsByIds",
+                                 isSqlite() ? "SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms "
+                                              "FROM json_each(:ids) AS u JOIN Songs s ON s.id = u.value ORDER BY u.key;"
+                                            : "SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms "
+                                              "FROM unnest(CAST(:ids AS INTEGER[])) WITH ORDINALITY AS u(id, ord) "
+                                              "JOIN Songs s ON s.id = u.id ORDER BY u.ord;");
+    query.bindValue(":ids", idList(songIds));
+    if (execStatement(query)) {
+        songs = readRows<SongInfo>(query, songIds.size());
+    } else {
+        qDebug() << "Ошибка загрузки песен по ID:" << query.lastError().text();
+    }
+    return songs;
+}
+
+bool DatabaseManager::hasSearchIndex()
+{
+    // Индекс строит миграция 8, если на сервере есть pg_trgm; без него (и в SQLite)
+    // остается поиск в памяти. Недостроенный индекс CONCURRENTLY невалиден и не в счет
+    if (isSqlite()) {
+        qDebug() << "Поиск pg_trgm недоступен в SQLite";
+        return false;
+    }
+    QSqlQuery query(db);
+    if (!query.exec("SELECT indisvalid FROM pg_index WHERE indexrelid = to_regclass('songs_search_trgm_idx');")) {
+        qDebug() << "Ошибка проверки триграммного индекса поиска:" << query.lastError().text();
+        return false;
+    }
+    if (!query.next() || !query.value(0).toBool()) {
+        qDebug() << "Триграммного индекса поиска нет: расширение pg_trgm недоступно";
+        return false;
+    }
+    return true;
+}
+
+QList<SongInfo> DatabaseManager::searchSongs(const QString &text, int limit)
+{
+    QList<SongInfo> songs;
+    const QStringList words = text.toLower().split(' ', Qt::SkipEmptyParts);
+    if (words.isEmpty()) {
+        return songs;
+    }
+
+    // Выражение должно совпадать с выражением индекса songs_search_trgm_idx
+    const QString searchText = "lower(title || ' ' || COALESCE(artist, '') || ' ' || COALESCE(album, ''))";
+    QStringList conditions;
+    for (int i = 0; i < words.size(); ++i) {
+        conditions.append(searchText + " LIKE CAST(? AS TEXT)");
+    }
+    QSqlQuery &query = statement(QString("searchSongs/%1").arg(words.size()),
+                                 "SELECT id, title, artist, album, file_path, duration_ms FROM Songs WHERE "
+                                 + conditions.join(" AND ") +
+                                 " ORDER BY similarity(" + searchText + ", CAST(? AS TEXT)) DESC, title, id LIMIT ?;");
+    for (QString word : words) {
+        word.replace('\\', "\\\\").replace('%', "\\%").replace('_', "\\_");
+        query.addBindValue("%" + word + "%");
+    }
+    query.addBindValue(words.join(' '));
+    query.addBindValue(limit);
+    if (execStatement(query)) {
+        songs = readRows<SongInfo>(query, limit);
+    } else {
+        qDebug() << "Ошибка поиска песен:" << query.lastError().text();
+    }
+    return songs;
+}
+
+// --- Справочники: пакетное получение ID ---
+NameIdCache &DatabaseManager::nameIds() const
+{
+    // Ключ — база, а не соединение: соединения рабочих потоков делят кэш с основным
+    const QString database = isSqlite() ? QFileInfo(db.databaseName()).absoluteFilePath() : db.databaseName();
+    return NameIdCache::forDatabase(QString("%1|%2:%3|%4").arg(db.driverName(), db.hostName()).arg(db.port()).arg(database));
+}
+
+void DatabaseManager::clearNameIdCache()
+{
+    nameIds().clear();
+}
+
+QHash<QString, int> DatabaseManager::resolveNames(const QString &table, NameIdCache::Dictionary dictionary,
+                                                  const QStringList &names)
+{
+    // Одно значение на строку: 1000 строк далеко от лимита параметров PostgreSQL
+    const int chunkSize = 1000;
+
+    NameIdCache &cache = nameIds();
+    QHash<QString, int> ids;
+    QStringList missing;
+    for (const QString &name : names) {
+        if (name.isEmpty() || ids.contains(name)) {
+            continue;
+        }
+        const int cached = cache.value(dictionary, name);
+        ids.insert(name, cached);
+        if (cached == -1) {
+            missing.append(name);
+        }
+    }
+
+    // Вставка и чтение существующих строк — один запрос на пачку. Строки, вставленные
+    // параллельной транзакцией, не видны ни INSERT (DO NOTHING), ни снимку запроса:
+    // за ними идет второй проход
+    for (int attempt = 0; attempt < 2 && !missing.isEmpty(); ++attempt) {
+        QStringList stillMissing;
+        for (int start = 0, count = 0; start < missing.size(); start += count) {
+            count = chunkRows(int(missing.size()) - start, chunkSize);
+            QStringList rows;
+            rows.reserve(count);
+            for (int i = 0; i < count; ++i) {
+                rows.append(QStringLiteral("(CAST(? AS TEXT))"));
+            }
+            const QString input = "WITH input (name) AS (VALUES " + rows.join(", ") + ") ";
+            if (isSqlite()) {
+                // SQLite не допускает INSERT внутри WITH: вставка отдельным запросом перед чтением.
+                // WHERE true отделяет SELECT от ON CONFLICT при разборе
+                QSqlQuery &insert = statement(QString("resolve%1/insert/%2").arg(table).arg(count),
+                                              input + "INSERT INTO " + table + " (name) SELECT name FROM input WHERE true "
+                                              "ON CONFLICT (name) DO NOTHING;");
+                for (int i = start; i < start + count; ++i) {
+                    insert.addBindValue(missing.at(i));
+                }
+                if (!execStatement(insert)) {
+                    qDebug() << "Ошибка добавления строк в" << table << ":" << insert.lastError().text();
+                    return ids;
+                }
+            }
+            QSqlQuery &query = statement(QString("resolve%1/%2").arg(table).arg(count),
+                                         isSqlite() ? input + "SELECT t.id, t.name FROM " + table + " t JOIN input i ON t.name = i.name;"
+                                                    : input + ", inserted AS (INSERT INTO " + table + " (name) SELECT name FROM input "
+                                                      "ON CONFLICT (name) DO NOTHING RETURNING id, name) "
+                                                      "SELECT id, name FROM inserted "
+                                                      "UNION ALL "
+                                                      "SELECT t.id, t.name FROM " + table + " t JOIN input i ON t.name = i.name;");
+            for (int i = start; i < start + count; ++i) {
+                query.addBindValue(missing.at(i));
+            }
+            if (!execStatement(query)) {
+                qDebug() << "Ошибка получения ID из" << table << ":" << query.lastError().text();
+                return ids;
+            }
+            QHash<QString, int> resolved;
+            while (query.next()) {
+                resolved.insert(query.value(1).toString(), query.value(0).toInt());
+            }
+            countRows(query, resolved.size());
+            for (int i = start; i < start + count; ++i) {
+                const int id = resolved.value(missing.at(i), -1);
+                ids.insert(missing.at(i), id);
+                if (id == -1) {
+                    stillMissing.append(missing.at(i));
+                }
+            }
+            // Внутри транзакции строка может откатиться вместе с ней
+            if (!m_inTransaction) {
+                cache.insert(dictionary, resolved);
+            }
+        }
+        missing = stillMissing;
+    }
+    return ids;
+}
+
+QHash<QString, int> DatabaseManager::resolveArtistIds(const QStringList &names)
+{
+    return resolveNames("Artists", NameIdCache::Artists, names);
+}
+
+QHash<QString, int> DatabaseManager::resolveGenreIds(const QStringList &names)
+{
+    return resolveNames("Genres", NameIdCache::Genres, names);
+}
+
+QHash<QString, int> DatabaseManager::resolveAlbumIds(const QList<QPair<QString, int>> &albums)
+{
+    // Два значения на строку
+    const int chunkSize = 500;
+
+    NameIdCache &cache = nameIds();
+    QHash<QString, int> ids;
+    QList<QPair<QString, int>> missing;
+    for (const QPair<QString, int> &album : albums) {
+        const QString key = NameIdCache::albumKey(album.first, album.second);
+        if (album.first.isEmpty() || ids.contains(key)) {
+            continue;
+        }
+        const int cached = cache.value(NameIdCache::Albums, key);
+        ids.insert(key, cached);
+        if (cached == -1) {
+            missing.append(album);
+        }
+    }
+
+    // UNIQUE(title, artist_id) не различает альбомы без исполнителя (NULL), поэтому
+    // вставляются только отсутствующие пары, а сравнение — через IS NOT DISTINCT FROM
+    for (int attempt = 0; attempt < 2 && !missing.isEmpty(); ++attempt) {
+        QList<QPair<QString, int>> stillMissing;
+        for (int start = 0, count = 0; start < missing.size(); start += count) {
+            count = chunkRows(int(missing.size()) - start, chunkSize);
+            QStringList rows;
+            rows.reserve(count);
+            for (int i = 0; i < count; ++i) {
+                rows.append(QStringLiteral("(CAST(? AS TEXT), CAST(? AS INTEGER))"));
+            }
+            const auto bindChunk = [&missing, start, count](QSqlQuery &query) {
+                for (int i = start; i < start + count; ++i) {
+                    const QPair<QString, int> &album = missing.at(i);
+                    query.addBindValue(album.first);
+                    query.addBindValue(album.second > 0 ? QVariant(album.second) : QVariant(QMetaType::fromType<int>()));
+                }
+            };
+            const QString input = "WITH input (title, artist_id) AS (VALUES " + rows.join(", ") + ") ";
+            const QString insertMissing = "INSERT INTO Albums (title, artist_id) "
+                                          "SELECT DISTINCT i.title, i.artist_id FROM input i WHERE NOT EXISTS "
+                                          "(SELECT 1 FROM Albums a WHERE a.title = i.title AND a.artist_id IS NOT DISTINCT FROM i.artist_id) "
+                                          "ON CONFLICT (title, artist_id) DO NOTHING";
+            const QString selectExisting = "SELECT a.id, a.title, a.artist_id FROM Albums a "
+                                           "JOIN input i ON a.title = i.title AND a.artist_id IS NOT DISTINCT FROM i.artist_id;";
+            if (isSqlite()) {
+                // Как и в resolveNames, в SQLite вставка — отдельным запросом перед чтением
+                QSqlQuery &insert = statement(QString("resolveAlbums/insert/%1").arg(count), input + insertMissing + ";");
+                bindChunk(insert);
+                if (!execStatement(insert)) {
+                    qDebug() << "Ошибка добавления альбомов:" << insert.lastError().text();
+                    return ids;
+                }
+            }
+            QSqlQuery &query = statement(QString("resolveAlbums/%1").arg(count),
+                                         isSqlite() ? input + selectExisting
+                                                    : input + ", inserted AS (" + insertMissing + " RETURNING id, title, artist_id) "
+                                                      "SELECT id, title, artist_id FROM inserted "
+                                                      "UNION ALL " + selectExisting);
+            bindChunk(query);
+            if (!execStatement(query)) {
+                qDebug() << "Ошибка получения ID альбомов:" << query.lastError().text();
+                return ids;
+            }
+            QHash<QString, int> resolved;
+            while (query.next()) {
+                const int artistId = query.value(2).isNull() ? 0 : query.value(2).toInt();
+                resolved.insert(NameIdCache::albumKey(query.value(1).toString(), artistId), query.value(0).toInt());
+            }
+            countRows(query, resolved.size());
+            for (int i = start; i < start + count; ++i) {
+                const QString key = NameIdCache::albumKey(missing.at(i).first, missing.at(i).second);
+                const int id = resolved.value(key, -1);
+                ids.insert(key, id);
+                if (id == -1) {
+                    stillMissing.append(missing.at(i));
+                }
+            }
+            if (!m_inTransaction) {
+                cache.insert(NameIdCache::Albums, resolved);
+            }
+        }
+        missing = stillMissing;
+    }
+    return ids;
+}
+
+int DatabaseManager::linkSongsToCatalog(int afterId, int batchSize, int *linked)
+{
+    if (linked) {
+        *linked = 0;
+    }
+
+    struct UnlinkedSong {
+        int id;
+        QString artist;
+        QString album;
+    };
+    QList<UnlinkedSong> songs;
+    QSqlQuery &select = statement("loadUnlinkedSongs",
+                                  "SELECT id, COALESCE(artist, '') AS artist, COALESCE(album, '') AS album FROM Songs "
+                                  "WHERE id > :after_id AND ((artist_id IS NULL AND COALESCE(artist, '') <> '') "
+                                  "OR (album_id IS NULL AND COALESCE(album, '') <> '')) "
+                                  "ORDER BY id LIMIT :limit;");
+    select.bindValue(":after_id", afterId);
+    select.bindValue(":limit", batchSize);
+    if (!execStatement(select)) {
+        qDebug() << "Ошибка выборки несвязанных песен:" << select.lastError().text();
+        return -1;
+    }
+    while (select.next()) {
+        songs.append({select.value(0).toInt(), select.value(1).toString(), select.value(2).toString()});
+    }
+    countRows(select, songs.size());
+    if (songs.isEmpty()) {
+        return 0;
+    }
+
+    // Сначала исполнители всей пачки, затем альбомы по (название, ID исполнителя)
+    QStringList artists;
+    for (const UnlinkedSong &song : songs) {
+        artists.append(song.artist);
+    }
+    const QHash<QString, int> artistIds = resolveArtistIds(artists);
+    QList<QPair<QString, int>> albums;
+    for (const UnlinkedSong &song : songs) {
+        if (!song.album.isEmpty()) {
+            albums.append({song.album, artistIds.value(song.artist, -1)});
+        }
+    }
+    const QHash<QString, int> albumIds = resolveAlbumIds(albums);
+
+    // Песни, чьи теги успели измениться после выборки, не трогаем: их свяжет следующий проход.
+    // 5 параметров на строку; размер пачки задает вызывающий, поэтому она делится как в addSongs
+    const int chunkSize = 1000;
+    const QVariant nullId(QMetaType::fromType<int>());
+    for (int start = 0, count = 0; start < songs.size(); start += count) {
+        count = chunkRows(int(songs.size()) - start, chunkSize);
+        QStringList rows;
+        rows.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            rows.append(QStringLiteral("(CAST(? AS INTEGER), CAST(? AS TEXT), CAST(? AS TEXT), CAST(? AS INTEGER), CAST(? AS INTEGER))"));
+        }
+        QSqlQuery &update = statement(QString("linkSongsToCatalog/%1").arg(count),
+                                      "WITH v (id, artist, album, artist_id, album_id) AS (VALUES " + rows.join(", ") + ") "
+                                      "UPDATE Songs AS s SET artist_id = v.artist_id, album_id = v.album_id FROM v "
+                                      "WHERE s.id = v.id AND COALESCE(s.artist, '') = v.artist AND COALESCE(s.album, '') = v.album "
+                                      "AND (s.artist_id, s.album_id) IS DISTINCT FROM (v.artist_id, v.album_id);");
+        for (int i = start; i < start + count; ++i) {
+            const UnlinkedSong &song = songs.at(i);
+            const int artistId = artistIds.value(song.artist, -1);
+            const int albumId = song.album.isEmpty() ? -1
+                                                     : albumIds.value(NameIdCache::albumKey(song.album, artistId), -1);
+            update.addBindValue(song.id);
+            update.addBindValue(song.artist);
+            update.addBindValue(song.album);
+            update.addBindValue(artistId > 0 ? QVariant(artistId) : nullId);
+            update.addBindValue(albumId > 0 ? QVariant(albumId) : nullId);
+        }
+        if (!execStatement(update)) {
+            qDebug() << "Ошибка связывания песен со справочниками:" << update.lastError().text();
+            return -1;
+        }
+        if (linked) {
+            *linked += update.numRowsAffected();
+        }
+    }
+    return songs.last().id;
+}
+
+// --- Кэш каталога и уведомления об изменениях ---
+QSqlDriver *DatabaseManager::driver() const
+{
+    return db.driver();
+}
+
+bool DatabaseManager::subscribe(const QString &channel)
+{
+    if (!db.driver()->hasFeature(QSqlDriver::EventNotifications)) {
+        qDebug() << "Драйвер БД не поддерживает уведомления";
+        return false;
+    }
+    if (db.driver()->subscribedToNotifications().contains(channel)) {
+        return true;
+    }
+    if (!db.driver()->subscribeToNotification(channel)) {
+        qDebug() << "Не удалось подписаться на канал" << channel << ":" << db.driver()->lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::ensureConnected(bool *reconnected)
+{
+    if (reconnected) {
+        *reconnected = false;
+    }
+    if (isConnectionAlive()) {
+        return true;
+    }
+    if (!reconnect()) {
+        return false;
+    }
+    if (reconnected) {
+        *reconnected = true;
+    }
+    return true;
+}
+
+QList<SongPosition> DatabaseManager::loadSongPositions(int playlistId, const QList<int> &songIds, int limit)
+{
+    QList<SongPosition> songs;
+    if (songIds.isEmpty()) {
+        return songs;
+    }
+    // Позиция — число строк перед песней в порядке самого списка: библиотека по (title, id),
+    // плейлист по (song_order, song_id). Подсчет идет по индексу этого порядка и
+    // останавливается на limit строках, поэтому не зависит от размера списка
+    QSqlQuery *query = nullptr;
+    if (playlistId > 0) {
+        query = &statement("loadSongPositions/playlist",
+                           "SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms, ps.song_order, "
+                           "(SELECT count(*) FROM (SELECT 1 FROM PlaylistSongs o WHERE o.playlist_id = ps.playlist_id "
+                           "AND (o.song_order, o.song_id) < (ps.song_order, ps.song_id) LIMIT :limit) o) AS position "
+                           "FROM PlaylistSongs ps JOIN Songs s ON s.id = ps.song_id "
+                           "WHERE ps.playlist_id = :playlist_id AND " + idListContains("ps.song_id", ":ids") + " "
+                           "ORDER BY position;");
+        query->bindValue(":playlist_id", playlistId);
+    } else {
+        query = &statement("loadSongPositions/library",
+                           "SELECT s.id, s.title, s.artist, s.album, s.file_path, s.duration_ms, "
+                           "(SELECT count(*) FROM (SELECT 1 FROM Songs o WHERE (o.title, o.id) < (s.title, s.id) "
+                           "LIMIT :limit) o) AS position "
+                           "FROM Songs s WHERE " + idListContains("s.id", ":ids") + " "
+                           "ORDER BY position;");
+    }
+    query->bindValue(":limit", qMax(0, limit));
+    query->bindValue(":ids", idList(songIds));
+    if (!execStatement(*query)) {
+        qDebug() << "Ошибка загрузки позиций песен:" << query->lastError().text();
+        return songs;
+    }
+    const auto columns = SqlRowMapper::resolveColumns<SongInfo>(*query);
+    const int positionColumn = query->record().indexOf("position");
+    while (query->next()) {
+        SongPosition song;
+        SqlRowMapper::readRow(*query, columns, song.song);
+        song.position = query->value(positionColumn).toInt();
+        songs.append(song);
+    }
+    countRows(*query, songs.size());
+    return songs;
+}
+
+QList<PlaylistInfo> DatabaseManager::loadPlaylistsByIds(const QList<int> &playlistIds)
+{
+    QList<PlaylistInfo> playlists;
+    QSqlQuery &query = statement("loadPlaylistsByIds",
+                                 "SELECT id, name FROM Playlists WHERE " + idListContains("id", ":ids") + " ORDER BY name;");
+    query.bindValue(":ids", idList(playlistIds));
+    if (execStatement(query)) {
+        playlists = readRows<PlaylistInfo>(query);
+    } else {
+        qDebug() << "Ошибка загрузки плейлистов по ID:" << query.lastError().text();
+    }
+    return playlists;
+}
+
+QList<QPair<int, int>> DatabaseManager::loadPlaylistMembership()
+{
+    QList<QPair<int, int>> membership;
+    QSqlQuery &query = statement("loadPlaylistMembership", "SELECT playlist_id, song_id FROM PlaylistSongs;");
+    if (!execStatement(query)) {
+        qDebug() << "Ошибка загрузки состава плейлистов:" << query.lastError().text();
+        return membership;
+    }
+    while (query.next()) {
+        membership.append({query.value(0).toInt(), query.value(1).toInt()});
+    }
+    countRows(query, membership.size());
+    return membership;
+}
+
+// --- Снимок библиотеки ---
+bool DatabaseManager::beginConsistentRead()
+{
+    if (isSqlite()) {
+        // В режиме WAL отложенная транзакция читает один снимок с первого запроса
+        // и не мешает писателям, в отличие от BEGIN IMMEDIATE из beginTransaction()
+        releaseStatements();
+        QSqlQuery query(db);
+        if (!query.exec("BEGIN DEFERRED;")) {
+            qDebug() << "Не удалось начать согласованное чтение:" << query.lastError().text();
+            return false;
+        }
+        m_inTransaction = true;
+        return true;
+    }
+    if (!beginTransaction()) {
+        return false;
+    }
+    // Уровень изоляции задается первым оператором транзакции
+    QSqlQuery query(db);
+    if (!query.exec("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ, READ ONLY;")) {
+        qDebug() << "Не удалось начать согласованное чтение:" << query.lastError().text();
+        rollbackTransaction();
+        return false;
+    }
+    return true;
+}
+
+void DatabaseManager::endConsistentRead()
+{
+    // Транзакция только читала, фиксировать нечего
+    rollbackTransaction();
+}
+
+qint64 DatabaseManager::catalogRevision()
+{
+    QSqlQuery &query = statement("catalogRevision", isSqlite()
+        ? "SELECT revision FROM CatalogRevision;"
+        : "SELECT COALESCE(sum(changes), 0) FROM CatalogChanges;");
+    if (!execStatement(query) || !query.next()) {
+        qDebug() << "Ошибка чтения счетчика изменений библиотеки:" << query.lastError().text();
+        return -1;
+    }
+    return query.value(0).toLongLong();
+}
+
+bool DatabaseManager::compactCatalogRevision()
+{
+    if (isSqlite()) {
+        return true;
+    }
+    // Удаляются только видимые строки, и их сумма вставляется той же транзакцией: строки
+    // незафиксированных записей остаются. Вторая одновременная свертка пропустит строки,
+    // удаленные первой, и ничего не вставит
+    QSqlQuery &query = statement("compactCatalogRevision",
+        "WITH folded AS (DELETE FROM CatalogChanges RETURNING changes) "
+        "INSERT INTO CatalogChanges (changes) SELECT sum(changes) FROM folded HAVING count(*) > 0;");
+    if (!execStatement(query)) {
+        qDebug() << "Ошибка свертки счетчика изменений библиотеки:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+int DatabaseManager::songCount()
+{
+    QSqlQuery &query = statement("songCount", "SELECT count(*) FROM Songs;");
+    if (!execStatement(query) || !query.next()) {
+        qDebug() << "Ошибка подсчета песен:" << query.lastError().text();
+        return -1;
+    }
+    return query.value(0).toInt();
+}
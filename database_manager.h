@@ -2,12 +2,22 @@
 #define DATABASE_MANAGER_H
 
 #include <QSqlDatabase>
+#include <QSqlDriver>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QDebug>
 #include <QString>
 #include <QList>
+#include <QHash>
+#include <QPair>
+#include <QStringList>
 #include <QDateTime> // Для PlaybackHistory
+#include <functional>
+
+#include "name_id_cache.h"
+#include "query_metrics.h"
+
+struct ReplayGainValues;
 
 // Существующие структуры
 struct SongInfo {
@@ -17,6 +27,7 @@ struct SongInfo {
     QString album;
     QString filePath;
     int durationMs;
+    qint64 playlistOrder = 0; // song_order, только в строках плейлиста: курсор следующей страницы
 };
 
 struct PlaylistInfo {
@@ -58,29 +69,116 @@ struct PlaybackEntryInfo {
 };
 
 
+// Состояние анализа громкости песни для LoudnessScanner; -1 — файл еще не анализировался
+struct SongScanState {
+    int id;
+    QString filePath;
+    QString album;
+    QString artist;
+    qint64 fileMtime;
+    qint64 fileSize;
+    bool hasLoudness;     // false после неудачного анализа (или для тишины)
+};
+
+// Громкость песни по EBU R128. Пишется вместе с mtime и размером файла; при valid == false
+// (файл не декодировался или в нем тишина) сохраняются только они, чтобы не повторять анализ
+struct SongLoudnessInfo {
+    int songId = -1;
+    qint64 fileMtime = -1;
+    qint64 fileSize = -1;
+    bool valid = false;
+    double integratedLufs = 0.0;
+    double rangeLu = 0.0;
+    double truePeakDbtp = 0.0;
+    double replayGainDb = 0.0;
+    QByteArray histogram;      // LoudnessHistogram::serialize(), из нее считается громкость альбома
+};
+
+// Громкость альбома; альбом определяется названием и исполнителем, как в Songs
+struct AlbumLoudnessInfo {
+    QString album;
+    QString artist;
+    double integratedLufs = 0.0;
+    double rangeLu = 0.0;
+    double truePeakDbtp = 0.0;
+    double replayGainDb = 0.0;
+};
+
+// Песня и ее позиция (число строк перед ней) в порядке списка — библиотеки или плейлиста
+struct SongPosition {
+    SongInfo song;
+    int position = 0;
+};
+
+// Сервер PostgreSQL или локальный файл SQLite (настройка database/backend). В SQLite нет
+// LISTEN/NOTIFY и pg_trgm: кэш каталога работает без живых уведомлений, поиск — в памяти
+enum class DatabaseBackend {
+    PostgreSql,
+    Sqlite
+};
+
+
 class DatabaseManager {
 public:
-    DatabaseManager();
+    explicit DatabaseManager(DatabaseBackend backend = DatabaseBackend::PostgreSql);
+    // Отдельное именованное соединение с параметрами основного (для рабочих потоков).
+    // Соединение нужно открыть через open() в том потоке, где оно будет использоваться.
+    explicit DatabaseManager(const QString &connectionName);
     ~DatabaseManager();
 
+    // Только запоминает параметры (соединение не открывается); именованные соединения
+    // рабочих потоков копируют их из основного
+    void setConnectionParameters(const QString& hostName, int port,
+                                 const QString& dbName, const QString& userName,
+                                 const QString& password);
+    // Файл базы SQLite; каталог создается при необходимости
+    void setDatabaseFile(const QString &path);
     bool connectToDatabase(const QString& hostName, int port,
                            const QString& dbName, const QString& userName,
                            const QString& password);
+    bool open();
     void disconnectFromDatabase();
-    bool createTables();
+    QString connectionName() const;
+    DatabaseBackend backend() const;
+    // Те же счетчики после каждого запроса уходят в QueryMetrics (Prometheus и окно диагностики)
+    StatementCacheStats statementCacheStats() const;
+    // Закрывает результат последнего запроса. Недочитанный SELECT или RETURNING держит
+    // в SQLite открытую транзакцию (снимок чтения или блокировку записи) до сброса запроса
+    void releaseStatements();
+    // Применяет недостающие миграции из SchemaMigrator::migrations()
+    bool migrateSchema();
     bool seedDatabase(); // НОВОЕ: Объявление функции для заполнения БД начальными данными
 
     // Методы для Songs
     QList<SongInfo> loadSongs();
+    // Постраничная загрузка с keyset-пагинацией по (title, id): afterId = -1 — первая страница,
+    // иначе строки строго после песни (afterTitle, afterId)
+    QList<SongInfo> loadSongsPage(const QString &afterTitle, int afterId, int limit);
     int addSong(const QString &filePath, const QString &title, const QString &artist,
                 const QString &album, int durationMs);
     bool deleteSong(int songId);
+    // Массовое добавление/обновление песен одной транзакцией многострочными upsert'ами.
+    // Возвращает ID в порядке входного списка (-1, если строку записать не удалось).
+    QList<int> addSongs(const QList<SongInfo> &songs,
+                        const std::function<void(int done, int total)> &progress = {});
 
     // Методы для Playlists
     QList<PlaylistInfo> loadPlaylists();
     int createPlaylist(const QString &name);
-    bool addSongToPlaylist(int playlistId, int songId, int songOrder);
+    // Порядок песен — разреженные ключи song_order (шаг PlaylistOrderGap): вставка и
+    // перемещение пишут только свои строки, ключ берется между соседями.
+    // beforeSongId = -1 — в конец. false, если песня уже в плейлисте
+    bool addSongToPlaylist(int playlistId, int songId, int beforeSongId = -1);
+    // Ставит songIds в указанном порядке перед beforeSongId (-1 — в конец) одной транзакцией
+    bool moveSongsInPlaylist(int playlistId, const QList<int> &songIds, int beforeSongId);
+    // Перенумеровывает плейлист с исходным шагом (нужно, когда место между ключами кончилось)
+    bool rebalancePlaylist(int playlistId);
+    // Фоновое обслуживание: перенумеровывает плейлисты со слишком близкими ключами
+    int rebalanceCrowdedPlaylists();
     QList<SongInfo> getSongsInPlaylist(int playlistId);
+    // То же для плейлиста: keyset по (song_order, song_id), afterSongId = -1 — первая страница,
+    // иначе строки строго после (afterOrder, afterSongId) последней загруженной строки
+    QList<SongInfo> getSongsInPlaylistPage(int playlistId, qint64 afterOrder, int afterSongId, int limit);
     bool removeSongFromPlaylist(int playlistId, int songId);
     bool deletePlaylist(int playlistId); // НОВЫЙ МЕТОД
 
@@ -111,10 +209,141 @@ public:
 
     // Новые методы для PlaybackHistory
     bool addPlaybackEntry(int userId, int songId);
+    // Пакетная вставка с временем прослушивания из записей (id игнорируется); все или ничего
+    bool addPlaybackEntries(const QList<PlaybackEntryInfo> &entries);
     QList<PlaybackEntryInfo> getPlaybackHistory(int userId, int limit = 100);
 
+    // Громкость (LoudnessScanner)
+    QList<SongScanState> loadSongScanStates();
+    // Пакетная запись результатов анализа одной транзакцией; альбомная поправка
+    // обновленных песен сбрасывается до пересчета альбома
+    bool updateSongLoudness(const QList<SongLoudnessInfo> &songs);
+    // Альбомы, у которых есть проанализированные песни без альбомной поправки
+    QList<AlbumLoudnessInfo> loadAlbumsPendingLoudness();
+    // Гистограммы и пики проанализированных песен альбома
+    QList<SongLoudnessInfo> getAlbumSongLoudness(const QString &album, const QString &artist);
+    bool updateAlbumLoudness(const AlbumLoudnessInfo &album);
+    // ReplayGain из библиотеки по пути к файлу — для файлов без тегов ReplayGain
+    QHash<QString, ReplayGainValues> loadLibraryReplayGain();
+
+    // Справочники: ID по именам, недостающие строки создаются. Один запрос на пачку
+    // до тысячи имен; уже известные ID берутся из NameIdCache без обращения к БД.
+    // Ключ результата — имя, для альбомов — NameIdCache::albumKey(название, ID исполнителя)
+    QHash<QString, int> resolveArtistIds(const QStringList &names);
+    QHash<QString, int> resolveGenreIds(const QStringList &names);
+    QHash<QString, int> resolveAlbumIds(const QList<QPair<QString, int>> &albums); // ID исполнителя <= 0 — без исполнителя
+    // Забывает ID справочников этой базы; нужно, если база пересоздается под тем же именем
+    void clearNameIdCache();
+    // Заполняет Songs.artist_id/album_id для следующих batchSize песен после afterId,
+    // у которых они не заданы. Возвращает ID последней просмотренной песни, 0 — больше
+    // таких песен нет, -1 — ошибка; linked — число обновленных строк
+    int linkSongsToCatalog(int afterId, int batchSize, int *linked = nullptr);
+
+    // Кэш каталога
+    // Уведомления PostgreSQL (LISTEN). Сигнал QSqlDriver::notification приходит через цикл
+    // событий потока, в котором открыто соединение
+    QSqlDriver *driver() const;
+    bool subscribe(const QString &channel);
+    // Проверяет соединение и при обрыве переподключается (подписки при этом теряются)
+    bool ensureConnected(bool *reconnected = nullptr);
+    // Текущие данные и позиции songIds в библиотеке (playlistId = -1) или в плейлисте;
+    // песен, которых в списке больше нет, в ответе нет. Позиции считаются не дальше limit:
+    // limit означает «limit или дальше», то есть за пределами загруженной части списка
+    QList<SongPosition> loadSongPositions(int playlistId, const QList<int> &songIds, int limit);
+    QList<PlaylistInfo> loadPlaylistsByIds(const QList<int> &playlistIds);
+    QList<QPair<int, int>> loadPlaylistMembership(); // (playlist_id, song_id)
+
+    // Снимок библиотеки
+    // Транзакция только для чтения с единым снимком данных (REPEATABLE READ): счетчик
+    // изменений и постраничное чтение песен в ней согласованы
+    bool beginConsistentRead();
+    void endConsistentRead();
+    // Счетчик изменений библиотеки (сумма CatalogChanges в PostgreSQL, CatalogRevision
+    // в SQLite); -1 — ошибка
+    qint64 catalogRevision();
+    // Сворачивает строки CatalogChanges в одну, не меняя счетчик; в SQLite ничего не делает
+    bool compactCatalogRevision();
+    int songCount(); // -1 — ошибка
+
+    // Поиск
+    // Только id, название, исполнитель и альбом всех песен — для построения SearchIndex
+    QList<SongInfo> loadSongSearchFields();
+    // Песни в порядке songIds; отсутствующие в БД пропускаются
+    QList<SongInfo> loadSongsByIds(const QList<int> &songIds);
+    // Поиск на сервере (настройка search/backend=pg_trgm) возможен, если миграция построила
+    // GIN-индекс pg_trgm по названию, исполнителю и альбому. false — расширение недоступно
+    bool hasSearchIndex();
+    // Каждое слово text должно встречаться как подстрока; порядок — по сходству триграмм
+    QList<SongInfo> searchSongs(const QString &text, int limit);
+
 private:
+    Q_DISABLE_COPY(DatabaseManager)
+
+    struct PreparedStatement {
+        QString id;
+        QString sql;
+        QSqlQuery query;
+        bool prepared;
+        quint64 lastUse = 0;
+    };
+
+    // Больше подготовленных запросов на соединение не держим: вытесняется давно не использованный
+    static constexpr int MaxCachedStatements = 256;
+
+    // Возвращает долгоживущий подготовленный запрос по его идентификатору
+    QSqlQuery &statement(const QString &id, const QString &sql);
+    void evictStatement();
+    // Выполняет запрос из кэша; при обрыве соединения переподключается и повторяет один раз.
+    // Время, ошибки и число измененных строк записываются в QueryMetrics
+    bool execStatement(QSqlQuery &query);
+    bool execWithReconnect(QSqlQuery &query);
+    // SqlRowMapper::readAll с учетом прочитанных строк в метриках запроса
+    template <typename Struct>
+    QList<Struct> readRows(QSqlQuery &query, qsizetype sizeHint = -1);
+    void countRows(const QSqlQuery &query, qsizetype rows);
+    // План медленного запроса снимается после того, как его результат дочитан и закрыт,
+    // а в PostgreSQL — еще и вне транзакции вызывающего метода
+    void capturePendingPlan();
+    QString inlineParameters(const QSqlQuery &query, const QString &sql) const;
+    bool isConnectionAlive();
+    bool reconnect();
+    void clearStatementCache();
+    bool configureConnection();
+    bool isSqlite() const { return m_backend == DatabaseBackend::Sqlite; }
+    // Условие "expr входит / не входит в список ID" для параметра param со значением idList()
+    QString idListContains(const QString &expr, const QString &param) const;
+    QString idListExcludes(const QString &expr, const QString &param) const;
+    QString idList(const QList<int> &values) const;
+    int addSongSqlite(const SongInfo &song);
+    QHash<QString, int> resolveNames(const QString &table, NameIdCache::Dictionary dictionary,
+                                     const QStringList &names);
+    NameIdCache &nameIds() const;
+
+    static constexpr qint64 PlaylistOrderGap = 65536;
+    static constexpr qint64 PlaylistMinGap = 32; // ближе — плейлист перенумеровывается заранее
+    bool lockPlaylist(int playlistId);
+    bool renumberPlaylist(int playlistId);
+    // count ключей между соседями места вставки; при нехватке места плейлист перенумеровывается
+    bool playlistOrderKeys(int playlistId, int beforeSongId, const QList<int> &movedSongIds,
+                           int count, QList<qint64> *keys);
+
+    bool beginTransaction();
+    bool commitTransaction();
+    void rollbackTransaction();
+
     QSqlDatabase db;
+    QString m_connectionName; // пусто для соединения по умолчанию
+    DatabaseBackend m_backend = DatabaseBackend::PostgreSql;
+
+    QHash<QString, PreparedStatement *> m_statements;
+    QHash<const QSqlQuery *, PreparedStatement *> m_statementsByQuery;
+    QSqlQuery *m_lastStatement = nullptr;
+    quint64 m_statementUses = 0;
+    StatementCacheStats m_statementStats;
+    bool m_inTransaction = false;
+    QString m_pendingPlanStatement; // метрика и текст запроса с подставленными параметрами
+    QString m_pendingPlanSql;
+    bool m_pendingPlanAnalyze = false; // только чтение: план можно снять с ANALYZE
 };
 
 #endif // DATABASE_MANAGER_H
@@ -0,0 +1,306 @@
+#include "diagnostics_dialog.h"
+
+#include <QDialogButtonBox>
+#include <QFont>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QSignalBlocker>
+#include <QSplitter>
+#include <QTabWidget>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+namespace {
+
+enum QueryColumn {
+    StatementColumn,
+    CallsColumn,
+    ErrorsColumn,
+    RowsColumn,
+    P50Column,
+    P95Column,
+    P99Column,
+    MaxColumn,
+    TotalColumn,
+    SlowColumn,
+    QueryColumnCount
+};
+
+enum PlaybackColumn {
+    StageColumn,
+    FormatColumn,
+    WindowCountColumn,
+    PlaybackP50Column,
+    PlaybackP95Column,
+    PlaybackP99Column,
+    PlaybackMaxColumn,
+    TotalCountColumn,
+    PlaybackColumnCount
+};
+
+enum CacheColumn {
+    ConnectionColumn,
+    HitsColumn,
+    MissesColumn,
+    HitRateColumn,
+    EvictionsColumn,
+    RebuildsColumn,
+    SizeColumn,
+    CacheColumnCount
+};
+
+QTableWidgetItem *numberItem(const QString &text)
+{
+    auto *item = new QTableWidgetItem(text);
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    return item;
+}
+
+QString milliseconds(double ms)
+{
+    return QString::number(ms, 'f', ms < 10.0 ? 2 : 0);
+}
+
+} // namespace
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget *parent)
+    : QDialog(parent)
+    , m_refreshTimer(new QTimer(this))
+{
+    setWindowTitle("Диагностика");
+    resize(900, 560);
+
+    m_tabs = new QTabWidget(this);
+    m_tabs->addTab(createQueriesTab(), "Запросы к БД");
+    m_tabs->addTab(createStatementCacheTab(), "Кэш запросов");
+    m_tabs->addTab(createPlaybackTab(), "Воспроизведение");
+
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    QPushButton *resetButton = buttons->addButton("Сбросить метрики", QDialogButtonBox::ResetRole);
+    connect(resetButton, &QPushButton::clicked, this, &DiagnosticsDialog::resetMetrics);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->addWidget(m_tabs);
+    layout->addWidget(buttons);
+
+    m_refreshTimer->setInterval(1000);
+    connect(m_refreshTimer, &QTimer::timeout, this, &DiagnosticsDialog::refresh);
+}
+
+QWidget *DiagnosticsDialog::createQueriesTab()
+{
+    auto *tab = new QWidget(this);
+    m_summaryLabel = new QLabel(tab);
+
+    m_queryTable = new QTableWidget(0, QueryColumnCount, tab);
+    m_queryTable->setHorizontalHeaderLabels({"Запрос", "Вызовы", "Ошибки", "Строки", "p50, мс", "p95, мс",
+                                             "p99, мс", "Макс., мс", "Всего, мс", "Медленные"});
+    m_queryTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_queryTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_queryTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_queryTable->verticalHeader()->hide();
+    m_queryTable->horizontalHeader()->setSectionResizeMode(StatementColumn, QHeaderView::Stretch);
+    connect(m_queryTable, &QTableWidget::itemSelectionChanged, this, &DiagnosticsDialog::showSelectedPlan);
+
+    m_planView = new QPlainTextEdit(tab);
+    m_planView->setReadOnly(true);
+    m_planView->setLineWrapMode(QPlainTextEdit::NoWrap);
+    m_planView->setFont(QFont("monospace"));
+    m_planView->setPlaceholderText("План снимается автоматически для запросов дольше порога diagnostics/slowQueryMs");
+
+    auto *splitter = new QSplitter(Qt::Vertical, tab);
+    splitter->addWidget(m_queryTable);
+    splitter->addWidget(m_planView);
+    splitter->setStretchFactor(0, 3);
+    splitter->setStretchFactor(1, 2);
+
+    auto *layout = new QVBoxLayout(tab);
+    layout->addWidget(m_summaryLabel);
+    layout->addWidget(splitter);
+    return tab;
+}
+
+QWidget *DiagnosticsDialog::createPlaybackTab()
+{
+    auto *tab = new QWidget(this);
+    auto *description = new QLabel("Отсчет от запроса трека до отметок на пути воспроизведения и паузы между "
+                                   "треками. Квантили и максимум — за последний час, «Всего» — с запуска", tab);
+    description->setWordWrap(true);
+
+    m_playbackTable = new QTableWidget(0, PlaybackColumnCount, tab);
+    m_playbackTable->setHorizontalHeaderLabels({"Этап", "Формат", "За час", "p50, мс", "p95, мс", "p99, мс",
+                                                "Макс., мс", "Всего"});
+    m_playbackTable->setSelectionMode(QAbstractItemView::NoSelection);
+    m_playbackTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_playbackTable->verticalHeader()->hide();
+    m_playbackTable->horizontalHeader()->setSectionResizeMode(StageColumn, QHeaderView::Stretch);
+
+    auto *layout = new QVBoxLayout(tab);
+    layout->addWidget(description);
+    layout->addWidget(m_playbackTable);
+    return tab;
+}
+
+QWidget *DiagnosticsDialog::createStatementCacheTab()
+{
+    auto *tab = new QWidget(this);
+    auto *description = new QLabel("Подготовленные запросы открытых соединений с БД. Промахи после первых минут "
+                                   "работы и вытеснения означают, что запросы не переиспользуются", tab);
+    description->setWordWrap(true);
+
+    m_cacheTable = new QTableWidget(0, CacheColumnCount, tab);
+    m_cacheTable->setHorizontalHeaderLabels({"Соединение", "Попадания", "Промахи", "Попаданий, %", "Вытеснения",
+                                             "Пересоздания", "В кэше"});
+    m_cacheTable->setSelectionMode(QAbstractItemView::NoSelection);
+    m_cacheTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_cacheTable->verticalHeader()->hide();
+    m_cacheTable->horizontalHeader()->setSectionResizeMode(ConnectionColumn, QHeaderView::Stretch);
+
+    auto *layout = new QVBoxLayout(tab);
+    layout->addWidget(description);
+    layout->addWidget(m_cacheTable);
+    return tab;
+}
+
+void DiagnosticsDialog::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+    refresh();
+    m_refreshTimer->start();
+}
+
+void DiagnosticsDialog::hideEvent(QHideEvent *event)
+{
+    m_refreshTimer->stop();
+    QDialog::hideEvent(event);
+}
+
+void DiagnosticsDialog::refresh()
+{
+    refreshQueries();
+    refreshStatementCache();
+    refreshPlayback();
+}
+
+void DiagnosticsDialog::refreshQueries()
+{
+    // Выделение переносится по имени запроса: порядок строк меняется вместе со временем
+    const int selectedRow = m_queryTable->currentRow();
+    const QString selected = selectedRow >= 0 && selectedRow < m_stats.size() ? m_stats.at(selectedRow).statement
+                                                                              : QString();
+
+    QueryMetrics &metrics = QueryMetrics::instance();
+    m_stats = metrics.stats();
+    quint64 calls = 0;
+    quint64 errors = 0;
+    double totalMs = 0.0;
+
+    QSignalBlocker blocker(m_queryTable);
+    m_queryTable->setRowCount(int(m_stats.size()));
+    int selectRow = -1;
+    for (int row = 0; row < m_stats.size(); ++row) {
+        const QueryStats &stats = m_stats.at(row);
+        calls += stats.calls;
+        errors += stats.errors;
+        totalMs += stats.totalMs;
+        if (stats.statement == selected) {
+            selectRow = row;
+        }
+        auto *name = new QTableWidgetItem(stats.statement);
+        if (!stats.plan.isEmpty()) {
+            name->setToolTip("Есть план медленного выполнения");
+            QFont font = name->font();
+            font.setBold(true);
+            name->setFont(font);
+        }
+        m_queryTable->setItem(row, StatementColumn, name);
+        m_queryTable->setItem(row, CallsColumn, numberItem(QString::number(stats.calls)));
+        m_queryTable->setItem(row, ErrorsColumn, numberItem(QString::number(stats.errors)));
+        m_queryTable->setItem(row, RowsColumn, numberItem(QString::number(stats.rows)));
+        m_queryTable->setItem(row, P50Column, numberItem(milliseconds(stats.p50Ms)));
+        m_queryTable->setItem(row, P95Column, numberItem(milliseconds(stats.p95Ms)));
+        m_queryTable->setItem(row, P99Column, numberItem(milliseconds(stats.p99Ms)));
+        m_queryTable->setItem(row, MaxColumn, numberItem(milliseconds(stats.maxMs)));
+        m_queryTable->setItem(row, TotalColumn, numberItem(milliseconds(stats.totalMs)));
+        m_queryTable->setItem(row, SlowColumn, numberItem(QString::number(stats.slowCalls)));
+    }
+    if (selectRow >= 0) {
+        m_queryTable->selectRow(selectRow);
+    } else {
+        m_queryTable->clearSelection();
+    }
+    blocker.unblock();
+    showSelectedPlan();
+
+    const int threshold = metrics.slowQueryThresholdMs();
+    m_summaryLabel->setText(QString("Запросов: %1, вызовов: %2, ошибок: %3, всего %4 мс. Порог медленного запроса: %5")
+                                .arg(m_stats.size())
+                                .arg(calls)
+                                .arg(errors)
+                                .arg(milliseconds(totalMs))
+                                .arg(threshold > 0 ? QString("%1 мс").arg(threshold) : QString("выключен")));
+}
+
+void DiagnosticsDialog::refreshPlayback()
+{
+    const QList<PlaybackLatencyStats> all = PlaybackTelemetry::instance().stats();
+    m_playbackTable->setRowCount(int(all.size()));
+    for (int row = 0; row < all.size(); ++row) {
+        const PlaybackLatencyStats &stats = all.at(row);
+        m_playbackTable->setItem(row, StageColumn, new QTableWidgetItem(stats.stage));
+        m_playbackTable->setItem(row, FormatColumn, new QTableWidgetItem(stats.format));
+        m_playbackTable->setItem(row, WindowCountColumn, numberItem(QString::number(stats.count)));
+        m_playbackTable->setItem(row, PlaybackP50Column, numberItem(milliseconds(stats.p50Ms)));
+        m_playbackTable->setItem(row, PlaybackP95Column, numberItem(milliseconds(stats.p95Ms)));
+        m_playbackTable->setItem(row, PlaybackP99Column, numberItem(milliseconds(stats.p99Ms)));
+        m_playbackTable->setItem(row, PlaybackMaxColumn, numberItem(milliseconds(stats.maxMs)));
+        m_playbackTable->setItem(row, TotalCountColumn, numberItem(QString::number(stats.totalCount)));
+    }
+}
+
+void DiagnosticsDialog::refreshStatementCache()
+{
+    const QList<StatementCacheStats> all = QueryMetrics::instance().statementCacheStats();
+    m_cacheTable->setRowCount(int(all.size()));
+    for (int row = 0; row < all.size(); ++row) {
+        const StatementCacheStats &stats = all.at(row);
+        const quint64 lookups = stats.hits + stats.misses;
+        m_cacheTable->setItem(row, ConnectionColumn, new QTableWidgetItem(stats.connection));
+        m_cacheTable->setItem(row, HitsColumn, numberItem(QString::number(stats.hits)));
+        m_cacheTable->setItem(row, MissesColumn, numberItem(QString::number(stats.misses)));
+        m_cacheTable->setItem(row, HitRateColumn,
+                              numberItem(lookups > 0 ? QString::number(100.0 * stats.hits / lookups, 'f', 1) : QString()));
+        m_cacheTable->setItem(row, EvictionsColumn, numberItem(QString::number(stats.evictions)));
+        m_cacheTable->setItem(row, RebuildsColumn, numberItem(QString::number(stats.rebuilds)));
+        m_cacheTable->setItem(row, SizeColumn, numberItem(QString::number(stats.size)));
+    }
+}
+
+void DiagnosticsDialog::showSelectedPlan()
+{
+    const int row = m_queryTable->currentRow();
+    if (row < 0 || row >= m_stats.size() || m_queryTable->selectedItems().isEmpty()) {
+        m_planView->clear();
+        return;
+    }
+    const QueryStats &stats = m_stats.at(row);
+    const QString text = stats.plan.isEmpty()
+                             ? QString()
+                             : QString("-- %1, снят %2\n%3")
+                                   .arg(stats.statement, stats.planCapturedAt.toString(Qt::ISODate), stats.plan);
+    // Текст не перезаписывается без изменений, иначе каждое обновление сбрасывало бы прокрутку
+    if (m_planView->toPlainText() != text) {
+        m_planView->setPlainText(text);
+    }
+}
+
+void DiagnosticsDialog::resetMetrics()
+{
+    QueryMetrics::instance().reset();
+    PlaybackTelemetry::instance().reset();
+    refresh();
+}
@@ -0,0 +1,53 @@
+#ifndef DIAGNOSTICS_DIALOG_H
+#define DIAGNOSTICS_DIALOG_H
+
+#include <QDialog>
+#include <QList>
+#include "playback_telemetry.h"
+#include "query_metrics.h"
+
+class QLabel;
+class QPlainTextEdit;
+class QTabWidget;
+class QTableWidget;
+class QTimer;
+
+// Скрытое окно диагностики (Ctrl+Shift+D в главном окне): метрики запросов к БД,
+// планы медленных запросов, кэш подготовленных запросов по соединениям и задержки
+// воспроизведения. Пока окно открыто, данные
+// обновляются раз в секунду
+class DiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsDialog(QWidget *parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void refresh();
+    void showSelectedPlan();
+    void resetMetrics();
+
+private:
+    QWidget *createQueriesTab();
+    QWidget *createPlaybackTab();
+    QWidget *createStatementCacheTab();
+    void refreshQueries();
+    void refreshPlayback();
+    void refreshStatementCache();
+
+    QTabWidget *m_tabs;
+    QTableWidget *m_queryTable;
+    QPlainTextEdit *m_planView;
+    QLabel *m_summaryLabel;
+    QTableWidget *m_playbackTable;
+    QTableWidget *m_cacheTable;
+    QTimer *m_refreshTimer;
+    QList<QueryStats> m_stats; // в порядке строк таблицы
+};
+
+#endif // DIAGNOSTICS_DIALOG_H
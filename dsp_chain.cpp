@@ -0,0 +1,329 @@
+#include "dsp_chain.h"
+#include "tag_reader.h"
+
+#include <QDebug>
+#include <QtMath>
+#include <cmath>
+#include <cstring>
+
+DspChain::DspChain(const QAudioFormat &format)
+    : m_format(format)
+    , m_channels(qBound(1, format.channelCount(), int(MaxChannels)))
+    , m_kernels(DspKernels::active())
+    , m_rampFrames(qMax<qint64>(1, qint64(format.sampleRate()) * RampMs / 1000))
+{
+}
+
+// --- GUI-поток ---
+
+void DspChain::setVolume(float volume)
+{
+    m_editing.volume = qBound(0.0f, volume, 1.0f);
+    publish();
+}
+
+void DspChain::setEqualizer(const QList<EqBand> &bands)
+{
+    m_editing.bandCount = 0;
+    for (const EqBand &band : bands) {
+        if (m_editing.bandCount == MaxBands) {
+            qDebug() << "Эквалайзер: полос больше" << MaxBands << ", лишние пропущены";
+            break;
+        }
+        if (qFuzzyIsNull(band.gainDb)) {
+            continue; // нулевая полоса ничего не меняет, а время на нее тратится
+        }
+        m_editing.bands[m_editing.bandCount++] = biquadFor(band, m_format.sampleRate());
+    }
+    publish();
+}
+
+void DspChain::setLimiter(bool enabled, float thresholdDb)
+{
+    m_editing.limiterThreshold = enabled ? qBound(0.1f, std::pow(10.0f, thresholdDb / 20.0f), 0.999f) : 1.0f;
+    publish();
+}
+
+void DspChain::publish()
+{
+    m_slots[m_writeSlot] = m_editing;
+    m_writeSlot = m_middleSlot.exchange(m_writeSlot | FreshBit, std::memory_order_acq_rel) & 3;
+}
+
+BiquadCoefficients DspChain::biquadFor(const EqBand &band, int sampleRate)
+{
+    const double rate = qMax(1, sampleRate);
+    const double frequency = qBound(10.0, band.frequencyHz, rate * 0.49);
+    const double A = std::pow(10.0, band.gainDb / 40.0);
+    const double w0 = 2.0 * M_PI * frequency / rate;
+    const double cosW = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * qMax(0.05, band.q));
+    const double twoSqrtAAlpha = 2.0 * std::sqrt(A) * alpha;
+
+    double b0, b1, b2, a0, a1, a2;
+    switch (band.type) {
+    case EqBand::LowShelf:
+        b0 = A * ((A + 1) - (A - 1) * cosW + twoSqrtAAlpha);
+        b1 = 2 * A * ((A - 1) - (A + 1) * cosW);
+        b2 = A * ((A + 1) - (A - 1) * cosW - twoSqrtAAlpha);
+        a0 = (A + 1) + (A - 1) * cosW + twoSqrtAAlpha;
+        a1 = -2 * ((A - 1) + (A + 1) * cosW);
+        a2 = (A + 1) + (A - 1) * cosW - twoSqrtAAlpha;
+        break;
+    case EqBand::HighShelf:
+        b0 = A * ((A + 1) + (A - 1) * cosW + twoSqrtAAlpha);
+        b1 = -2 * A * ((A - 1) + (A + 1) * cosW);
+        b2 = A * ((A + 1) + (A - 1) * cosW - twoSqrtAAlpha);
+        a0 = (A + 1) - (A - 1) * cosW + twoSqrtAAlpha;
+        a1 = 2 * ((A - 1) - (A + 1) * cosW);
+        a2 = (A + 1) - (A - 1) * cosW - twoSqrtAAlpha;
+        break;
+    case EqBand::Peaking:
+    default:
+        b0 = 1 + alpha * A;
+        b1 = -2 * cosW;
+        b2 = 1 - alpha * A;
+        a0 = 1 + alpha / A;
+        a1 = -2 * cosW;
+        a2 = 1 - alpha / A;
+        break;
+    }
+
+    BiquadCoefficients c;
+    c.b0 = float(b0 / a0);
+    c.b1 = float(b1 / a0);
+    c.b2 = float(b2 / a0);
+    c.a1 = float(a1 / a0);
+    c.a2 = float(a2 / a0);
+    return c;
+}
+
+// --- Аудиопоток ---
+
+void DspChain::process(char *data, qint64 frames)
+{
+    if (m_middleSlot.load(std::memory_order_relaxed) & FreshBit) {
+        m_readSlot = m_middleSlot.exchange(m_readSlot, std::memory_order_acq_rel) & 3;
+    }
+
+    switch (m_format.sampleFormat()) {
+    case QAudioFormat::Float:
+        processFloat(reinterpret_cast<float *>(data), frames);
+        break;
+    case QAudioFormat::Int16:
+    case QAudioFormat::Int32: {
+        // Целые форматы обрабатываются кусками через буфер float внутри объекта
+        const bool int16 = m_format.sampleFormat() == QAudioFormat::Int16;
+        const qsizetype chunkFrames = ScratchSamples / m_channels;
+        for (qint64 done = 0; done < frames; done += chunkFrames) {
+            const qsizetype count = qMin<qint64>(chunkFrames, frames - done) * m_channels;
+            if (int16) {
+                qint16 *samples = reinterpret_cast<qint16 *>(data) + done * m_channels;
+                m_kernels.int16ToFloat(samples, m_scratch, count);
+                processFloat(m_scratch, count / m_channels);
+                m_kernels.floatToInt16(m_scratch, samples, count);
+            } else {
+                qint32 *samples = reinterpret_cast<qint32 *>(data) + done * m_channels;
+                m_kernels.int32ToFloat(samples, m_scratch, count);
+                processFloat(m_scratch, count / m_channels);
+                m_kernels.floatToInt32(m_scratch, samples, count);
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void DspChain::processFloat(float *data, qsizetype frames)
+{
+    applyEqualizer(data, frames);
+    applyVolume(data, frames);
+    const float threshold = m_slots[m_readSlot].limiterThreshold;
+    if (threshold < 1.0f) {
+        m_kernels.softLimit(data, frames * m_channels, threshold);
+    }
+}
+
+void DspChain::applyVolume(float *data, qsizetype frames)
+{
+    const float target = m_slots[m_readSlot].volume;
+    if (target != m_rampTarget) {
+        m_rampTarget = target;
+        m_rampRemaining = m_rampFrames;
+    }
+
+    qsizetype done = 0;
+    if (m_rampRemaining > 0) {
+        // Линейная рампа по кадрам: скачок громкости дал бы щелчок
+        const qsizetype count = qMin<qint64>(frames, m_rampRemaining);
+        const float step = (m_rampTarget - m_currentVolume) / float(m_rampRemaining);
+        for (qsizetype i = 0; i < count; ++i) {
+            const float gain = m_currentVolume + step * float(i + 1);
+            float *frame = data + i * m_channels;
+            for (int channel = 0; channel < m_channels; ++channel) {
+                frame[channel] *= gain;
+            }
+        }
+        m_rampRemaining -= count;
+        m_currentVolume = m_rampRemaining > 0 ? m_currentVolume + step * float(count) : m_rampTarget;
+        done = count;
+    }
+    if (m_currentVolume != 1.0f && done < frames) {
+        m_kernels.applyGain(data + done * m_channels, (frames - done) * m_channels, m_currentVolume);
+    }
+}
+
+void DspChain::applyEqualizer(float *data, qsizetype frames)
+{
+    const Settings &settings = m_slots[m_readSlot];
+    if (settings.bandCount != m_activeBands) {
+        // Состояние сохраняется для оставшихся полос, новые начинают с нуля
+        for (int band = m_activeBands; band < settings.bandCount; ++band) {
+            std::memset(m_stereoState[band], 0, sizeof(m_stereoState[band]));
+            std::memset(m_biquadState[band], 0, sizeof(m_biquadState[band]));
+        }
+        m_activeBands = settings.bandCount;
+    }
+    if (m_activeBands == 0) {
+        return;
+    }
+
+    if (m_channels == 2) {
+        m_kernels.biquadStereo(data, frames, settings.bands, m_activeBands, &m_stereoState[0][0][0]);
+    } else {
+        for (int band = 0; band < m_activeBands; ++band) {
+            const BiquadCoefficients &c = settings.bands[band];
+            for (int channel = 0; channel < m_channels; ++channel) {
+                float s1 = m_biquadState[band][channel][0];
+                float s2 = m_biquadState[band][channel][1];
+                for (qsizetype i = 0; i < frames; ++i) {
+                    float &sample = data[i * m_channels + channel];
+                    const float x = sample;
+                    const float y = c.b0 * x + s1;
+                    s1 = c.b1 * x - c.a1 * y + s2;
+                    s2 = c.b2 * x - c.a2 * y;
+                    sample = y;
+                }
+                m_biquadState[band][channel][0] = s1;
+                m_biquadState[band][channel][1] = s2;
+            }
+        }
+    }
+
+    // Затухающее состояние фильтра уходит в денормализованные числа, которые
+    // в разы замедляют арифметику; обнуляем его, когда оно уже неслышно
+    float *states[] = {&m_stereoState[0][0][0], &m_biquadState[0][0][0]};
+    const int sizes[] = {m_activeBands * 4, m_activeBands * MaxChannels * 2};
+    for (int k = 0; k < 2; ++k) {
+        for (int i = 0; i < sizes[k]; ++i) {
+            if (std::fabs(states[k][i]) < 1e-15f) {
+                states[k][i] = 0.0f;
+            }
+        }
+    }
+}
+
+// --- Без состояния ---
+
+void DspChain::applyGain(char *data, qint64 frames, const QAudioFormat &format, float gain)
+{
+    if (gain == 1.0f) {
+        return;
+    }
+    const DspKernels &kernels = DspKernels::active();
+    const qint64 count = frames * format.channelCount();
+    float scratch[1024];
+    switch (format.sampleFormat()) {
+    case QAudioFormat::Float:
+        kernels.applyGain(reinterpret_cast<float *>(data), count, gain);
+        break;
+    case QAudioFormat::Int16:
+        for (qint64 done = 0; done < count; done += 1024) {
+            qint16 *samples = reinterpret_cast<qint16 *>(data) + done;
+            const qsizetype chunk = qMin<qint64>(1024, count - done);
+            kernels.int16ToFloat(samples, scratch, chunk);
+            kernels.applyGain(scratch, chunk, gain);
+            kernels.floatToInt16(scratch, samples, chunk);
+        }
+        break;
+    case QAudioFormat::Int32:
+        for (qint64 done = 0; done < count; done += 1024) {
+            qint32 *samples = reinterpret_cast<qint32 *>(data) + done;
+            const qsizetype chunk = qMin<qint64>(1024, count - done);
+            kernels.int32ToFloat(samples, scratch, chunk);
+            kernels.applyGain(scratch, chunk, gain);
+            kernels.floatToInt32(scratch, samples, chunk);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+QList<EqBand> DspChain::parseEqualizer(const QStringList &bands)
+{
+    // "тип:частота:усиление_дБ:добротность", тип — peaking, lowshelf или highshelf
+    QList<EqBand> result;
+    for (const QString &entry : bands) {
+        const QStringList parts = entry.split(':');
+        if (parts.size() != 4) {
+            qDebug() << "Неверная полоса эквалайзера:" << entry;
+            continue;
+        }
+        EqBand band;
+        const QString type = parts.at(0).trimmed().toLower();
+        band.type = type == "lowshelf" ? EqBand::LowShelf : type == "highshelf" ? EqBand::HighShelf : EqBand::Peaking;
+        band.frequencyHz = parts.at(1).toDouble();
+        band.gainDb = parts.at(2).toDouble();
+        band.q = parts.at(3).toDouble();
+        result.append(band);
+    }
+    return result;
+}
+
+ReplayGainMode DspChain::replayGainModeFromString(const QString &mode)
+{
+    if (mode == "off") {
+        return ReplayGainMode::Off;
+    }
+    if (mode == "album") {
+        return ReplayGainMode::Album;
+    }
+    return ReplayGainMode::Track;
+}
+
+ReplayGainValues DspChain::replayGainValues(const TrackTags &tags)
+{
+    ReplayGainValues values;
+    values.hasTrackGain = tags.hasTrackGain;
+    values.hasAlbumGain = tags.hasAlbumGain;
+    values.trackGainDb = tags.trackGainDb;
+    values.trackPeak = tags.trackPeak;
+    values.albumGainDb = tags.albumGainDb;
+    values.albumPeak = tags.albumPeak;
+    return values;
+}
+
+float DspChain::replayGainFactor(const TrackTags &tags, ReplayGainMode mode, float preampDb)
+{
+    return replayGainFactor(replayGainValues(tags), mode, preampDb);
+}
+
+float DspChain::replayGainFactor(const ReplayGainValues &values, ReplayGainMode mode, float preampDb)
+{
+    if (mode == ReplayGainMode::Off || (!values.hasTrackGain && !values.hasAlbumGain)) {
+        return 1.0f;
+    }
+    // Альбомная поправка, если ее просили и она есть; иначе та, что есть
+    const bool useAlbum = values.hasAlbumGain && (mode == ReplayGainMode::Album || !values.hasTrackGain);
+    const float gainDb = useAlbum ? values.albumGainDb : values.trackGainDb;
+    const float peak = useAlbum ? values.albumPeak : values.trackPeak;
+
+    float factor = std::pow(10.0f, (gainDb + preampDb) / 20.0f);
+    if (peak > 0.0f) {
+        factor = qMin(factor, 1.0f / peak);
+    }
+    return factor;
+}
@@ -0,0 +1,111 @@
+#ifndef DSP_CHAIN_H
+#define DSP_CHAIN_H
+
+#include "dsp_kernels.h"
+
+#include <QAudioFormat>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <array>
+#include <atomic>
+
+struct TrackTags;
+
+// Полоса параметрического эквалайзера (формулы RBJ Audio EQ Cookbook)
+struct EqBand {
+    enum Type { Peaking, LowShelf, HighShelf };
+    Type type = Peaking;
+    double frequencyHz = 1000.0;
+    double gainDb = 0.0;
+    double q = 0.707;
+};
+
+enum class ReplayGainMode { Off, Track, Album };
+
+// Поправки ReplayGain трека: из тегов файла или из анализа громкости библиотеки
+struct ReplayGainValues {
+    bool hasTrackGain = false;
+    bool hasAlbumGain = false;
+    float trackGainDb = 0.0f;
+    float trackPeak = 0.0f;    // линейный пик, 0 — неизвестен
+    float albumGainDb = 0.0f;
+    float albumPeak = 0.0f;
+};
+
+// Цепочка обработки декодированного PCM: плавная громкость -> эквалайзер -> мягкий
+// лимитер. process() вызывается из аудиопотока и не выделяет память и не блокируется;
+// параметры из GUI-потока передаются через тройной буфер. Поддерживаются форматы
+// Int16, Int32 и Float (остальные проходят без изменений).
+class DspChain
+{
+public:
+    static constexpr int MaxBands = 10;
+    static constexpr int MaxChannels = 8;
+
+    explicit DspChain(const QAudioFormat &format);
+    Q_DISABLE_COPY(DspChain)
+
+    // --- GUI-поток ---
+    void setVolume(float volume);            // меняется плавно, за RampMs
+    void setEqualizer(const QList<EqBand> &bands);
+    void setLimiter(bool enabled, float thresholdDb = -1.0f);
+
+    // --- Аудиопоток ---
+    void process(char *data, qint64 frames);
+
+    // Постоянный коэффициент для буфера в формате format (ReplayGain в потоке декодера)
+    static void applyGain(char *data, qint64 frames, const QAudioFormat &format, float gain);
+
+    // Полосы из настройки audio/equalizer: "тип:частота:усиление_дБ:добротность"
+    static QList<EqBand> parseEqualizer(const QStringList &bands);
+    static ReplayGainMode replayGainModeFromString(const QString &mode);
+    // Линейный коэффициент ReplayGain с предусилением; ограничен пиком трека, чтобы
+    // усиление не приводило к клиппингу. Без тегов — 1.0
+    static float replayGainFactor(const TrackTags &tags, ReplayGainMode mode, float preampDb);
+    static float replayGainFactor(const ReplayGainValues &values, ReplayGainMode mode, float preampDb);
+    static ReplayGainValues replayGainValues(const TrackTags &tags);
+
+    static BiquadCoefficients biquadFor(const EqBand &band, int sampleRate);
+
+private:
+    static constexpr int RampMs = 20;
+    static constexpr int ScratchSamples = 4096;
+
+    struct Settings {
+        float volume = 1.0f;
+        float limiterThreshold = 1.0f; // >= 1 — лимитер выключен (включает setLimiter)
+        int bandCount = 0;
+        BiquadCoefficients bands[MaxBands];
+    };
+
+    void publish();
+    void processFloat(float *data, qsizetype frames);
+    void applyVolume(float *data, qsizetype frames);
+    void applyEqualizer(float *data, qsizetype frames);
+
+    QAudioFormat m_format;
+    int m_channels;
+    const DspKernels &m_kernels;
+
+    // Тройной буфер: писатель пишет в свой слот и обменивает его со средним,
+    // читатель забирает средний, если там свежие данные (бит FreshBit)
+    static constexpr int FreshBit = 4;
+    std::array<Settings, 3> m_slots;
+    Settings m_editing;                  // копия параметров в GUI-потоке
+    int m_writeSlot = 0;
+    int m_readSlot = 1;
+    std::atomic<int> m_middleSlot{2};
+
+    // Состояние аудиопотока
+    float m_currentVolume = 1.0f;
+    float m_rampTarget = 1.0f;
+    qint64 m_rampRemaining = 0;
+    qint64 m_rampFrames;
+    int m_activeBands = 0;
+    float m_stereoState[MaxBands][2][2] = {};           // раскладка ядра biquadStereo
+    float m_biquadState[MaxBands][MaxChannels][2] = {}; // прочие числа каналов
+    float m_scratch[ScratchSamples];
+};
+
+#endif // DSP_CHAIN_H
@@ -0,0 +1,545 @@
+#include "dsp_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DSP_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define DSP_TARGET_AVX2
+#else
+// AVX2-функции компилируются отдельно от остального файла и вызываются только после проверки процессора
+#define DSP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+constexpr float int16Scale = 1.0f / 32768.0f;
+constexpr float int32Scale = 1.0f / 2147483648.0f;
+// Наибольшее float, не превышающее INT32_MAX: 2^31 в int32 уже не помещается
+constexpr float int32Max = 2147483520.0f;
+
+// --- scalar: эталон и хвосты буферов для SIMD-версий ---
+
+void int16ToFloatScalar(const qint16 *in, float *out, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        out[i] = float(in[i]) * int16Scale;
+    }
+}
+
+void int32ToFloatScalar(const qint32 *in, float *out, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        out[i] = float(in[i]) * int32Scale;
+    }
+}
+
+void floatToInt16Scalar(const float *in, qint16 *out, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        const float value = std::min(std::max(in[i] * 32768.0f, -32768.0f), 32767.0f);
+        out[i] = qint16(std::lrintf(value));
+    }
+}
+
+void floatToInt32Scalar(const float *in, qint32 *out, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        const float value = std::min(std::max(in[i] * 2147483648.0f, -2147483648.0f), int32Max);
+        out[i] = qint32(std::lrintf(value));
+    }
+}
+
+void applyGainScalar(float *data, qsizetype count, float gain)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        data[i] *= gain;
+    }
+}
+
+// y = min(|x|, t) + (1 - t) * tanh((|x| - t) / (1 - t)), tanh — рациональное приближение
+// u(27 + u^2) / (27 + 9u^2), равное 1 при u = 3 (дальше ограничено)
+void softLimitScalar(float *data, qsizetype count, float threshold)
+{
+    const float knee = 1.0f - threshold;
+    const float invKnee = 1.0f / knee;
+    for (qsizetype i = 0; i < count; ++i) {
+        const float x = data[i];
+        const float magnitude = std::fabs(x);
+        const float u = std::min(std::max(magnitude - threshold, 0.0f) * invKnee, 3.0f);
+        const float u2 = u * u;
+        const float shaped = u * (27.0f + u2) / (27.0f + 9.0f * u2);
+        data[i] = std::copysign(std::min(magnitude, threshold) + knee * shaped, x);
+    }
+}
+
+void biquadStereoScalar(float *data, qsizetype frames, const BiquadCoefficients *coefficients,
+                        int bands, float *state)
+{
+    for (int band = 0; band < bands; ++band) {
+        const BiquadCoefficients &c = coefficients[band];
+        float *s = state + band * 4;
+        for (int channel = 0; channel < 2; ++channel) {
+            float s1 = s[channel * 2];
+            float s2 = s[channel * 2 + 1];
+            for (qsizetype i = 0; i < frames; ++i) {
+                const float x = data[i * 2 + channel];
+                const float y = c.b0 * x + s1;
+                s1 = c.b1 * x - c.a1 * y + s2;
+                s2 = c.b2 * x - c.a2 * y;
+                data[i * 2 + channel] = y;
+            }
+            s[channel * 2] = s1;
+            s[channel * 2 + 1] = s2;
+        }
+    }
+}
+
+const DspKernels scalarKernels = {
+    "scalar",
+    int16ToFloatScalar,
+    int32ToFloatScalar,
+    floatToInt16Scalar,
+    floatToInt32Scalar,
+    applyGainScalar,
+    softLimitScalar,
+    biquadStereoScalar,
+};
+
+#if defined(DSP_X86)
+
+// --- SSE2: базовый уровень x86-64 ---
+
+void int16ToFloatSse2(const qint16 *in, float *out, qsizetype count)
+{
+    const __m128 scale = _mm_set1_ps(int16Scale);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        // Расширение со знаком: 16 бит в старшую половину и арифметический сдвиг
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    int16ToFloatScalar(in + i, out + i, count - i);
+}
+
+void int32ToFloatSse2(const qint32 *in, float *out, qsizetype count)
+{
+    const __m128 scale = _mm_set1_ps(int32Scale);
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    int32ToFloatScalar(in + i, out + i, count - i);
+}
+
+void floatToInt16Sse2(const float *in, qint16 *out, qsizetype count)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 low = _mm_set1_ps(-32768.0f);
+    const __m128 high = _mm_set1_ps(32767.0f);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), low), high);
+        const __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), low), high);
+        const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+    }
+    floatToInt16Scalar(in + i, out + i, count - i);
+}
+
+void floatToInt32Sse2(const float *in, qint32 *out, qsizetype count)
+{
+    const __m128 scale = _mm_set1_ps(2147483648.0f);
+    const __m128 low = _mm_set1_ps(-2147483648.0f);
+    const __m128 high = _mm_set1_ps(int32Max);
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), low), high);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_cvtps_epi32(v));
+    }
+    floatToInt32Scalar(in + i, out + i, count - i);
+}
+
+void applyGainSse2(float *data, qsizetype count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+    }
+    applyGainScalar(data + i, count - i, gain);
+}
+
+void softLimitSse2(float *data, qsizetype count, float threshold)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 t = _mm_set1_ps(threshold);
+    const __m128 knee = _mm_set1_ps(1.0f - threshold);
+    const __m128 invKnee = _mm_set1_ps(1.0f / (1.0f - threshold));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 three = _mm_set1_ps(3.0f);
+    const __m128 c27 = _mm_set1_ps(27.0f);
+    const __m128 c9 = _mm_set1_ps(9.0f);
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 x = _mm_loadu_ps(data + i);
+        const __m128 sign = _mm_and_ps(x, signMask);
+        const __m128 magnitude = _mm_andnot_ps(signMask, x);
+        const __m128 u = _mm_min_ps(_mm_mul_ps(_mm_max_ps(_mm_sub_ps(magnitude, t), zero), invKnee), three);
+        const __m128 u2 = _mm_mul_ps(u, u);
+        const __m128 shaped = _mm_div_ps(_mm_mul_ps(u, _mm_add_ps(c27, u2)), _mm_add_ps(c27, _mm_mul_ps(c9, u2)));
+        const __m128 y = _mm_add_ps(_mm_min_ps(magnitude, t), _mm_mul_ps(knee, shaped));
+        _mm_storeu_ps(data + i, _mm_or_ps(y, sign));
+    }
+    softLimitScalar(data + i, count - i, threshold);
+}
+
+// Левый и правый каналы кадра — две дорожки одного регистра; все полосы каскада
+// проходятся на кадре подряд, состояния живут в регистрах
+void biquadStereoSse2(float *data, qsizetype frames, const BiquadCoefficients *coefficients,
+                      int bands, float *state)
+{
+    constexpr int maxBands = 16;
+    if (bands > maxBands) {
+        biquadStereoScalar(data, frames, coefficients, bands, state);
+        return;
+    }
+    __m128 b0[maxBands], b1[maxBands], b2[maxBands], a1[maxBands], a2[maxBands];
+    __m128 s1[maxBands], s2[maxBands];
+    for (int band = 0; band < bands; ++band) {
+        b0[band] = _mm_set1_ps(coefficients[band].b0);
+        b1[band] = _mm_set1_ps(coefficients[band].b1);
+        b2[band] = _mm_set1_ps(coefficients[band].b2);
+        a1[band] = _mm_set1_ps(coefficients[band].a1);
+        a2[band] = _mm_set1_ps(coefficients[band].a2);
+        const float *s = state + band * 4;
+        s1[band] = _mm_setr_ps(s[0], s[2], 0.0f, 0.0f);
+        s2[band] = _mm_setr_ps(s[1], s[3], 0.0f, 0.0f);
+    }
+    for (qsizetype i = 0; i < frames; ++i) {
+        double frame;
+        std::memcpy(&frame, data + i * 2, sizeof(frame));
+        __m128 x = _mm_castpd_ps(_mm_set_sd(frame));
+        for (int band = 0; band < bands; ++band) {
+            const __m128 y = _mm_add_ps(_mm_mul_ps(b0[band], x), s1[band]);
+            s1[band] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1[band], x), _mm_mul_ps(a1[band], y)), s2[band]);
+            s2[band] = _mm_sub_ps(_mm_mul_ps(b2[band], x), _mm_mul_ps(a2[band], y));
+            x = y;
+        }
+        frame = _mm_cvtsd_f64(_mm_castps_pd(x));
+        std::memcpy(data + i * 2, &frame, sizeof(frame));
+    }
+    for (int band = 0; band < bands; ++band) {
+        float lanes1[4];
+        float lanes2[4];
+        _mm_storeu_ps(lanes1, s1[band]);
+        _mm_storeu_ps(lanes2, s2[band]);
+        float *s = state + band * 4;
+        s[0] = lanes1[0];
+        s[1] = lanes2[0];
+        s[2] = lanes1[1];
+        s[3] = lanes2[1];
+    }
+}
+
+const DspKernels sse2Kernels = {
+    "sse2",
+    int16ToFloatSse2,
+    int32ToFloatSse2,
+    floatToInt16Sse2,
+    floatToInt32Sse2,
+    applyGainSse2,
+    softLimitSse2,
+    biquadStereoSse2,
+};
+
+// --- AVX2: 8 сэмплов за операцию ---
+
+DSP_TARGET_AVX2 void int16ToFloatAvx2(const qint16 *in, float *out, qsizetype count)
+{
+    const __m256 scale = _mm256_set1_ps(int16Scale);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    int16ToFloatScalar(in + i, out + i, count - i);
+}
+
+DSP_TARGET_AVX2 void int32ToFloatAvx2(const qint32 *in, float *out, qsizetype count)
+{
+    const __m256 scale = _mm256_set1_ps(int32Scale);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    int32ToFloatScalar(in + i, out + i, count - i);
+}
+
+DSP_TARGET_AVX2 void floatToInt16Avx2(const float *in, qint16 *out, qsizetype count)
+{
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    const __m256 low = _mm256_set1_ps(-32768.0f);
+    const __m256 high = _mm256_set1_ps(32767.0f);
+    qsizetype i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), low), high);
+        const __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale), low), high);
+        // packs работает внутри 128-битных половин: возвращаем порядок перестановкой
+        const __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    floatToInt16Scalar(in + i, out + i, count - i);
+}
+
+DSP_TARGET_AVX2 void floatToInt32Avx2(const float *in, qint32 *out, qsizetype count)
+{
+    const __m256 scale = _mm256_set1_ps(2147483648.0f);
+    const __m256 low = _mm256_set1_ps(-2147483648.0f);
+    const __m256 high = _mm256_set1_ps(int32Max);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), low), high);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_cvtps_epi32(v));
+    }
+    floatToInt32Scalar(in + i, out + i, count - i);
+}
+
+DSP_TARGET_AVX2 void applyGainAvx2(float *data, qsizetype count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), g));
+    }
+    applyGainScalar(data + i, count - i, gain);
+}
+
+DSP_TARGET_AVX2 void softLimitAvx2(float *data, qsizetype count, float threshold)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 t = _mm256_set1_ps(threshold);
+    const __m256 knee = _mm256_set1_ps(1.0f - threshold);
+    const __m256 invKnee = _mm256_set1_ps(1.0f / (1.0f - threshold));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 three = _mm256_set1_ps(3.0f);
+    const __m256 c27 = _mm256_set1_ps(27.0f);
+    const __m256 c9 = _mm256_set1_ps(9.0f);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 x = _mm256_loadu_ps(data + i);
+        const __m256 sign = _mm256_and_ps(x, signMask);
+        const __m256 magnitude = _mm256_andnot_ps(signMask, x);
+        const __m256 u = _mm256_min_ps(_mm256_mul_ps(_mm256_max_ps(_mm256_sub_ps(magnitude, t), zero), invKnee), three);
+        const __m256 u2 = _mm256_mul_ps(u, u);
+        const __m256 shaped = _mm256_div_ps(_mm256_mul_ps(u, _mm256_add_ps(c27, u2)),
+                                            _mm256_add_ps(c27, _mm256_mul_ps(c9, u2)));
+        const __m256 y = _mm256_add_ps(_mm256_min_ps(magnitude, t), _mm256_mul_ps(knee, shaped));
+        _mm256_storeu_ps(data + i, _mm256_or_ps(y, sign));
+    }
+    softLimitScalar(data + i, count - i, threshold);
+}
+
+const DspKernels avx2Kernels = {
+    "avx2",
+    int16ToFloatAvx2,
+    int32ToFloatAvx2,
+    floatToInt16Avx2,
+    floatToInt32Avx2,
+    applyGainAvx2,
+    softLimitAvx2,
+    biquadStereoSse2, // рекурсивному фильтру на стерео шире двух дорожек не нужно
+};
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = info[2] & (1 << 27);
+    const bool avx = info[2] & (1 << 28);
+    // Регистры YMM должны сохраняться операционной системой
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // DSP_X86
+
+#if defined(DSP_NEON)
+
+// --- NEON: обязательная часть AArch64 ---
+
+void int16ToFloatNeon(const qint16 *in, float *out, qsizetype count)
+{
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t v = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), int16Scale));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), int16Scale));
+    }
+    int16ToFloatScalar(in + i, out + i, count - i);
+}
+
+void int32ToFloatNeon(const qint32 *in, float *out, qsizetype count)
+{
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)), int32Scale));
+    }
+    int32ToFloatScalar(in + i, out + i, count - i);
+}
+
+void floatToInt16Neon(const float *in, qint16 *out, qsizetype count)
+{
+    const float32x4_t low = vdupq_n_f32(-32768.0f);
+    const float32x4_t high = vdupq_n_f32(32767.0f);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const float32x4_t a = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + i), 32768.0f), low), high);
+        const float32x4_t b = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + i + 4), 32768.0f), low), high);
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b))));
+    }
+    floatToInt16Scalar(in + i, out + i, count - i);
+}
+
+void floatToInt32Neon(const float *in, qint32 *out, qsizetype count)
+{
+    const float32x4_t low = vdupq_n_f32(-2147483648.0f);
+    const float32x4_t high = vdupq_n_f32(int32Max);
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t v = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + i), 2147483648.0f), low), high);
+        vst1q_s32(out + i, vcvtnq_s32_f32(v));
+    }
+    floatToInt32Scalar(in + i, out + i, count - i);
+}
+
+void applyGainNeon(float *data, qsizetype count, float gain)
+{
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(data + i, vmulq_n_f32(vld1q_f32(data + i), gain));
+    }
+    applyGainScalar(data + i, count - i, gain);
+}
+
+void softLimitNeon(float *data, qsizetype count, float threshold)
+{
+    const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+    const float32x4_t t = vdupq_n_f32(threshold);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t three = vdupq_n_f32(3.0f);
+    const float32x4_t c27 = vdupq_n_f32(27.0f);
+    const float knee = 1.0f - threshold;
+    const float invKnee = 1.0f / knee;
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t x = vld1q_f32(data + i);
+        const float32x4_t magnitude = vabsq_f32(x);
+        const float32x4_t u = vminq_f32(vmulq_n_f32(vmaxq_f32(vsubq_f32(magnitude, t), zero), invKnee), three);
+        const float32x4_t u2 = vmulq_f32(u, u);
+        const float32x4_t shaped = vdivq_f32(vmulq_f32(u, vaddq_f32(c27, u2)), vmlaq_n_f32(c27, u2, 9.0f));
+        const float32x4_t y = vmlaq_n_f32(vminq_f32(magnitude, t), shaped, knee);
+        const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(x), signMask);
+        vst1q_f32(data + i, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(y), sign)));
+    }
+    softLimitScalar(data + i, count - i, threshold);
+}
+
+void biquadStereoNeon(float *data, qsizetype frames, const BiquadCoefficients *coefficients,
+                      int bands, float *state)
+{
+    constexpr int maxBands = 16;
+    if (bands > maxBands) {
+        biquadStereoScalar(data, frames, coefficients, bands, state);
+        return;
+    }
+    float32x2_t s1[maxBands], s2[maxBands];
+    for (int band = 0; band < bands; ++band) {
+        const float *s = state + band * 4;
+        const float first[2] = {s[0], s[2]};
+        const float second[2] = {s[1], s[3]};
+        s1[band] = vld1_f32(first);
+        s2[band] = vld1_f32(second);
+    }
+    for (qsizetype i = 0; i < frames; ++i) {
+        float32x2_t x = vld1_f32(data + i * 2);
+        for (int band = 0; band < bands; ++band) {
+            const BiquadCoefficients &c = coefficients[band];
+            const float32x2_t y = vmla_n_f32(s1[band], x, c.b0);
+            s1[band] = vmls_n_f32(vmla_n_f32(s2[band], x, c.b1), y, c.a1);
+            s2[band] = vmls_n_f32(vmul_n_f32(x, c.b2), y, c.a2);
+            x = y;
+        }
+        vst1_f32(data + i * 2, x);
+    }
+    for (int band = 0; band < bands; ++band) {
+        float *s = state + band * 4;
+        s[0] = vget_lane_f32(s1[band], 0);
+        s[2] = vget_lane_f32(s1[band], 1);
+        s[1] = vget_lane_f32(s2[band], 0);
+        s[3] = vget_lane_f32(s2[band], 1);
+    }
+}
+
+const DspKernels neonKernels = {
+    "neon",
+    int16ToFloatNeon,
+    int32ToFloatNeon,
+    floatToInt16Neon,
+    floatToInt32Neon,
+    applyGainNeon,
+    softLimitNeon,
+    biquadStereoNeon,
+};
+
+#endif // DSP_NEON
+
+} // namespace
+
+const DspKernels &DspKernels::active()
+{
+    static const DspKernels *const kernels = [] {
+        const QList<const DspKernels *> candidates = available();
+        return candidates.last();
+    }();
+    return *kernels;
+}
+
+QList<const DspKernels *> DspKernels::available()
+{
+    QList<const DspKernels *> kernels{&scalarKernels};
+#if defined(DSP_X86)
+    // SSE2 входит в базовый набор x86-64
+    kernels.append(&sse2Kernels);
+    if (cpuHasAvx2()) {
+        kernels.append(&avx2Kernels);
+    }
+#elif defined(DSP_NEON)
+    kernels.append(&neonKernels);
+#endif
+    return kernels;
+}
@@ -0,0 +1,40 @@
+#ifndef DSP_KERNELS_H
+#define DSP_KERNELS_H
+
+#include <QtGlobal>
+#include <QList>
+
+// Коэффициенты биквада, нормированные на a0 (прямая форма II, транспонированная)
+struct BiquadCoefficients {
+    float b0 = 1.0f;
+    float b1 = 0.0f;
+    float b2 = 0.0f;
+    float a1 = 0.0f;
+    float a2 = 0.0f;
+};
+
+// Ядра обработки PCM для одного набора инструкций. Внутри цепочки звук — float
+// в диапазоне [-1, 1], каналы чередуются; count — число сэмплов, frames — кадров.
+// Реализации: scalar (везде), SSE2 и AVX2 (x86, выбор во время выполнения), NEON (AArch64).
+struct DspKernels {
+    const char *name;
+    void (*int16ToFloat)(const qint16 *in, float *out, qsizetype count);
+    void (*int32ToFloat)(const qint32 *in, float *out, qsizetype count);
+    void (*floatToInt16)(const float *in, qint16 *out, qsizetype count);
+    void (*floatToInt32)(const float *in, qint32 *out, qsizetype count);
+    void (*applyGain)(float *data, qsizetype count, float gain);
+    // Мягкое ограничение выше порога threshold (0..1): до порога сигнал не меняется,
+    // выше — плавно приближается к полной шкале, никогда ее не превышая
+    void (*softLimit)(float *data, qsizetype count, float threshold);
+    // Каскад из bands биквадов над стереопотоком; state — [bands][2 канала][2] float.
+    // Рекурсия не векторизуется по времени, поэтому SIMD идет по каналам
+    void (*biquadStereo)(float *data, qsizetype frames, const BiquadCoefficients *coefficients,
+                         int bands, float *state);
+
+    // Лучший набор для текущего процессора (определяется один раз)
+    static const DspKernels &active();
+    // Все наборы, которые может выполнить этот процессор, начиная со scalar
+    static QList<const DspKernels *> available();
+};
+
+#endif // DSP_KERNELS_H
@@ -0,0 +1,58 @@
+#include "latency_histogram.h"
+
+#include <cmath>
+
+int LatencyHistogram::bucketFor(double ms)
+{
+    if (!(ms > MinMs)) {
+        return 0; // в том числе NaN
+    }
+    const double bucket = std::ceil(std::log2(ms / MinMs) * BucketsPerDoubling);
+    return bucket >= BucketCount - 1 ? BucketCount - 1 : int(bucket);
+}
+
+double LatencyHistogram::upperBound(int bucket)
+{
+    return MinMs * std::exp2(double(bucket) / BucketsPerDoubling);
+}
+
+void LatencyHistogram::add(double ms)
+{
+    ++m_buckets[bucketFor(ms)];
+    ++m_count;
+    m_sum += ms;
+    m_max = qMax(m_max, ms);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (int i = 0; i < BucketCount; ++i) {
+        m_buckets[i] += other.m_buckets[i];
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_max = qMax(m_max, other.m_max);
+}
+
+void LatencyHistogram::clear()
+{
+    *this = LatencyHistogram();
+}
+
+double LatencyHistogram::quantile(double q) const
+{
+    if (m_count == 0) {
+        return 0.0;
+    }
+    // Ранг замера, ниже или на уровне которого лежит доля q всех замеров
+    const quint64 rank = qMax<quint64>(1, quint64(std::ceil(qBound(0.0, q, 1.0) * double(m_count))));
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            // Последняя корзина открыта сверху, а граница любой корзины может превышать максимум
+            return i == BucketCount - 1 ? m_max : qMin(upperBound(i), m_max);
+        }
+    }
+    return m_max;
+}
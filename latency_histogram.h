@@ -0,0 +1,38 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <QtGlobal>
+#include <array>
+
+// Гистограмма задержек в миллисекундах с логарифмическими корзинами: четыре корзины
+// на удвоение (шаг ~19%) от 10 мкс до ~3 минут, все, что дольше, — в последней.
+// Квантиль оценивается верхней границей корзины, поэтому ошибка не больше шага.
+// Память постоянна при любом числе замеров; не потокобезопасна.
+class LatencyHistogram
+{
+public:
+    void add(double ms);
+    void merge(const LatencyHistogram &other);
+    void clear();
+
+    quint64 count() const { return m_count; }
+    double sum() const { return m_sum; }
+    double max() const { return m_max; }
+    // q от 0 до 1; 0, если замеров нет
+    double quantile(double q) const;
+
+private:
+    static constexpr int BucketsPerDoubling = 4;
+    static constexpr int BucketCount = 96;
+    static constexpr double MinMs = 0.01;
+
+    static int bucketFor(double ms);
+    static double upperBound(int bucket);
+
+    std::array<quint32, BucketCount> m_buckets{};
+    quint64 m_count = 0;
+    double m_sum = 0.0;
+    double m_max = 0.0;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,46 @@
+#include "library_importer.h"
+#include "database_manager.h"
+#include "tag_reader.h"
+
+LibraryImporter::LibraryImporter(const QStringList &filePaths, QObject *parent)
+    : QThread(parent)
+    , m_filePaths(filePaths)
+{
+}
+
+void LibraryImporter::run()
+{
+    // Теги читаются порциями, чтобы между ними можно было сообщать о прогрессе
+    const int tagChunkSize = 256;
+
+    QList<SongInfo> songs;
+    songs.reserve(m_filePaths.size());
+    for (int start = 0; start < m_filePaths.size(); start += tagChunkSize) {
+        const QStringList chunk = m_filePaths.mid(start, tagChunkSize);
+        const QList<TrackTags> chunkTags = TagReader::readAll(chunk);
+        for (int i = 0; i < chunk.size(); ++i) {
+            const TrackTags &tags = chunkTags.at(i);
+            SongInfo song;
+            song.id = -1;
+            song.title = tags.title;
+            song.artist = tags.artist;
+            song.album = tags.album;
+            song.filePath = chunk.at(i);
+            song.durationMs = tags.durationMs;
+            songs.append(song);
+        }
+        emit tagsProgressChanged(songs.size(), m_filePaths.size());
+    }
+
+    // Соединение QSqlDatabase можно использовать только в создавшем его потоке
+    DatabaseManager database(QString("library_import_%1").arg(quintptr(this)));
+    if (!database.open()) {
+        emit importFinished(QList<int>(songs.size(), -1));
+        return;
+    }
+
+    QList<int> songIds = database.addSongs(songs, [this](int done, int total) {
+        emit progressChanged(done, total);
+    });
+    emit importFinished(songIds);
+}
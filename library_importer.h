@@ -0,0 +1,30 @@
+#ifndef LIBRARY_IMPORTER_H
+#define LIBRARY_IMPORTER_H
+
+#include <QThread>
+#include <QStringList>
+#include <QList>
+
+// Фоновый импорт файлов в библиотеку: теги читаются параллельно на пуле потоков,
+// затем все песни записываются одной транзакцией через собственное соединение с БД.
+// GUI-поток получает только прогресс и итог.
+class LibraryImporter : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit LibraryImporter(const QStringList &filePaths, QObject *parent = nullptr);
+
+signals:
+    void tagsProgressChanged(int done, int total);
+    void progressChanged(int done, int total);
+    void importFinished(const QList<int> &songIds); // ID в порядке filePaths, -1 при ошибке
+
+protected:
+    void run() override;
+
+private:
+    QStringList m_filePaths;
+};
+
+#endif // LIBRARY_IMPORTER_H
@@ -0,0 +1,210 @@
+#include "library_snapshot.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char magic[4] = {'M', 'P', 'L', '1'};
+const int headerSize = 32;
+const int recordSize = 40;   // id, длительность и 4 пары (смещение, длина)
+const int idEntrySize = 8;   // id, строка
+const int titleField = 8;
+const int artistField = 16;
+const int albumField = 24;
+const int pathField = 32;
+
+} // namespace
+
+LibrarySnapshot::~LibrarySnapshot()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+    }
+}
+
+QString LibrarySnapshot::defaultPath()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("library.snapshot");
+}
+
+std::shared_ptr<const LibrarySnapshot> LibrarySnapshot::open(const QString &path)
+{
+    std::shared_ptr<LibrarySnapshot> snapshot(new LibrarySnapshot());
+    snapshot->m_file.setFileName(path);
+    if (!snapshot->m_file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    const qint64 size = snapshot->m_file.size();
+    if (size < headerSize) {
+        return nullptr;
+    }
+    snapshot->m_map = snapshot->m_file.map(0, size);
+    if (!snapshot->m_map) {
+        qDebug() << "Не удалось отобразить в память снимок библиотеки:" << path;
+        return nullptr;
+    }
+
+    const uchar *data = snapshot->m_map;
+    if (memcmp(data, magic, sizeof(magic)) != 0 || qFromLittleEndian<quint32>(data + 24) != recordSize) {
+        qDebug() << "Снимок библиотеки другого формата:" << path;
+        return nullptr;
+    }
+    snapshot->m_count = qFromLittleEndian<quint32>(data + 4);
+    snapshot->m_revision = qFromLittleEndian<qint64>(data + 8);
+    snapshot->m_poolSize = qFromLittleEndian<quint64>(data + 16);
+    const quint64 expected = headerSize + quint64(snapshot->m_count) * (recordSize + idEntrySize) + snapshot->m_poolSize;
+    if (expected != quint64(size)) {
+        qDebug() << "Поврежден снимок библиотеки:" << path;
+        return nullptr;
+    }
+    snapshot->m_records = data + headerSize;
+    snapshot->m_idIndex = snapshot->m_records + qint64(snapshot->m_count) * recordSize;
+    snapshot->m_pool = snapshot->m_idIndex + qint64(snapshot->m_count) * idEntrySize;
+    return snapshot;
+}
+
+QString LibrarySnapshot::stringAt(const uchar *field) const
+{
+    const quint32 offset = qFromLittleEndian<quint32>(field);
+    const quint32 length = qFromLittleEndian<quint32>(field + 4);
+    if (quint64(offset) + length > m_poolSize) {
+        return QString();
+    }
+    return QString::fromUtf8(reinterpret_cast<const char *>(m_pool + offset), length);
+}
+
+SongInfo LibrarySnapshot::songAt(int row) const
+{
+    const uchar *record = m_records + qint64(row) * recordSize;
+    return SongInfo{qFromLittleEndian<qint32>(record),
+                    stringAt(record + titleField),
+                    stringAt(record + artistField),
+                    stringAt(record + albumField),
+                    stringAt(record + pathField),
+                    qFromLittleEndian<qint32>(record + 4)};
+}
+
+int LibrarySnapshot::rowOfSongId(int songId) const
+{
+    // Индекс лежит в файле уже отсортированным: при открытии ничего не строится
+    quint32 low = 0;
+    quint32 high = m_count;
+    while (low < high) {
+        const quint32 middle = low + (high - low) / 2;
+        const qint32 id = qFromLittleEndian<qint32>(m_idIndex + qint64(middle) * idEntrySize);
+        if (id < songId) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < m_count && qFromLittleEndian<qint32>(m_idIndex + qint64(low) * idEntrySize) == songId) {
+        return int(qFromLittleEndian<quint32>(m_idIndex + qint64(low) * idEntrySize + 4));
+    }
+    return -1;
+}
+
+QList<SongInfo> LibrarySnapshot::page(const SongInfo *last, int limit) const
+{
+    QList<SongInfo> songs;
+    // Порядок строк — порядок библиотеки в БД, поэтому продолжение ищется по id,
+    // без сравнения названий, которое зависело бы от правил сортировки сервера
+    const int first = last ? rowOfSongId(last->id) + 1 : 0;
+    if (last && first == 0) {
+        return songs;
+    }
+    const int end = int(qMin<qint64>(m_count, qint64(first) + qMax(0, limit)));
+    songs.reserve(qMax(0, end - first));
+    for (int row = first; row < end; ++row) {
+        songs.append(songAt(row));
+    }
+    return songs;
+}
+
+LibrarySnapshotBuilder::LibrarySnapshotBuilder(qint64 revision)
+    : m_revision(revision)
+{
+}
+
+void LibrarySnapshotBuilder::reserve(qsizetype songs)
+{
+    m_records.reserve(songs * recordSize);
+    m_ids.reserve(songs);
+}
+
+void LibrarySnapshotBuilder::appendString(uchar *field, const QString &text, bool shared)
+{
+    const QByteArray utf8 = text.toUtf8();
+    quint32 offset = quint32(m_pool.size());
+    if (shared) {
+        const auto existing = m_sharedStrings.constFind(utf8);
+        if (existing != m_sharedStrings.constEnd()) {
+            offset = existing.value();
+        } else {
+            m_sharedStrings.insert(utf8, offset);
+            m_pool.append(utf8);
+        }
+    } else {
+        m_pool.append(utf8);
+    }
+    qToLittleEndian<quint32>(offset, field);
+    qToLittleEndian<quint32>(quint32(utf8.size()), field + 4);
+}
+
+void LibrarySnapshotBuilder::addSong(const SongInfo &song)
+{
+    const qsizetype offset = m_records.size();
+    m_records.resize(offset + recordSize);
+    uchar *record = reinterpret_cast<uchar *>(m_records.data()) + offset;
+    qToLittleEndian<qint32>(song.id, record);
+    qToLittleEndian<qint32>(song.durationMs, record + 4);
+    appendString(record + titleField, song.title, false);
+    appendString(record + artistField, song.artist, true);
+    appendString(record + albumField, song.album, true);
+    appendString(record + pathField, song.filePath, false);
+    m_ids.append({song.id, m_count++});
+}
+
+bool LibrarySnapshotBuilder::save(const QString &path) const
+{
+    QByteArray header(headerSize, '\0');
+    uchar *out = reinterpret_cast<uchar *>(header.data());
+    memcpy(out, magic, sizeof(magic));
+    qToLittleEndian<quint32>(m_count, out + 4);
+    qToLittleEndian<qint64>(m_revision, out + 8);
+    qToLittleEndian<quint64>(quint64(m_pool.size()), out + 16);
+    qToLittleEndian<quint32>(quint32(recordSize), out + 24);
+
+    QList<QPair<qint32, quint32>> ids = m_ids;
+    std::sort(ids.begin(), ids.end());
+    QByteArray idIndex(ids.size() * idEntrySize, '\0');
+    uchar *entry = reinterpret_cast<uchar *>(idIndex.data());
+    for (const auto &id : std::as_const(ids)) {
+        qToLittleEndian<qint32>(id.first, entry);
+        qToLittleEndian<quint32>(id.second, entry + 4);
+        entry += idEntrySize;
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Не удалось сохранить снимок библиотеки:" << path;
+        return false;
+    }
+    file.write(header);
+    file.write(m_records);
+    file.write(idIndex);
+    file.write(m_pool);
+    if (!file.commit()) {
+        qDebug() << "Не удалось сохранить снимок библиотеки:" << path << file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef LIBRARY_SNAPSHOT_H
+#define LIBRARY_SNAPSHOT_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QtGlobal>
+#include <memory>
+#include "database_manager.h"
+
+// Локальный снимок библиотеки для быстрого запуска: песни в порядке списка библиотеки
+// (title, id) записями фиксированной длины и пул строк UTF-8. Файл <кэш>/library.snapshot
+// открывается отображением в память, поэтому показ первой страницы не зависит ни от
+// размера библиотеки, ни от доступности БД: разбираются только запрошенные записи.
+// Актуальность проверяется сравнением revision со счетчиком изменений библиотеки в БД
+// (DatabaseManager::catalogRevision).
+//
+// Формат (little-endian): "MPL1", число песен (u32), revision (i64), размер пула (u64),
+// размер записи (u32), 0 (u32); записи: id (i32), длительность (i32) и по (смещение,
+// длина) u32 для названия, исполнителя, альбома и пути; индекс (id i32, строка u32),
+// отсортированный по id; пул строк.
+class LibrarySnapshot
+{
+public:
+    ~LibrarySnapshot();
+    Q_DISABLE_COPY(LibrarySnapshot)
+
+    // nullptr, если снимка нет или он поврежден
+    static std::shared_ptr<const LibrarySnapshot> open(const QString &path = defaultPath());
+    static QString defaultPath();
+
+    qint64 revision() const { return m_revision; }
+    int size() const { return int(m_count); }
+    SongInfo songAt(int row) const;
+    // Двоичный поиск по индексу id; -1 — песни в снимке нет
+    int rowOfSongId(int songId) const;
+    // До limit песен после last (nullptr — с начала), как DatabaseManager::loadSongsPage
+    QList<SongInfo> page(const SongInfo *last, int limit) const;
+
+private:
+    LibrarySnapshot() = default;
+
+    QString stringAt(const uchar *field) const;
+
+    QFile m_file;
+    uchar *m_map = nullptr;
+    quint32 m_count = 0;
+    qint64 m_revision = 0;
+    const uchar *m_records = nullptr;
+    const uchar *m_idIndex = nullptr;
+    const uchar *m_pool = nullptr;
+    quint64 m_poolSize = 0;
+};
+
+// Построение снимка из песен в порядке библиотеки (поток LibrarySnapshotWriter).
+// Повторяющиеся исполнители и альбомы хранятся в пуле один раз
+class LibrarySnapshotBuilder
+{
+public:
+    explicit LibrarySnapshotBuilder(qint64 revision);
+
+    void reserve(qsizetype songs);
+    void addSong(const SongInfo &song);
+    int size() const { return int(m_count); }
+    // Атомарная запись файла
+    bool save(const QString &path = LibrarySnapshot::defaultPath()) const;
+
+private:
+    void appendString(uchar *field, const QString &text, bool shared);
+
+    qint64 m_revision;
+    quint32 m_count = 0;
+    QByteArray m_records;
+    QByteArray m_pool;
+    QHash<QByteArray, quint32> m_sharedStrings; // исполнитель/альбом -> смещение в пуле
+    QList<QPair<qint32, quint32>> m_ids;         // (id, строка)
+};
+
+#endif // LIBRARY_SNAPSHOT_H
@@ -0,0 +1,55 @@
+#include "library_snapshot_writer.h"
+#include "library_snapshot.h"
+#include "database_manager.h"
+
+#include <QElapsedTimer>
+
+LibrarySnapshotWriter::LibrarySnapshotWriter(QObject *parent)
+    : QThread(parent)
+{
+}
+
+void LibrarySnapshotWriter::run()
+{
+    // Соединение QSqlDatabase можно использовать только в создавшем его потоке
+    DatabaseManager database(QString("library_snapshot_writer_%1").arg(quintptr(this)));
+    if (!database.open() || !database.beginConsistentRead()) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 revision = database.catalogRevision();
+    if (revision < 0) {
+        database.endConsistentRead();
+        return;
+    }
+    LibrarySnapshotBuilder builder(revision);
+    QString afterTitle;
+    int afterId = -1;
+    while (!isInterruptionRequested()) {
+        const QList<SongInfo> songs = database.loadSongsPage(afterTitle, afterId, PageSize);
+        for (const SongInfo &song : songs) {
+            builder.addSong(song);
+        }
+        if (songs.size() < PageSize) {
+            break;
+        }
+        afterTitle = songs.last().title;
+        afterId = songs.last().id;
+    }
+    // Ошибка чтения страницы выглядит как конец списка: число строк сверяется
+    // в той же транзакции, чтобы не записать усеченный снимок
+    const int expected = database.songCount();
+    database.endConsistentRead();
+    if (isInterruptionRequested() || expected != builder.size()) {
+        return;
+    }
+
+    if (builder.save()) {
+        qDebug() << "Снимок библиотеки записан: песен" << builder.size() << "ревизия" << revision
+                 << "за" << timer.elapsed() << "мс";
+        // Снимок пишется после изменений библиотеки, заодно сворачиваем их журнал
+        database.compactCatalogRevision();
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef LIBRARY_SNAPSHOT_WRITER_H
+#define LIBRARY_SNAPSHOT_WRITER_H
+
+#include <QThread>
+
+// Фоновая запись снимка библиотеки (LibrarySnapshot): счетчик изменений и все песни
+// читаются постранично в одной транзакции REPEATABLE READ через собственное соединение,
+// поэтому снимок точно соответствует записанному в него revision. Прерывание оставляет
+// прежний файл.
+class LibrarySnapshotWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit LibrarySnapshotWriter(QObject *parent = nullptr);
+
+protected:
+    void run() override;
+
+private:
+    static constexpr int PageSize = 5000;
+};
+
+#endif // LIBRARY_SNAPSHOT_WRITER_H
@@ -0,0 +1,378 @@
+#include "loudness_meter.h"
+
+#include <QtEndian>
+#include <cmath>
+
+namespace {
+
+constexpr int HistogramBins = 1000;        // 0.1 LU от -70 до +30
+constexpr double HistogramFloor = -70.0;
+constexpr double AbsoluteGate = -70.0;
+constexpr double IntegratedRelativeGate = -10.0;
+constexpr double RangeRelativeGate = -20.0;
+constexpr quint8 HistogramVersion = 1;
+
+double energyToLoudness(double energy)
+{
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+double loudnessToEnergy(double loudness)
+{
+    return std::pow(10.0, (loudness + 0.691) / 10.0);
+}
+
+double binLoudness(int bin)
+{
+    return HistogramFloor + (bin + 0.5) * 0.1;
+}
+
+// Таблица энергий центров ячеек: гистограммы сворачиваются часто (каждый альбом)
+const double *binEnergies()
+{
+    static const auto table = [] {
+        static double energies[HistogramBins];
+        for (int i = 0; i < HistogramBins; ++i) {
+            energies[i] = loudnessToEnergy(binLoudness(i));
+        }
+        return energies;
+    }();
+    return table;
+}
+
+void appendSection(QByteArray &out, const QVector<quint32> &bins)
+{
+    quint16 used = 0;
+    for (quint32 count : bins) {
+        if (count) {
+            ++used;
+        }
+    }
+
+    char header[2];
+    qToLittleEndian<quint16>(used, header);
+    out.append(header, sizeof(header));
+
+    for (int i = 0; i < bins.size(); ++i) {
+        if (!bins[i]) {
+            continue;
+        }
+        char entry[6];
+        qToLittleEndian<quint16>(quint16(i), entry);
+        qToLittleEndian<quint32>(bins[i], entry + 2);
+        out.append(entry, sizeof(entry));
+    }
+}
+
+bool readSection(const QByteArray &data, qsizetype &offset, QVector<quint32> &bins)
+{
+    if (offset + 2 > data.size()) {
+        return false;
+    }
+    const quint16 used = qFromLittleEndian<quint16>(data.constData() + offset);
+    offset += 2;
+    if (offset + qsizetype(used) * 6 > data.size()) {
+        return false;
+    }
+
+    for (quint16 i = 0; i < used; ++i) {
+        const quint16 bin = qFromLittleEndian<quint16>(data.constData() + offset);
+        const quint32 count = qFromLittleEndian<quint32>(data.constData() + offset + 2);
+        offset += 6;
+        if (bin >= HistogramBins) {
+            return false;
+        }
+        bins[bin] += count;
+    }
+    return true;
+}
+
+} // namespace
+
+double LoudnessResult::truePeakDbtp() const
+{
+    return truePeak > 1e-10 ? 20.0 * std::log10(truePeak) : -200.0;
+}
+
+double LoudnessResult::replayGainDb() const
+{
+    return -18.0 - integratedLufs;
+}
+
+LoudnessHistogram::LoudnessHistogram()
+    : m_blocks(HistogramBins, 0)
+    , m_shortTerm(HistogramBins, 0)
+{
+}
+
+int LoudnessHistogram::binFor(double energy)
+{
+    // Абсолютный порог -70 LUFS одинаков для обоих измерений (BS.1770-4, EBU Tech 3342)
+    if (energy <= 0.0) {
+        return -1;
+    }
+    const double loudness = energyToLoudness(energy);
+    if (loudness < AbsoluteGate) {
+        return -1;
+    }
+    return qMin(HistogramBins - 1, int((loudness - HistogramFloor) * 10.0));
+}
+
+void LoudnessHistogram::addBlock(double energy)
+{
+    const int bin = binFor(energy);
+    if (bin >= 0) {
+        ++m_blocks[bin];
+    }
+}
+
+void LoudnessHistogram::addShortTerm(double energy)
+{
+    const int bin = binFor(energy);
+    if (bin >= 0) {
+        ++m_shortTerm[bin];
+    }
+}
+
+void LoudnessHistogram::merge(const LoudnessHistogram &other)
+{
+    for (int i = 0; i < HistogramBins; ++i) {
+        m_blocks[i] += other.m_blocks[i];
+        m_shortTerm[i] += other.m_shortTerm[i];
+    }
+}
+
+LoudnessResult LoudnessHistogram::result(double truePeak) const
+{
+    const double *energies = binEnergies();
+    LoudnessResult result;
+    result.truePeak = truePeak;
+
+    // Интегральная громкость: среднее по блокам выше относительного порога -10 LU
+    double sum = 0.0;
+    quint64 count = 0;
+    for (int i = 0; i < HistogramBins; ++i) {
+        sum += energies[i] * m_blocks[i];
+        count += m_blocks[i];
+    }
+    if (count == 0) {
+        return result;
+    }
+
+    const double relativeGate = energyToLoudness(sum / count) + IntegratedRelativeGate;
+    const int firstBin = qBound(0, int(std::ceil((relativeGate - HistogramFloor) * 10.0 - 0.5)), HistogramBins);
+    sum = 0.0;
+    count = 0;
+    for (int i = firstBin; i < HistogramBins; ++i) {
+        sum += energies[i] * m_blocks[i];
+        count += m_blocks[i];
+    }
+    if (count == 0) {
+        return result;
+    }
+    result.valid = true;
+    result.integratedLufs = energyToLoudness(sum / count);
+
+    // LRA: разница 95-го и 10-го процентилей кратковременной громкости после порога -20 LU
+    sum = 0.0;
+    count = 0;
+    for (int i = 0; i < HistogramBins; ++i) {
+        sum += energies[i] * m_shortTerm[i];
+        count += m_shortTerm[i];
+    }
+    if (count == 0) {
+        return result;
+    }
+
+    const double rangeGate = energyToLoudness(sum / count) + RangeRelativeGate;
+    const int rangeFirstBin = qBound(0, int(std::ceil((rangeGate - HistogramFloor) * 10.0 - 0.5)), HistogramBins);
+    count = 0;
+    for (int i = rangeFirstBin; i < HistogramBins; ++i) {
+        count += m_shortTerm[i];
+    }
+    if (count == 0) {
+        return result;
+    }
+
+    const quint64 lowIndex = quint64((count - 1) * 0.10 + 0.5);
+    const quint64 highIndex = quint64((count - 1) * 0.95 + 0.5);
+    double low = 0.0;
+    double high = 0.0;
+    quint64 seen = 0;
+    bool lowFound = false;
+    for (int i = rangeFirstBin; i < HistogramBins; ++i) {
+        seen += m_shortTerm[i];
+        if (!lowFound && seen > lowIndex) {
+            low = binLoudness(i);
+            lowFound = true;
+        }
+        if (seen > highIndex) {
+            high = binLoudness(i);
+            break;
+        }
+    }
+    result.rangeLu = high - low;
+    return result;
+}
+
+QByteArray LoudnessHistogram::serialize() const
+{
+    QByteArray out;
+    out.append(char(HistogramVersion));
+    appendSection(out, m_blocks);
+    appendSection(out, m_shortTerm);
+    return out;
+}
+
+LoudnessHistogram LoudnessHistogram::deserialize(const QByteArray &data, bool *ok)
+{
+    LoudnessHistogram histogram;
+    qsizetype offset = 1;
+    const bool valid = !data.isEmpty() && quint8(data.at(0)) == HistogramVersion
+                       && readSection(data, offset, histogram.m_blocks)
+                       && readSection(data, offset, histogram.m_shortTerm);
+    if (ok) {
+        *ok = valid;
+    }
+    return valid ? histogram : LoudnessHistogram();
+}
+
+LoudnessMeter::LoudnessMeter(int channels, int sampleRate)
+    : m_channels(channels)
+    , m_sampleRate(qMax(1, sampleRate))
+    , m_subBlockFrames(qMax(1, sampleRate / 10))
+{
+    // Веса каналов BS.1770: боковые тыловые +1.5 дБ, LFE не учитывается.
+    // Раскладки 5.0 и 5.1 — в порядке WAV/FFmpeg (L R C [LFE] Ls Rs)
+    for (int c = 0; c < MaxChannels; ++c) {
+        m_weights[c] = 1.0;
+    }
+    if (channels == 5) {
+        m_weights[3] = m_weights[4] = 1.41;
+    } else if (channels == 6) {
+        m_weights[3] = 0.0;
+        m_weights[4] = m_weights[5] = 1.41;
+    }
+
+    // K-взвешивание, пересчитанное для частоты дискретизации (как в libebur128)
+    const double pi = 3.14159265358979323846;
+    double f0 = 1681.974450955533;
+    const double gainDb = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = std::tan(pi * f0 / m_sampleRate);
+    const double vh = std::pow(10.0, gainDb / 20.0);
+    const double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    m_shelf = { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0,
+                (vh - vb * k / q + k * k) / a0, 2.0 * (k * k - 1.0) / a0,
+                (1.0 - k / q + k * k) / a0 };
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(pi * f0 / m_sampleRate);
+    a0 = 1.0 + k / q + k * k;
+    m_highPass = { 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+
+    // Истинный пик: передискретизация до >= 192 кГц, фильтр-интерполятор sinc с окном
+    m_oversample = m_sampleRate >= 192000 ? 1 : (m_sampleRate >= 96000 ? 2 : 4);
+    m_tapsPerPhase = 12;
+    if (m_oversample > 1) {
+        const int length = m_oversample * m_tapsPerPhase;
+        const double center = (length - 1) / 2.0;
+        QVector<float> taps(length);
+        for (int n = 0; n < length; ++n) {
+            const double x = (n - center) / m_oversample;
+            const double sinc = std::abs(x) < 1e-9 ? 1.0 : std::sin(pi * x) / (pi * x);
+            const double window = 0.5 * (1.0 - std::cos(2.0 * pi * (n + 1) / (length + 1)));
+            taps[n] = float(sinc * window);
+        }
+        m_interpolator = QVector<float>(length);
+        for (int phase = 0; phase < m_oversample; ++phase) {
+            for (int t = 0; t < m_tapsPerPhase; ++t) {
+                m_interpolator[phase * m_tapsPerPhase + t] = taps[phase + t * m_oversample];
+            }
+        }
+    }
+}
+
+void LoudnessMeter::updateTruePeak(int channel, float sample)
+{
+    double peak = std::abs(sample);
+    if (m_oversample > 1) {
+        float *history = m_history[channel];
+        history[m_historyPosition] = sample;
+        for (int phase = 0; phase < m_oversample; ++phase) {
+            const float *taps = m_interpolator.constData() + phase * m_tapsPerPhase;
+            float acc = 0.0f;
+            for (int t = 0; t < m_tapsPerPhase; ++t) {
+                acc += taps[t] * history[(m_historyPosition - t) & 15];
+            }
+            peak = qMax(peak, double(std::abs(acc)));
+        }
+    }
+    if (peak > m_truePeak) {
+        m_truePeak = peak;
+    }
+}
+
+void LoudnessMeter::addFrames(const float *data, qsizetype frames)
+{
+    const int measured = qMin(m_channels, int(MaxChannels));
+    for (qsizetype f = 0; f < frames; ++f) {
+        const float *frame = data + f * m_channels;
+        for (int c = 0; c < measured; ++c) {
+            const float sample = frame[c];
+            updateTruePeak(c, sample);
+
+            // Два биквада (транспонированная прямая форма II) в double:
+            // у фильтра высоких частот полюса почти на единичной окружности
+            double *s = m_state[c];
+            const double x = sample;
+            const double y1 = m_shelf.b0 * x + s[0];
+            s[0] = m_shelf.b1 * x - m_shelf.a1 * y1 + s[1];
+            s[1] = m_shelf.b2 * x - m_shelf.a2 * y1;
+            const double y2 = m_highPass.b0 * y1 + s[2];
+            s[2] = m_highPass.b1 * y1 - m_highPass.a1 * y2 + s[3];
+            s[3] = m_highPass.b2 * y1 - m_highPass.a2 * y2;
+            m_subBlockSum[c] += y2 * y2;
+        }
+        m_historyPosition = (m_historyPosition + 1) & 15;
+        if (++m_subBlockPosition == m_subBlockFrames) {
+            finishSubBlock();
+        }
+    }
+}
+
+void LoudnessMeter::finishSubBlock()
+{
+    double energy = 0.0;
+    const int measured = qMin(m_channels, int(MaxChannels));
+    for (int c = 0; c < measured; ++c) {
+        energy += m_weights[c] * m_subBlockSum[c] / m_subBlockFrames;
+        m_subBlockSum[c] = 0.0;
+    }
+    m_subBlockPosition = 0;
+    m_subBlocks[m_subBlockCount % 30] = energy;
+    ++m_subBlockCount;
+
+    // Блок 400 мс каждые 100 мс (перекрытие 75%), окно 3 с с тем же шагом
+    if (m_subBlockCount >= 4) {
+        double block = 0.0;
+        for (int i = 1; i <= 4; ++i) {
+            block += m_subBlocks[(m_subBlockCount - i) % 30];
+        }
+        m_histogram.addBlock(block / 4.0);
+    }
+    if (m_subBlockCount >= 30) {
+        double window = 0.0;
+        for (double subBlock : m_subBlocks) {
+            window += subBlock;
+        }
+        m_histogram.addShortTerm(window / 30.0);
+    }
+}
+
+LoudnessResult LoudnessMeter::result() const
+{
+    return m_histogram.result(m_truePeak);
+}
@@ -0,0 +1,90 @@
+#ifndef LOUDNESS_METER_H
+#define LOUDNESS_METER_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+
+// Итог измерения громкости по EBU R128 / ITU-R BS.1770-4
+struct LoudnessResult {
+    bool valid = false;          // false — ни один блок не прошел абсолютный порог (тишина)
+    double integratedLufs = 0.0;
+    double rangeLu = 0.0;        // LRA
+    double truePeak = 0.0;       // линейная амплитуда, 1.0 — полная шкала
+    double truePeakDbtp() const;
+    // ReplayGain 2.0: опорный уровень -18 LUFS
+    double replayGainDb() const;
+};
+
+// Гистограммы громкости блоков с шагом 0.1 LU от -70 до +30 LUFS. Из них считаются
+// интегральная громкость (блоки 400 мс) и LRA (окна 3 с); для альбома гистограммы
+// треков просто складываются, поэтому треки можно анализировать по отдельности.
+class LoudnessHistogram
+{
+public:
+    LoudnessHistogram();
+
+    void addBlock(double energy);
+    void addShortTerm(double energy);
+    void merge(const LoudnessHistogram &other);
+    LoudnessResult result(double truePeak) const;
+
+    // Компактная запись для БД: только ненулевые ячейки
+    QByteArray serialize() const;
+    static LoudnessHistogram deserialize(const QByteArray &data, bool *ok = nullptr);
+
+private:
+    static int binFor(double energy);
+
+    QVector<quint32> m_blocks;
+    QVector<quint32> m_shortTerm;
+};
+
+// Потоковый измеритель: K-взвешивание, блоки 400 мс с перекрытием 75%, окна 3 с
+// с шагом 100 мс, истинный пик через передискретизацию (4x ниже 96 кГц).
+class LoudnessMeter
+{
+public:
+    static constexpr int MaxChannels = 8;
+
+    LoudnessMeter(int channels, int sampleRate);
+
+    // Чередующиеся каналы, float в [-1, 1]
+    void addFrames(const float *data, qsizetype frames);
+
+    LoudnessResult result() const;
+    const LoudnessHistogram &histogram() const { return m_histogram; }
+    double truePeak() const { return m_truePeak; }
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+    void finishSubBlock();
+    void updateTruePeak(int channel, float sample);
+
+    int m_channels;
+    int m_sampleRate;
+    double m_weights[MaxChannels];
+    Biquad m_shelf;
+    Biquad m_highPass;
+    double m_state[MaxChannels][4] = {};   // состояния двух биквадов на канал
+
+    qint64 m_subBlockFrames;               // 100 мс
+    qint64 m_subBlockPosition = 0;
+    double m_subBlockSum[MaxChannels] = {};
+    double m_subBlocks[30] = {};           // последние 3 с по 100 мс, взвешенные по каналам
+    int m_subBlockCount = 0;
+
+    // Истинный пик: многофазный интерполятор с окном Ханна
+    int m_oversample;
+    int m_tapsPerPhase;
+    QVector<float> m_interpolator;         // [фаза][отвод]
+    float m_history[MaxChannels][16] = {};
+    int m_historyPosition = 0;
+    double m_truePeak = 0.0;
+
+    LoudnessHistogram m_histogram;
+};
+
+#endif // LOUDNESS_METER_H
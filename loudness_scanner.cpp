@@ -0,0 +1,339 @@
+#include "loudness_scanner.h"
+#include "database_manager.h"
+#include "dsp_kernels.h"
+#include "loudness_meter.h"
+#include "waveform_data.h"
+
+#include <QAudioBuffer>
+#include <QAudioDecoder>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QFuture>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVector>
+#include <QtConcurrent/QtConcurrent>
+#include <cmath>
+#include <memory>
+
+#if defined(Q_OS_LINUX)
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_MACOS)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Файл, который нужно проанализировать, с его текущими mtime и размером
+struct ScanJob {
+    int songId;
+    QString filePath;
+    qint64 fileMtime;
+    qint64 fileSize;
+};
+
+// Фоновый приоритет ввода-вывода для текущего потока. Внутренние потоки
+// QAudioDecoder создаются уже из него и наследуют приоритет (Linux)
+void lowerCurrentThreadIoPriority()
+{
+    static thread_local bool lowered = false;
+    if (lowered) {
+        return;
+    }
+    lowered = true;
+#if defined(Q_OS_LINUX)
+    // IOPRIO_WHO_PROCESS с нулевым id — вызывающий поток; IOPRIO_CLASS_IDLE
+    const int ioprioWhoProcess = 1;
+    const int ioprioIdle = 3 << 13;
+    syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioIdle);
+#elif defined(Q_OS_WIN)
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(Q_OS_MACOS)
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+#endif
+}
+
+// Сэмплы буфера как float; nullptr для неподдерживаемого формата
+const float *samplesAsFloat(const QAudioBuffer &buffer, QVector<float> &scratch)
+{
+    const qsizetype count = buffer.sampleCount();
+    const DspKernels &kernels = DspKernels::active();
+    switch (buffer.format().sampleFormat()) {
+    case QAudioFormat::Float:
+        return buffer.constData<float>();
+    case QAudioFormat::Int16:
+        scratch.resize(count);
+        kernels.int16ToFloat(buffer.constData<qint16>(), scratch.data(), count);
+        return scratch.constData();
+    case QAudioFormat::Int32:
+        scratch.resize(count);
+        kernels.int32ToFloat(buffer.constData<qint32>(), scratch.data(), count);
+        return scratch.constData();
+    case QAudioFormat::UInt8: {
+        scratch.resize(count);
+        const quint8 *in = buffer.constData<quint8>();
+        for (qsizetype i = 0; i < count; ++i) {
+            scratch[i] = (int(in[i]) - 128) / 128.0f;
+        }
+        return scratch.constData();
+    }
+    default:
+        return nullptr;
+    }
+}
+
+// Декодирует файл целиком в собственном цикле событий потока пула.
+// songId == -1 в результате — анализ прерван, записывать нечего
+SongLoudnessInfo analyzeFile(const ScanJob &job, const QThread *scanner)
+{
+    lowerCurrentThreadIoPriority();
+
+    SongLoudnessInfo info;
+    info.songId = job.songId;
+    info.fileMtime = job.fileMtime;
+    info.fileSize = job.fileSize;
+
+    QAudioDecoder decoder;
+    decoder.setSource(QUrl::fromLocalFile(job.filePath));
+
+    std::unique_ptr<LoudnessMeter> meter;
+    std::unique_ptr<WaveformBuilder> waveform;
+    QAudioFormat meterFormat;
+    QVector<float> scratch;
+    bool done = false;
+    bool failed = false;
+    bool cancelled = false;
+
+    QEventLoop loop;
+    auto finish = [&] {
+        done = true;
+        loop.quit();
+    };
+    QObject::connect(&decoder, &QAudioDecoder::bufferReady, &loop, [&] {
+        const QAudioBuffer buffer = decoder.read();
+        if (scanner->isInterruptionRequested()) {
+            cancelled = true;
+            decoder.stop();
+            finish();
+            return;
+        }
+        if (!buffer.isValid() || done) {
+            return;
+        }
+        const QAudioFormat format = buffer.format();
+        if (!meter) {
+            meterFormat = format;
+            meter = std::make_unique<LoudnessMeter>(format.channelCount(), format.sampleRate());
+            waveform = std::make_unique<WaveformBuilder>(format.channelCount(), format.sampleRate());
+        }
+        const float *samples = samplesAsFloat(buffer, scratch);
+        // Смена формата посреди потока (цепочка файлов в одном контейнере) не поддерживается
+        if (!samples || format.channelCount() != meterFormat.channelCount()
+            || format.sampleRate() != meterFormat.sampleRate()) {
+            failed = true;
+            decoder.stop();
+            finish();
+            return;
+        }
+        meter->addFrames(samples, buffer.frameCount());
+        waveform->addFrames(samples, buffer.frameCount());
+    });
+    QObject::connect(&decoder, &QAudioDecoder::finished, &loop, finish);
+    QObject::connect(&decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error), &loop,
+                     [&](QAudioDecoder::Error) {
+        qDebug() << "Анализ громкости: не удалось декодировать" << job.filePath << ":" << decoder.errorString();
+        failed = true;
+        finish();
+    });
+
+    decoder.start();
+    // Ошибка может прийти прямо из start(), до запуска цикла
+    if (!done) {
+        loop.exec();
+    }
+
+    if (cancelled) {
+        info.songId = -1;
+        return info;
+    }
+    if (failed || !meter) {
+        return info;
+    }
+    // Обзор формы волны для полосы перемотки строится из того же декодирования
+    waveform->save(job.songId, job.fileMtime, job.fileSize);
+    const LoudnessResult result = meter->result();
+    if (!result.valid) {
+        return info;
+    }
+    info.valid = true;
+    info.integratedLufs = result.integratedLufs;
+    info.rangeLu = result.rangeLu;
+    info.truePeakDbtp = result.truePeakDbtp();
+    info.replayGainDb = result.replayGainDb();
+    info.histogram = meter->histogram().serialize();
+    return info;
+}
+
+} // namespace
+
+LoudnessScanner::LoudnessScanner(QObject *parent)
+    : QThread(parent)
+{
+}
+
+void LoudnessScanner::setPlaybackActive(bool active)
+{
+    m_playbackActive = active;
+}
+
+void LoudnessScanner::reportUnderruns(quint64 totalUnderruns)
+{
+    // Счетчик движка сбрасывается при остановке, поэтому считаем только рост
+    const quint64 previous = m_lastUnderruns.exchange(totalUnderruns);
+    if (totalUnderruns > previous) {
+        m_backoffUntil = QDateTime::currentMSecsSinceEpoch() + UnderrunBackoffMs;
+    }
+}
+
+int LoudnessScanner::allowedWorkers() const
+{
+    if (QDateTime::currentMSecsSinceEpoch() < m_backoffUntil) {
+        return 0;
+    }
+    const int cores = qMax(1, QThread::idealThreadCount());
+    return m_playbackActive ? qMax(1, cores / 2) : cores;
+}
+
+void LoudnessScanner::run()
+{
+    lowerCurrentThreadIoPriority();
+
+    // Соединение QSqlDatabase можно использовать только в создавшем его потоке
+    DatabaseManager database(QString("loudness_scan_%1").arg(quintptr(this)));
+    if (!database.open()) {
+        emit scanFinished(0, 0);
+        return;
+    }
+
+    // Анализируются только новые и изменившиеся файлы, а также файлы без актуального
+    // обзора формы волны; недоступные и уже не декодировавшиеся пропускаются
+    QList<ScanJob> jobs;
+    for (const SongScanState &state : database.loadSongScanStates()) {
+        const QFileInfo info(state.filePath);
+        if (!info.isFile()) {
+            continue;
+        }
+        const qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+        if (mtime == state.fileMtime && info.size() == state.fileSize
+            && (!state.hasLoudness || WaveformData::isUpToDate(state.id, mtime, info.size()))) {
+            continue;
+        }
+        jobs.append({state.id, state.filePath, mtime, info.size()});
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    pool.setThreadPriority(QThread::IdlePriority);
+
+    // Задачи раздаются по одной, чтобы число одновременно декодируемых файлов
+    // можно было менять на ходу (воспроизведение, опустошения буфера)
+    QList<QFuture<SongLoudnessInfo>> running;
+    QList<SongLoudnessInfo> pending;
+    QElapsedTimer sinceCommit;
+    sinceCommit.start();
+    int next = 0;
+    int done = 0;
+    int analyzed = 0;
+    int failed = 0;
+    emit progressChanged(0, jobs.size());
+
+    auto commit = [&] {
+        const bool written = database.updateSongLoudness(pending);
+        for (const SongLoudnessInfo &song : pending) {
+            if (written && song.valid) {
+                ++analyzed;
+            } else {
+                ++failed;
+            }
+        }
+        pending.clear();
+        sinceCommit.restart();
+    };
+
+    while (next < jobs.size() || !running.isEmpty()) {
+        const bool stopping = isInterruptionRequested();
+        while (!stopping && next < jobs.size() && running.size() < allowedWorkers()) {
+            const ScanJob job = jobs.at(next++);
+            running.append(QtConcurrent::run(&pool, [job, this] {
+                return analyzeFile(job, this);
+            }));
+        }
+
+        for (int i = running.size() - 1; i >= 0; --i) {
+            if (!running.at(i).isFinished()) {
+                continue;
+            }
+            const SongLoudnessInfo result = running.takeAt(i).result();
+            if (result.songId == -1) {
+                continue;
+            }
+            ++done;
+            // Неудачи тоже записываются (mtime и размер без громкости), чтобы не повторять их
+            pending.append(result);
+        }
+        if (!pending.isEmpty()) {
+            emit progressChanged(done, jobs.size());
+        }
+        if (pending.size() >= BatchSize || (!pending.isEmpty() && sinceCommit.elapsed() >= BatchIntervalMs)) {
+            commit();
+        }
+        if (stopping && running.isEmpty()) {
+            break;
+        }
+        QThread::msleep(20);
+    }
+    if (!pending.isEmpty()) {
+        commit();
+    }
+
+    if (!isInterruptionRequested()) {
+        updateAlbums(database);
+    }
+    emit scanFinished(analyzed, failed);
+}
+
+void LoudnessScanner::updateAlbums(DatabaseManager &database)
+{
+    // Альбом пересчитывается, когда у его песен сброшена альбомная поправка:
+    // так подхватываются и альбомы, недосчитанные прерванным анализом
+    for (AlbumLoudnessInfo album : database.loadAlbumsPendingLoudness()) {
+        if (isInterruptionRequested()) {
+            return;
+        }
+        LoudnessHistogram histogram;
+        double truePeak = 0.0;
+        for (const SongLoudnessInfo &song : database.getAlbumSongLoudness(album.album, album.artist)) {
+            bool ok = false;
+            const LoudnessHistogram songHistogram = LoudnessHistogram::deserialize(song.histogram, &ok);
+            if (!ok) {
+                continue;
+            }
+            histogram.merge(songHistogram);
+            truePeak = qMax(truePeak, std::pow(10.0, song.truePeakDbtp / 20.0));
+        }
+        const LoudnessResult result = histogram.result(truePeak);
+        if (!result.valid) {
+            continue;
+        }
+        album.integratedLufs = result.integratedLufs;
+        album.rangeLu = result.rangeLu;
+        album.truePeakDbtp = result.truePeakDbtp();
+        album.replayGainDb = result.replayGainDb();
+        database.updateAlbumLoudness(album);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef LOUDNESS_SCANNER_H
+#define LOUDNESS_SCANNER_H
+
+#include <QThread>
+#include <atomic>
+
+class DatabaseManager;
+
+// Фоновый анализ громкости библиотеки по EBU R128: файлы декодируются параллельно
+// на собственном пуле потоков, результаты пишутся в Songs пачками, затем по сумме
+// гистограмм треков считаются альбомы. Неизменившиеся файлы (mtime и размер)
+// пропускаются, поэтому прерванный анализ продолжается с того же места.
+// Из того же декодирования строится обзор формы волны (WaveformData).
+// Потоки пула работают с фоновым приоритетом процессора и диска; во время
+// воспроизведения анализ идет в половину ядер, а после опустошения буфера
+// вывода новые файлы какое-то время не берутся.
+class LoudnessScanner : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit LoudnessScanner(QObject *parent = nullptr);
+
+    // Вызываются из GUI-потока
+    void setPlaybackActive(bool active);
+    // Накопленный счетчик опустошений буфера вывода (MusicPlayer::underrunCount)
+    void reportUnderruns(quint64 totalUnderruns);
+
+signals:
+    void progressChanged(int done, int total);
+    void scanFinished(int analyzed, int failed);
+
+protected:
+    void run() override;
+
+private:
+    static constexpr int BatchSize = 32;
+    static constexpr int BatchIntervalMs = 5000;
+    static constexpr int UnderrunBackoffMs = 10000;
+
+    int allowedWorkers() const;
+    void updateAlbums(DatabaseManager &database);
+
+    std::atomic<bool> m_playbackActive{false};
+    std::atomic<quint64> m_lastUnderruns{0};
+    std::atomic<qint64> m_backoffUntil{0}; // мс с начала эпохи
+};
+
+#endif // LOUDNESS_SCANNER_H
@@ -5,6 +5,9 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    // Имена нужны QSettings и QStandardPaths (настройки, кэши, локальные файлы)
+    a.setOrganizationName("MPlayer");
+    a.setApplicationName("MusicPlayer");
     MainWindow w;
     w.show();
     return a.exec();
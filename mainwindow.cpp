@@ -1,6 +1,24 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include <QShortcut>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+
+// Страница, которая уже есть в памяти (снимок библиотеки, конец результатов поиска)
+QFuture<QList<SongInfo>> readyPage(const QList<SongInfo> &songs)
+{
+    QPromise<QList<SongInfo>> promise;
+    promise.start();
+    promise.addResult(songs);
+    promise.finish();
+    return promise.future();
+}
+
+} // namespace
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
@@ -10,32 +28,96 @@ MainWindow::MainWindow(QWidget *parent)
     ui->setupUi(this);
 
     musicPlayer = new MusicPlayer(this);
-    dbManager = new DatabaseManager();
+    albumArtCache = new AlbumArtCache(this);
+    connect(albumArtCache, &AlbumArtCache::artReady, this, &MainWindow::handleAlbumArtReady);
+
+    // Параметры подключения; само соединение открывает поток исполнителя,
+    // поэтому недоступная БД не замораживает окно при запуске. Вместо сервера
+    // PostgreSQL можно выбрать локальный файл SQLite (database/backend=sqlite)
+    QSettings settings;
+    if (settings.value("database/backend", "postgresql").toString() == "sqlite") {
+        dbManager = new DatabaseManager(DatabaseBackend::Sqlite);
+        dbManager->setDatabaseFile(settings.value("database/sqlitePath",
+                                                  QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)
+                                                      + "/music_player.db").toString());
+    } else {
+        dbManager = new DatabaseManager();
+        dbManager->setConnectionParameters("localhost", 5432, "music_player_db", "dima", "zxc011");
+    }
 
-    // Подключение к базе данных
-    if (!dbManager->connectToDatabase("localhost", 5432, "music_player_db", "dima", "zxc011")) {
-        QMessageBox::critical(this, "Ошибка БД", "Не удалось подключиться к базе данных. Проверьте настройки.");
-        return;
+    // Метрики запросов: для запросов дольше порога снимается план EXPLAIN, а сводка
+    // раз в интервал перезаписывает файл в текстовом формате Prometheus (0 — не выгружать).
+    // Рядом выгружаются задержки воспроизведения (PlaybackTelemetry)
+    QueryMetrics::instance().setSlowQueryThresholdMs(settings.value("diagnostics/slowQueryMs", 200).toInt());
+    const int metricsIntervalSec = settings.value("diagnostics/metricsIntervalSec", 60).toInt();
+    if (metricsIntervalSec > 0) {
+        const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        m_queryMetricsFile = settings.value("diagnostics/metricsFile", dataDir + "/query_metrics.prom").toString();
+        m_playbackMetricsFile = settings.value("diagnostics/playbackMetricsFile",
+                                               dataDir + "/playback_metrics.prom").toString();
+        auto *metricsTimer = new QTimer(this);
+        connect(metricsTimer, &QTimer::timeout, this, &MainWindow::exportMetrics);
+        metricsTimer->start(metricsIntervalSec * 1000);
     }
-    dbManager->createTables();
-    dbManager->seedDatabase();
+    auto *diagnosticsShortcut = new QShortcut(QKeySequence("Ctrl+Shift+D"), this);
+    connect(diagnosticsShortcut, &QShortcut::activated, this, &MainWindow::showDiagnostics);
+
+    dbExecutor = new DatabaseExecutor(this);
+    dbExecutor->start();
+    historyWriter = new PlaybackHistoryWriter(dbExecutor, this);
+    catalogCache = new CatalogCache(dbExecutor, this);
+    connect(catalogCache, &CatalogCache::playlistsChanged, this, &MainWindow::handlePlaylistsChanged);
+    connect(catalogCache, &CatalogCache::catalogChanged, this, &MainWindow::handleCatalogChanged);
+    connect(catalogCache, &CatalogCache::resyncRequired, this, &MainWindow::handleCatalogResync);
+    dbExecutor->submit([](DatabaseManager &db) {
+        return db.open() && db.migrateSchema() && db.seedDatabase();
+    }).then(this, [this](bool ready) {
+        if (!ready) {
+            // Список из снимка библиотеки остается на экране
+            QMessageBox::critical(this, "Ошибка БД", "Не удалось подключиться к базе данных. Проверьте настройки.");
+            return;
+        }
+        reconcileLibrarySnapshot();
+        // Список плейлистов приходит из кэша каталога
+        catalogCache->start();
+        loadLibraryReplayGain();
+        startLoudnessScan();
+        startCatalogNormalization();
+        // Плейлисты, где ключи порядка сблизились, перенумеровываются заранее, а не
+        // посреди перетаскивания
+        dbExecutor->submit([](DatabaseManager &db) {
+            return db.rebalanceCrowdedPlaylists();
+        });
+
+        // Поиск в PostgreSQL включается настройкой и требует индекса pg_trgm из миграции
+        // схемы; без него используется индекс в памяти
+        if (QSettings().value("search/backend", "memory").toString() != "pg_trgm") {
+            buildSearchIndex();
+            return;
+        }
+        dbExecutor->submit([](DatabaseManager &db) {
+            return db.hasSearchIndex();
+        }).then(this, [this](bool available) {
+            m_serverSearch = available;
+            if (!available) {
+                buildSearchIndex();
+            }
+        });
+    });
 
     // Инициализация моделей для QListView
-    songListModel = new QStandardItemModel(this);
+    songListModel = new SongListModel(this);
     ui->songListView->setModel(songListModel);
+    connect(songListModel, &SongListModel::loadFinished, this, &MainWindow::handleSongsLoaded);
+    connect(songListModel, &SongListModel::songsMoveRequested, this, &MainWindow::handleSongsMoveRequested);
+    ui->songListView->setDropIndicatorShown(true);
 
     playlistListModel = new QStandardItemModel(this);
     ui->playlistListView->setModel(playlistListModel);
 
-    // Загрузка всех плейлистов при запуске
-    QList<PlaylistInfo> playlists = dbManager->loadPlaylists();
-    for (const PlaylistInfo& playlist : playlists) {
-        QStandardItem *item = new QStandardItem(playlist.name);
-        item->setData(playlist.id, Qt::UserRole + 1);  // Playlist ID
-        playlistListModel->appendRow(item);
-    }
-
-    // Загрузка всех песен в songListModel и m_playbackQueue при запуске
+    // Первая страница библиотеки показывается из локального снимка сразу, не дожидаясь БД;
+    // без снимка задания выполняются по порядку, и загрузка списка идет после создания таблиц
+    m_librarySnapshot = LibrarySnapshot::open();
     loadAllSongs();
 
     // Начальное состояние UI
@@ -48,6 +130,7 @@ MainWindow::MainWindow(QWidget *parent)
     connect(musicPlayer, &MusicPlayer::metaDataChanged, this, &MainWindow::handlePlayerMetaDataChanged);
     connect(musicPlayer, &MusicPlayer::errorOccurred, this, &MainWindow::handlePlayerError);
     connect(musicPlayer, &MusicPlayer::mediaStatusChanged, this, &MainWindow::handleMediaStatusChanged);
+    connect(musicPlayer, &MusicPlayer::advancedToNext, this, &MainWindow::handlePlayerAdvanced);
 
     // НОВЫЕ СОЕДИНЕНИЯ для контекстного меню и смены вкладок
     connect(ui->songListView, &QListView::customContextMenuRequested, this, &MainWindow::on_songListView_customContextMenuRequested);
@@ -55,16 +138,36 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Установка громкости по умолчанию
     musicPlayer->setVolume(ui->volumeSlider->value());
-
-    // Если есть песни, выбираем первую
-    if (!m_playbackQueue.isEmpty()) {
-        ui->songListView->setCurrentIndex(songListModel->index(0, 0));
-        m_currentSongIndex = 0;
-    }
+    musicPlayer->setCrossfadeDuration(QSettings().value("playback/crossfadeMs", 0).toInt());
+    // Первая песня будет выбрана, когда придет первая страница списка
 }
 
 MainWindow::~MainWindow()
 {
+    // Анализ громкости прерывается: уже записанные пачки сохранятся, остальное
+    // досчитается при следующем запуске
+    if (m_loudnessScanner) {
+        m_loudnessScanner->requestInterruption();
+        m_loudnessScanner->wait();
+    }
+    if (m_catalogNormalizer) {
+        m_catalogNormalizer->requestInterruption();
+        m_catalogNormalizer->wait();
+    }
+    if (m_snapshotWriter) {
+        m_snapshotWriter->requestInterruption();
+        m_snapshotWriter->wait();
+    }
+    delete catalogCache; // останавливает поток подписки на изменения
+    // Поток импорта нельзя уничтожать, пока он работает
+    if (m_importer) {
+        m_importer->wait();
+    }
+    // Остаток истории и уже отправленные записи (например, метаданные) дописываются до закрытия
+    delete historyWriter;
+    delete dbExecutor;
+    // Последняя выгрузка, когда все запросы уже выполнены
+    exportMetrics();
     delete ui;
     delete dbManager;
 }
@@ -72,12 +175,12 @@ MainWindow::~MainWindow()
 void MainWindow::initializeUIState()
 {
     // Кнопки управления плеером
-    bool hasSongs = !m_playbackQueue.isEmpty();
+    bool hasSongs = songListModel->rowCount() > 0;
     ui->playButton->setEnabled(hasSongs);
     ui->pauseButton->setEnabled(false);
     ui->stopButton->setEnabled(false);
-    ui->nextButton->setEnabled(hasSongs && m_playbackQueue.size() > 1);
-    ui->previousButton->setEnabled(hasSongs && m_playbackQueue.size() > 1);
+    ui->nextButton->setEnabled(hasSongs && songListModel->rowCount() > 1);
+    ui->previousButton->setEnabled(hasSongs && songListModel->rowCount() > 1);
 
     ui->progressBar->setEnabled(false);
     ui->deleteSongButton->setEnabled(hasSongs);
@@ -94,74 +197,462 @@ void MainWindow::initializeUIState()
     ui->currentSongListViewTitleLabel->setText("Библиотека песен");
 }
 
-// НОВАЯ ФУНКЦИЯ: Загружает все песни в songListModel и m_playbackQueue
-void MainWindow::loadAllSongs()
+// Приводит список плейлистов к кэшу каталога по ID, не сбрасывая модель:
+// выделение и текущая строка в списке сохраняются
+void MainWindow::handlePlaylistsChanged()
 {
-    songListModel->clear();
-    m_playbackQueue.clear(); // Очищаем очередь воспроизведения
-    QList<SongInfo> songs = dbManager->loadSongs();
-    for (const SongInfo& song : songs) {
-        QString displayText; // ИЗМЕНЕНО
-        if (!song.artist.isEmpty()) { // ИЗМЕНЕНО: Сначала исполнитель
-            displayText = song.artist + " - " + song.title;
-        } else {
-            displayText = song.title; // Если исполнителя нет, просто название
+    const QList<PlaylistInfo> playlists = catalogCache->playlists();
+    QSet<int> ids;
+    for (const PlaylistInfo &playlist : playlists) {
+        ids.insert(playlist.id);
+    }
+    for (int row = playlistListModel->rowCount() - 1; row >= 0; --row) {
+        if (!ids.contains(playlistListModel->item(row)->data(Qt::UserRole + 1).toInt())) {
+            playlistListModel->removeRow(row);
         }
-        QStandardItem *item = new QStandardItem(displayText);
-        item->setData(song.id, Qt::UserRole + 1);      // Song ID
-        item->setData(song.filePath, Qt::UserRole + 2); // File Path
-        songListModel->appendRow(item);
-        m_playbackQueue.append(song); // Добавляем в очередь воспроизведения
     }
+    for (int row = 0; row < playlists.size(); ++row) {
+        const PlaylistInfo &playlist = playlists.at(row);
+        int existingRow = row;
+        while (existingRow < playlistListModel->rowCount()
+               && playlistListModel->item(existingRow)->data(Qt::UserRole + 1).toInt() != playlist.id) {
+            ++existingRow;
+        }
+        if (existingRow == playlistListModel->rowCount()) {
+            QStandardItem *item = new QStandardItem(playlist.name);
+            item->setData(playlist.id, Qt::UserRole + 1);  // Playlist ID
+            playlistListModel->insertRow(row, item);
+            continue;
+        }
+        if (existingRow != row) {
+            playlistListModel->insertRow(row, playlistListModel->takeRow(existingRow));
+        }
+        if (playlistListModel->item(row)->text() != playlist.name) {
+            playlistListModel->item(row)->setText(playlist.name);
+        }
+    }
+
+    // Просматриваемый плейлист удалили в другой копии программы
+    if (m_currentViewingPlaylistId > 0 && !ids.contains(m_currentViewingPlaylistId)) {
+        loadAllSongs();
+    }
+}
+
+// НОВАЯ ФУНКЦИЯ: Загружает все песни в songListModel
+void MainWindow::loadAllSongs()
+{
+    if (m_librarySnapshot) {
+        showSongs([snapshot = m_librarySnapshot](const SongInfo *last, int limit) {
+            return readyPage(snapshot->page(last, limit));
+        }, -1);
+        ui->currentSongListViewTitleLabel->setText("Библиотека песен");
+        return;
+    }
+    showSongs([this](const SongInfo *last, int limit) {
+        const QString afterTitle = last ? last->title : QString();
+        const int afterId = last ? last->id : -1;
+        return dbExecutor->submit([afterTitle, afterId, limit](DatabaseManager &db) {
+            return db.loadSongsPage(afterTitle, afterId, limit);
+        });
+    }, -1);
     ui->currentSongListViewTitleLabel->setText("Библиотека песен");
-    m_currentViewingPlaylistId = -1; // Сбрасываем ID просматриваемого плейлиста
+}
 
-    // Обновляем состояние кнопок после загрузки
-    initializeUIState();
-    if (!m_playbackQueue.isEmpty()) {
-        m_currentSongIndex = 0; // Устанавливаем на первую песню
-        ui->songListView->setCurrentIndex(songListModel->index(0, 0));
+// НОВАЯ ФУНКЦИЯ: Загружает песни для конкретного плейлиста в songListModel
+void MainWindow::loadSongsForPlaylist(int playlistId, const QString& playlistName)
+{
+    showSongs([this, playlistId](const SongInfo *last, int limit) {
+        const qint64 afterOrder = last ? last->playlistOrder : 0;
+        const int afterSongId = last ? last->id : -1;
+        return dbExecutor->submit([playlistId, afterOrder, afterSongId, limit](DatabaseManager &db) {
+            return db.getSongsInPlaylistPage(playlistId, afterOrder, afterSongId, limit);
+        });
+    }, playlistId);
+    ui->currentSongListViewTitleLabel->setText("Плейлист: " + playlistName);
+}
+
+// Показывает список песен постранично: сразу загружается только первая страница,
+// остальные — по мере прокрутки. Повторная загрузка того же списка применяется
+// как разница, поэтому выделение, прокрутка и текущая песня сохраняются.
+// Страницы приходят асинхронно; выбор текущей песни делает handleSongsLoaded().
+void MainWindow::showSongs(const SongListModel::PageFetcher &fetcher, int playlistId, bool reloadSameView)
+{
+    const bool sameView = reloadSameView && m_currentViewingPlaylistId == playlistId && songListModel->hasPageFetcher();
+    m_restoreSongId = -1;
+    if (sameView && m_currentSongIndex >= 0 && m_currentSongIndex < songListModel->rowCount()) {
+        m_restoreSongId = songListModel->songAt(m_currentSongIndex).id;
+    }
+
+    if (sameView) {
+        songListModel->replacePageFetcher(fetcher);
     } else {
+        songListModel->setPageFetcher(fetcher);
         m_currentSongIndex = -1;
     }
+    m_currentViewingPlaylistId = playlistId; // -1 — библиотека, SearchViewId — поиск, иначе ID плейлиста
+    m_selectAfterLoad = true;
+
+    // Порядок меняется перетаскиванием только в плейлисте
+    const bool reorderable = playlistId > 0;
+    songListModel->setReorderable(reorderable);
+    ui->songListView->setDragDropMode(reorderable ? QAbstractItemView::InternalMove : QAbstractItemView::NoDragDrop);
+    ui->songListView->setSelectionMode(reorderable ? QAbstractItemView::ExtendedSelection
+                                                   : QAbstractItemView::SingleSelection);
 }
 
-// НОВАЯ ФУНКЦИЯ: Загружает песни для конкретного плейлиста в songListModel и m_playbackQueue
-void MainWindow::loadSongsForPlaylist(int playlistId, const QString& playlistName)
+void MainWindow::handleSongsMoveRequested(const QList<int> &songIds, int beforeSongId)
 {
-    songListModel->clear();
-    m_playbackQueue.clear(); // Очищаем очередь воспроизведения
-    QList<SongInfo> songs = dbManager->getSongsInPlaylist(playlistId);
-    for (const SongInfo& song : songs) {
-        QString displayText; // ИЗМЕНЕНО
-        if (!song.artist.isEmpty()) { // ИЗМЕНЕНО: Сначала исполнитель
-            displayText = song.artist + " - " + song.title;
-        } else {
-            displayText = song.title; // Если исполнителя нет, просто название
+    const int playlistId = m_currentViewingPlaylistId;
+    if (playlistId <= 0) {
+        return;
+    }
+
+    // Список меняется сразу; в БД пишутся только перемещенные строки. Если запись
+    // не удалась, плейлист перечитывается
+    const int currentSongId = m_currentSongIndex >= 0 && m_currentSongIndex < songListModel->rowCount()
+                                  ? songListModel->songAt(m_currentSongIndex).id : -1;
+    songListModel->moveSongs(songIds, beforeSongId);
+    if (currentSongId != -1) {
+        m_currentSongIndex = songListModel->rowOfSongId(currentSongId);
+    }
+    if (musicPlayer->playbackState() != QMediaPlayer::StoppedState) {
+        preloadNextSong(); // следующая в очереди могла смениться
+    }
+
+    dbExecutor->submit([playlistId, songIds, beforeSongId](DatabaseManager &db) {
+        return db.moveSongsInPlaylist(playlistId, songIds, beforeSongId);
+    }).then(this, [this, playlistId, songIds](bool moved) {
+        if (moved) {
+            // У перемещенных строк новые ключи song_order: без них курсор следующей страницы
+            // ушел бы назад, если такая строка окажется последней загруженной
+            if (m_currentViewingPlaylistId == playlistId) {
+                const int positionLimit = songListModel->rowCount() + 1;
+                dbExecutor->submit([playlistId, songIds, positionLimit](DatabaseManager &db) {
+                    return db.loadSongPositions(playlistId, songIds, positionLimit);
+                }).then(this, [this, playlistId, songIds, positionLimit](const QList<SongPosition> &positions) {
+                    if (m_currentViewingPlaylistId == playlistId) {
+                        applySongPositions(songIds, positions, positionLimit);
+                    }
+                });
+            }
+            return;
+        }
+        ui->statusbar->showMessage("Не удалось сохранить порядок плейлиста", 5000);
+        if (m_currentViewingPlaylistId == playlistId) {
+            loadSongsForPlaylist(playlistId, playlistNameById(playlistId));
         }
-        QStandardItem *item = new QStandardItem(displayText);
-        item->setData(song.id, Qt::UserRole + 1);      // Song ID
-        item->setData(song.filePath, Qt::UserRole + 2); // File Path
-        songListModel->appendRow(item);
-        m_playbackQueue.append(song); // Добавляем в очередь воспроизведения
+    });
+}
+
+void MainWindow::on_searchLineEdit_textChanged(const QString &text)
+{
+    const QString query = text.simplified();
+    if (query.isEmpty()) {
+        if (m_currentViewingPlaylistId == SearchViewId) {
+            loadAllSongs();
+        }
+        return;
     }
-    ui->currentSongListViewTitleLabel->setText("Плейлист: " + playlistName);
-    m_currentViewingPlaylistId = playlistId; // Устанавливаем ID просматриваемого плейлиста
 
-    // Обновляем состояние кнопок после загрузки
-    initializeUIState();
-    if (!m_playbackQueue.isEmpty()) {
-        m_currentSongIndex = 0; // Устанавливаем на первую песню
-        ui->songListView->setCurrentIndex(songListModel->index(0, 0));
+    SongListModel::PageFetcher fetcher;
+    if (m_serverSearch) {
+        // Сервер возвращает все результаты (до SearchResultLimit) одной страницей
+        fetcher = [this, query](const SongInfo *last, int) -> QFuture<QList<SongInfo>> {
+            if (last) {
+                return readyPage({});
+            }
+            return dbExecutor->submit([query](DatabaseManager &db) {
+                return db.searchSongs(query, SearchResultLimit);
+            });
+        };
+    } else if (m_searchIndex) {
+        // Ранжирование — в памяти за доли миллисекунды; из БД постранично
+        // догружаются только строки найденных песен
+        const auto songIds = std::make_shared<const QList<int>>(m_searchIndex->search(query, SearchResultLimit));
+        fetcher = [this, songIds](const SongInfo *last, int limit) {
+            const qsizetype from = last ? songIds->indexOf(last->id) + 1 : 0;
+            const QList<int> page = songIds->mid(from, limit);
+            return dbExecutor->submit([page](DatabaseManager &db) {
+                return db.loadSongsByIds(page);
+            });
+        };
     } else {
-        m_currentSongIndex = -1;
+        // Запрос повторится, когда индекс будет построен
+        ui->currentSongListViewTitleLabel->setText("Поиск: индекс строится...");
+        return;
+    }
+
+    // Каждый новый запрос — новый список, а не перезагрузка прежнего
+    showSongs(fetcher, SearchViewId, false);
+    ui->currentSongListViewTitleLabel->setText("Поиск: " + query);
+}
+
+void MainWindow::buildSearchIndex()
+{
+    if (m_searchIndexBuilding) {
+        m_searchIndexDirty = true;
+        return;
+    }
+    m_searchIndexBuilding = true;
+    m_searchIndexDirty = false;
+
+    dbExecutor->submit([](DatabaseManager &db) {
+        return db.loadSongSearchFields();
+    }).then(QtFuture::Launch::Async, [](const QList<SongInfo> &songs) {
+        // Нормализация строк и построение списков ключей идут в пуле потоков, а не в GUI
+        auto index = std::make_shared<SearchIndex>();
+        index->reserve(songs.size());
+        for (const SongInfo &song : songs) {
+            index->addOrUpdate(song.id, song.title, song.artist, song.album);
+        }
+        return index;
+    }).then(this, [this](std::shared_ptr<SearchIndex> index) {
+        m_searchIndexBuilding = false;
+        m_searchIndex = std::move(index);
+        qDebug() << "Индекс поиска построен, песен:" << m_searchIndex->size();
+        if (m_searchIndexDirty) {
+            buildSearchIndex(); // пока строили, библиотека изменилась
+        }
+        if (!ui->searchLineEdit->text().simplified().isEmpty()) {
+            on_searchLineEdit_textChanged(ui->searchLineEdit->text());
+        }
+    });
+}
+
+void MainWindow::updateSearchIndex(const QList<SongInfo> &songs)
+{
+    if (m_searchIndexBuilding) {
+        m_searchIndexDirty = true;
+    }
+    if (!m_searchIndex) {
+        return;
+    }
+    for (const SongInfo &song : songs) {
+        m_searchIndex->addOrUpdate(song.id, song.title, song.artist, song.album);
+    }
+}
+
+void MainWindow::removeFromSearchIndex(int songId)
+{
+    if (m_searchIndex) {
+        m_searchIndex->remove(songId);
+    }
+    if (m_searchIndexBuilding) {
+        m_searchIndexDirty = true;
+    }
+}
+
+// Перечитывает текущий список как разницу (см. showSongs)
+void MainWindow::reloadCurrentView()
+{
+    if (m_currentViewingPlaylistId == SearchViewId) {
+        on_searchLineEdit_textChanged(ui->searchLineEdit->text());
+    } else if (m_currentViewingPlaylistId > 0) {
+        loadSongsForPlaylist(m_currentViewingPlaylistId, playlistNameById(m_currentViewingPlaylistId));
+    } else {
+        loadAllSongs();
+    }
+}
+
+// Вместо перезагрузки списка обновляются только затронутые строки: для них из БД
+// приходят текущие данные и позиции в порядке списка
+void MainWindow::handleCatalogChanged(const CatalogChanges &changes)
+{
+    const int viewId = m_currentViewingPlaylistId;
+    QSet<int> affected;
+    if (viewId > 0) {
+        affected = changes.playlistSongs.value(viewId);
+        for (int songId : changes.songs) {
+            if (songListModel->rowOfSongId(songId) != -1) {
+                affected.insert(songId);
+            }
+        }
+    } else if (viewId == -1) {
+        affected = changes.songs;
+    }
+
+    // Индекс поиска в памяти и строки результатов поиска обновляются по одной песне;
+    // новые совпадения появятся при следующем запросе
+    if (!changes.songs.isEmpty() && (!m_serverSearch || viewId == SearchViewId)) {
+        const QList<int> songIds = changes.songs.values();
+        dbExecutor->submit([songIds](DatabaseManager &db) {
+            return db.loadSongsByIds(songIds);
+        }).then(this, [this, songIds](const QList<SongInfo> &songs) {
+            QHash<int, SongInfo> found;
+            for (const SongInfo &song : songs) {
+                found.insert(song.id, song);
+            }
+            if (!m_serverSearch) {
+                updateSearchIndex(songs);
+                for (int songId : songIds) {
+                    if (!found.contains(songId)) {
+                        removeFromSearchIndex(songId);
+                    }
+                }
+            }
+            if (m_currentViewingPlaylistId != SearchViewId) {
+                return;
+            }
+            for (int songId : songIds) {
+                const int row = songListModel->rowOfSongId(songId);
+                if (row == -1) {
+                    continue;
+                }
+                if (found.contains(songId)) {
+                    songListModel->updateSong(row, found.value(songId));
+                } else {
+                    removeSongRow(row);
+                }
+            }
+        });
+    }
+
+    if (affected.isEmpty() || !songListModel->hasPageFetcher()) {
+        return;
+    }
+    if (affected.size() > MaxIncrementalChanges) {
+        reloadCurrentView();
+        return;
+    }
+    const QList<int> songIds = affected.values();
+    // Позиции дальше загруженных строк все равно отбрасываются в applySongPositions;
+    // на единицу больше, чтобы отличить вставку в конец полностью загруженного списка
+    const int positionLimit = songListModel->rowCount() + 1;
+    dbExecutor->submit([viewId, songIds, positionLimit](DatabaseManager &db) {
+        return db.loadSongPositions(viewId, songIds, positionLimit);
+    }).then(this, [this, viewId, songIds, positionLimit](const QList<SongPosition> &positions) {
+        if (m_currentViewingPlaylistId == viewId) {
+            applySongPositions(songIds, positions, positionLimit);
+        }
+    });
+}
+
+void MainWindow::applySongPositions(const QList<int> &songIds, const QList<SongPosition> &positions, int positionLimit)
+{
+    const int currentSongId = m_currentSongIndex >= 0 && m_currentSongIndex < songListModel->rowCount()
+                                  ? songListModel->songAt(m_currentSongIndex).id : -1;
+
+    // Частый случай — поменялись только метаданные, а строки остались на местах
+    QList<int> rows;
+    for (int songId : songIds) {
+        const int row = songListModel->rowOfSongId(songId);
+        if (row != -1) {
+            rows.append(row);
+        }
+    }
+    bool inPlace = rows.size() == positions.size();
+    for (qsizetype i = 0; inPlace && i < positions.size(); ++i) {
+        inPlace = positions.at(i).position < positionLimit
+                  && songListModel->rowOfSongId(positions.at(i).song.id) == positions.at(i).position;
+    }
+    if (inPlace) {
+        for (const SongPosition &position : positions) {
+            songListModel->updateSong(position.position, position.song);
+        }
+        return;
+    }
+
+    // Загружено начало списка: после удаления затронутых строк вставка по возрастанию
+    // позиций дает то же начало нового порядка. Песни дальше загруженного придут со страницами;
+    // позиция, равная positionLimit, не точна (список мог догрузиться, пока шел запрос)
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+    for (int row : rows) {
+        songListModel->removeSongAt(row);
+    }
+    for (const SongPosition &position : positions) {
+        if (position.position >= positionLimit) {
+            continue;
+        }
+        if (position.position < songListModel->rowCount()
+            || (position.position == songListModel->rowCount() && !songListModel->hasMorePages())) {
+            songListModel->insertSong(position.position, position.song);
+        }
+    }
+
+    if (currentSongId != -1) {
+        const int row = songListModel->rowOfSongId(currentSongId);
+        m_currentSongIndex = row != -1 ? row : qMin(m_currentSongIndex, songListModel->rowCount() - 1);
     }
+    if (musicPlayer->playbackState() != QMediaPlayer::StoppedState) {
+        preloadNextSong(); // следующая в очереди могла смениться
+    }
+    updateUIForPlaybackState(musicPlayer->playbackState());
+}
+
+// Убирает строку из списка, сохраняя текущую песню
+void MainWindow::removeSongRow(int row)
+{
+    songListModel->removeSongAt(row);
+    if (row < m_currentSongIndex) {
+        --m_currentSongIndex;
+    } else if (m_currentSongIndex >= songListModel->rowCount()) {
+        m_currentSongIndex = songListModel->rowCount() - 1;
+    }
+    if (musicPlayer->playbackState() != QMediaPlayer::StoppedState) {
+        preloadNextSong();
+    }
+}
+
+// Уведомления за время обрыва соединения потеряны: все, что держится в памяти, перечитывается
+void MainWindow::handleCatalogResync()
+{
+    reloadCurrentView();
+    if (!m_serverSearch) {
+        buildSearchIndex();
+    }
+}
+
+void MainWindow::showDiagnostics()
+{
+    if (!m_diagnosticsDialog) {
+        m_diagnosticsDialog = new DiagnosticsDialog(this);
+        m_diagnosticsDialog->setAttribute(Qt::WA_DeleteOnClose);
+    }
+    m_diagnosticsDialog->show();
+    m_diagnosticsDialog->raise();
+    m_diagnosticsDialog->activateWindow();
 }
 
-// НОВАЯ ФУНКЦИЯ: Воспроизводит песню по индексу из m_playbackQueue
+void MainWindow::exportMetrics()
+{
+    if (!m_queryMetricsFile.isEmpty()) {
+        QueryMetrics::instance().writePrometheusFile(m_queryMetricsFile);
+    }
+    if (!m_playbackMetricsFile.isEmpty()) {
+        PlaybackTelemetry::instance().writePrometheusFile(m_playbackMetricsFile);
+    }
+}
+
+void MainWindow::handleSongsLoaded()
+{
+    if (m_selectAfterLoad) {
+        m_selectAfterLoad = false;
+        if (m_restoreSongId != -1) {
+            m_currentSongIndex = songListModel->rowOfSongId(m_restoreSongId);
+            m_restoreSongId = -1;
+        } else if (m_currentSongIndex >= songListModel->rowCount()) {
+            m_currentSongIndex = -1;
+        }
+        if (m_currentSongIndex == -1 && songListModel->rowCount() > 0) {
+            m_currentSongIndex = 0; // Устанавливаем на первую песню
+            ui->songListView->setCurrentIndex(songListModel->index(0, 0));
+        }
+        // Обновляем состояние кнопок после загрузки
+        initializeUIState();
+    }
+
+    if (m_playNextAfterLoad) {
+        m_playNextAfterLoad = false;
+        on_nextButton_clicked();
+    } else if (musicPlayer->playbackState() != QMediaPlayer::StoppedState) {
+        preloadNextSong(); // очередь могла сдвинуться или дозагрузиться
+    }
+}
+
+// НОВАЯ ФУНКЦИЯ: Воспроизводит песню по строке songListModel
 void MainWindow::playSongAtIndex(int index)
 {
-    if (index < 0 || index >= m_playbackQueue.size()) {
+    if (index < 0 || index >= songListModel->rowCount()) {
         qDebug() << "Попытка воспроизвести песню по неверному индексу:" << index;
         musicPlayer->stop();
         m_currentSongIndex = -1; // Сбрасываем индекс, так как песня не найдена
@@ -170,12 +661,58 @@ void MainWindow::playSongAtIndex(int index)
     }
 
     m_currentSongIndex = index;
-    SongInfo song = m_playbackQueue.at(m_currentSongIndex);
+    SongInfo song = songListModel->songAt(m_currentSongIndex);
+    PlaybackTelemetry::instance().markRequest(song.filePath);
     musicPlayer->setSource(song.filePath);
     musicPlayer->play();
+    showWaveform(song.id, song.filePath);
+    historyWriter->record(-1, song.id); // входа пользователей пока нет
 
     // Выделяем текущую песню в списке
     ui->songListView->setCurrentIndex(songListModel->index(m_currentSongIndex, 0));
+    preloadNextSong();
+}
+
+// Открывает следующий трек очереди во втором плеере, чтобы переход прошел без паузы
+void MainWindow::preloadNextSong()
+{
+    const int rowCount = songListModel->rowCount();
+    int nextIndex = -1;
+    if (m_currentSongIndex >= 0 && m_currentSongIndex < rowCount) {
+        nextIndex = isRepeatEnabled ? m_currentSongIndex : m_currentSongIndex + 1;
+        if (nextIndex >= rowCount) {
+            if (songListModel->canFetchMore(QModelIndex()) || songListModel->isLoading()) {
+                // Следующая страница еще не загружена; после загрузки вызовемся снова
+                songListModel->fetchMore(QModelIndex());
+                nextIndex = -1;
+            } else {
+                nextIndex = 0; // Как и кнопка "Следующая", переходим к началу списка
+            }
+        }
+    }
+
+    if (nextIndex == -1) {
+        m_preloadedSongId = -1;
+        musicPlayer->setNextSource(QString());
+        return;
+    }
+    const SongInfo &song = songListModel->songAt(nextIndex);
+    m_preloadedSongId = song.id;
+    musicPlayer->setNextSource(song.filePath);
+}
+
+void MainWindow::handlePlayerAdvanced()
+{
+    // Плеер уже играет предзагруженный трек: обновляем очередь и выделение
+    m_currentSongIndex = songListModel->rowOfSongId(m_preloadedSongId);
+    if (m_currentSongIndex != -1) {
+        ui->songListView->setCurrentIndex(songListModel->index(m_currentSongIndex, 0));
+        showWaveform(m_preloadedSongId, songListModel->songAt(m_currentSongIndex).filePath);
+    } else {
+        showWaveform(-1, QString());
+    }
+    historyWriter->record(-1, m_preloadedSongId);
+    preloadNextSong();
 }
 
 
@@ -184,7 +721,7 @@ void MainWindow::on_playButton_clicked()
 {
     if (musicPlayer->playbackState() == QMediaPlayer::PausedState ||
         musicPlayer->playbackState() == QMediaPlayer::StoppedState) {
-        if (m_playbackQueue.isEmpty()) {
+        if (songListModel->rowCount() == 0) {
             QMessageBox::information(this, "Нет песен", "Добавьте песни в библиотеку для воспроизведения.");
             return;
         }
@@ -205,23 +742,31 @@ void MainWindow::on_pauseButton_clicked()
 
 void MainWindow::on_stopButton_clicked()
 {
+    PlaybackTelemetry::instance().cancel();
     musicPlayer->stop();
     ui->currentTrackLabel->setText("Нет трека");
     ui->currentTimeLabel->setText(formatTime(0));
     ui->totalTimeLabel->setText(formatTime(0));
     ui->progressBar->setValue(0);
     ui->progressBar->setEnabled(false);
-    updateAlbumArt(QImage()); // Очистка обложки
+    m_albumArtKey.clear();
+    updateAlbumArt(QPixmap()); // Очистка обложки
     updateUIForPlaybackState(QMediaPlayer::StoppedState); // Обновление состояния кнопок
     // m_currentSongIndex = -1; // Можно сбросить индекс, если хотим, чтобы Stop полностью "сбрасывал" воспроизведение
 }
 
 void MainWindow::on_nextButton_clicked()
 {
-    if (m_playbackQueue.isEmpty()) return;
+    if (songListModel->rowCount() == 0) return;
 
     int nextIndex = m_currentSongIndex + 1;
-    if (nextIndex >= m_playbackQueue.size()) {
+    if (nextIndex >= songListModel->rowCount()) {
+        if (songListModel->canFetchMore(QModelIndex()) || songListModel->isLoading()) {
+            // Следующая песня еще не загружена: продолжим, когда придет страница
+            m_playNextAfterLoad = true;
+            songListModel->fetchMore(QModelIndex());
+            return;
+        }
         nextIndex = 0; // Переход к началу списка
     }
     playSongAtIndex(nextIndex);
@@ -229,11 +774,11 @@ void MainWindow::on_nextButton_clicked()
 
 void MainWindow::on_previousButton_clicked()
 {
-    if (m_playbackQueue.isEmpty()) return;
+    if (songListModel->rowCount() == 0) return;
 
     int prevIndex = m_currentSongIndex - 1;
     if (prevIndex < 0) {
-        prevIndex = m_playbackQueue.size() - 1; // Переход к концу списка
+        prevIndex = songListModel->rowCount() - 1; // Переход к концу списка
     }
     playSongAtIndex(prevIndex);
 }
@@ -243,6 +788,9 @@ void MainWindow::on_repeatButton_toggled(bool checked)
 {
     isRepeatEnabled = checked;
     qDebug() << "Repeat is now:" << (isRepeatEnabled ? "ON" : "OFF");
+    if (musicPlayer->playbackState() != QMediaPlayer::StoppedState) {
+        preloadNextSong(); // при повторе следующим становится тот же трек
+    }
 }
 
 // --- Слоты для прогресс-бара и громкости ---
@@ -266,25 +814,162 @@ void MainWindow::on_addSongButton_clicked()
         return;
     }
 
-    for (const QString &filePath : files) {
-        QFileInfo fileInfo(filePath);
-        QString title = fileInfo.baseName();
-        int songId = dbManager->addSong(filePath, title, "", "", 0);
+    // Импорт идет в отдельном потоке: теги и длительность читаются из заголовков файлов,
+    // запись в БД — одной транзакцией, список обновляется один раз в конце
+    ui->addSongButton->setEnabled(false);
+    ui->statusbar->showMessage(QString("Чтение тегов: 0 из %1").arg(files.size()));
+
+    m_importer = new LibraryImporter(files, this);
+    connect(m_importer, &LibraryImporter::tagsProgressChanged, this, [this](int done, int total) {
+        ui->statusbar->showMessage(QString("Чтение тегов: %1 из %2").arg(done).arg(total));
+    });
+    connect(m_importer, &LibraryImporter::progressChanged, this, [this](int done, int total) {
+        ui->statusbar->showMessage(QString("Импорт песен: %1 из %2").arg(done).arg(total));
+    });
+    connect(m_importer, &LibraryImporter::importFinished, this, &MainWindow::handleImportFinished);
+    connect(m_importer, &QThread::finished, m_importer, &QObject::deleteLater);
+    m_importer->start();
+}
+
+void MainWindow::handleImportFinished(const QList<int> &songIds)
+{
+    ui->addSongButton->setEnabled(true);
+
+    int importedCount = 0;
+    for (int songId : songIds) {
         if (songId != -1) {
-            // После добавления песни в БД, обновляем текущий список, если это "Библиотека песен"
-            if (m_currentViewingPlaylistId == -1) {
-                // Чтобы избежать дублирования кода, просто перезагружаем все песни
-                // Это также обновит m_playbackQueue
-                loadAllSongs();
+            ++importedCount;
+        }
+    }
+    ui->statusbar->showMessage(QString("Импортировано песен: %1 из %2").arg(importedCount).arg(songIds.size()), 5000);
+    if (importedCount < songIds.size()) {
+        QMessageBox::warning(this, "Импорт", "Не все файлы удалось добавить в библиотеку.");
+    }
+
+    // При живом кэше каталога новые строки и индекс поиска обновят уведомления.
+    // Если просматривается плейлист, новые песни появятся при переходе в "Библиотеку песен"
+    if (importedCount > 0 && m_currentViewingPlaylistId == -1 && !catalogCache->isLive()) {
+        loadAllSongs();
+    }
+    if (importedCount > 0 && !m_serverSearch && !catalogCache->isLive()) {
+        QList<int> importedIds;
+        for (int songId : songIds) {
+            if (songId != -1) {
+                importedIds.append(songId);
             }
-            // Если просматривается плейлист, песня добавится в БД, но не в текущий список песен
-            // Пользователь должен будет переключиться на "Библиотека песен", чтобы увидеть ее
         }
+        dbExecutor->submit([importedIds](DatabaseManager &db) {
+            return db.loadSongsByIds(importedIds);
+        }).then(this, [this](const QList<SongInfo> &songs) {
+            updateSearchIndex(songs);
+            if (m_currentViewingPlaylistId == SearchViewId) {
+                on_searchLineEdit_textChanged(ui->searchLineEdit->text());
+            }
+        });
+    }
+    if (importedCount > 0) {
+        startLoudnessScan();
+        startCatalogNormalization();
     }
     // Обновляем состояние кнопок после добавления
     initializeUIState();
 }
 
+void MainWindow::startLoudnessScan()
+{
+    // Один анализ за раз; изменения библиотеки во время анализа подхватит следующий
+    if (m_loudnessScanner) {
+        m_loudnessScanPending = true;
+        return;
+    }
+    m_loudnessScanPending = false;
+
+    m_loudnessScanner = new LoudnessScanner(this);
+    m_loudnessScanner->setPlaybackActive(musicPlayer->playbackState() == QMediaPlayer::PlayingState);
+    connect(m_loudnessScanner, &LoudnessScanner::progressChanged, this, [this](int done, int total) {
+        if (total > 0) {
+            ui->statusbar->showMessage(QString("Анализ громкости: %1 из %2").arg(done).arg(total), 3000);
+        }
+    });
+    connect(m_loudnessScanner, &LoudnessScanner::scanFinished, this, [this](int analyzed, int failed) {
+        if (analyzed + failed > 0) {
+            ui->statusbar->showMessage(QString("Анализ громкости завершен: %1 треков, ошибок: %2").arg(analyzed).arg(failed), 5000);
+            loadLibraryReplayGain();
+            // Обзор текущего трека мог появиться только что
+            if (!ui->progressBar->hasWaveform()) {
+                showWaveform(m_waveformSongId, m_waveformFilePath);
+            }
+        }
+    });
+    connect(m_loudnessScanner, &QThread::finished, m_loudnessScanner, &QObject::deleteLater);
+    connect(m_loudnessScanner, &QThread::finished, this, [this] {
+        if (m_loudnessScanPending) {
+            m_loudnessScanner.clear();
+            startLoudnessScan();
+        }
+    });
+    m_loudnessScanner->start(QThread::IdlePriority);
+}
+
+void MainWindow::startCatalogNormalization()
+{
+    if (m_catalogNormalizer) {
+        m_catalogNormalizationPending = true;
+        return;
+    }
+    m_catalogNormalizationPending = false;
+
+    m_catalogNormalizer = new CatalogNormalizer(this);
+    connect(m_catalogNormalizer, &QThread::finished, m_catalogNormalizer, &QObject::deleteLater);
+    connect(m_catalogNormalizer, &QThread::finished, this, [this] {
+        if (m_catalogNormalizationPending) {
+            m_catalogNormalizer.clear();
+            startCatalogNormalization();
+        }
+    });
+    m_catalogNormalizer->start(QThread::LowPriority);
+}
+
+// БД готова: список библиотеки переходит со снимка на запросы к БД (загруженная часть
+// перечитывается как разница), а устаревший снимок переписывается в фоне
+void MainWindow::reconcileLibrarySnapshot()
+{
+    const qint64 snapshotRevision = m_librarySnapshot ? m_librarySnapshot->revision() : -1;
+    m_librarySnapshot.reset();
+    if (m_currentViewingPlaylistId == -1) {
+        loadAllSongs();
+    }
+
+    dbExecutor->submit([](DatabaseManager &db) {
+        return db.catalogRevision();
+    }).then(this, [this, snapshotRevision](qint64 revision) {
+        if (revision < 0 || revision == snapshotRevision || m_snapshotWriter) {
+            return;
+        }
+        m_snapshotWriter = new LibrarySnapshotWriter(this);
+        connect(m_snapshotWriter, &QThread::finished, m_snapshotWriter, &QObject::deleteLater);
+        m_snapshotWriter->start(QThread::LowPriority);
+    });
+}
+
+// Обзор формы волны открывается отображением готового файла, без декодирования;
+// если его еще нет, полоса перемотки остается обычным слайдером
+void MainWindow::showWaveform(int songId, const QString &filePath)
+{
+    m_waveformSongId = songId;
+    m_waveformFilePath = filePath;
+    ui->progressBar->setWaveform(songId != -1 ? WaveformData::open(songId, filePath) : nullptr);
+}
+
+void MainWindow::loadLibraryReplayGain()
+{
+    dbExecutor->submit([](DatabaseManager &db) {
+        return db.loadLibraryReplayGain();
+    }).then(this, [this](const QHash<QString, ReplayGainValues> &gains) {
+        musicPlayer->setLibraryReplayGain(gains);
+    });
+}
+
 void MainWindow::on_createPlaylistButton_clicked()
 {
     bool ok;
@@ -292,15 +977,16 @@ void MainWindow::on_createPlaylistButton_clicked()
                                                  "Название плейлиста:", QLineEdit::Normal,
                                                  "", &ok);
     if (ok && !playlistName.isEmpty()) {
-        int playlistId = dbManager->createPlaylist(playlistName);
-        if (playlistId != -1) {
-            QStandardItem *item = new QStandardItem(playlistName);
-            item->setData(playlistId, Qt::UserRole + 1);
-            playlistListModel->appendRow(item);
-            QMessageBox::information(this, "Плейлист создан", "Плейлист '" + playlistName + "' успешно создан.");
-        } else {
-            QMessageBox::warning(this, "Ошибка", "Плейлист с таким названием уже существует или произошла другая ошибка.");
-        }
+        dbExecutor->submit([playlistName](DatabaseManager &db) {
+            return db.createPlaylist(playlistName);
+        }).then(this, [this, playlistName](int playlistId) {
+            if (playlistId != -1) {
+                catalogCache->insertPlaylist({playlistId, playlistName});
+                QMessageBox::information(this, "Плейлист создан", "Плейлист '" + playlistName + "' успешно создан.");
+            } else {
+                QMessageBox::warning(this, "Ошибка", "Плейлист с таким названием уже существует или произошла другая ошибка.");
+            }
+        });
     }
 }
 
@@ -324,36 +1010,33 @@ void MainWindow::on_deleteSongButton_clicked()
         return;
     }
 
-    if (dbManager->deleteSong(songId)) {
-        QMessageBox::information(this, "Удаление песни", "Песня '" + songTitle + "' успешно удалена.");
-
-        // Если удаляемая песня была текущей воспроизводимой
-        if (musicPlayer->playbackState() != QMediaPlayer::StoppedState &&
-            musicPlayer->currentSource().toLocalFile() == songFilePath) {
-            on_stopButton_clicked();
-        }
+    dbExecutor->submit([songId](DatabaseManager &db) {
+        return db.deleteSong(songId);
+    }).then(this, [this, songId, songTitle, songFilePath](bool deleted) {
+        if (deleted) {
+            QFile::remove(WaveformData::sidecarPath(songId));
+            removeFromSearchIndex(songId);
+            QMessageBox::information(this, "Удаление песни", "Песня '" + songTitle + "' успешно удалена.");
+
+            // Если удаляемая песня была текущей воспроизводимой
+            if (musicPlayer->playbackState() != QMediaPlayer::StoppedState &&
+                musicPlayer->currentSource().toLocalFile() == songFilePath) {
+                on_stopButton_clicked();
+            }
 
-        // Перезагружаем текущий список, чтобы обновить songListModel и m_playbackQueue
-        if (m_currentViewingPlaylistId == -1) {
-            loadAllSongs();
-        } else {
-            // Если удаляем из плейлиста, нужно обновить список песен этого плейлиста
-            // Сначала получаем имя плейлиста, чтобы передать его в loadSongsForPlaylist
-            QString playlistName = "";
-            for (int row = 0; row < playlistListModel->rowCount(); ++row) {
-                QStandardItem *item = playlistListModel->item(row);
-                if (item->data(Qt::UserRole + 1).toInt() == m_currentViewingPlaylistId) {
-                    playlistName = item->text();
-                    break;
-                }
+            // Песня исчезает и из библиотеки, и из плейлистов (ON DELETE CASCADE),
+            // поэтому достаточно убрать одну строку модели без перезагрузки списка.
+            // Строку ищем заново: пока шел запрос, список мог измениться
+            const int removedRow = songListModel->rowOfSongId(songId);
+            if (removedRow != -1) {
+                removeSongRow(removedRow);
             }
-            loadSongsForPlaylist(m_currentViewingPlaylistId, playlistName);
+        } else {
+            QMessageBox::critical(this, "Ошибка БД", "Не удалось удалить песню из базы данных.");
         }
-    } else {
-        QMessageBox::critical(this, "Ошибка БД", "Не удалось удалить песню из базы данных.");
-    }
-    // Обновляем состояние кнопок после удаления
-    initializeUIState();
+        // Обновляем состояние кнопок после удаления
+        initializeUIState();
+    });
 }
 
 void MainWindow::on_deletePlaylistButton_clicked()
@@ -375,31 +1058,43 @@ void MainWindow::on_deletePlaylistButton_clicked()
         return;
     }
 
-    if (dbManager->deletePlaylist(playlistId)) {
-        playlistListModel->removeRow(currentIndex.row());
-        QMessageBox::information(this, "Удаление плейлиста", "Плейлист '" + playlistName + "' успешно удален.");
+    dbExecutor->submit([playlistId](DatabaseManager &db) {
+        return db.deletePlaylist(playlistId);
+    }).then(this, [this, playlistId, playlistName](bool deleted) {
+        if (deleted) {
+            catalogCache->removePlaylist(playlistId);
+            QMessageBox::information(this, "Удаление плейлиста", "Плейлист '" + playlistName + "' успешно удален.");
 
-        // Если удаленный плейлист был текущим просматриваемым, переключиться на "Все песни"
-        if (m_currentViewingPlaylistId == playlistId) {
-            loadAllSongs();
+            // Если удаленный плейлист был текущим просматриваемым, переключиться на "Все песни"
+            if (m_currentViewingPlaylistId == playlistId) {
+                loadAllSongs();
+            }
+        } else {
+            QMessageBox::critical(this, "Ошибка БД", "Не удалось удалить плейлист из базы данных.");
         }
-    } else {
-        QMessageBox::critical(this, "Ошибка БД", "Не удалось удалить плейлист из базы данных.");
-    }
-    // Обновляем состояние кнопок после удаления
-    initializeUIState();
+        // Обновляем состояние кнопок после удаления
+        initializeUIState();
+    });
 }
 
 // --- Слоты от MusicPlayer ---
 void MainWindow::handlePlayerPlaybackStateChanged(QMediaPlayer::PlaybackState state)
 {
+    PlaybackTelemetry::instance().markPlaybackState(state);
     updateUIForPlaybackState(state);
+    if (m_loudnessScanner) {
+        m_loudnessScanner->setPlaybackActive(state == QMediaPlayer::PlayingState);
+    }
 }
 
 void MainWindow::handlePlayerPositionChanged(qint64 position)
 {
+    PlaybackTelemetry::instance().markPosition(position);
     ui->progressBar->setValue(position);
     ui->currentTimeLabel->setText(formatTime(position));
+    if (m_loudnessScanner) {
+        m_loudnessScanner->reportUnderruns(musicPlayer->underrunCount());
+    }
 }
 
 void MainWindow::handlePlayerDurationChanged(qint64 duration)
@@ -411,36 +1106,58 @@ void MainWindow::handlePlayerDurationChanged(qint64 duration)
     }
 }
 
-void MainWindow::handlePlayerMetaDataChanged(const QString& title, const QString& artist, const QString& album, const QImage& albumArt)
+void MainWindow::handlePlayerMetaDataChanged(const QString& title, const QString& artist, const QString& album, const QVariant& albumArt)
 {
     updateCurrentTrackInfo(title, artist);
-    updateAlbumArt(albumArt);
+
+    // Повторная обложка (тот же альбом) берется из памяти уже уменьшенной;
+    // иначе область очищается до ответа кэша, чтобы не показывать чужую обложку
+    m_albumArtKey = albumArtCache->keyFor(albumArt);
+    updateAlbumArt(albumArtCache->pixmap(m_albumArtKey, albumArt, ui->albumArtLabel->size()));
 
     QString currentFilePath = musicPlayer->currentSource().toLocalFile();
     qint64 durationMs = musicPlayer->duration();
 
-    int songId = dbManager->addSong(currentFilePath, title, artist, album, durationMs);
-
-    if (songId != -1) {
-        qDebug() << "Метаданные песни (ID:" << songId << ") обновлены в БД: " << title << " - " << artist << " - " << album << " (" << durationMs << "ms)";
+    auto withMetadata = [title, artist, album, durationMs](SongInfo song) {
+        song.title = title;
+        song.artist = artist;
+        song.album = album;
+        if (durationMs > 0) { // 0 — длительность еще не известна плееру
+            song.durationMs = int(durationMs);
+        }
+        return song;
+    };
+
+    // Строка модели совпадает с тем, что хранится в БД: если песня в списке и ее
+    // метаданные не изменились, в базу ничего не пишем
+    const int row = songListModel->rowOfFilePath(currentFilePath);
+    const SongInfo stored = row != -1 ? songListModel->songAt(row) : SongInfo{-1, {}, {}, {}, {}, 0};
+    if (row != -1 && !songListModel->updateSong(row, withMetadata(stored))) {
+        return;
+    }
 
-        // Обновляем отображение в QListView, если метаданные изменились
-        for (int row = 0; row < songListModel->rowCount(); ++row) {
-            QStandardItem *item = songListModel->item(row);
-            if (item->data(Qt::UserRole + 2).toString() == currentFilePath) {
-                QString newDisplayText; // ИЗМЕНЕНО
-                if (!artist.isEmpty()) { // ИЗМЕНЕНО: Сначала исполнитель
-                    newDisplayText = artist + " - " + title;
-                } else {
-                    newDisplayText = title; // Если исполнителя нет, просто название
-                }
-                if (item->text() != newDisplayText) {
-                    item->setText(newDisplayText);
-                }
-                break;
+    // Запись идет в фоне, чтобы смена трека не ждала базу
+    dbExecutor->submit([currentFilePath, title, artist, album, durationMs](DatabaseManager &db) {
+        return db.addSong(currentFilePath, title, artist, album, durationMs);
+    }).then(this, [this, currentFilePath, withMetadata, stored](int songId) {
+        const int currentRow = songListModel->rowOfFilePath(currentFilePath);
+        if (songId == -1) {
+            // Запись не удалась: возвращаем строке сохраненные значения, чтобы
+            // следующее сравнение снова увидело разницу
+            if (currentRow != -1 && stored.id != -1) {
+                songListModel->updateSong(currentRow, stored);
             }
+            return;
         }
-    }
+        qDebug() << "Метаданные песни (ID:" << songId << ") сохранены в БД:" << currentFilePath;
+
+        updateSearchIndex({withMetadata(SongInfo{songId, {}, {}, {}, currentFilePath, 0})});
+
+        // Песня могла появиться в списке, пока шел запрос; уже обновленная строка не изменится
+        if (currentRow != -1) {
+            songListModel->updateSong(currentRow, withMetadata(songListModel->songAt(currentRow)));
+        }
+    });
 }
 
 void MainWindow::handlePlayerError(const QString& errorMessage)
@@ -455,7 +1172,7 @@ void MainWindow::on_songListView_doubleClicked(const QModelIndex &index)
 {
     if (!index.isValid()) return;
 
-    // Находим индекс в m_playbackQueue
+    // Строка модели совпадает с позицией в очереди воспроизведения
     m_currentSongIndex = index.row();
     playSongAtIndex(m_currentSongIndex);
 }
@@ -466,8 +1183,15 @@ void MainWindow::on_playlistListView_doubleIndexClicked(const QModelIndex &index
     int playlistId = index.data(Qt::UserRole + 1).toInt();
     QString playlistName = index.data(Qt::DisplayRole).toString();
 
+    // Плейлист показывается целиком, без фильтра поиска
+    const QSignalBlocker blocker(ui->searchLineEdit);
+    ui->searchLineEdit->clear();
+    {
+        // Переключение вкладки не должно перечитывать прежний список поверх плейлиста
+        const QSignalBlocker tabBlocker(ui->tabWidget);
+        ui->tabWidget->setCurrentIndex(0); // Переключаемся на вкладку "Библиотека песен"
+    }
     loadSongsForPlaylist(playlistId, playlistName); // Загружаем песни выбранного плейлиста
-    ui->tabWidget->setCurrentIndex(0); // Переключаемся на вкладку "Библиотека песен"
 }
 
 // НОВЫЙ СЛОТ: Обработка запроса контекстного меню для songListView
@@ -484,13 +1208,20 @@ void MainWindow::on_songListView_customContextMenuRequested(const QPoint &pos)
     QMenu contextMenu(this);
     QMenu *addToPlaylistMenu = contextMenu.addMenu("Добавить в плейлист");
 
-    QList<PlaylistInfo> playlists = dbManager->loadPlaylists();
-
+    // Плейлисты и их состав берем из кэша каталога, а не из БД; плейлисты,
+    // где песня уже есть, отмечены и недоступны
+    const QList<PlaylistInfo> playlists = catalogCache->playlists();
     if (playlists.isEmpty()) {
         addToPlaylistMenu->addAction("Нет плейлистов")->setEnabled(false);
     } else {
-        for (const PlaylistInfo& playlist : playlists) {
+        for (const PlaylistInfo &playlist : playlists) {
             QAction *action = addToPlaylistMenu->addAction(playlist.name);
+            if (catalogCache->containsSong(playlist.id, songId)) {
+                action->setCheckable(true);
+                action->setChecked(true);
+                action->setEnabled(false);
+                continue;
+            }
             // Используем лямбда-функцию для передачи songId и playlistId в слот
             connect(action, &QAction::triggered, this, [this, songId, playlistId = playlist.id]() {
                 addSongToSpecificPlaylist(songId, playlistId);
@@ -504,38 +1235,40 @@ void MainWindow::on_songListView_customContextMenuRequested(const QPoint &pos)
 // НОВЫЙ СЛОТ: Добавление песни в выбранный плейлист
 void MainWindow::addSongToSpecificPlaylist(int songId, int playlistId)
 {
-    // Для song_order можно использовать 0 или найти максимальный существующий order в плейлисте
-    // Для простоты пока используем 0, т.к. ON CONFLICT предотвратит дублирование
-    if (dbManager->addSongToPlaylist(playlistId, songId, 0)) {
-        QMessageBox::information(this, "Добавление в плейлист", "Песня успешно добавлена в плейлист.");
-
-        // Если текущий просматриваемый список песен - это тот же плейлист,
-        // то обновляем его, чтобы новая песня появилась сразу
-        if (m_currentViewingPlaylistId == playlistId) {
-            // Находим имя плейлиста по ID для обновления заголовка
-            QString playlistName = "";
-            QList<PlaylistInfo> playlists = dbManager->loadPlaylists();
-            for (const PlaylistInfo& p : playlists) {
-                if (p.id == playlistId) {
-                    playlistName = p.name;
-                    break;
-                }
+    // Песня встает в конец плейлиста; повторное добавление ничего не меняет
+    dbExecutor->submit([playlistId, songId](DatabaseManager &db) {
+        return db.addSongToPlaylist(playlistId, songId);
+    }).then(this, [this, playlistId](bool added) {
+        if (added) {
+            QMessageBox::information(this, "Добавление в плейлист", "Песня успешно добавлена в плейлист.");
+
+            // Если текущий просматриваемый список песен - это тот же плейлист,
+            // то обновляем его, чтобы новая песня появилась сразу. При живом кэше
+            // строку вставит уведомление об изменении
+            if (m_currentViewingPlaylistId == playlistId && !catalogCache->isLive()) {
+                loadSongsForPlaylist(playlistId, playlistNameById(playlistId));
             }
-            loadSongsForPlaylist(playlistId, playlistName);
+        } else {
+            QMessageBox::warning(this, "Ошибка", "Не удалось добавить песню в плейлист. Возможно, она уже там.");
         }
-    } else {
-        QMessageBox::warning(this, "Ошибка", "Не удалось добавить песню в плейлист. Возможно, она уже там.");
-    }
+    });
+}
+
+QString MainWindow::playlistNameById(int playlistId) const
+{
+    return catalogCache->playlistName(playlistId);
 }
 
 // НОВЫЙ СЛОТ: Обработка смены вкладок
 void MainWindow::on_tabWidget_currentChanged(int index)
 {
-    if (index == 0) { // Если выбрана вкладка "Библиотека песен"
-        loadAllSongs(); // Загружаем все песни
+    // Пока кэш каталога получает уведомления, показанный список уже актуален;
+    // иначе он перечитывается как разница, без сброса прокрутки
+    if (index == 0 && !catalogCache->isLive()) { // Если выбрана вкладка "Библиотека песен"
+        reloadCurrentView();
     }
-    // Если выбрана вкладка "Плейлисты" (индекс 1), ничего не делаем,
-    // так как playlistListModel уже загружен в конструкторе,
+    // Если выбрана вкладка "Плейлисты" (индекс 1), ничего не делаем:
+    // список плейлистов поддерживает кэш каталога,
     // а песни плейлиста загружаются по двойному клику.
 }
 
@@ -543,8 +1276,8 @@ void MainWindow::on_tabWidget_currentChanged(int index)
 // --- Вспомогательные методы ---
 void MainWindow::updateUIForPlaybackState(QMediaPlayer::PlaybackState state)
 {
-    bool hasSongs = !m_playbackQueue.isEmpty();
-    bool hasMultipleSongs = m_playbackQueue.size() > 1;
+    bool hasSongs = songListModel->rowCount() > 0;
+    bool hasMultipleSongs = songListModel->rowCount() > 1;
 
     switch (state) {
     case QMediaPlayer::PlayingState:
@@ -587,27 +1320,37 @@ void MainWindow::updateCurrentTrackInfo(const QString &title, const QString &art
     }
 }
 
-void MainWindow::updateAlbumArt(const QImage &image)
+void MainWindow::updateAlbumArt(const QPixmap &pixmap)
 {
-    if (image.isNull()) {
+    if (pixmap.isNull()) {
         ui->albumArtLabel->setText("No Album Art");
         ui->albumArtLabel->setPixmap(QPixmap());
     } else {
-        QPixmap pixmap = QPixmap::fromImage(image);
-        ui->albumArtLabel->setPixmap(pixmap.scaled(ui->albumArtLabel->size(),
-                                                   Qt::KeepAspectRatio,
-                                                   Qt::SmoothTransformation));
+        ui->albumArtLabel->setPixmap(pixmap);
         ui->albumArtLabel->setText("");
     }
 }
 
+void MainWindow::handleAlbumArtReady(const QString &key, const QSize &size, const QPixmap &pixmap)
+{
+    Q_UNUSED(size);
+    if (!m_albumArtKey.isEmpty() && key == m_albumArtKey) {
+        updateAlbumArt(pixmap);
+    }
+}
+
 void MainWindow::handleMediaStatusChanged(QMediaPlayer::MediaStatus status)
 {
+    // До перехода к следующему треку: он продолжает замер паузы после EndOfMedia
+    PlaybackTelemetry::instance().markMediaStatus(status);
     if (status == QMediaPlayer::EndOfMedia) {
         if (isRepeatEnabled) {
             musicPlayer->setPosition(0);
             musicPlayer->play();
             qDebug() << "Repeating current track.";
+        } else if (songListModel->rowCount() == 0) {
+            // Следующего трека нет, паузы между треками не будет
+            PlaybackTelemetry::instance().cancel();
         } else {
             on_nextButton_clicked(); // Автоматический переход к следующему треку
         }
@@ -9,10 +9,29 @@
 #include <QStandardPaths>
 #include <QTime>
 #include <QMenu>
+#include <QPointer>
+#include <QSettings>
+#include <QPromise>
+#include <QSignalBlocker>
 
 // Включаем новые заголовочные файлы
 #include "database_manager.h"
+#include "database_executor.h"
+#include "album_art_cache.h"
 #include "music_player.h"
+#include "playback_history_writer.h"
+#include "playback_telemetry.h"
+#include "library_importer.h"
+#include "loudness_scanner.h"
+#include "catalog_normalizer.h"
+#include "catalog_cache.h"
+#include "library_snapshot.h"
+#include "library_snapshot_writer.h"
+#include "search_index.h"
+#include "song_list_model.h"
+#include "diagnostics_dialog.h"
+
+#include <memory>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -36,6 +55,7 @@ private slots:
 
     void on_repeatButton_toggled(bool checked);
     void handleMediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void handlePlayerAdvanced(); // бесшовный переход на предзагруженный трек
 
     // Слоты для прогресс-бара и громкости
     void on_progressBar_sliderMoved(int position);
@@ -51,7 +71,8 @@ private slots:
     void handlePlayerPlaybackStateChanged(QMediaPlayer::PlaybackState state);
     void handlePlayerPositionChanged(qint64 position);
     void handlePlayerDurationChanged(qint64 duration);
-    void handlePlayerMetaDataChanged(const QString& title, const QString& artist, const QString& album, const QImage& albumArt);
+    void handlePlayerMetaDataChanged(const QString& title, const QString& artist, const QString& album, const QVariant& albumArt);
+    void handleAlbumArtReady(const QString &key, const QSize &size, const QPixmap &pixmap);
     void handlePlayerError(const QString& errorMessage);
 
     // Слоты для выбора песен/плейлистов
@@ -63,32 +84,96 @@ private slots:
     void addSongToSpecificPlaylist(int songId, int playlistId);
     void on_tabWidget_currentChanged(int index);
 
+    // Завершение фонового импорта песен
+    void handleImportFinished(const QList<int> &songIds);
+    // Модель песен получила ответ от БД
+    void handleSongsLoaded();
+    // Перетаскивание строк в просматриваемом плейлисте
+    void handleSongsMoveRequested(const QList<int> &songIds, int beforeSongId);
+    // Поиск по библиотеке при каждом изменении строки поиска
+    void on_searchLineEdit_textChanged(const QString &text);
+    // Уведомления об изменениях каталога (в том числе из других копий программы)
+    void handlePlaylistsChanged();
+    void handleCatalogChanged(const CatalogChanges &changes);
+    void handleCatalogResync();
+    // Скрытое окно диагностики и периодическая выгрузка метрик запросов
+    void showDiagnostics();
+    void exportMetrics();
+
 private:
     Ui::MainWindow *ui;
     MusicPlayer *musicPlayer;
-    DatabaseManager *dbManager;
-
-    QStandardItemModel *songListModel;
+    DatabaseManager *dbManager;     // Только параметры основного соединения, запросы через dbExecutor
+    DatabaseExecutor *dbExecutor;   // Все обращения к БД из GUI идут через него
+    PlaybackHistoryWriter *historyWriter; // Пишет историю прослушиваний пачками в фоне
+    AlbumArtCache *albumArtCache;
+    CatalogCache *catalogCache;     // Плейлисты и их состав; обновляется уведомлениями из БД
+    QString m_albumArtKey;          // обложка текущего трека; ответы кэша для других треков игнорируются
+
+    SongListModel *songListModel; // Является и текущей очередью воспроизведения
     QStandardItemModel *playlistListModel;
 
+    QPointer<LibraryImporter> m_importer; // Текущий фоновый импорт, если он идет
+    QPointer<LoudnessScanner> m_loudnessScanner; // Фоновый анализ громкости, если он идет
+    bool m_loudnessScanPending = false;   // библиотека изменилась во время анализа
+    QPointer<CatalogNormalizer> m_catalogNormalizer; // Связывание песен со справочниками, если идет
+    bool m_catalogNormalizationPending = false;
+    // Снимок библиотеки: список показывается из него, пока БД не готова
+    std::shared_ptr<const LibrarySnapshot> m_librarySnapshot;
+    QPointer<LibrarySnapshotWriter> m_snapshotWriter;
+    QPointer<DiagnosticsDialog> m_diagnosticsDialog;
+    QString m_queryMetricsFile; // пусто — выгрузка выключена
+    QString m_playbackMetricsFile;
+
     bool isRepeatEnabled = false;
 
     int m_currentViewingPlaylistId; // -1, если показываются все песни; ID плейлиста, если показываются песни плейлиста
 
-    // НОВЫЕ ПЕРЕМЕННЫЕ ДЛЯ ВОСПРОИЗВЕДЕНИЯ
-    QList<SongInfo> m_playbackQueue; // Текущий список песен для воспроизведения
-    int m_currentSongIndex;         // Индекс текущей песни в m_playbackQueue
+    int m_currentSongIndex;         // Строка текущей песни в songListModel
+
+    bool m_selectAfterLoad = false;   // после загрузки списка восстановить/выбрать текущую песню
+    int m_restoreSongId = -1;         // песня, которую нужно найти после перезагрузки того же списка
+    bool m_playNextAfterLoad = false; // "Следующая" ждет догрузки страницы
+    int m_preloadedSongId = -1;       // песня, открытая плеером заранее для бесшовного перехода
+    int m_waveformSongId = -1;        // песня, чей обзор формы волны показан (или ожидается)
+    QString m_waveformFilePath;
+
+    // Поиск: индекс в памяти строится в фоне после открытия БД и дальше обновляется
+    // по одной песне. При search/backend=pg_trgm запросы уходят в PostgreSQL
+    static constexpr int SearchViewId = -2;       // m_currentViewingPlaylistId для результатов поиска
+    static constexpr int SearchResultLimit = 1000;
+    std::shared_ptr<SearchIndex> m_searchIndex;   // nullptr, пока индекс строится
+    bool m_searchIndexBuilding = false;
+    bool m_searchIndexDirty = false;              // библиотека изменилась во время построения
+    bool m_serverSearch = false;
+
+    // Больше изменений за раз проще перечитать загруженную часть списка целиком
+    static constexpr int MaxIncrementalChanges = 200;
 
     void initializeUIState();
     void loadAllSongs();
     void loadSongsForPlaylist(int playlistId, const QString& playlistName);
-
-    // НОВАЯ ФУНКЦИЯ: Воспроизводит песню по индексу из m_playbackQueue
+    void showSongs(const SongListModel::PageFetcher &fetcher, int playlistId, bool reloadSameView = true);
+    void buildSearchIndex();
+    void updateSearchIndex(const QList<SongInfo> &songs);
+    void removeFromSearchIndex(int songId);
+    void reloadCurrentView();
+    void applySongPositions(const QList<int> &songIds, const QList<SongPosition> &positions, int positionLimit);
+    void removeSongRow(int row);
+    QString playlistNameById(int playlistId) const;
+
+    // НОВАЯ ФУНКЦИЯ: Воспроизводит песню по строке songListModel
     void playSongAtIndex(int index);
+    void startLoudnessScan();
+    void startCatalogNormalization();
+    void reconcileLibrarySnapshot();
+    void showWaveform(int songId, const QString &filePath);
+    void loadLibraryReplayGain();
+    void preloadNextSong();
 
     void updateUIForPlaybackState(QMediaPlayer::PlaybackState state);
     void updateCurrentTrackInfo(const QString &title, const QString &artist);
-    void updateAlbumArt(const QImage &image);
+    void updateAlbumArt(const QPixmap &pixmap); // pixmap уже уменьшен под размер области
     QString formatTime(qint64 milliseconds);
 };
 #endif // MAINWINDOW_H
@@ -1,34 +1,77 @@
 #include "music_player.h"
+#include "tag_reader.h"
+#include "pcm_playback_engine.h"
+#include "playback_telemetry.h"
 #include <QFileInfo>
-#include <QBuffer>
-#include <QImage>
+#include <QSettings>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtMath>
+#include <utility>
 
 MusicPlayer::MusicPlayer(QObject *parent)
     : QObject(parent)
 {
-    // Инициализация QMediaPlayer и QAudioOutput
+    // Инициализация QMediaPlayer и QAudioOutput. Плееров два: пока один играет,
+    // второй заранее открывает следующий трек; на границе они меняются ролями
     mediaPlayer = new QMediaPlayer(this);
     audioOutput = new QAudioOutput(this);
     mediaPlayer->setAudioOutput(audioOutput);
+    m_standbyPlayer = new QMediaPlayer(this);
+    m_standbyOutput = new QAudioOutput(this);
+    m_standbyPlayer->setAudioOutput(m_standbyOutput);
 
-    // Соединение сигналов QMediaPlayer с внутренними слотами MusicPlayer
-    connect(mediaPlayer, &QMediaPlayer::playbackStateChanged,
+    connectPlayer(mediaPlayer);
+    connectPlayer(m_standbyPlayer);
+
+    m_transitionTimer.setSingleShot(true);
+    m_transitionTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_transitionTimer, &QTimer::timeout, this, &MusicPlayer::performTransition);
+
+    m_crossfadeTimer.setInterval(10);
+    m_crossfadeTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_crossfadeTimer, &QTimer::timeout, this, &MusicPlayer::updateCrossfade);
+
+    if (QSettings().value("audio/engine").toString() == "pcm") {
+        // Собственный конвейер воспроизведения: его сигналы уходят наружу как есть
+        m_pcmEngine = new PcmPlaybackEngine(this);
+        connect(m_pcmEngine, &PcmPlaybackEngine::playbackStateChanged, this, &MusicPlayer::playbackStateChanged);
+        connect(m_pcmEngine, &PcmPlaybackEngine::positionChanged, this, &MusicPlayer::positionChanged);
+        connect(m_pcmEngine, &PcmPlaybackEngine::durationChanged, this, &MusicPlayer::durationChanged);
+        connect(m_pcmEngine, &PcmPlaybackEngine::metaDataChanged, this, &MusicPlayer::metaDataChanged);
+        connect(m_pcmEngine, &PcmPlaybackEngine::errorOccurred, this, &MusicPlayer::errorOccurred);
+        connect(m_pcmEngine, &PcmPlaybackEngine::mediaStatusChanged, this, &MusicPlayer::mediaStatusChanged);
+        connect(m_pcmEngine, &PcmPlaybackEngine::advancedToNext, this, &MusicPlayer::advancedToNext);
+    }
+
+    QSettings settings;
+    setReplayGain(DspChain::replayGainModeFromString(settings.value("audio/replayGain", "off").toString()),
+                  settings.value("audio/replayGainPreampDb", 0.0).toFloat());
+    const QStringList equalizer = settings.value("audio/equalizer").toStringList();
+    if (!equalizer.isEmpty()) {
+        setEqualizer(DspChain::parseEqualizer(equalizer));
+    }
+}
+
+void MusicPlayer::connectPlayer(QMediaPlayer *player)
+{
+    // Соединение сигналов QMediaPlayer с внутренними слотами MusicPlayer.
+    // Наружу уходят только сигналы активного плеера (проверка sender() в слотах)
+    connect(player, &QMediaPlayer::playbackStateChanged,
             this, &MusicPlayer::handlePlaybackStateChanged);
-    connect(mediaPlayer, &QMediaPlayer::positionChanged,
+    connect(player, &QMediaPlayer::positionChanged,
             this, &MusicPlayer::handlePositionChanged);
-    connect(mediaPlayer, &QMediaPlayer::durationChanged,
+    connect(player, &QMediaPlayer::durationChanged,
             this, &MusicPlayer::handleDurationChanged);
-    connect(mediaPlayer, &QMediaPlayer::metaDataChanged,
+    connect(player, &QMediaPlayer::metaDataChanged,
             this, &MusicPlayer::handleMetaDataChanged);
-
-
-    connect(mediaPlayer, &QMediaPlayer::mediaStatusChanged,
-            this, &MusicPlayer::mediaStatusChanged);
-
+    connect(player, &QMediaPlayer::mediaStatusChanged,
+            this, &MusicPlayer::handleMediaStatusChanged);
+    connect(player, &QMediaPlayer::mediaStatusChanged,
+            this, &MusicPlayer::handleStandbyStatusChanged);
 
     // Подключение сигнала errorOccurred с правильной перегрузкой
     // В Qt 6, errorOccurred имеет сигнатуру (QMediaPlayer::Error, const QString &)
-    connect(mediaPlayer, QOverload<QMediaPlayer::Error, const QString &>::of(&QMediaPlayer::errorOccurred),
+    connect(player, QOverload<QMediaPlayer::Error, const QString &>::of(&QMediaPlayer::errorOccurred),
             this, &MusicPlayer::handleError);
 }
 
@@ -43,11 +86,20 @@ MusicPlayer::~MusicPlayer()
 
 void MusicPlayer::play()
 {
+    if (m_pcmEngine) {
+        m_pcmEngine->play();
+        return;
+    }
     mediaPlayer->play();
 }
 
 void MusicPlayer::pause()
 {
+    if (m_pcmEngine) {
+        m_pcmEngine->pause();
+        return;
+    }
+    finishCrossfade(); // затухающий трек дальше не нужен
     mediaPlayer->pause();
 }
 
@@ -58,73 +110,418 @@ void MusicPlayer::repeat() {
 
 void MusicPlayer::stop()
 {
+    if (m_pcmEngine) {
+        m_pcmEngine->stop();
+        return;
+    }
+    m_transitionTimer.stop();
+    finishCrossfade();
     mediaPlayer->stop();
 }
 
 void MusicPlayer::setSource(const QString& filePath)
 {
-    // Устанавливает источник воспроизведения для плеера
+    // Устанавливает источник воспроизведения для плеера.
+    // При ручном запуске начало не обрезается: задержка кодера важна только на стыке треков
+    PlaybackTelemetry::instance().markSourceSet(filePath);
+    if (m_pcmEngine) {
+        m_pcmEngine->setSource(filePath);
+        return;
+    }
+    m_transitionTimer.stop();
+    finishCrossfade();
+    // Пока теги читаются, громкость берется из анализа библиотеки: он уже в памяти
+    m_currentTrim = GaplessTrim();
+    m_currentTrim.gain = DspChain::replayGainFactor(m_libraryReplayGain.value(filePath), m_replayGainMode, m_replayGainPreampDb);
+    audioOutput->setVolume(outputVolume(m_currentTrim));
     mediaPlayer->setSource(QUrl::fromLocalFile(filePath));
+
+    const quint64 request = ++m_currentTrimRequest;
+    requestTrim(filePath).then(this, [this, request](const GaplessTrim &trim) {
+        if (request != m_currentTrimRequest) {
+            return; // источник уже сменился
+        }
+        m_currentTrim = trim;
+        audioOutput->setVolume(outputVolume(m_currentTrim));
+        scheduleTransition();
+    });
 }
 
 void MusicPlayer::setVolume(int value) {
     // Устанавливает громкость (значение от 0 до 100)
-    audioOutput->setVolume(value / 100.0);
+    m_volume = value / 100.0f;
+    if (m_pcmEngine) {
+        m_pcmEngine->setVolume(m_volume);
+        return;
+    }
+    if (!m_crossfading) {
+        audioOutput->setVolume(outputVolume(m_currentTrim));
+        m_standbyOutput->setVolume(outputVolume(m_nextTrim));
+    }
+}
+
+void MusicPlayer::setNextSource(const QString& filePath)
+{
+    if (m_pcmEngine) {
+        m_pcmEngine->setNextSource(filePath);
+        return;
+    }
+    if (m_crossfading) {
+        m_nextFilePath = filePath; // второй плеер еще занят затуханием, загрузим после
+        return;
+    }
+    if (filePath == m_nextFilePath) {
+        return;
+    }
+    resetStandby();
+    m_nextFilePath = filePath;
+    if (filePath.isEmpty()) {
+        return;
+    }
+    // Трек открывается вторым плеером параллельно с чтением тегов; к переходу он готов,
+    // когда есть и то и другое
+    m_standbyPlayer->setSource(QUrl::fromLocalFile(filePath));
+    const quint64 request = ++m_nextTrimRequest;
+    requestTrim(filePath).then(this, [this, request](const GaplessTrim &trim) {
+        if (request != m_nextTrimRequest) {
+            return; // предзагрузка отменена или заменена
+        }
+        m_nextTrim = trim;
+        m_nextTrimReady = true;
+        completeStandby();
+    });
+}
+
+QString MusicPlayer::nextSource() const
+{
+    if (m_pcmEngine) {
+        return m_pcmEngine->nextSource();
+    }
+    return m_nextFilePath;
+}
+
+void MusicPlayer::setCrossfadeDuration(int milliseconds)
+{
+    m_crossfadeMs = qMax(0, milliseconds);
+    scheduleTransition();
+}
+
+int MusicPlayer::crossfadeDuration() const
+{
+    return m_crossfadeMs;
+}
+
+double MusicPlayer::lastTransitionLatency() const
+{
+    return m_lastTransitionLatencyMs;
+}
+
+bool MusicPlayer::usesPcmEngine() const
+{
+    return m_pcmEngine != nullptr;
+}
+
+void MusicPlayer::setReplayGain(ReplayGainMode mode, float preampDb)
+{
+    // Применяется к трекам, открытым после вызова
+    m_replayGainMode = mode;
+    m_replayGainPreampDb = preampDb;
+    if (m_pcmEngine) {
+        m_pcmEngine->setReplayGain(mode, preampDb);
+    }
+}
+
+void MusicPlayer::setLibraryReplayGain(const QHash<QString, ReplayGainValues> &gains)
+{
+    m_libraryReplayGain = gains;
+    if (m_pcmEngine) {
+        m_pcmEngine->setLibraryReplayGain(gains);
+    }
+}
+
+void MusicPlayer::setEqualizer(const QList<EqBand> &bands)
+{
+    if (!m_pcmEngine) {
+        qDebug() << "Эквалайзер доступен только с движком audio/engine=pcm";
+        return;
+    }
+    m_pcmEngine->setEqualizer(bands);
+}
+
+quint64 MusicPlayer::underrunCount() const
+{
+    return m_pcmEngine ? m_pcmEngine->underrunCount() : 0;
+}
+
+qint64 MusicPlayer::bufferedMs() const
+{
+    return m_pcmEngine ? m_pcmEngine->bufferedMs() : 0;
 }
 
 void MusicPlayer::setPosition(qint64 position)
 {
     // Устанавливает текущую позицию воспроизведения (в миллисекундах)
+    if (m_pcmEngine) {
+        m_pcmEngine->setPosition(position);
+        return;
+    }
     mediaPlayer->setPosition(position);
 }
 
 QMediaPlayer::PlaybackState MusicPlayer::playbackState() const
 {
     // Возвращает текущее состояние воспроизведения плеера
+    if (m_pcmEngine) {
+        return m_pcmEngine->playbackState();
+    }
     return mediaPlayer->playbackState();
 }
 
 qint64 MusicPlayer::position() const
 {
     // Возвращает текущую позицию воспроизведения (в миллисекундах)
+    if (m_pcmEngine) {
+        return m_pcmEngine->position();
+    }
     return mediaPlayer->position();
 }
 
 qint64 MusicPlayer::duration() const
 {
     // Возвращает общую длительность текущего медиафайла (в миллисекундах)
+    if (m_pcmEngine) {
+        return m_pcmEngine->duration();
+    }
     return mediaPlayer->duration();
 }
 
 QUrl MusicPlayer::currentSource() const
 {
     // Возвращает URL текущего источника воспроизведения
+    if (m_pcmEngine) {
+        return m_pcmEngine->currentSource();
+    }
     return mediaPlayer->source();
 }
 
+// --- Бесшовный переход ---
+
+QFuture<MusicPlayer::GaplessTrim> MusicPlayer::requestTrim(const QString& filePath) const
+{
+    // Настройки копируются сейчас: в пуле потоков к полям MusicPlayer не обращаемся
+    return QtConcurrent::run(&MusicPlayer::readTrim, filePath, m_libraryReplayGain.value(filePath),
+                             m_replayGainMode, m_replayGainPreampDb);
+}
+
+MusicPlayer::GaplessTrim MusicPlayer::readTrim(const QString& filePath, const ReplayGainValues &libraryGains,
+                                               ReplayGainMode mode, float preampDb)
+{
+    // Читаются только заголовки отображенного в память файла, это быстрее открытия медиа
+    GaplessTrim trim;
+    const TrackTags tags = TagReader::read(filePath);
+    if (tags.sampleRate > 0) {
+        trim.startMs = (qint64(tags.startPaddingSamples) * 1000 + tags.sampleRate / 2) / tags.sampleRate;
+        trim.endMs = (qint64(tags.endPaddingSamples) * 1000 + tags.sampleRate / 2) / tags.sampleRate;
+    }
+    ReplayGainValues gains = DspChain::replayGainValues(tags);
+    if (!gains.hasTrackGain && !gains.hasAlbumGain) {
+        gains = libraryGains;
+    }
+    trim.gain = DspChain::replayGainFactor(gains, mode, preampDb);
+    return trim;
+}
+
+float MusicPlayer::outputVolume(const GaplessTrim &trim) const
+{
+    // QAudioOutput не усиливает выше 1.0, поэтому ReplayGain здесь только ослабляет
+    return m_volume * qMin(1.0f, trim.gain);
+}
+
+void MusicPlayer::handleStandbyStatusChanged(QMediaPlayer::MediaStatus status)
+{
+    if (sender() != m_standbyPlayer || m_crossfading || m_nextLoaded || m_nextFilePath.isEmpty()) {
+        return;
+    }
+    if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia) {
+        m_nextLoaded = true;
+        completeStandby();
+    }
+}
+
+void MusicPlayer::completeStandby()
+{
+    if (!m_nextLoaded || !m_nextTrimReady || m_nextReady || m_crossfading) {
+        return;
+    }
+    // Пауза на начале записи: декодер открыт и буферы заполнены, старт мгновенный
+    m_standbyOutput->setVolume(outputVolume(m_nextTrim));
+    m_standbyPlayer->pause();
+    m_standbyPlayer->setPosition(m_nextTrim.startMs);
+    m_nextReady = true;
+    scheduleTransition();
+}
+
+void MusicPlayer::scheduleTransition()
+{
+    if (!m_nextReady || m_crossfading || mediaPlayer->playbackState() != QMediaPlayer::PlayingState) {
+        m_transitionTimer.stop();
+        return;
+    }
+    const qint64 duration = mediaPlayer->duration();
+    if (duration <= 0) {
+        return;
+    }
+
+    // Граница — конец записи без добивки кодера; при кроссфейде следующий трек стартует раньше
+    const qint64 switchAt = duration - m_currentTrim.endMs - m_crossfadeMs;
+    const qint64 remaining = switchAt - mediaPlayer->position();
+    if (remaining <= 0) {
+        performTransition();
+    } else if (remaining <= 1000) {
+        // Таймер взводится на последней секунде и уточняется при каждом обновлении позиции
+        m_transitionTimer.start(int(remaining));
+    }
+}
+
+void MusicPlayer::performTransition()
+{
+    if (!m_nextReady) {
+        return;
+    }
+    m_transitionTimer.stop();
+
+    m_standbyOutput->setVolume(m_crossfadeMs > 0 ? 0.0f : outputVolume(m_nextTrim));
+    m_standbyPlayer->play();
+    m_transitionClock.start();
+    m_measuringTransition = true;
+
+    // Меняем плееры ролями: прежний становится резервным
+    std::swap(mediaPlayer, m_standbyPlayer);
+    std::swap(audioOutput, m_standbyOutput);
+    m_fadingTrim = m_currentTrim;
+    m_currentTrim = m_nextTrim;
+    m_nextTrim = GaplessTrim();
+    m_nextReady = false;
+    m_nextLoaded = false;
+    m_nextTrimReady = false;
+    m_nextFilePath.clear();
+    ++m_currentTrimRequest; // теги прежнего трека, если еще читаются, уже не нужны
+
+    if (m_crossfadeMs > 0) {
+        m_crossfading = true;
+        m_crossfadeClock.start();
+        m_crossfadeTimer.start();
+    } else {
+        resetStandby();
+    }
+
+    emit advancedToNext();
+    // Сигналы нового трека во время предзагрузки не уходили наружу, сообщаем их сейчас
+    emit durationChanged(mediaPlayer->duration());
+    emitMetaData();
+    emit playbackStateChanged(mediaPlayer->playbackState());
+}
+
+void MusicPlayer::updateCrossfade()
+{
+    const double t = qMin(1.0, m_crossfadeClock.elapsed() / double(qMax(1, m_crossfadeMs)));
+    // Равномощный кроссфейд: без провала громкости посередине перехода
+    audioOutput->setVolume(outputVolume(m_currentTrim) * float(qSin(t * M_PI_2)));
+    m_standbyOutput->setVolume(outputVolume(m_fadingTrim) * float(qCos(t * M_PI_2)));
+    if (t >= 1.0) {
+        finishCrossfade();
+    }
+}
+
+void MusicPlayer::finishCrossfade()
+{
+    if (!m_crossfading) {
+        return;
+    }
+    m_crossfadeTimer.stop();
+    m_crossfading = false;
+    audioOutput->setVolume(outputVolume(m_currentTrim));
+
+    const QString pendingNext = m_nextFilePath;
+    m_nextFilePath.clear();
+    resetStandby();
+    if (!pendingNext.isEmpty()) {
+        setNextSource(pendingNext);
+    }
+}
+
+void MusicPlayer::resetStandby()
+{
+    m_nextReady = false;
+    m_nextLoaded = false;
+    m_nextTrimReady = false;
+    m_nextTrim = GaplessTrim();
+    ++m_nextTrimRequest;
+    m_nextFilePath.clear();
+    m_standbyPlayer->stop();
+    m_standbyPlayer->setSource(QUrl());
+    m_standbyOutput->setVolume(m_volume);
+}
+
 // --- Обработчики сигналов от QMediaPlayer ---
 
 void MusicPlayer::handlePlaybackStateChanged(QMediaPlayer::PlaybackState state)
 {
+    if (sender() != mediaPlayer) {
+        return;
+    }
     // Переизлучает сигнал об изменении состояния воспроизведения
     emit playbackStateChanged(state);
+    scheduleTransition();
 }
 
 void MusicPlayer::handlePositionChanged(qint64 position)
 {
+    if (sender() != mediaPlayer) {
+        return;
+    }
+    if (m_measuringTransition && position > m_currentTrim.startMs) {
+        // Сколько прошло от переключения до старта звука, за вычетом уже проигранного
+        m_measuringTransition = false;
+        m_lastTransitionLatencyMs = qMax(0.0, m_transitionClock.nsecsElapsed() / 1e6 - double(position - m_currentTrim.startMs));
+        qDebug() << "Переход между треками, задержка старта (мс):" << m_lastTransitionLatencyMs;
+        PlaybackTelemetry::instance().recordGaplessSwitch(mediaPlayer->source().toLocalFile(), m_lastTransitionLatencyMs);
+    }
     // Переизлучает сигнал об изменении текущей позиции
     emit positionChanged(position);
+    scheduleTransition();
 }
 
 void MusicPlayer::handleDurationChanged(qint64 duration)
 {
+    if (sender() != mediaPlayer) {
+        return;
+    }
     // Переизлучает сигнал об изменении длительности
     emit durationChanged(duration);
+    scheduleTransition();
+}
+
+void MusicPlayer::handleMediaStatusChanged(QMediaPlayer::MediaStatus status)
+{
+    if (sender() != mediaPlayer) {
+        return;
+    }
+    emit mediaStatusChanged(status);
 }
 
 void MusicPlayer::handleMetaDataChanged()
 {
-    // Извлекает метаданные трека и обложку альбома, затем переизлучает сигнал
+    if (sender() != mediaPlayer) {
+        return;
+    }
+    emitMetaData();
+}
+
+void MusicPlayer::emitMetaData()
+{
+    // Извлекает метаданные трека и обложку альбома, затем переизлучает сигнал.
+    // Обложка не декодируется здесь: это делает кэш обложек, и только при промахе
     QString title = mediaPlayer->metaData().stringValue(QMediaMetaData::Title);
     QString artist = mediaPlayer->metaData().stringValue(QMediaMetaData::AlbumArtist);
     if (artist.isEmpty()) {
@@ -138,35 +535,23 @@ void MusicPlayer::handleMetaDataChanged()
         title = fileInfo.baseName();
     }
 
-    QImage coverImage;
     // Используем ThumbnailImage для обложки альбома (наиболее распространенное)
     QVariant imageData = mediaPlayer->metaData().value(QMediaMetaData::ThumbnailImage);
-
-    if (imageData.isValid()) {
-        if (imageData.canConvert<QImage>()) {
-            coverImage = imageData.value<QImage>();
-        } else if (imageData.canConvert<QByteArray>()) {
-            QByteArray byteArray = imageData.toByteArray();
-            QBuffer buffer(&byteArray); // Используем QBuffer для чтения QByteArray как файла
-            buffer.open(QIODevice::ReadOnly);
-            // Пробуем загрузить как JPG, затем как PNG
-            if (!coverImage.load(&buffer, "JPG")) {
-                buffer.seek(0); // Сброс позиции буфера
-                if (!coverImage.load(&buffer, "PNG")) {
-                    // Можно добавить обработку других форматов или сообщение об ошибке
-                    qDebug() << "Не удалось загрузить обложку из QByteArray как JPG или PNG.";
-                }
-            }
-            buffer.close();
-        }
-    }
-    emit metaDataChanged(title, artist, album, coverImage); // ИЗМЕНЕНО: передаем album
+    emit metaDataChanged(title, artist, album, imageData);
 }
 
 void MusicPlayer::handleError(QMediaPlayer::Error error, const QString &errorString)
 {
     // Обрабатывает ошибки QMediaPlayer и переизлучает их
     Q_UNUSED(error); // Если сам enum ошибки не используется, можно его игнорировать
+    if (sender() == m_standbyPlayer) {
+        // Следующий трек не открылся: переход пройдет обычным путем через EndOfMedia
+        qDebug() << "Не удалось предзагрузить следующий трек:" << errorString;
+        if (!m_crossfading) {
+            resetStandby();
+        }
+        return;
+    }
     qDebug() << "Player error occurred: " << errorString;
     emit errorOccurred(errorString);
 }
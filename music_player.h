@@ -10,6 +10,13 @@
 #include <QImage>
 #include <QBuffer>
 #include <QDebug>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QFuture>
+#include "dsp_chain.h"
+
+class PcmPlaybackEngine;
 
 class MusicPlayer : public QObject
 {
@@ -28,6 +35,33 @@ public:
     void setVolume(int value);
     void setPosition(qint64 position);
 
+    // Бесшовное воспроизведение: следующий трек заранее открывается и буферизуется
+    // во втором плеере и запускается ровно на границе текущего (с учетом задержки
+    // и добивки кодера). Пустой путь отменяет предзагрузку.
+    void setNextSource(const QString& filePath);
+    QString nextSource() const;
+    // Длительность наложения треков при переходе (0 — без кроссфейда)
+    void setCrossfadeDuration(int milliseconds);
+    int crossfadeDuration() const;
+    // Измеренная задержка старта следующего трека на последнем переходе (мс, -1 — не было)
+    double lastTransitionLatency() const;
+
+    // Движок выбирается настройкой audio/engine: "pcm" — собственный конвейер
+    // декодер -> кольцевой буфер -> QAudioSink, иначе QMediaPlayer.
+    // Для движка QMediaPlayer счетчики буферизации всегда нулевые.
+    bool usesPcmEngine() const;
+
+    // ReplayGain из тегов (настройки audio/replayGain и audio/replayGainPreampDb).
+    // Движок QMediaPlayer может только ослаблять: усиление выше 1.0 отбрасывается
+    void setReplayGain(ReplayGainMode mode, float preampDb = 0.0f);
+    // Поправки из анализа громкости библиотеки по пути к файлу; используются для
+    // файлов без тегов ReplayGain
+    void setLibraryReplayGain(const QHash<QString, ReplayGainValues> &gains);
+    // Эквалайзер (настройка audio/equalizer); доступен только движку pcm
+    void setEqualizer(const QList<EqBand> &bands);
+    quint64 underrunCount() const;
+    qint64 bufferedMs() const;
+
     QMediaPlayer::PlaybackState playbackState() const;
     qint64 position() const;
     qint64 duration() const;
@@ -37,9 +71,13 @@ signals:
     void playbackStateChanged(QMediaPlayer::PlaybackState state);
     void positionChanged(qint64 position);
     void durationChanged(qint64 duration);
-    void metaDataChanged(const QString& title, const QString& artist, const QString& album, const QImage& albumArt); // ИЗМЕНЕНО: добавлено album
+    // albumArt — обложка как есть из метаданных (QImage или закодированные байты);
+    // декодирование и масштабирование выполняет AlbumArtCache вне GUI-потока
+    void metaDataChanged(const QString& title, const QString& artist, const QString& album, const QVariant& albumArt);
     void errorOccurred(const QString& errorMessage); // This signal takes a QString
     void mediaStatusChanged(QMediaPlayer::MediaStatus status);
+    // Плеер сам перешел на трек из setNextSource(); EndOfMedia для прежнего трека не придет
+    void advancedToNext();
 
 private slots:
     void handlePlaybackStateChanged(QMediaPlayer::PlaybackState state);
@@ -48,10 +86,62 @@ private slots:
     void handleMetaDataChanged();
     // THIS IS THE CRITICAL LINE:
     void handleError(QMediaPlayer::Error error, const QString &errorString); // <-- MUST BE const QString &
+    void handleMediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void handleStandbyStatusChanged(QMediaPlayer::MediaStatus status);
+    void performTransition();
+    void updateCrossfade();
 
 private:
-    QMediaPlayer *mediaPlayer;
+    // Начало и конец трека, которые не относятся к записи (задержка кодера и добивка), в мс,
+    // и поправка громкости ReplayGain
+    struct GaplessTrim {
+        qint64 startMs = 0;
+        qint64 endMs = 0;
+        float gain = 1.0f;
+    };
+    // Теги читаются в пуле потоков: даже чтение заголовков может ждать диска
+    QFuture<GaplessTrim> requestTrim(const QString& filePath) const;
+    static GaplessTrim readTrim(const QString& filePath, const ReplayGainValues &libraryGains,
+                                ReplayGainMode mode, float preampDb);
+    float outputVolume(const GaplessTrim &trim) const;
+
+    void connectPlayer(QMediaPlayer *player);
+    void emitMetaData();
+    void scheduleTransition();
+    void finishCrossfade();
+    void resetStandby();
+    void completeStandby();
+
+    PcmPlaybackEngine *m_pcmEngine = nullptr; // если задан, все вызовы уходят в него
+
+    QMediaPlayer *mediaPlayer;       // Активный плеер: его сигналы уходят наружу
     QAudioOutput *audioOutput;
+    QMediaPlayer *m_standbyPlayer;   // Предзагруженный следующий трек (или затухающий прежний)
+    QAudioOutput *m_standbyOutput;
+
+    QString m_nextFilePath;
+    GaplessTrim m_currentTrim;
+    GaplessTrim m_nextTrim;
+    GaplessTrim m_fadingTrim;        // прежний трек во время кроссфейда
+    bool m_nextReady = false;        // следующий трек открыт и стоит на своем начале
+    bool m_nextLoaded = false;       // второй плеер открыл следующий трек
+    bool m_nextTrimReady = false;    // теги следующего трека прочитаны
+    quint64 m_currentTrimRequest = 0; // номер последнего запроса тегов; устаревшие ответы отбрасываются
+    quint64 m_nextTrimRequest = 0;
+
+    QTimer m_transitionTimer;        // точный таймер до границы трека
+    QTimer m_crossfadeTimer;
+    QElapsedTimer m_crossfadeClock;
+    bool m_crossfading = false;
+    int m_crossfadeMs = 0;
+    float m_volume = 1.0f;
+    ReplayGainMode m_replayGainMode = ReplayGainMode::Off;
+    float m_replayGainPreampDb = 0.0f;
+    QHash<QString, ReplayGainValues> m_libraryReplayGain;
+
+    QElapsedTimer m_transitionClock; // от переключения до первой позиции нового трека
+    bool m_measuringTransition = false;
+    double m_lastTransitionLatencyMs = -1.0;
 };
 
 #endif // MUSIC_PLAYER_H
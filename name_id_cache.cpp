@@ -0,0 +1,55 @@
+#include "name_id_cache.h"
+
+#include <memory>
+
+NameIdCache &NameIdCache::forDatabase(const QString &databaseKey)
+{
+    static QMutex mutex;
+    static QHash<QString, std::shared_ptr<NameIdCache>> caches;
+    QMutexLocker locker(&mutex);
+    std::shared_ptr<NameIdCache> &cache = caches[databaseKey];
+    if (!cache) {
+        cache.reset(new NameIdCache);
+    }
+    return *cache;
+}
+
+QString NameIdCache::albumKey(const QString &title, int artistId)
+{
+    // \x1f не встречается в тегах, поэтому ключи разных пар не совпадут
+    return title + QChar(0x1f) + QString::number(artistId > 0 ? artistId : 0);
+}
+
+int NameIdCache::value(Dictionary dictionary, const QString &key) const
+{
+    QReadLocker locker(&m_lock);
+    return m_ids[dictionary].value(key, -1);
+}
+
+void NameIdCache::insert(Dictionary dictionary, const QString &key, int id)
+{
+    if (id <= 0) {
+        return;
+    }
+    QWriteLocker locker(&m_lock);
+    m_ids[dictionary].insert(key, id);
+}
+
+void NameIdCache::insert(Dictionary dictionary, const QHash<QString, int> &ids)
+{
+    QWriteLocker locker(&m_lock);
+    QHash<QString, int> &target = m_ids[dictionary];
+    for (auto it = ids.constBegin(); it != ids.constEnd(); ++it) {
+        if (it.value() > 0) {
+            target.insert(it.key(), it.value());
+        }
+    }
+}
+
+void NameIdCache::clear()
+{
+    QWriteLocker locker(&m_lock);
+    for (QHash<QString, int> &ids : m_ids) {
+        ids.clear();
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef NAME_ID_CACHE_H
+#define NAME_ID_CACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QString>
+
+// Словарь имя -> ID справочников Artists, Albums и Genres одной базы, общий для всех
+// ее соединений в процессе (GUI-исполнитель, импорт, фоновые задания). Строки справочников
+// не удаляются и не меняют ID, поэтому однажды найденное значение остается верным.
+// Заполняется только после фиксации записи: ID из откатившейся транзакции сюда не попадают
+class NameIdCache
+{
+public:
+    enum Dictionary {
+        Artists,
+        Albums,
+        Genres,
+        DictionaryCount
+    };
+
+    // Кэш базы с этим ключом (драйвер, сервер и имя базы или путь к файлу): ID разных
+    // баз одного процесса не смешиваются. Кэши живут до завершения процесса
+    static NameIdCache &forDatabase(const QString &databaseKey);
+
+    // Ключ альбома: название и исполнитель (artistId <= 0 — без исполнителя)
+    static QString albumKey(const QString &title, int artistId);
+
+    int value(Dictionary dictionary, const QString &key) const; // -1, если нет в кэше
+    void insert(Dictionary dictionary, const QString &key, int id);
+    void insert(Dictionary dictionary, const QHash<QString, int> &ids);
+    void clear();
+
+private:
+    NameIdCache() = default;
+
+    mutable QReadWriteLock m_lock;
+    QHash<QString, int> m_ids[DictionaryCount];
+};
+
+#endif // NAME_ID_CACHE_H
@@ -0,0 +1,784 @@
+#include "pcm_playback_engine.h"
+#include "tag_reader.h"
+
+#include <QAudioBuffer>
+#include <QAudioDevice>
+#include <QDebug>
+#include <QFileInfo>
+#include <QMediaDevices>
+#include <QSettings>
+#include <cstring>
+
+// --- PcmRingDevice ---
+
+PcmRingDevice::PcmRingDevice(QObject *parent)
+    : QIODevice(parent)
+{
+}
+
+void PcmRingDevice::setRing(PcmRingBuffer *ring, int bytesPerFrame)
+{
+    m_ring = ring;
+    m_bytesPerFrame = qMax(1, bytesPerFrame);
+}
+
+void PcmRingDevice::setDsp(DspChain *dsp)
+{
+    m_dsp = dsp;
+}
+
+void PcmRingDevice::resetCounters()
+{
+    m_endOfStream.store(false, std::memory_order_relaxed);
+    m_underruns.store(0, std::memory_order_relaxed);
+    m_consumedBytes.store(0, std::memory_order_relaxed);
+    m_silenceBytes.store(0, std::memory_order_relaxed);
+}
+
+void PcmRingDevice::setEndOfStream(bool endOfStream)
+{
+    m_endOfStream.store(endOfStream, std::memory_order_relaxed);
+}
+
+quint64 PcmRingDevice::underruns() const
+{
+    return m_underruns.load(std::memory_order_relaxed);
+}
+
+qint64 PcmRingDevice::consumedBytes() const
+{
+    return m_consumedBytes.load(std::memory_order_acquire);
+}
+
+qint64 PcmRingDevice::silenceBytes() const
+{
+    return m_silenceBytes.load(std::memory_order_acquire);
+}
+
+bool PcmRingDevice::isSequential() const
+{
+    return true;
+}
+
+qint64 PcmRingDevice::readData(char *data, qint64 maxlen)
+{
+    // Отдаем только целые кадры: иначе после вставки тишины каналы сдвинутся
+    const qint64 length = maxlen - maxlen % m_bytesPerFrame;
+    if (length <= 0) {
+        return 0;
+    }
+
+    qint64 got = 0;
+    if (m_ring) {
+        qint64 available = m_ring->readAvailable();
+        available -= available % m_bytesPerFrame;
+        got = m_ring->read(data, qMin(length, available));
+    }
+    if (m_dsp && got > 0) {
+        m_dsp->process(data, got / m_bytesPerFrame);
+    }
+    if (got < length) {
+        // Аудиосистема не должна останавливаться: недостающее заполняется тишиной.
+        // После конца потока это штатный хвост, а не потеря данных
+        std::memset(data + got, 0, size_t(length - got));
+        m_silenceBytes.fetch_add(length - got, std::memory_order_release);
+        if (!m_endOfStream.load(std::memory_order_relaxed)) {
+            m_underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    m_consumedBytes.fetch_add(got, std::memory_order_release);
+    return length;
+}
+
+qint64 PcmRingDevice::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return -1;
+}
+
+// --- PcmDecodeWorker ---
+
+PcmDecodeWorker::PcmDecodeWorker(const QAudioFormat &format)
+    : m_format(format)
+    , m_bytesPerFrame(qMax(1, format.bytesPerFrame()))
+{
+}
+
+void PcmDecodeWorker::start(int session, PcmRingBuffer *ring, const PcmTrack &track, qint64 primeBytes, qint64 stagingBytes)
+{
+    closeDecoder();
+    if (!m_pumpTimer) {
+        // Создается здесь, а не в конструкторе, чтобы принадлежать потоку декодера
+        m_pumpTimer = new QTimer(this);
+        m_pumpTimer->setSingleShot(true);
+        m_pumpTimer->setInterval(5);
+        connect(m_pumpTimer, &QTimer::timeout, this, &PcmDecodeWorker::pump);
+    }
+
+    m_session = session;
+    m_ring = ring;
+    m_pending.clear();
+    m_pending.reserve(stagingBytes);
+    m_pendingOffset = 0;
+    m_stagingBytes = stagingBytes;
+    m_streamBytes = 0;
+    m_primeBytes = qMin(primeBytes, ring->capacity() / 2);
+    m_primed = false;
+    m_draining = false;
+    m_next = PcmTrack();
+    openDecoder(track);
+}
+
+void PcmDecodeWorker::setNext(int afterTrackId, const PcmTrack &next)
+{
+    if (afterTrackId != m_trackId) {
+        emit nextRejected(m_session);
+        return;
+    }
+    m_next = next;
+    if (!m_decoding && m_ring && next.id != 0) {
+        // Текущий трек уже декодирован до конца: продолжаем поток следующим
+        m_next = PcmTrack();
+        m_draining = false;
+        emit trackBoundary(m_session, m_streamBytes / m_bytesPerFrame, next.id);
+        openDecoder(next);
+    }
+}
+
+void PcmDecodeWorker::stop()
+{
+    closeDecoder();
+    m_pending.clear();
+    m_pendingOffset = 0;
+    m_ring = nullptr;
+    m_trackId = 0;
+    m_next = PcmTrack();
+    m_draining = false;
+}
+
+void PcmDecodeWorker::openDecoder(const PcmTrack &track)
+{
+    if (!m_decoder) {
+        m_decoder = new QAudioDecoder(this);
+        // Декодер сам приводит поток к формату устройства вывода
+        m_decoder->setAudioFormat(m_format);
+        connect(m_decoder, &QAudioDecoder::bufferReady, this, &PcmDecodeWorker::handleBufferReady);
+        connect(m_decoder, &QAudioDecoder::finished, this, &PcmDecodeWorker::handleDecoderFinished);
+        connect(m_decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error),
+                this, &PcmDecodeWorker::handleDecoderError);
+        connect(m_decoder, &QAudioDecoder::durationChanged, this, [this](qint64 duration) {
+            if (duration > 0) {
+                emit durationKnown(m_session, m_trackId, duration);
+            }
+        });
+    }
+
+    m_decoder->stop();
+    m_trackId = track.id;
+    m_skipBytes = track.skipFrames * m_bytesPerFrame;
+    m_holdBackBytes = track.endPaddingFrames * m_bytesPerFrame;
+    m_gain = track.gain;
+    m_decoding = true;
+    m_decoder->setSource(QUrl::fromLocalFile(track.filePath));
+    m_decoder->start();
+}
+
+void PcmDecodeWorker::closeDecoder()
+{
+    if (m_decoder) {
+        m_decoder->stop();
+    }
+    if (m_pumpTimer) {
+        m_pumpTimer->stop();
+    }
+    m_decoding = false;
+}
+
+void PcmDecodeWorker::handleBufferReady()
+{
+    // Буфер забирает pump(), когда в промежуточном буфере есть место
+    if (m_decoding) {
+        pump();
+    }
+}
+
+void PcmDecodeWorker::takeBuffer()
+{
+    const QAudioBuffer buffer = m_decoder->read();
+    if (!buffer.isValid()) {
+        return;
+    }
+
+    const char *data = buffer.constData<char>();
+    qint64 length = buffer.byteCount();
+    if (m_skipBytes > 0) {
+        // Задержка кодера (и позиция перемотки) отбрасываются до попадания в буфер
+        const qint64 skip = qMin(m_skipBytes, length);
+        data += skip;
+        length -= skip;
+        m_skipBytes -= skip;
+    }
+    if (length > 0) {
+        // Записанное в кольцо начало сдвигается перед добавлением; сдвигать приходится
+        // не больше размера промежуточного буфера
+        if (m_pendingOffset > 0) {
+            m_pending.remove(0, m_pendingOffset);
+            m_pendingOffset = 0;
+        }
+        const qsizetype appendedAt = m_pending.size();
+        m_pending.append(data, length);
+        // ReplayGain постоянен в пределах трека, поэтому применяется здесь, вне аудиопотока
+        DspChain::applyGain(m_pending.data() + appendedAt, length / m_bytesPerFrame, m_format, m_gain);
+        m_streamBytes += length;
+    }
+}
+
+void PcmDecodeWorker::handleDecoderFinished()
+{
+    if (!m_decoding) {
+        return;
+    }
+    // Конец потока может прийти раньше, чем прочитаны последние буферы
+    while (m_decoder->bufferAvailable()) {
+        takeBuffer();
+    }
+    m_decoding = false;
+
+    // Удерживаемый хвост теперь известно что является добивкой — выбрасываем его
+    const qint64 cut = qMin(m_holdBackBytes, qint64(m_pending.size() - m_pendingOffset));
+    m_pending.chop(cut);
+    m_streamBytes -= cut;
+    m_holdBackBytes = 0;
+
+    if (m_next.id != 0) {
+        const PcmTrack next = m_next;
+        m_next = PcmTrack();
+        emit trackBoundary(m_session, m_streamBytes / m_bytesPerFrame, next.id);
+        openDecoder(next);
+    } else {
+        m_draining = true;
+    }
+    pump();
+}
+
+void PcmDecodeWorker::handleDecoderError(QAudioDecoder::Error error)
+{
+    Q_UNUSED(error);
+    qDebug() << "Ошибка декодирования:" << m_decoder->errorString();
+    emit errorOccurred(m_session, m_decoder->errorString());
+    // Что успели декодировать — доигрываем, дальше переходим к следующему треку
+    handleDecoderFinished();
+}
+
+// Переносит в кольцо все, что не удерживается как возможная добивка; возвращает остаток
+qint64 PcmDecodeWorker::pushPending()
+{
+    const qint64 heldBack = m_decoding ? m_holdBackBytes : 0;
+    qint64 pushable = m_pending.size() - m_pendingOffset - heldBack;
+    if (pushable > 0) {
+        const qsizetype written = m_ring->write(m_pending.constData() + m_pendingOffset, pushable);
+        m_pendingOffset += written;
+        pushable -= written;
+    }
+    if (m_pendingOffset == m_pending.size()) {
+        m_pending.resize(0); // емкость сохраняется
+        m_pendingOffset = 0;
+    }
+    return pushable;
+}
+
+void PcmDecodeWorker::pump()
+{
+    if (!m_ring) {
+        return;
+    }
+
+    qint64 pushable = pushPending();
+    while (m_decoding && pushable <= m_stagingBytes && m_decoder->bufferAvailable()) {
+        takeBuffer();
+        pushable = pushPending();
+    }
+
+    const bool drained = m_draining && pushable <= 0;
+    if (!m_primed && (drained || m_ring->readAvailable() >= m_primeBytes || m_ring->writeAvailable() == 0)) {
+        m_primed = true;
+        emit primed(m_session);
+    }
+
+    if (pushable > 0) {
+        m_pumpTimer->start(); // кольцо заполнено: ждем, пока аудиопоток его освободит
+    } else if (drained) {
+        m_draining = false;
+        emit finished(m_session, m_streamBytes / m_bytesPerFrame);
+    }
+}
+
+// --- PcmPlaybackEngine ---
+
+PcmPlaybackEngine::PcmPlaybackEngine(QObject *parent)
+    : QObject(parent)
+{
+    QSettings settings;
+    m_ringBufferMs = qMax(50, settings.value("audio/ringBufferMs", 1000).toInt());
+    m_sinkBufferMs = qMax(5, settings.value("audio/sinkBufferMs", 40).toInt());
+    m_stagingBufferMs = qMax(0, settings.value("audio/stagingBufferMs", 250).toInt());
+
+    // Формат устройства по умолчанию; float, если устройство его принимает
+    const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+    m_format = device.preferredFormat();
+    QAudioFormat floatFormat = m_format;
+    floatFormat.setSampleFormat(QAudioFormat::Float);
+    if (device.isFormatSupported(floatFormat)) {
+        m_format = floatFormat;
+    }
+
+    m_sink = new QAudioSink(device, m_format, this);
+    m_dsp = std::make_unique<DspChain>(m_format);
+    m_dsp->setLimiter(settings.value("audio/limiter", false).toBool(),
+                      settings.value("audio/limiterThresholdDb", -1.0).toFloat());
+    m_device = new PcmRingDevice(this);
+    m_device->setDsp(m_dsp.get());
+    m_device->open(QIODevice::ReadOnly);
+
+    m_worker = new PcmDecodeWorker(m_format);
+    m_worker->moveToThread(&m_decodeThread);
+    connect(&m_decodeThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &PcmDecodeWorker::primed, this, &PcmPlaybackEngine::handlePrimed);
+    connect(m_worker, &PcmDecodeWorker::trackBoundary, this, &PcmPlaybackEngine::handleTrackBoundary);
+    connect(m_worker, &PcmDecodeWorker::nextRejected, this, &PcmPlaybackEngine::handleNextRejected);
+    connect(m_worker, &PcmDecodeWorker::finished, this, &PcmPlaybackEngine::handleDecodeFinished);
+    connect(m_worker, &PcmDecodeWorker::durationKnown, this, &PcmPlaybackEngine::handleDurationKnown);
+    connect(m_worker, &PcmDecodeWorker::errorOccurred, this, &PcmPlaybackEngine::handleDecodeError);
+    m_decodeThread.setObjectName("pcm_decoder");
+    m_decodeThread.start();
+
+    m_positionTimer.setInterval(50);
+    connect(&m_positionTimer, &QTimer::timeout, this, &PcmPlaybackEngine::updatePosition);
+}
+
+PcmPlaybackEngine::~PcmPlaybackEngine()
+{
+    stopPipeline();
+    m_decodeThread.quit();
+    m_decodeThread.wait();
+}
+
+void PcmPlaybackEngine::play()
+{
+    if (m_current.filePath.isEmpty() || m_state == QMediaPlayer::PlayingState) {
+        return;
+    }
+    if (!m_pipelineActive) {
+        startPipeline(m_stoppedPositionMs); // звук пойдет, когда буфер наполнится (handlePrimed)
+    } else if (m_sinkStarted) {
+        m_sink->resume();
+    } else if (m_primed) {
+        startSink();
+    }
+    setState(QMediaPlayer::PlayingState);
+}
+
+void PcmPlaybackEngine::pause()
+{
+    if (m_state != QMediaPlayer::PlayingState) {
+        return;
+    }
+    if (m_sinkStarted) {
+        m_sink->suspend();
+    }
+    setState(QMediaPlayer::PausedState);
+    emit positionChanged(position());
+}
+
+void PcmPlaybackEngine::stop()
+{
+    stopPipeline();
+    m_stoppedPositionMs = 0;
+    setState(QMediaPlayer::StoppedState);
+    emit positionChanged(0);
+}
+
+void PcmPlaybackEngine::setSource(const QString &filePath)
+{
+    stop();
+    m_current = TrackPlan();
+    if (filePath.isEmpty()) {
+        emit mediaStatusChanged(QMediaPlayer::NoMedia);
+        return;
+    }
+    if (!QFileInfo::exists(filePath)) {
+        qDebug() << "Файл не найден:" << filePath;
+        emit mediaStatusChanged(QMediaPlayer::InvalidMedia);
+        emit errorOccurred(QString("Файл не найден: %1").arg(filePath));
+        return;
+    }
+
+    // Метаданные и длительность — из заголовков файла, не дожидаясь декодера
+    m_current = planFor(filePath);
+    emit mediaStatusChanged(QMediaPlayer::LoadedMedia);
+    emit durationChanged(m_current.durationMs);
+    emitMetaData();
+}
+
+void PcmPlaybackEngine::setNextSource(const QString &filePath)
+{
+    if (filePath == m_next.filePath) {
+        return;
+    }
+    m_next = filePath.isEmpty() ? TrackPlan() : planFor(filePath);
+    queueNextToWorker();
+}
+
+QString PcmPlaybackEngine::nextSource() const
+{
+    return m_next.filePath;
+}
+
+void PcmPlaybackEngine::setVolume(float volume)
+{
+    m_dsp->setVolume(volume);
+}
+
+void PcmPlaybackEngine::setReplayGain(ReplayGainMode mode, float preampDb)
+{
+    m_replayGainMode = mode;
+    m_replayGainPreampDb = preampDb;
+}
+
+void PcmPlaybackEngine::setLibraryReplayGain(const QHash<QString, ReplayGainValues> &gains)
+{
+    m_libraryReplayGain = gains;
+}
+
+void PcmPlaybackEngine::setEqualizer(const QList<EqBand> &bands)
+{
+    m_dsp->setEqualizer(bands);
+}
+
+void PcmPlaybackEngine::setPosition(qint64 position)
+{
+    position = qMax<qint64>(0, position);
+    if (!m_pipelineActive) {
+        m_stoppedPositionMs = position;
+    } else {
+        // Состояние сохраняется: при паузе буфер наполнится, но звук не пойдет
+        startPipeline(position);
+    }
+    emit positionChanged(position);
+}
+
+QMediaPlayer::PlaybackState PcmPlaybackEngine::playbackState() const
+{
+    return m_state;
+}
+
+qint64 PcmPlaybackEngine::position() const
+{
+    if (!m_pipelineActive) {
+        return m_stoppedPositionMs;
+    }
+    return qMax<qint64>(0, framesToMs(playedFrames() - m_trackStartFrame));
+}
+
+qint64 PcmPlaybackEngine::duration() const
+{
+    return m_current.durationMs;
+}
+
+QUrl PcmPlaybackEngine::currentSource() const
+{
+    return m_current.filePath.isEmpty() ? QUrl() : QUrl::fromLocalFile(m_current.filePath);
+}
+
+void PcmPlaybackEngine::setBufferSizes(int ringBufferMs, int sinkBufferMs, int stagingBufferMs)
+{
+    m_ringBufferMs = qMax(50, ringBufferMs);
+    m_sinkBufferMs = qMax(5, sinkBufferMs);
+    m_stagingBufferMs = qMax(0, stagingBufferMs);
+}
+
+int PcmPlaybackEngine::ringBufferMs() const
+{
+    return m_ringBufferMs;
+}
+
+int PcmPlaybackEngine::sinkBufferMs() const
+{
+    return m_sinkBufferMs;
+}
+
+int PcmPlaybackEngine::stagingBufferMs() const
+{
+    return m_stagingBufferMs;
+}
+
+quint64 PcmPlaybackEngine::underrunCount() const
+{
+    return m_underrunsBefore + m_device->underruns();
+}
+
+qint64 PcmPlaybackEngine::bufferedMs() const
+{
+    if (!m_ring) {
+        return 0;
+    }
+    return framesToMs(m_ring->readAvailable() / qMax(1, m_format.bytesPerFrame()));
+}
+
+// --- Конвейер ---
+
+PcmPlaybackEngine::TrackPlan PcmPlaybackEngine::planFor(const QString &filePath)
+{
+    TrackPlan plan;
+    plan.id = ++m_lastTrackId;
+    plan.filePath = filePath;
+
+    const TrackTags tags = TagReader::read(filePath);
+    plan.title = tags.title.isEmpty() ? QFileInfo(filePath).baseName() : tags.title;
+    plan.artist = tags.artist;
+    plan.album = tags.album;
+    plan.durationMs = tags.durationMs;
+    ReplayGainValues gains = DspChain::replayGainValues(tags);
+    if (!gains.hasTrackGain && !gains.hasAlbumGain) {
+        gains = m_libraryReplayGain.value(filePath);
+    }
+    plan.gain = DspChain::replayGainFactor(gains, m_replayGainMode, m_replayGainPreampDb);
+    if (tags.sampleRate > 0) {
+        // Задержка и добивка записаны в сэмплах файла, а декодер выдает формат устройства
+        const qint64 outputRate = m_format.sampleRate();
+        plan.startPaddingFrames = qint64(tags.startPaddingSamples) * outputRate / tags.sampleRate;
+        plan.endPaddingFrames = qint64(tags.endPaddingSamples) * outputRate / tags.sampleRate;
+        const qint64 paddingMs = qint64(tags.startPaddingSamples + tags.endPaddingSamples) * 1000 / tags.sampleRate;
+        plan.durationMs = qMax<qint64>(0, plan.durationMs - paddingMs);
+    }
+    return plan;
+}
+
+PcmTrack PcmPlaybackEngine::decoderTrack(const TrackPlan &plan, qint64 positionMs) const
+{
+    PcmTrack track;
+    track.id = plan.id;
+    track.filePath = plan.filePath;
+    track.skipFrames = plan.startPaddingFrames + msToFrames(positionMs);
+    track.endPaddingFrames = plan.endPaddingFrames;
+    track.gain = plan.gain;
+    return track;
+}
+
+void PcmPlaybackEngine::startPipeline(qint64 positionMs)
+{
+    stopPipeline();
+    if (m_current.filePath.isEmpty()) {
+        return;
+    }
+
+    const int bytesPerFrame = qMax(1, m_format.bytesPerFrame());
+    const qsizetype ringBytes = m_format.bytesForDuration(qint64(m_ringBufferMs) * 1000);
+    if (!m_ring || m_ring->capacity() < ringBytes || m_ring->capacity() >= ringBytes * 2) {
+        m_ring = std::make_unique<PcmRingBuffer>(ringBytes);
+    }
+    m_device->setRing(m_ring.get(), bytesPerFrame);
+
+    m_trackStartFrame = -msToFrames(positionMs);
+    m_endFrame = -1;
+    m_boundaries.clear();
+    m_primed = false;
+    m_pipelineActive = true;
+
+    // Звук запускается, когда в кольце накопится хотя бы два буфера устройства
+    const qint64 primeBytes = m_format.bytesForDuration(qint64(m_sinkBufferMs) * 2000);
+    const qint64 stagingBytes = m_format.bytesForDuration(qint64(m_stagingBufferMs) * 1000);
+    const int session = m_session;
+    PcmRingBuffer *ring = m_ring.get();
+    const PcmTrack track = decoderTrack(m_current, positionMs);
+    PcmDecodeWorker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, session, ring, track, primeBytes, stagingBytes]() {
+        worker->start(session, ring, track, primeBytes, stagingBytes);
+    }, Qt::QueuedConnection);
+    queueNextToWorker();
+}
+
+void PcmPlaybackEngine::stopPipeline()
+{
+    // Новая сессия: запоздавшие сигналы прежнего конвейера будут проигнорированы
+    ++m_session;
+    if (!m_pipelineActive) {
+        return;
+    }
+    m_pipelineActive = false;
+
+    // Сначала останавливаются писатель и читатель, только потом сбрасывается кольцо
+    PcmDecodeWorker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker]() { worker->stop(); }, Qt::BlockingQueuedConnection);
+    m_sink->stop();
+    m_sinkStarted = false;
+    m_primed = false;
+    m_underrunsBefore += m_device->underruns();
+    m_device->resetCounters();
+    m_ring->reset();
+    m_boundaries.clear();
+}
+
+void PcmPlaybackEngine::startSink()
+{
+    m_sink->setBufferSize(m_format.bytesForDuration(qint64(m_sinkBufferMs) * 1000));
+    m_sink->start(m_device);
+    m_sinkStarted = true;
+    if (m_sink->error() != QAudio::NoError) {
+        qDebug() << "Не удалось открыть аудиоустройство:" << m_sink->error();
+        emit errorOccurred("Не удалось открыть аудиоустройство");
+    }
+}
+
+void PcmPlaybackEngine::queueNextToWorker()
+{
+    if (!m_pipelineActive) {
+        return; // передадим при запуске конвейера
+    }
+    const int afterTrackId = m_current.id;
+    const PcmTrack next = m_next.id != 0 ? decoderTrack(m_next, 0) : PcmTrack();
+    PcmDecodeWorker *worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, afterTrackId, next]() {
+        worker->setNext(afterTrackId, next);
+    }, Qt::QueuedConnection);
+}
+
+qint64 PcmPlaybackEngine::playedFrames() const
+{
+    if (!m_sinkStarted) {
+        return 0;
+    }
+    // Прошедшее через устройство минус вставленная тишина; не больше реально отданного
+    const int bytesPerFrame = qMax(1, m_format.bytesPerFrame());
+    const qint64 processed = m_sink->processedUSecs() * m_format.sampleRate() / 1000000;
+    const qint64 silence = m_device->silenceBytes() / bytesPerFrame;
+    const qint64 consumed = m_device->consumedBytes() / bytesPerFrame;
+    return qBound<qint64>(0, processed - silence, consumed);
+}
+
+qint64 PcmPlaybackEngine::framesToMs(qint64 frames) const
+{
+    return m_format.sampleRate() > 0 ? frames * 1000 / m_format.sampleRate() : 0;
+}
+
+qint64 PcmPlaybackEngine::msToFrames(qint64 ms) const
+{
+    return ms * m_format.sampleRate() / 1000;
+}
+
+void PcmPlaybackEngine::setState(QMediaPlayer::PlaybackState state)
+{
+    if (state == QMediaPlayer::PlayingState) {
+        m_positionTimer.start();
+    } else {
+        m_positionTimer.stop();
+    }
+    if (m_state == state) {
+        return;
+    }
+    m_state = state;
+    emit playbackStateChanged(state);
+}
+
+void PcmPlaybackEngine::emitMetaData()
+{
+    // Обложку этот движок не извлекает: декодер отдает только PCM
+    emit metaDataChanged(m_current.title, m_current.artist, m_current.album, QVariant());
+}
+
+void PcmPlaybackEngine::updatePosition()
+{
+    const qint64 frame = playedFrames();
+
+    // Граница склейки прозвучала: дальше играет следующий трек
+    while (!m_boundaries.isEmpty() && frame >= m_boundaries.first().frame) {
+        const Boundary boundary = m_boundaries.takeFirst();
+        m_trackStartFrame = boundary.frame;
+        m_current = boundary.track;
+        if (m_next.id == boundary.track.id) {
+            m_next = TrackPlan();
+        }
+        emit advancedToNext();
+        emit durationChanged(m_current.durationMs);
+        emitMetaData();
+    }
+
+    if (m_endFrame >= 0 && m_boundaries.isEmpty() && frame >= m_endFrame) {
+        // Сначала состояние, потом EndOfMedia: обработчик конца трека может сразу
+        // запустить следующий, и его PlayingState не должен быть перекрыт
+        stopPipeline();
+        m_stoppedPositionMs = 0;
+        setState(QMediaPlayer::StoppedState);
+        emit mediaStatusChanged(QMediaPlayer::EndOfMedia);
+        return;
+    }
+
+    emit positionChanged(position());
+}
+
+// --- Сигналы потока декодера ---
+
+void PcmPlaybackEngine::handlePrimed(int session)
+{
+    if (session != m_session) {
+        return;
+    }
+    m_primed = true;
+    if (m_state == QMediaPlayer::PlayingState && !m_sinkStarted) {
+        startSink();
+    }
+    emit mediaStatusChanged(QMediaPlayer::BufferedMedia);
+}
+
+void PcmPlaybackEngine::handleTrackBoundary(int session, qint64 frame, int trackId)
+{
+    // Граница трека, которого уже нет в очереди, означает, что следующий трек сменили;
+    // декодер отклонит новую заявку, и конвейер перезапустится (handleNextRejected)
+    if (session != m_session || trackId != m_next.id) {
+        return;
+    }
+    m_boundaries.append({frame, m_next});
+    m_endFrame = -1;
+    m_device->setEndOfStream(false);
+}
+
+void PcmPlaybackEngine::handleNextRejected(int session)
+{
+    if (session != m_session) {
+        return;
+    }
+    // Декодер уже склеил прежний следующий трек: пересобираем поток с текущей позиции
+    startPipeline(position());
+}
+
+void PcmPlaybackEngine::handleDecodeFinished(int session, qint64 totalFrames)
+{
+    if (session != m_session) {
+        return;
+    }
+    m_endFrame = totalFrames;
+    m_device->setEndOfStream(true);
+}
+
+void PcmPlaybackEngine::handleDurationKnown(int session, int trackId, qint64 durationMs)
+{
+    if (session != m_session) {
+        return;
+    }
+    // Заголовки не всегда содержат длительность (например, MP3 без Xing)
+    if (trackId == m_current.id && m_current.durationMs <= 0) {
+        m_current.durationMs = durationMs;
+        emit durationChanged(durationMs);
+    } else if (trackId == m_next.id && m_next.durationMs <= 0) {
+        m_next.durationMs = durationMs;
+    }
+}
+
+void PcmPlaybackEngine::handleDecodeError(int session, const QString &message)
+{
+    if (session != m_session) {
+        return;
+    }
+    emit errorOccurred(message);
+}
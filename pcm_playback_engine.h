@@ -0,0 +1,256 @@
+#ifndef PCM_PLAYBACK_ENGINE_H
+#define PCM_PLAYBACK_ENGINE_H
+
+#include "dsp_chain.h"
+#include "pcm_ring_buffer.h"
+
+#include <QObject>
+#include <QAudioDecoder>
+#include <QAudioFormat>
+#include <QAudioSink>
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QMediaPlayer>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <QVariant>
+#include <atomic>
+#include <memory>
+
+// Источник для QAudioSink в режиме pull. readData() вызывается из аудиопотока и
+// безопасен для реального времени: только копирование из кольцевого буфера, без
+// блокировок и выделения памяти. Нехватка данных заполняется тишиной и считается.
+class PcmRingDevice : public QIODevice
+{
+public:
+    explicit PcmRingDevice(QObject *parent = nullptr);
+
+    // Вызывать только при остановленном QAudioSink
+    void setRing(PcmRingBuffer *ring, int bytesPerFrame);
+    // Цепочка обработки, через которую проходят данные перед отдачей аудиосистеме
+    void setDsp(DspChain *dsp);
+    void resetCounters();
+
+    void setEndOfStream(bool endOfStream);
+    quint64 underruns() const;
+    qint64 consumedBytes() const;   // реальные данные, отданные аудиосистеме
+    qint64 silenceBytes() const;    // тишина, вставленная при нехватке данных
+
+    bool isSequential() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    PcmRingBuffer *m_ring = nullptr;
+    DspChain *m_dsp = nullptr;
+    int m_bytesPerFrame = 1;
+    std::atomic<bool> m_endOfStream{false};
+    std::atomic<quint64> m_underruns{0};
+    std::atomic<qint64> m_consumedBytes{0};
+    std::atomic<qint64> m_silenceBytes{0};
+};
+
+// Трек в том виде, в каком его видит декодер
+struct PcmTrack {
+    int id = 0;                   // 0 — нет трека
+    QString filePath;
+    qint64 skipFrames = 0;        // задержка кодера (+ позиция при перемотке)
+    qint64 endPaddingFrames = 0;  // добивка последнего кадра
+    float gain = 1.0f;            // ReplayGain, применяется при декодировании
+};
+
+// Декодирование в отдельном потоке: QAudioDecoder -> обрезка задержки и добивки
+// кодера -> кольцевой буфер. Следующий трек склеивается с текущим прямо в потоке PCM,
+// поэтому переход между треками точен до сэмпла.
+class PcmDecodeWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PcmDecodeWorker(const QAudioFormat &format);
+
+    // Все методы вызываются в потоке декодера (через QMetaObject::invokeMethod)
+    void start(int session, PcmRingBuffer *ring, const PcmTrack &track, qint64 primeBytes, qint64 stagingBytes);
+    // Следующий трек после afterTrackId; если декодер уже ушел дальше (склеил прежний
+    // следующий трек), придет nextRejected() и конвейер нужно перезапустить
+    void setNext(int afterTrackId, const PcmTrack &next);
+    void stop();
+
+signals:
+    // Буфер заполнен до порога старта (или весь поток короче порога)
+    void primed(int session);
+    // С кадра frame потока начинается трек trackId, ранее переданный в setNext()
+    void trackBoundary(int session, qint64 frame, int trackId);
+    void nextRejected(int session);
+    // Весь поток записан в буфер; totalFrames — его длина в кадрах
+    void finished(int session, qint64 totalFrames);
+    void durationKnown(int session, int trackId, qint64 durationMs);
+    void errorOccurred(int session, const QString &message);
+
+private:
+    void openDecoder(const PcmTrack &track);
+    void closeDecoder();
+    void handleBufferReady();
+    void handleDecoderFinished();
+    void handleDecoderError(QAudioDecoder::Error error);
+    void takeBuffer();
+    qint64 pushPending();
+    void pump();
+
+    QAudioFormat m_format;
+    int m_bytesPerFrame;
+    int m_session = 0;
+    PcmRingBuffer *m_ring = nullptr;
+    QAudioDecoder *m_decoder = nullptr;
+    QTimer *m_pumpTimer = nullptr;
+    int m_trackId = 0;               // трек, который сейчас декодируется
+
+    // Промежуточный буфер между декодером и кольцом. Обратное давление — в том, что
+    // следующий буфер декодера не читается, пока здесь больше m_stagingBytes: непрочитанный
+    // буфер останавливает декодер. Поэтому размер ограничен m_stagingBytes + один буфер
+    // декодера + удерживаемый хвост, а не длиной трека
+    QByteArray m_pending;
+    qsizetype m_pendingOffset = 0;
+    qint64 m_stagingBytes = 0;
+    qint64 m_skipBytes = 0;          // сколько еще отбросить в начале трека
+    qint64 m_holdBackBytes = 0;      // хвост, который может оказаться добивкой
+    float m_gain = 1.0f;
+    qint64 m_streamBytes = 0;        // длина потока с учетом обрезки
+    qint64 m_primeBytes = 0;
+    bool m_primed = false;
+    bool m_decoding = false;
+    bool m_draining = false;
+
+    PcmTrack m_next;
+};
+
+// Альтернативный движок воспроизведения с полным контролем над буферизацией:
+// декодер в рабочем потоке -> SPSC кольцевой буфер -> QAudioSink (pull).
+// Интерфейс и сигналы повторяют MusicPlayer, чтобы тот мог просто делегировать.
+// Размеры буферов берутся из настроек audio/ringBufferMs, audio/sinkBufferMs и
+// audio/stagingBufferMs (сколько декодер может опережать заполненное кольцо).
+class PcmPlaybackEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PcmPlaybackEngine(QObject *parent = nullptr);
+    ~PcmPlaybackEngine();
+
+    void play();
+    void pause();
+    void stop();
+    void setSource(const QString &filePath);
+    void setNextSource(const QString &filePath);
+    QString nextSource() const;
+    // Громкость меняется плавно в цепочке обработки, а не скачком на устройстве
+    void setVolume(float volume);
+    // Действует на треки, открытые после вызова
+    void setReplayGain(ReplayGainMode mode, float preampDb);
+    // Поправки из анализа громкости для файлов без тегов ReplayGain
+    void setLibraryReplayGain(const QHash<QString, ReplayGainValues> &gains);
+    void setEqualizer(const QList<EqBand> &bands);
+    // QAudioDecoder не умеет перематывать: поток декодируется заново с начала
+    // трека, а все до нужной позиции отбрасывается
+    void setPosition(qint64 position);
+
+    QMediaPlayer::PlaybackState playbackState() const;
+    qint64 position() const;
+    qint64 duration() const;
+    QUrl currentSource() const;
+
+    // Новые размеры применяются при следующем запуске конвейера (смена трека, перемотка)
+    void setBufferSizes(int ringBufferMs, int sinkBufferMs, int stagingBufferMs);
+    int ringBufferMs() const;
+    int sinkBufferMs() const;
+    int stagingBufferMs() const;
+    // Сколько раз аудиосистеме не хватило данных с момента создания движка
+    quint64 underrunCount() const;
+    // Сколько декодированного звука ждет в кольцевом буфере
+    qint64 bufferedMs() const;
+
+signals:
+    void playbackStateChanged(QMediaPlayer::PlaybackState state);
+    void positionChanged(qint64 position);
+    void durationChanged(qint64 duration);
+    void metaDataChanged(const QString &title, const QString &artist, const QString &album, const QVariant &albumArt);
+    void errorOccurred(const QString &errorMessage);
+    void mediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void advancedToNext();
+
+private:
+    struct TrackPlan {
+        int id = 0;
+        QString filePath;
+        QString title;
+        QString artist;
+        QString album;
+        qint64 durationMs = 0;
+        qint64 startPaddingFrames = 0;  // в кадрах выходного формата
+        qint64 endPaddingFrames = 0;
+        float gain = 1.0f;
+    };
+    struct Boundary {
+        qint64 frame;
+        TrackPlan track;
+    };
+
+    TrackPlan planFor(const QString &filePath);
+    void startPipeline(qint64 positionMs);
+    void stopPipeline();
+    void startSink();
+    void queueNextToWorker();
+    PcmTrack decoderTrack(const TrackPlan &plan, qint64 positionMs) const;
+    qint64 playedFrames() const;
+    qint64 framesToMs(qint64 frames) const;
+    qint64 msToFrames(qint64 ms) const;
+    void setState(QMediaPlayer::PlaybackState state);
+    void emitMetaData();
+    void updatePosition();
+
+    void handlePrimed(int session);
+    void handleTrackBoundary(int session, qint64 frame, int trackId);
+    void handleNextRejected(int session);
+    void handleDecodeFinished(int session, qint64 totalFrames);
+    void handleDurationKnown(int session, int trackId, qint64 durationMs);
+    void handleDecodeError(int session, const QString &message);
+
+    QAudioFormat m_format;
+    QAudioSink *m_sink = nullptr;
+    PcmRingDevice *m_device = nullptr;
+    std::unique_ptr<PcmRingBuffer> m_ring;
+    std::unique_ptr<DspChain> m_dsp;
+    ReplayGainMode m_replayGainMode = ReplayGainMode::Off;
+    float m_replayGainPreampDb = 0.0f;
+    QHash<QString, ReplayGainValues> m_libraryReplayGain;
+    QThread m_decodeThread;
+    PcmDecodeWorker *m_worker = nullptr;
+    QTimer m_positionTimer;
+
+    int m_ringBufferMs = 1000;
+    int m_sinkBufferMs = 40;
+    int m_stagingBufferMs = 250;
+    quint64 m_underrunsBefore = 0;  // счетчики устройства сбрасываются при каждом запуске
+
+    int m_session = 0;
+    bool m_pipelineActive = false;
+    bool m_primed = false;           // в буфере достаточно данных для старта
+    bool m_sinkStarted = false;
+    QMediaPlayer::PlaybackState m_state = QMediaPlayer::StoppedState;
+
+    int m_lastTrackId = 0;
+    TrackPlan m_current;
+    TrackPlan m_next;
+    QList<Boundary> m_boundaries;    // склеенные декодером, но еще не зазвучавшие треки
+    qint64 m_trackStartFrame = 0;    // кадр потока, соответствующий началу текущего трека
+    qint64 m_endFrame = -1;          // длина потока, когда декодер его закончил
+    qint64 m_stoppedPositionMs = 0;
+};
+
+#endif // PCM_PLAYBACK_ENGINE_H
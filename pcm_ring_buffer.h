@@ -0,0 +1,89 @@
+#ifndef PCM_RING_BUFFER_H
+#define PCM_RING_BUFFER_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+// Кольцевой буфер байтов на одного писателя и одного читателя без блокировок.
+// Писатель — поток декодера, читатель — аудиопоток QAudioSink; ни одна операция
+// не выделяет память и не ждет другой поток. Емкость округляется до степени двойки,
+// индексы растут монотонно, позиция в массиве — индекс & (емкость - 1).
+// reset() допустим только когда ни писатель, ни читатель не работают.
+class PcmRingBuffer
+{
+public:
+    explicit PcmRingBuffer(qsizetype capacity)
+    {
+        qsizetype size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_capacity = size;
+        m_mask = size - 1;
+        m_data.reset(new char[size_t(size)]);
+    }
+
+    qsizetype capacity() const { return m_capacity; }
+
+    qsizetype readAvailable() const
+    {
+        return qsizetype(m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_relaxed));
+    }
+
+    qsizetype writeAvailable() const
+    {
+        return m_capacity - qsizetype(m_writeIndex.load(std::memory_order_relaxed) - m_readIndex.load(std::memory_order_acquire));
+    }
+
+    // Только писатель; возвращает число записанных байт (может быть меньше len)
+    qsizetype write(const char *data, qsizetype len)
+    {
+        const quint64 write = m_writeIndex.load(std::memory_order_relaxed);
+        const quint64 read = m_readIndex.load(std::memory_order_acquire);
+        const qsizetype count = qMin(len, m_capacity - qsizetype(write - read));
+        if (count <= 0) {
+            return 0;
+        }
+        const qsizetype offset = qsizetype(write & quint64(m_mask));
+        const qsizetype first = qMin(count, m_capacity - offset);
+        std::memcpy(m_data.get() + offset, data, size_t(first));
+        std::memcpy(m_data.get(), data + first, size_t(count - first));
+        m_writeIndex.store(write + quint64(count), std::memory_order_release);
+        return count;
+    }
+
+    // Только читатель; возвращает число прочитанных байт (может быть меньше len)
+    qsizetype read(char *data, qsizetype len)
+    {
+        const quint64 read = m_readIndex.load(std::memory_order_relaxed);
+        const quint64 write = m_writeIndex.load(std::memory_order_acquire);
+        const qsizetype count = qMin(len, qsizetype(write - read));
+        if (count <= 0) {
+            return 0;
+        }
+        const qsizetype offset = qsizetype(read & quint64(m_mask));
+        const qsizetype first = qMin(count, m_capacity - offset);
+        std::memcpy(data, m_data.get() + offset, size_t(first));
+        std::memcpy(data + first, m_data.get(), size_t(count - first));
+        m_readIndex.store(read + quint64(count), std::memory_order_release);
+        return count;
+    }
+
+    void reset()
+    {
+        m_readIndex.store(0, std::memory_order_relaxed);
+        m_writeIndex.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<char[]> m_data;
+    qsizetype m_capacity = 0;
+    qsizetype m_mask = 0;
+    // Индексы на разных кэш-линиях, чтобы писатель и читатель не мешали друг другу
+    alignas(64) std::atomic<quint64> m_writeIndex{0};
+    alignas(64) std::atomic<quint64> m_readIndex{0};
+};
+
+#endif // PCM_RING_BUFFER_H
@@ -0,0 +1,180 @@
+#include "playback_history_writer.h"
+#include "database_executor.h"
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
+
+namespace {
+
+// Одновременно в очереди исполнителя не больше двух пачек: если база тормозит,
+// новые события копятся в буфере, а не удлиняют очередь перед чтением страниц
+const int maxBatchesInFlight = 2;
+
+// Файл пишется и из GUI-потока (сброс излишка), и из потока исполнителя (неудачная вставка)
+QMutex spoolMutex;
+
+bool appendToSpool(const QString &path, const QList<PlaybackEntryInfo> &entries)
+{
+    QMutexLocker locker(&spoolMutex);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qDebug() << "Не удалось открыть файл отложенной истории:" << path << file.errorString();
+        return false;
+    }
+    // Строка на запись: user_id;song_id;время в ISO 8601
+    QTextStream out(&file);
+    for (const PlaybackEntryInfo &entry : entries) {
+        out << entry.userId << ';' << entry.songId << ';'
+            << entry.playedAt.toString(Qt::ISODateWithMs) << '\n';
+    }
+    return out.status() == QTextStream::Ok;
+}
+
+QList<PlaybackEntryInfo> readSpool(const QString &path)
+{
+    QList<PlaybackEntryInfo> entries;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return entries;
+    }
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QStringList fields = in.readLine().split(';');
+        if (fields.size() != 3) {
+            continue; // недописанная строка после аварийного завершения
+        }
+        PlaybackEntryInfo entry;
+        entry.id = -1;
+        entry.userId = fields.at(0).toInt();
+        entry.songId = fields.at(1).toInt();
+        entry.playedAt = QDateTime::fromString(fields.at(2), Qt::ISODateWithMs);
+        if (entry.songId > 0 && entry.playedAt.isValid()) {
+            entries.append(entry);
+        }
+    }
+    return entries;
+}
+
+// Выполняется в потоке исполнителя после удачной вставки. Файл сначала переименовывается,
+// чтобы GUI-поток не ждал мьютекс, пока идет запись в БД.
+void replaySpool(const QString &path, DatabaseManager &db)
+{
+    const QString replayPath = path + ".replay";
+    {
+        QMutexLocker locker(&spoolMutex);
+        if (!QFile::exists(replayPath)) {
+            if (!QFile::exists(path) || !QFile::rename(path, replayPath)) {
+                return;
+            }
+        }
+    }
+
+    const QList<PlaybackEntryInfo> entries = readSpool(replayPath);
+    if (!entries.isEmpty() && !db.addPlaybackEntries(entries)) {
+        return; // .replay останется и будет отправлен в следующий раз
+    }
+    QFile::remove(replayPath);
+    qDebug() << "Дописано записей истории из локального файла:" << entries.size();
+}
+
+} // namespace
+
+PlaybackHistoryWriter::PlaybackHistoryWriter(DatabaseExecutor *executor, QObject *parent)
+    : QObject(parent)
+    , m_executor(executor)
+{
+    const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QDir().mkpath(dataDir);
+    m_spoolPath = QDir(dataDir).filePath("playback_history.spool");
+
+    m_flushTimer.setInterval(30000);
+    connect(&m_flushTimer, &QTimer::timeout, this, &PlaybackHistoryWriter::flush);
+    m_flushTimer.start();
+}
+
+PlaybackHistoryWriter::~PlaybackHistoryWriter()
+{
+    // При закрытии ограничение на число пачек в очереди не действует
+    if (!m_buffer.isEmpty()) {
+        submitBatch(m_buffer);
+        m_buffer.clear();
+    }
+}
+
+void PlaybackHistoryWriter::setBatchSize(int entries)
+{
+    m_batchSize = qMax(1, entries);
+}
+
+void PlaybackHistoryWriter::setFlushInterval(int milliseconds)
+{
+    m_flushTimer.setInterval(milliseconds);
+}
+
+void PlaybackHistoryWriter::setMaxPending(int entries)
+{
+    m_maxPending = qMax(m_batchSize, entries);
+}
+
+void PlaybackHistoryWriter::record(int userId, int songId)
+{
+    PlaybackEntryInfo entry;
+    entry.id = -1;
+    entry.userId = userId;
+    entry.songId = songId;
+    entry.playedAt = QDateTime::currentDateTime(); // время прослушивания, а не записи в БД
+    m_buffer.append(entry);
+
+    if (m_buffer.size() >= m_batchSize) {
+        flush();
+    }
+}
+
+void PlaybackHistoryWriter::flush()
+{
+    if (m_buffer.isEmpty()) {
+        return;
+    }
+    if (m_batchesInFlight < maxBatchesInFlight) {
+        submitBatch(m_buffer);
+        m_buffer.clear();
+        return;
+    }
+
+    // База не успевает: держим записи в памяти до предела, дальше сбрасываем в файл
+    if (m_buffer.size() >= m_maxPending) {
+        if (!appendToSpool(m_spoolPath, m_buffer)) {
+            qDebug() << "История прослушиваний перегружена, отброшено записей:" << m_buffer.size();
+        }
+        m_buffer.clear();
+    }
+}
+
+int PlaybackHistoryWriter::pendingCount() const
+{
+    return int(m_buffer.size());
+}
+
+QString PlaybackHistoryWriter::spoolPath() const
+{
+    return m_spoolPath;
+}
+
+void PlaybackHistoryWriter::submitBatch(const QList<PlaybackEntryInfo> &batch)
+{
+    ++m_batchesInFlight;
+    m_executor->submit([batch, spoolPath = m_spoolPath](DatabaseManager &db) {
+        if (!db.addPlaybackEntries(batch)) {
+            // БД недоступна: сохраняем пачку локально, она уйдет после восстановления
+            appendToSpool(spoolPath, batch);
+            return false;
+        }
+        replaySpool(spoolPath, db);
+        return true;
+    }).then(this, [this](bool) {
+        --m_batchesInFlight;
+    });
+}
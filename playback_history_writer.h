@@ -0,0 +1,49 @@
+#ifndef PLAYBACK_HISTORY_WRITER_H
+#define PLAYBACK_HISTORY_WRITER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QList>
+#include <QString>
+#include "database_manager.h"
+
+class DatabaseExecutor;
+
+// Отложенная запись истории прослушиваний. События копятся в памяти и уходят в БД
+// одной многострочной вставкой при наборе batchSize записей, по таймеру и при закрытии.
+// Если БД не успевает (пачки висят в очереди исполнителя) или недоступна, записи
+// сбрасываются в локальный файл и дописываются в БД после следующей удачной вставки.
+// Воспроизведение никогда не ждет базу: record() только добавляет запись в буфер.
+class PlaybackHistoryWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PlaybackHistoryWriter(DatabaseExecutor *executor, QObject *parent = nullptr);
+    // Отправляет остаток буфера; исполнитель допишет его перед остановкой
+    ~PlaybackHistoryWriter() override;
+
+    void setBatchSize(int entries);
+    void setFlushInterval(int milliseconds);
+    void setMaxPending(int entries);
+
+    // userId <= 0 — пользователь неизвестен
+    void record(int userId, int songId);
+    void flush();
+
+    int pendingCount() const;
+    QString spoolPath() const;
+
+private:
+    void submitBatch(const QList<PlaybackEntryInfo> &batch);
+
+    DatabaseExecutor *m_executor;
+    QList<PlaybackEntryInfo> m_buffer;
+    QTimer m_flushTimer;
+    QString m_spoolPath;
+    int m_batchSize = 100;
+    int m_maxPending = 5000;   // больше этого в памяти не держим, излишек уходит в файл
+    int m_batchesInFlight = 0; // пачки, отправленные исполнителю и еще не записанные
+};
+
+#endif // PLAYBACK_HISTORY_WRITER_H
@@ -0,0 +1,243 @@
+#include "playback_telemetry.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+
+const char *const stageNames[] = {
+    "click_to_source", "click_to_loaded", "click_to_playing", "click_to_sound", "end_of_media_gap", "gapless_switch"};
+
+// Последний — для всего, что не входит в список: метки Prometheus не должны плодиться
+const char *const formatNames[] = {"mp3", "flac", "wav", "other"};
+
+QString number(double value)
+{
+    return QString::number(value, 'g', 9);
+}
+
+} // namespace
+
+PlaybackTelemetry &PlaybackTelemetry::instance()
+{
+    static PlaybackTelemetry telemetry;
+    return telemetry;
+}
+
+PlaybackTelemetry::PlaybackTelemetry()
+{
+    m_clock.start();
+}
+
+QString PlaybackTelemetry::stageName(Stage stage)
+{
+    return QLatin1String(stageNames[stage]);
+}
+
+QString PlaybackTelemetry::formatOf(const QString &filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    return QLatin1String(formatNames[formatIndex(suffix)]);
+}
+
+int PlaybackTelemetry::formatIndex(const QString &format)
+{
+    for (int i = 0; i < FormatCount - 1; ++i) {
+        if (format == QLatin1String(formatNames[i])) {
+            return i;
+        }
+    }
+    return FormatCount - 1;
+}
+
+void PlaybackTelemetry::markRequest(const QString &filePath)
+{
+    m_currentFormat = formatOf(filePath);
+    m_request = Request();
+    if (m_endOfMediaAt >= 0 && msSince(m_endOfMediaAt) > AutomaticRequestWindowMs) {
+        // Следующий трек после EndOfMedia так и не запустился: это уже выбор пользователя
+        m_endOfMediaAt = -1;
+        m_playingSinceEnd = false;
+    }
+    if (m_endOfMediaAt >= 0) {
+        // Переход по EndOfMedia: замер уже идет как пауза между треками
+        return;
+    }
+    m_request.requestedAt = m_clock.nsecsElapsed();
+    m_request.format = m_currentFormat;
+}
+
+void PlaybackTelemetry::markSourceSet(const QString &filePath)
+{
+    m_currentFormat = formatOf(filePath);
+    if (m_endOfMediaAt >= 0) {
+        m_playingSinceEnd = false; // тики до запуска нового источника относятся к прежнему
+    }
+    if (m_request.requestedAt < 0 || m_request.sourceAt >= 0) {
+        return;
+    }
+    m_request.sourceAt = m_clock.nsecsElapsed();
+    record(ClickToSource, m_request.format, msSince(m_request.requestedAt));
+}
+
+void PlaybackTelemetry::markMediaStatus(QMediaPlayer::MediaStatus status)
+{
+    switch (status) {
+    case QMediaPlayer::LoadedMedia:
+    case QMediaPlayer::BufferedMedia:
+        if (m_request.sourceAt >= 0 && m_request.loadedAt < 0) {
+            m_request.loadedAt = m_clock.nsecsElapsed();
+            record(ClickToLoaded, m_request.format, msSince(m_request.requestedAt));
+        }
+        break;
+    case QMediaPlayer::EndOfMedia:
+        m_request = Request();
+        m_endOfMediaAt = m_clock.nsecsElapsed();
+        m_playingSinceEnd = false;
+        break;
+    case QMediaPlayer::InvalidMedia:
+        cancel();
+        break;
+    default:
+        break;
+    }
+}
+
+void PlaybackTelemetry::markPlaybackState(QMediaPlayer::PlaybackState state)
+{
+    if (state != QMediaPlayer::PlayingState) {
+        return;
+    }
+    if (m_endOfMediaAt >= 0) {
+        m_playingSinceEnd = true;
+    }
+    if (m_request.sourceAt >= 0 && m_request.playingAt < 0) {
+        m_request.playingAt = m_clock.nsecsElapsed();
+        record(ClickToPlaying, m_request.format, msSince(m_request.requestedAt));
+    }
+}
+
+void PlaybackTelemetry::markPosition(qint64 position)
+{
+    if (position <= 0) {
+        return;
+    }
+    // Тики позиции приходят с интервалом, поэтому уже проигранное вычитается: так оценивается
+    // момент первого звука, а не момент тика
+    const double playedMs = double(position);
+    if (m_endOfMediaAt >= 0 && m_playingSinceEnd) {
+        record(EndOfMediaGap, m_currentFormat, qMax(0.0, msSince(m_endOfMediaAt) - playedMs));
+        m_endOfMediaAt = -1;
+        m_playingSinceEnd = false;
+    }
+    if (m_request.playingAt >= 0) {
+        // Звук не мог начаться раньше, чем плеер перешел в PlayingState
+        const double playingMs = double(m_request.playingAt - m_request.requestedAt) / 1e6;
+        record(ClickToSound, m_request.format, qMax(playingMs, msSince(m_request.requestedAt) - playedMs));
+        m_request = Request();
+    }
+}
+
+void PlaybackTelemetry::recordGaplessSwitch(const QString &filePath, double ms)
+{
+    m_currentFormat = formatOf(filePath);
+    record(GaplessSwitch, m_currentFormat, ms);
+}
+
+void PlaybackTelemetry::cancel()
+{
+    m_request = Request();
+    m_endOfMediaAt = -1;
+    m_playingSinceEnd = false;
+}
+
+void PlaybackTelemetry::record(Stage stage, const QString &format, double ms)
+{
+    RollingHistogram &histogram = m_histograms[stage][formatIndex(format)];
+    const qint64 current = epoch();
+    const int slot = int(current % WindowCount);
+    if (histogram.epochs[slot] != current) {
+        histogram.windows[slot].clear();
+        histogram.epochs[slot] = current;
+    }
+    histogram.windows[slot].add(ms);
+    ++histogram.totalCount;
+    histogram.totalMs += ms;
+}
+
+QList<PlaybackLatencyStats> PlaybackTelemetry::stats() const
+{
+    const qint64 current = epoch();
+    QList<PlaybackLatencyStats> result;
+    for (int stage = 0; stage < StageCount; ++stage) {
+        for (int format = 0; format < FormatCount; ++format) {
+            const RollingHistogram &histogram = m_histograms[stage][format];
+            if (histogram.totalCount == 0) {
+                continue;
+            }
+            LatencyHistogram recent;
+            for (int i = 0; i < WindowCount; ++i) {
+                if (histogram.epochs[i] > current - WindowCount) {
+                    recent.merge(histogram.windows[i]);
+                }
+            }
+            PlaybackLatencyStats stats;
+            stats.stage = stageName(Stage(stage));
+            stats.format = QLatin1String(formatNames[format]);
+            stats.count = recent.count();
+            stats.p50Ms = recent.quantile(0.50);
+            stats.p95Ms = recent.quantile(0.95);
+            stats.p99Ms = recent.quantile(0.99);
+            stats.maxMs = recent.max();
+            stats.totalCount = histogram.totalCount;
+            stats.totalMs = histogram.totalMs;
+            result.append(stats);
+        }
+    }
+    return result;
+}
+
+void PlaybackTelemetry::reset()
+{
+    m_histograms = {};
+}
+
+QString PlaybackTelemetry::prometheusText() const
+{
+    // Метки берутся из фиксированных списков, экранировать нечего
+    QString text;
+    text += "# HELP musicplayer_playback_latency_seconds Playback path latency per stage and file format; "
+            "quantiles over the last hour.\n"
+            "# TYPE musicplayer_playback_latency_seconds summary\n";
+    const QList<PlaybackLatencyStats> all = stats();
+    for (const PlaybackLatencyStats &stats : all) {
+        const QString label = QString("stage=\"%1\",format=\"%2\"").arg(stats.stage, stats.format);
+        const std::pair<const char *, double> quantiles[] = {
+            {"0.5", stats.p50Ms}, {"0.95", stats.p95Ms}, {"0.99", stats.p99Ms}};
+        for (const auto &quantile : quantiles) {
+            text += QString("musicplayer_playback_latency_seconds{%1,quantile=\"%2\"} %3\n")
+                        .arg(label, QLatin1String(quantile.first), number(quantile.second / 1000.0));
+        }
+        text += QString("musicplayer_playback_latency_seconds_sum{%1} %2\n").arg(label, number(stats.totalMs / 1000.0));
+        text += QString("musicplayer_playback_latency_seconds_count{%1} %2\n").arg(label).arg(stats.totalCount);
+    }
+    return text;
+}
+
+bool PlaybackTelemetry::writePrometheusFile(const QString &path) const
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Не удалось записать метрики воспроизведения:" << path;
+        return false;
+    }
+    file.write(prometheusText().toUtf8());
+    if (!file.commit()) {
+        qDebug() << "Не удалось записать метрики воспроизведения:" << path << file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef PLAYBACK_TELEMETRY_H
+#define PLAYBACK_TELEMETRY_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMediaPlayer>
+#include <QString>
+#include <array>
+#include "latency_histogram.h"
+
+// Сводка по одному этапу для одного формата файла
+struct PlaybackLatencyStats {
+    QString stage;
+    QString format;
+    quint64 count = 0;      // за скользящее окно
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+    quint64 totalCount = 0; // с запуска или сброса
+    double totalMs = 0.0;
+};
+
+// Задержки на пути воспроизведения. Отметки ставятся по ходу: запрос трека (двойной щелчок,
+// кнопки) -> MusicPlayer::setSource -> LoadedMedia/BufferedMedia -> PlayingState -> первый
+// тик позиции; последний этап и есть «от щелчка до звука». Отдельно измеряется пауза между
+// EndOfMedia и первым звуком следующего трека и старт трека при переходе без паузы.
+// Квантили считаются по последнему часу (шесть окон по 10 минут), счетчики и суммы — с
+// запуска, как у summary в Prometheus. Разбивка по формату: mp3, flac, wav, остальное.
+// Не потокобезопасна: отметки ставятся из потока интерфейса.
+class PlaybackTelemetry
+{
+public:
+    enum Stage {
+        ClickToSource,
+        ClickToLoaded,
+        ClickToPlaying,
+        ClickToSound,
+        EndOfMediaGap,  // EndOfMedia -> первый звук следующего (или повторенного) трека
+        GaplessSwitch,  // переключение плееров -> первый звук предзагруженного трека
+        StageCount
+    };
+
+    static PlaybackTelemetry &instance();
+
+    static QString stageName(Stage stage);
+    static QString formatOf(const QString &filePath);
+
+    // Пользователь запросил трек. В течение AutomaticRequestWindowMs после EndOfMedia запрос
+    // считается автоматическим переходом и идет в паузу между треками, а не в задержку щелчка
+    void markRequest(const QString &filePath);
+    void markSourceSet(const QString &filePath);
+    void markMediaStatus(QMediaPlayer::MediaStatus status);
+    void markPlaybackState(QMediaPlayer::PlaybackState state);
+    void markPosition(qint64 position);
+    // Задержка старта, уже измеренная MusicPlayer при переходе без паузы
+    void recordGaplessSwitch(const QString &filePath, double ms);
+    // Остановка пользователем или ошибка: незавершенные замеры отбрасываются
+    void cancel();
+
+    // По этапам, внутри — по форматам; пустые сочетания пропускаются
+    QList<PlaybackLatencyStats> stats() const;
+    void reset();
+
+    QString prometheusText() const;
+    bool writePrometheusFile(const QString &path) const;
+
+private:
+    PlaybackTelemetry();
+
+    static constexpr int FormatCount = 4; // mp3, flac, wav, other
+    static constexpr int WindowCount = 6;
+    static constexpr qint64 WindowMs = 10 * 60 * 1000;
+    // Запрос позже этого после EndOfMedia — не автоматический переход (хватает на догрузку страницы)
+    static constexpr double AutomaticRequestWindowMs = 10000.0;
+
+    static int formatIndex(const QString &format);
+
+    // Гистограмма за последние WindowCount окон: старое окно очищается при повторном использовании
+    struct RollingHistogram {
+        std::array<LatencyHistogram, WindowCount> windows;
+        std::array<qint64, WindowCount> epochs{}; // номер окна, к которому относятся данные
+        quint64 totalCount = 0;
+        double totalMs = 0.0;
+    };
+
+    void record(Stage stage, const QString &format, double ms);
+    qint64 epoch() const { return m_clock.elapsed() / WindowMs + 1; } // 0 — окно еще не использовалось
+    double msSince(qint64 startNs) const { return double(m_clock.nsecsElapsed() - startNs) / 1e6; }
+
+    // Отметки одного запуска трека, в наносекундах по m_clock; -1 — еще не было
+    struct Request {
+        qint64 requestedAt = -1;
+        qint64 sourceAt = -1;
+        qint64 loadedAt = -1;
+        qint64 playingAt = -1;
+        QString format;
+    };
+
+    QElapsedTimer m_clock;
+    std::array<std::array<RollingHistogram, FormatCount>, StageCount> m_histograms;
+    Request m_request;
+    qint64 m_endOfMediaAt = -1; // незакрытая пауза между треками
+    bool m_playingSinceEnd = false;
+    QString m_currentFormat;
+};
+
+#endif // PLAYBACK_TELEMETRY_H
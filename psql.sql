@@ -7,7 +7,18 @@ CREATE TABLE IF NOT EXISTS Songs (
     artist VARCHAR(255),
     album VARCHAR(255),
     file_path TEXT NOT NULL UNIQUE,
-    duration_ms INTEGER
+    duration_ms INTEGER,
+    -- Громкость по EBU R128 (LoudnessScanner); mtime и размер — для пропуска неизменившихся файлов
+    file_mtime BIGINT,
+    file_size BIGINT,
+    loudness_lufs REAL,
+    loudness_range_lu REAL,
+    true_peak_dbtp REAL,
+    replaygain_track_db REAL,
+    replaygain_album_db REAL,
+    album_true_peak_dbtp REAL,
+    loudness_histogram BYTEA,
+    loudness_scanned_at TIMESTAMP
 );
 
 CREATE TABLE IF NOT EXISTS Playlists (
@@ -18,7 +29,7 @@ CREATE TABLE IF NOT EXISTS Playlists (
 CREATE TABLE IF NOT EXISTS PlaylistSongs (
     playlist_id INTEGER REFERENCES Playlists(id) ON DELETE CASCADE,
     song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,
-    song_order INTEGER,
+    song_order BIGINT NOT NULL, -- разреженные ключи с шагом 65536
     PRIMARY KEY (playlist_id, song_id)
 );
 
@@ -34,6 +45,10 @@ CREATE TABLE IF NOT EXISTS Albums (
     title VARCHAR(255) NOT NULL,
     artist_id INTEGER REFERENCES Artists(id) ON DELETE SET NULL,
     release_year INTEGER,
+    loudness_lufs REAL,
+    loudness_range_lu REAL,
+    true_peak_dbtp REAL,
+    replaygain_db REAL,
     UNIQUE(title, artist_id)
 );
 
@@ -61,3 +76,86 @@ CREATE TABLE IF NOT EXISTS PlaybackHistory (
     song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,
     played_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
 );
+
+-- Связь песен со справочниками (заполняет CatalogNormalizer); Songs создается раньше
+-- Artists и Albums, поэтому колонки добавляются после них
+ALTER TABLE Songs
+    ADD COLUMN IF NOT EXISTS artist_id INTEGER REFERENCES Artists(id) ON DELETE SET NULL,
+    ADD COLUMN IF NOT EXISTS album_id INTEGER REFERENCES Albums(id) ON DELETE SET NULL;
+
+-- Индексы под частые запросы (в программе строятся миграциями через CONCURRENTLY)
+CREATE INDEX IF NOT EXISTS playlistsongs_position_idx ON PlaylistSongs (playlist_id, song_order, song_id);
+CREATE INDEX IF NOT EXISTS playbackhistory_user_played_idx ON PlaybackHistory (user_id, played_at DESC);
+CREATE INDEX IF NOT EXISTS songgenres_genre_idx ON SongGenres (genre_id, song_id);
+CREATE INDEX IF NOT EXISTS songs_title_id_idx ON Songs (title, id);
+CREATE INDEX IF NOT EXISTS songs_artist_id_idx ON Songs (artist_id);
+CREATE INDEX IF NOT EXISTS songs_album_id_idx ON Songs (album_id);
+
+-- Построчные уведомления об изменениях каталога (CatalogCache): "таблица:I|U|D:id"
+-- или "playlistsongs:I|U|D:playlist_id:song_id" в канал catalog_changes
+CREATE OR REPLACE FUNCTION notify_catalog_change() RETURNS trigger AS $$
+DECLARE
+    changed RECORD;
+BEGIN
+    IF TG_OP = 'DELETE' THEN
+        changed := OLD;
+    ELSE
+        changed := NEW;
+    END IF;
+    IF TG_TABLE_NAME = 'playlistsongs' THEN
+        PERFORM pg_notify('catalog_changes', TG_TABLE_NAME || ':' || left(TG_OP, 1) || ':'
+                          || changed.playlist_id || ':' || changed.song_id);
+    ELSE
+        PERFORM pg_notify('catalog_changes', TG_TABLE_NAME || ':' || left(TG_OP, 1) || ':' || changed.id);
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS songs_notify_change ON Songs;
+CREATE TRIGGER songs_notify_change
+    AFTER INSERT OR DELETE OR UPDATE OF title, artist, album, file_path, duration_ms ON Songs
+    FOR EACH ROW EXECUTE FUNCTION notify_catalog_change();
+DROP TRIGGER IF EXISTS playlists_notify_change ON Playlists;
+CREATE TRIGGER playlists_notify_change AFTER INSERT OR UPDATE OR DELETE ON Playlists
+    FOR EACH ROW EXECUTE FUNCTION notify_catalog_change();
+DROP TRIGGER IF EXISTS playlistsongs_notify_change ON PlaylistSongs;
+CREATE TRIGGER playlistsongs_notify_change AFTER INSERT OR UPDATE OR DELETE ON PlaylistSongs
+    FOR EACH ROW EXECUTE FUNCTION notify_catalog_change();
+
+-- Счетчик изменений библиотеки (LibrarySnapshot): растет на каждый оператор,
+-- меняющий отображаемые колонки Songs
+CREATE TABLE IF NOT EXISTS CatalogRevision (
+    id BOOLEAN PRIMARY KEY DEFAULT TRUE CHECK (id),
+    revision BIGINT NOT NULL DEFAULT 0
+);
+INSERT INTO CatalogRevision (id, revision) VALUES (TRUE, 0) ON CONFLICT (id) DO NOTHING;
+
+CREATE OR REPLACE FUNCTION bump_catalog_revision() RETURNS trigger AS $$
+BEGIN
+    UPDATE CatalogRevision SET revision = revision + 1;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS songs_bump_revision ON Songs;
+CREATE TRIGGER songs_bump_revision
+    AFTER INSERT OR DELETE OR UPDATE OF title, artist, album, file_path, duration_ms ON Songs
+    FOR EACH STATEMENT EXECUTE FUNCTION bump_catalog_revision();
+
+-- Версия схемы (SchemaMigrator): база, созданная этим скриптом, соответствует версии 7
+CREATE TABLE IF NOT EXISTS schema_version (
+    version INTEGER PRIMARY KEY,
+    description TEXT NOT NULL,
+    applied_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP
+);
+
+INSERT INTO schema_version (version, description) VALUES
+    (1, 'Базовые таблицы'),
+    (2, 'Колонки громкости'),
+    (3, 'Индексы плейлистов, истории, жанров и страниц библиотеки'),
+    (4, 'Связь Songs с Artists и Albums'),
+    (5, 'Разреженные ключи порядка в плейлистах'),
+    (6, 'Уведомления об изменениях каталога'),
+    (7, 'Счетчик изменений библиотеки')
+ON CONFLICT (version) DO NOTHING;
@@ -0,0 +1,256 @@
+#include "query_metrics.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+
+namespace {
+
+// Экранирование значения метки Prometheus: обратная косая черта, кавычка и перевод строки
+QString labelValue(const QString &value)
+{
+    QString escaped = value;
+    escaped.replace(u'\\', QLatin1String("\\\\"));
+    escaped.replace(u'"', QLatin1String("\\\""));
+    escaped.replace(u'\n', QLatin1String("\\n"));
+    return escaped;
+}
+
+QString number(double value)
+{
+    return QString::number(value, 'g', 9);
+}
+
+} // namespace
+
+QueryMetrics &QueryMetrics::instance()
+{
+    static QueryMetrics metrics;
+    return metrics;
+}
+
+QueryMetrics::QueryMetrics()
+{
+    m_clock.start();
+}
+
+QString QueryMetrics::metricName(const QString &statementId)
+{
+    const qsizetype slash = statementId.lastIndexOf(u'/');
+    if (slash <= 0 || slash == statementId.size() - 1) {
+        return statementId;
+    }
+    for (qsizetype i = slash + 1; i < statementId.size(); ++i) {
+        if (!statementId.at(i).isDigit()) {
+            return statementId;
+        }
+    }
+    return statementId.left(slash);
+}
+
+bool QueryMetrics::record(const QString &statement, qint64 elapsedNs, bool ok)
+{
+    const double ms = double(elapsedNs) / 1e6;
+    const int threshold = m_slowQueryThresholdMs.load(std::memory_order_relaxed);
+    const bool slow = threshold > 0 && ms >= threshold;
+
+    QMutexLocker locker(&m_mutex);
+    Entry &entry = m_entries[statement];
+    ++entry.calls;
+    entry.latency.add(ms);
+    if (!ok) {
+        ++entry.errors;
+        return false; // план ошибочного запроса ничего не объяснит
+    }
+    if (!slow) {
+        return false;
+    }
+    ++entry.slowCalls;
+    const qint64 now = m_clock.elapsed();
+    if (entry.planRequestedAt >= 0 && now - entry.planRequestedAt < PlanIntervalMs) {
+        return false;
+    }
+    entry.planRequestedAt = now;
+    return true;
+}
+
+void QueryMetrics::addRows(const QString &statement, qint64 rows)
+{
+    if (rows <= 0) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    m_entries[statement].rows += quint64(rows);
+}
+
+void QueryMetrics::setPlan(const QString &statement, const QString &plan)
+{
+    QMutexLocker locker(&m_mutex);
+    Entry &entry = m_entries[statement];
+    entry.plan = plan;
+    entry.planCapturedAt = QDateTime::currentDateTime();
+}
+
+void QueryMetrics::setStatementCacheStats(const StatementCacheStats &stats)
+{
+    QMutexLocker locker(&m_mutex);
+    m_statementCaches.insert(stats.connection, stats);
+}
+
+void QueryMetrics::removeStatementCacheStats(const QString &connection)
+{
+    QMutexLocker locker(&m_mutex);
+    m_statementCaches.remove(connection);
+}
+
+void QueryMetrics::setSlowQueryThresholdMs(int ms)
+{
+    m_slowQueryThresholdMs.store(ms, std::memory_order_relaxed);
+}
+
+int QueryMetrics::slowQueryThresholdMs() const
+{
+    return m_slowQueryThresholdMs.load(std::memory_order_relaxed);
+}
+
+QList<QueryStats> QueryMetrics::stats() const
+{
+    QList<QueryStats> result;
+    {
+        QMutexLocker locker(&m_mutex);
+        result.reserve(m_entries.size());
+        for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+            const Entry &entry = it.value();
+            QueryStats stats;
+            stats.statement = it.key();
+            stats.calls = entry.calls;
+            stats.errors = entry.errors;
+            stats.rows = entry.rows;
+            stats.slowCalls = entry.slowCalls;
+            stats.totalMs = entry.latency.sum();
+            stats.maxMs = entry.latency.max();
+            stats.p50Ms = entry.latency.quantile(0.50);
+            stats.p95Ms = entry.latency.quantile(0.95);
+            stats.p99Ms = entry.latency.quantile(0.99);
+            stats.plan = entry.plan;
+            stats.planCapturedAt = entry.planCapturedAt;
+            result.append(stats);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const QueryStats &a, const QueryStats &b) {
+        return a.totalMs != b.totalMs ? a.totalMs > b.totalMs : a.statement < b.statement;
+    });
+    return result;
+}
+
+QList<StatementCacheStats> QueryMetrics::statementCacheStats() const
+{
+    QList<StatementCacheStats> result;
+    {
+        QMutexLocker locker(&m_mutex);
+        result = m_statementCaches.values();
+    }
+    std::sort(result.begin(), result.end(), [](const StatementCacheStats &a, const StatementCacheStats &b) {
+        return a.connection < b.connection;
+    });
+    return result;
+}
+
+// Счетчики кэша не сбрасываются: они принадлежат соединениям и придут снова со следующим запросом
+void QueryMetrics::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+}
+
+QString QueryMetrics::prometheusText() const
+{
+    QList<QueryStats> all = stats();
+    // Стабильный порядок строк удобнее сравнивать между выгрузками
+    std::sort(all.begin(), all.end(), [](const QueryStats &a, const QueryStats &b) {
+        return a.statement < b.statement;
+    });
+
+    QString text;
+    text += "# HELP musicplayer_db_query_duration_seconds Query execution time per DatabaseManager statement.\n"
+            "# TYPE musicplayer_db_query_duration_seconds summary\n";
+    for (const QueryStats &stats : std::as_const(all)) {
+        const QString label = "statement=\"" + labelValue(stats.statement) + "\"";
+        const std::pair<const char *, double> quantiles[] = {
+            {"0.5", stats.p50Ms}, {"0.95", stats.p95Ms}, {"0.99", stats.p99Ms}};
+        for (const auto &quantile : quantiles) {
+            text += QString("musicplayer_db_query_duration_seconds{%1,quantile=\"%2\"} %3\n")
+                        .arg(label, QLatin1String(quantile.first), number(quantile.second / 1000.0));
+        }
+        text += QString("musicplayer_db_query_duration_seconds_sum{%1} %2\n").arg(label, number(stats.totalMs / 1000.0));
+        text += QString("musicplayer_db_query_duration_seconds_count{%1} %2\n").arg(label).arg(stats.calls);
+    }
+
+    const struct {
+        const char *name;
+        const char *help;
+        quint64 QueryStats::*field;
+    } counters[] = {
+        {"musicplayer_db_query_errors_total", "Failed executions per statement.", &QueryStats::errors},
+        {"musicplayer_db_query_rows_total", "Rows read or changed per statement.", &QueryStats::rows},
+        {"musicplayer_db_slow_queries_total", "Executions above the slow query threshold.", &QueryStats::slowCalls},
+    };
+    for (const auto &counter : counters) {
+        text += QString("# HELP %1 %2\n# TYPE %1 counter\n").arg(QLatin1String(counter.name), QLatin1String(counter.help));
+        for (const QueryStats &stats : std::as_const(all)) {
+            text += QString("%1{statement=\"%2\"} %3\n")
+                        .arg(QLatin1String(counter.name), labelValue(stats.statement))
+                        .arg(stats.*counter.field);
+        }
+    }
+
+    const QList<StatementCacheStats> caches = statementCacheStats();
+    const struct {
+        const char *name;
+        const char *help;
+        quint64 StatementCacheStats::*field;
+    } cacheCounters[] = {
+        {"musicplayer_db_statement_cache_hits_total", "Prepared statement cache hits per connection.",
+         &StatementCacheStats::hits},
+        {"musicplayer_db_statement_cache_misses_total", "Statements prepared per connection.",
+         &StatementCacheStats::misses},
+        {"musicplayer_db_statement_cache_evictions_total", "Least recently used statements evicted per connection.",
+         &StatementCacheStats::evictions},
+        {"musicplayer_db_statement_cache_rebuilds_total", "Cache rebuilds after a lost connection.",
+         &StatementCacheStats::rebuilds},
+    };
+    for (const auto &counter : cacheCounters) {
+        text += QString("# HELP %1 %2\n# TYPE %1 counter\n").arg(QLatin1String(counter.name), QLatin1String(counter.help));
+        for (const StatementCacheStats &stats : caches) {
+            text += QString("%1{connection=\"%2\"} %3\n")
+                        .arg(QLatin1String(counter.name), labelValue(stats.connection))
+                        .arg(stats.*counter.field);
+        }
+    }
+    text += "# HELP musicplayer_db_statement_cache_size Prepared statements held per connection.\n"
+            "# TYPE musicplayer_db_statement_cache_size gauge\n";
+    for (const StatementCacheStats &stats : caches) {
+        text += QString("musicplayer_db_statement_cache_size{connection=\"%1\"} %2\n")
+                    .arg(labelValue(stats.connection))
+                    .arg(stats.size);
+    }
+    return text;
+}
+
+bool QueryMetrics::writePrometheusFile(const QString &path) const
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Не удалось записать метрики запросов:" << path;
+        return false;
+    }
+    file.write(prometheusText().toUtf8());
+    if (!file.commit()) {
+        qDebug() << "Не удалось записать метрики запросов:" << path << file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef QUERY_METRICS_H
+#define QUERY_METRICS_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include "latency_histogram.h"
+
+// Сводка по одному запросу DatabaseManager
+struct QueryStats {
+    QString statement;
+    quint64 calls = 0;     // вместе с ошибочными
+    quint64 errors = 0;
+    quint64 rows = 0;      // прочитанных строк выборки или измененных строк
+    quint64 slowCalls = 0; // дольше порога медленного запроса
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    QString plan;          // EXPLAIN последнего медленного выполнения, если снимался
+    QDateTime planCapturedAt;
+};
+
+// Счетчики кэша подготовленных запросов одного соединения DatabaseManager
+struct StatementCacheStats {
+    QString connection;    // имя соединения; "main" — основное
+    quint64 hits = 0;
+    quint64 misses = 0;    // первая подготовка или повторная после переподключения
+    quint64 rebuilds = 0;  // сколько раз кэш пересоздавался после потери соединения
+    quint64 evictions = 0; // вытеснены как давно не использовавшиеся
+    int size = 0;
+};
+
+// Метрики запросов из кэша DatabaseManager, общие для всех соединений процесса:
+// число вызовов, ошибок и строк и гистограмма времени выполнения на каждый запрос.
+// Для запросов дольше порога (настройка diagnostics/slowQueryMs) соединение снимает план
+// EXPLAIN — не чаще раза в PlanIntervalMs на запрос, потому что EXPLAIN ANALYZE выполняет
+// запрос повторно (только для чтения и вне транзакций; запись получает план без ANALYZE).
+// Сводка выгружается в текстовом формате Prometheus.
+class QueryMetrics
+{
+public:
+    static QueryMetrics &instance();
+
+    // "addSongs/250" -> "addSongs": размер пачки в ID запроса не должен плодить метрики
+    static QString metricName(const QString &statementId);
+
+    // true, если выполнение медленное и для запроса пора снять новый план
+    bool record(const QString &statement, qint64 elapsedNs, bool ok);
+    void addRows(const QString &statement, qint64 rows);
+    void setPlan(const QString &statement, const QString &plan);
+    // Кэш подготовленных запросов по соединениям: соединение обновляет свои счетчики
+    // после каждого запроса и убирает их при закрытии
+    void setStatementCacheStats(const StatementCacheStats &stats);
+    void removeStatementCacheStats(const QString &connection);
+
+    void setSlowQueryThresholdMs(int ms); // <= 0 — медленные запросы не отслеживаются
+    int slowQueryThresholdMs() const;
+
+    // По убыванию суммарного времени: сверху то, что сильнее всего нагружает БД
+    QList<QueryStats> stats() const;
+    // По имени соединения
+    QList<StatementCacheStats> statementCacheStats() const;
+    void reset();
+
+    QString prometheusText() const;
+    // Атомарная запись: сборщик (например, textfile collector node_exporter) не увидит
+    // наполовину записанный файл
+    bool writePrometheusFile(const QString &path) const;
+
+private:
+    QueryMetrics();
+
+    static constexpr qint64 PlanIntervalMs = 10 * 60 * 1000;
+
+    struct Entry {
+        LatencyHistogram latency;
+        quint64 calls = 0;
+        quint64 errors = 0;
+        quint64 rows = 0;
+        quint64 slowCalls = 0;
+        qint64 planRequestedAt = -1; // по m_clock
+        QString plan;
+        QDateTime planCapturedAt;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    QHash<QString, StatementCacheStats> m_statementCaches;
+    QElapsedTimer m_clock;
+    std::atomic<int> m_slowQueryThresholdMs{200};
+};
+
+#endif // QUERY_METRICS_H
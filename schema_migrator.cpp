@@ -0,0 +1,539 @@
+#include "schema_migrator.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+
+// Ключ рекомендательной блокировки миграций ("MPSM")
+const qint64 migrationLockKey = 0x4D50534D;
+// Сборка индексов CONCURRENTLY на большой библиотеке может идти долго
+const int migrationLockPollMs = 250;
+const qint64 migrationLockTimeoutMs = 30 * 60 * 1000;
+
+QList<SchemaMigration> buildMigrations()
+{
+    QList<SchemaMigration> migrations;
+
+    // Таблицы, которые раньше создавались при каждом запуске. IF NOT EXISTS — для баз,
+    // созданных до появления schema_version
+    migrations.append({1, "Базовые таблицы", {
+        "CREATE TABLE IF NOT EXISTS Songs ("
+        "id SERIAL PRIMARY KEY,"
+        "title VARCHAR(255) NOT NULL,"
+        "artist VARCHAR(255),"
+        "album VARCHAR(255),"
+        "file_path TEXT NOT NULL UNIQUE,"
+        "duration_ms INTEGER"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Playlists ("
+        "id SERIAL PRIMARY KEY,"
+        "name VARCHAR(255) NOT NULL UNIQUE"
+        ");",
+        "CREATE TABLE IF NOT EXISTS PlaylistSongs ("
+        "playlist_id INTEGER REFERENCES Playlists(id) ON DELETE CASCADE,"
+        "song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,"
+        "song_order INTEGER,"
+        "PRIMARY KEY (playlist_id, song_id)"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Artists ("
+        "id SERIAL PRIMARY KEY,"
+        "name VARCHAR(255) NOT NULL UNIQUE,"
+        "bio TEXT"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Albums ("
+        "id SERIAL PRIMARY KEY,"
+        "title VARCHAR(255) NOT NULL,"
+        "artist_id INTEGER REFERENCES Artists(id) ON DELETE SET NULL,"
+        "release_year INTEGER,"
+        "UNIQUE(title, artist_id)"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Genres ("
+        "id SERIAL PRIMARY KEY,"
+        "name VARCHAR(255) NOT NULL UNIQUE"
+        ");",
+        "CREATE TABLE IF NOT EXISTS SongGenres ("
+        "song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,"
+        "genre_id INTEGER REFERENCES Genres(id) ON DELETE CASCADE,"
+        "PRIMARY KEY (song_id, genre_id)"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Users ("
+        "id SERIAL PRIMARY KEY,"
+        "username VARCHAR(255) NOT NULL UNIQUE,"
+        "password_hash TEXT NOT NULL,"
+        "email VARCHAR(255) UNIQUE"
+        ");",
+        "CREATE TABLE IF NOT EXISTS PlaybackHistory ("
+        "id SERIAL PRIMARY KEY,"
+        "user_id INTEGER REFERENCES Users(id) ON DELETE CASCADE,"
+        "song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,"
+        "played_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP"
+        ");",
+    }, {}});
+
+    // Громкость по EBU R128 (LoudnessScanner)
+    migrations.append({2, "Колонки громкости", {
+        "ALTER TABLE Songs "
+        "ADD COLUMN IF NOT EXISTS file_mtime BIGINT,"
+        "ADD COLUMN IF NOT EXISTS file_size BIGINT,"
+        "ADD COLUMN IF NOT EXISTS loudness_lufs REAL,"
+        "ADD COLUMN IF NOT EXISTS loudness_range_lu REAL,"
+        "ADD COLUMN IF NOT EXISTS true_peak_dbtp REAL,"
+        "ADD COLUMN IF NOT EXISTS replaygain_track_db REAL,"
+        "ADD COLUMN IF NOT EXISTS replaygain_album_db REAL,"
+        "ADD COLUMN IF NOT EXISTS album_true_peak_dbtp REAL,"
+        "ADD COLUMN IF NOT EXISTS loudness_histogram BYTEA,"
+        "ADD COLUMN IF NOT EXISTS loudness_scanned_at TIMESTAMP;",
+        "ALTER TABLE Albums "
+        "ADD COLUMN IF NOT EXISTS loudness_lufs REAL,"
+        "ADD COLUMN IF NOT EXISTS loudness_range_lu REAL,"
+        "ADD COLUMN IF NOT EXISTS true_peak_dbtp REAL,"
+        "ADD COLUMN IF NOT EXISTS replaygain_db REAL;",
+    }, {}});
+
+    // Индексы под частые запросы. Выражение song_order совпадает с ORDER BY в
+    // getSongsInPlaylist*, иначе планировщик его не использует
+    migrations.append({3, "Индексы плейлистов, истории, жанров и страниц библиотеки", {}, {
+        {"playlistsongs_order_idx", "ON PlaylistSongs (playlist_id, (COALESCE(song_order, 0)), song_id)"},
+        {"playbackhistory_user_played_idx", "ON PlaybackHistory (user_id, played_at DESC)"},
+        {"songgenres_genre_idx", "ON SongGenres (genre_id, song_id)"},
+        {"songs_title_id_idx", "ON Songs (title, id)"},
+    }});
+
+    // Связь песен со справочниками; текстовые artist/album остаются для отображения
+    // и заполняют ID через CatalogNormalizer. Индексы нужны ON DELETE SET NULL и выборкам по ID
+    migrations.append({4, "Связь Songs с Artists и Albums", {
+        "ALTER TABLE Songs "
+        "ADD COLUMN IF NOT EXISTS artist_id INTEGER REFERENCES Artists(id) ON DELETE SET NULL,"
+        "ADD COLUMN IF NOT EXISTS album_id INTEGER REFERENCES Albums(id) ON DELETE SET NULL;",
+    }, {
+        {"songs_artist_id_idx", "ON Songs (artist_id)"},
+        {"songs_album_id_idx", "ON Songs (album_id)"},
+    }});
+
+    // Разреженный порядок в плейлистах: BIGINT-ключи с шагом 65536 (DatabaseManager::PlaylistOrderGap),
+    // чтобы вставка и перемещение не перенумеровывали соседей. Существующий порядок сохраняется
+    migrations.append({5, "Разреженные ключи порядка в плейлистах", {
+        "DROP INDEX IF EXISTS playlistsongs_order_idx;",
+        "ALTER TABLE PlaylistSongs ALTER COLUMN song_order TYPE BIGINT;",
+        "UPDATE PlaylistSongs ps SET song_order = r.position * 65536 "
+        "FROM (SELECT playlist_id, song_id, ROW_NUMBER() OVER "
+        "(PARTITION BY playlist_id ORDER BY COALESCE(song_order, 0), song_id) AS position "
+        "FROM PlaylistSongs) r "
+        "WHERE ps.playlist_id = r.playlist_id AND ps.song_id = r.song_id;",
+        "ALTER TABLE PlaylistSongs ALTER COLUMN song_order SET NOT NULL;",
+    }, {
+        {"playlistsongs_position_idx", "ON PlaylistSongs (playlist_id, song_order, song_id)"},
+    }});
+
+    // Построчные уведомления об изменениях каталога для CatalogCache других копий программы:
+    // "таблица:I|U|D:id" или "playlistsongs:I|U|D:playlist_id:song_id". Songs уведомляет
+    // только об отображаемых колонках, чтобы запись громкости не порождала поток событий.
+    // Одинаковые уведомления одной транзакции PostgreSQL доставляет один раз
+    migrations.append({6, "Уведомления об изменениях каталога", {
+        "CREATE OR REPLACE FUNCTION notify_catalog_change() RETURNS trigger AS $$ "
+        "DECLARE changed RECORD; "
+        "BEGIN "
+        "IF TG_OP = 'DELETE' THEN changed := OLD; ELSE changed := NEW; END IF; "
+        "IF TG_TABLE_NAME = 'playlistsongs' THEN "
+        "PERFORM pg_notify('catalog_changes', TG_TABLE_NAME || ':' || left(TG_OP, 1) || ':' "
+        "|| changed.playlist_id || ':' || changed.song_id); "
+        "ELSE "
+        "PERFORM pg_notify('catalog_changes', TG_TABLE_NAME || ':' || left(TG_OP, 1) || ':' || changed.id); "
+        "END IF; "
+        "RETURN NULL; "
+        "END; $$ LANGUAGE plpgsql;",
+        "DROP TRIGGER IF EXISTS songs_notify_change ON Songs;",
+        "CREATE TRIGGER songs_notify_change "
+        "AFTER INSERT OR DELETE OR UPDATE OF title, artist, album, file_path, duration_ms ON Songs "
+        "FOR EACH ROW EXECUTE FUNCTION notify_catalog_change();",
+        "DROP TRIGGER IF EXISTS playlists_notify_change ON Playlists;",
+        "CREATE TRIGGER playlists_notify_change AFTER INSERT OR UPDATE OR DELETE ON Playlists "
+        "FOR EACH ROW EXECUTE FUNCTION notify_catalog_change();",
+        "DROP TRIGGER IF EXISTS playlistsongs_notify_change ON PlaylistSongs;",
+        "CREATE TRIGGER playlistsongs_notify_change AFTER INSERT OR UPDATE OR DELETE ON PlaylistSongs "
+        "FOR EACH ROW EXECUTE FUNCTION notify_catalog_change();",
+    }, {}});
+
+    // Счетчик изменений библиотеки для снимка LibrarySnapshot: растет на каждый оператор,
+    // меняющий отображаемые колонки Songs. Одна строка, поэтому снимок, прочитанный в той же
+    // транзакции, что и счетчик, точно ему соответствует
+    migrations.append({7, "Счетчик изменений библиотеки", {
+        "CREATE TABLE IF NOT EXISTS CatalogRevision ("
+        "id BOOLEAN PRIMARY KEY DEFAULT TRUE CHECK (id),"
+        "revision BIGINT NOT NULL DEFAULT 0"
+        ");",
+        "INSERT INTO CatalogRevision (id, revision) VALUES (TRUE, 0) ON CONFLICT (id) DO NOTHING;",
+        "CREATE OR REPLACE FUNCTION bump_catalog_revision() RETURNS trigger AS $$ "
+        "BEGIN "
+        "UPDATE CatalogRevision SET revision = revision + 1; "
+        "RETURN NULL; "
+        "END; $$ LANGUAGE plpgsql;",
+        "DROP TRIGGER IF EXISTS songs_bump_revision ON Songs;",
+        "CREATE TRIGGER songs_bump_revision "
+        "AFTER INSERT OR DELETE OR UPDATE OF title, artist, album, file_path, duration_ms ON Songs "
+        "FOR EACH STATEMENT EXECUTE FUNCTION bump_catalog_revision();",
+    }, {}});
+
+    // Триграммный индекс для поиска на сервере (search/backend=pg_trgm). Строится CONCURRENTLY,
+    // чтобы на большой библиотеке не блокировать запись в Songs; выражение совпадает с
+    // DatabaseManager::searchSongs. Без pg_trgm остается поиск в памяти
+    migrations.append({8, "Триграммный индекс поиска", {}, {
+        {"songs_search_trgm_idx", "ON Songs USING GIN "
+                                  "(lower(title || ' ' || COALESCE(artist, '') || ' ' || COALESCE(album, '')) gin_trgm_ops)"},
+    }, "pg_trgm"});
+
+    // Обновление единственной строки CatalogRevision выстраивало пишущие в Songs транзакции
+    // в очередь за блокировкой этой строки до их фиксации. Теперь каждый оператор добавляет
+    // свою строку в CatalogChanges (вставки друг друга не ждут), а счетчик — сумма changes.
+    // Сумма видна по MVCC, как и прежняя строка: в транзакции снимка она соответствует данным,
+    // а после фиксации любой записи только растет. Свертка старых строк в одну сумму не меняет
+    migrations.append({9, "Счетчик изменений без общей строки", {
+        "CREATE TABLE IF NOT EXISTS CatalogChanges ("
+        "changes BIGINT NOT NULL DEFAULT 1"
+        ");",
+        "INSERT INTO CatalogChanges (changes) SELECT revision FROM CatalogRevision;",
+        "CREATE OR REPLACE FUNCTION bump_catalog_revision() RETURNS trigger AS $$ "
+        "BEGIN "
+        "INSERT INTO CatalogChanges DEFAULT VALUES; "
+        "RETURN NULL; "
+        "END; $$ LANGUAGE plpgsql;",
+        "DROP TABLE CatalogRevision;",
+    }, {}});
+
+    return migrations;
+}
+
+// Та же схема для SQLite одной миграцией: база создается сразу в версии 7 и дальше
+// получает миграции с теми же номерами, что и PostgreSQL. Вместо SERIAL — AUTOINCREMENT
+// (ID удаленных строк не переиспользуются, как и в последовательностях), вместо BYTEA —
+// BLOB, время — текст ISO 8601. Уведомлений нет; счетчик изменений растет построчными
+// триггерами, потому что операторных в SQLite нет. Общая строка CatalogRevision здесь
+// никого не задерживает: пишущая транзакция в SQLite и так одна
+QList<SchemaMigration> buildSqliteMigrations()
+{
+    QList<SchemaMigration> migrations;
+
+    migrations.append({7, "Базовая схема SQLite", {
+        "CREATE TABLE IF NOT EXISTS Artists ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "name TEXT NOT NULL UNIQUE,"
+        "bio TEXT"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Albums ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "title TEXT NOT NULL,"
+        "artist_id INTEGER REFERENCES Artists(id) ON DELETE SET NULL,"
+        "release_year INTEGER,"
+        "loudness_lufs REAL,"
+        "loudness_range_lu REAL,"
+        "true_peak_dbtp REAL,"
+        "replaygain_db REAL,"
+        "UNIQUE(title, artist_id)"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Songs ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "title TEXT NOT NULL,"
+        "artist TEXT,"
+        "album TEXT,"
+        "file_path TEXT NOT NULL UNIQUE,"
+        "duration_ms INTEGER,"
+        "file_mtime INTEGER,"
+        "file_size INTEGER,"
+        "loudness_lufs REAL,"
+        "loudness_range_lu REAL,"
+        "true_peak_dbtp REAL,"
+        "replaygain_track_db REAL,"
+        "replaygain_album_db REAL,"
+        "album_true_peak_dbtp REAL,"
+        "loudness_histogram BLOB,"
+        "loudness_scanned_at TEXT,"
+        "artist_id INTEGER REFERENCES Artists(id) ON DELETE SET NULL,"
+        "album_id INTEGER REFERENCES Albums(id) ON DELETE SET NULL"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Playlists ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "name TEXT NOT NULL UNIQUE"
+        ");",
+        "CREATE TABLE IF NOT EXISTS PlaylistSongs ("
+        "playlist_id INTEGER REFERENCES Playlists(id) ON DELETE CASCADE,"
+        "song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,"
+        "song_order INTEGER NOT NULL,"
+        "PRIMARY KEY (playlist_id, song_id)"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Genres ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "name TEXT NOT NULL UNIQUE"
+        ");",
+        "CREATE TABLE IF NOT EXISTS SongGenres ("
+        "song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,"
+        "genre_id INTEGER REFERENCES Genres(id) ON DELETE CASCADE,"
+        "PRIMARY KEY (song_id, genre_id)"
+        ");",
+        "CREATE TABLE IF NOT EXISTS Users ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "username TEXT NOT NULL UNIQUE,"
+        "password_hash TEXT NOT NULL,"
+        "email TEXT UNIQUE"
+        ");",
+        "CREATE TABLE IF NOT EXISTS PlaybackHistory ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "user_id INTEGER REFERENCES Users(id) ON DELETE CASCADE,"
+        "song_id INTEGER REFERENCES Songs(id) ON DELETE CASCADE,"
+        "played_at TEXT DEFAULT CURRENT_TIMESTAMP"
+        ");",
+        "CREATE INDEX IF NOT EXISTS playlistsongs_position_idx ON PlaylistSongs (playlist_id, song_order, song_id);",
+        "CREATE INDEX IF NOT EXISTS playbackhistory_user_played_idx ON PlaybackHistory (user_id, played_at DESC);",
+        "CREATE INDEX IF NOT EXISTS songgenres_genre_idx ON SongGenres (genre_id, song_id);",
+        "CREATE INDEX IF NOT EXISTS songs_title_id_idx ON Songs (title, id);",
+        "CREATE INDEX IF NOT EXISTS songs_artist_id_idx ON Songs (artist_id);",
+        "CREATE INDEX IF NOT EXISTS songs_album_id_idx ON Songs (album_id);",
+        "CREATE TABLE IF NOT EXISTS CatalogRevision ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1),"
+        "revision INTEGER NOT NULL DEFAULT 0"
+        ");",
+        "INSERT INTO CatalogRevision (id, revision) VALUES (1, 0) ON CONFLICT (id) DO NOTHING;",
+        "CREATE TRIGGER IF NOT EXISTS songs_bump_revision_insert AFTER INSERT ON Songs "
+        "BEGIN UPDATE CatalogRevision SET revision = revision + 1; END;",
+        "CREATE TRIGGER IF NOT EXISTS songs_bump_revision_delete AFTER DELETE ON Songs "
+        "BEGIN UPDATE CatalogRevision SET revision = revision + 1; END;",
+        "CREATE TRIGGER IF NOT EXISTS songs_bump_revision_update "
+        "AFTER UPDATE OF title, artist, album, file_path, duration_ms ON Songs "
+        "BEGIN UPDATE CatalogRevision SET revision = revision + 1; END;",
+    }, {}});
+
+    return migrations;
+}
+
+} // namespace
+
+SchemaMigrator::SchemaMigrator(const QSqlDatabase &db)
+    : m_db(db)
+    , m_sqlite(db.driverName() == "QSQLITE")
+{
+}
+
+const QList<SchemaMigration> &SchemaMigrator::migrations() const
+{
+    static const QList<SchemaMigration> list = buildMigrations();
+    static const QList<SchemaMigration> sqliteList = buildSqliteMigrations();
+    return m_sqlite ? sqliteList : list;
+}
+
+int SchemaMigrator::latestVersion() const
+{
+    return migrations().isEmpty() ? 0 : migrations().last().version;
+}
+
+bool SchemaMigrator::exec(const QString &sql)
+{
+    QSqlQuery query(m_db);
+    if (!query.exec(sql)) {
+        qDebug() << "Ошибка миграции схемы:" << query.lastError().text() << "\n" << sql;
+        return false;
+    }
+    return true;
+}
+
+int SchemaMigrator::currentVersion()
+{
+    QSqlQuery query(m_db);
+    if (!query.exec("SELECT COALESCE(MAX(version), 0) FROM schema_version;") || !query.next()) {
+        qDebug() << "Ошибка чтения версии схемы:" << query.lastError().text();
+        return -1;
+    }
+    return query.value(0).toInt();
+}
+
+QSet<int> SchemaMigrator::appliedVersions(bool *ok)
+{
+    QSet<int> versions;
+    QSqlQuery query(m_db);
+    const bool success = query.exec("SELECT version FROM schema_version;");
+    if (success) {
+        while (query.next()) {
+            versions.insert(query.value(0).toInt());
+        }
+    } else {
+        qDebug() << "Ошибка чтения версий схемы:" << query.lastError().text();
+    }
+    if (ok) {
+        *ok = success;
+    }
+    return versions;
+}
+
+bool SchemaMigrator::migrate()
+{
+    // В SQLite миграции сериализует блокировка записи транзакции BEGIN IMMEDIATE,
+    // а все операторы базовой схемы повторяемы
+    if (m_sqlite) {
+        return applyPending();
+    }
+    // Сессионная блокировка: вторая копия программы дождется, пока первая закончит
+    if (!lockMigrations()) {
+        return false;
+    }
+    const bool success = applyPending();
+    exec(QString("SELECT pg_advisory_unlock(%1);").arg(migrationLockKey));
+    return success;
+}
+
+bool SchemaMigrator::lockMigrations()
+{
+    // Ожидание в pg_advisory_lock держит снимок, а CREATE INDEX CONCURRENTLY у держателя
+    // блокировки ждет завершения всех снимков — вышла бы взаимоблокировка. Поэтому
+    // блокировка берется попытками, а между ними у сессии нет открытого запроса
+    QElapsedTimer waited;
+    waited.start();
+    bool reported = false;
+    QSqlQuery query(m_db);
+    forever {
+        if (!query.exec(QString("SELECT pg_try_advisory_lock(%1);").arg(migrationLockKey)) || !query.next()) {
+            qDebug() << "Ошибка блокировки миграций:" << query.lastError().text();
+            return false;
+        }
+        const bool locked = query.value(0).toBool();
+        query.finish();
+        if (locked) {
+            return true;
+        }
+        if (waited.elapsed() > migrationLockTimeoutMs) {
+            qDebug() << "Не дождались миграции схемы другой копией программы";
+            return false;
+        }
+        if (!reported) {
+            qDebug() << "Схему обновляет другая копия программы, ожидание";
+            reported = true;
+        }
+        QThread::msleep(migrationLockPollMs);
+    }
+}
+
+bool SchemaMigrator::applyPending()
+{
+    if (!exec("CREATE TABLE IF NOT EXISTS schema_version ("
+              "version INTEGER PRIMARY KEY,"
+              "description TEXT NOT NULL,"
+              "applied_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP"
+              ");")) {
+        return false;
+    }
+
+    bool ok = false;
+    const QSet<int> applied = appliedVersions(&ok);
+    if (!ok) {
+        return false;
+    }
+    const int current = applied.isEmpty() ? 0 : *std::max_element(applied.cbegin(), applied.cend());
+    if (current > latestVersion()) {
+        // Базу обновила более новая версия программы; известные нам таблицы в ней есть
+        qDebug() << "Версия схемы БД" << current << "новее известной программе" << latestVersion();
+        return true;
+    }
+
+    // Номера сверяются по одному, а не с максимумом: пропущенная из-за расширения
+    // миграция применится, когда расширение появится, даже если за ней есть новые
+    for (const SchemaMigration &migration : migrations()) {
+        if (applied.contains(migration.version)) {
+            continue;
+        }
+        if (!migration.extension.isEmpty() && !createExtension(migration.extension)) {
+            qDebug() << "Миграция схемы" << migration.version << "пропущена: нет расширения" << migration.extension;
+            continue;
+        }
+        if (!apply(migration)) {
+            qDebug() << "Миграция схемы" << migration.version << "не применена:" << migration.description;
+            return false;
+        }
+        qDebug() << "Применена миграция схемы" << migration.version << ":" << migration.description;
+    }
+    return true;
+}
+
+bool SchemaMigrator::apply(const SchemaMigration &migration)
+{
+    const bool hasIndexes = !migration.indexes.isEmpty();
+    if (!migration.statements.isEmpty()) {
+        if (m_sqlite ? !exec("BEGIN IMMEDIATE;") : !m_db.transaction()) {
+            qDebug() << "Не удалось начать транзакцию миграции:" << m_db.lastError().text();
+            return false;
+        }
+        for (const QString &sql : migration.statements) {
+            if (!exec(sql)) {
+                m_db.rollback();
+                return false;
+            }
+        }
+        if (!hasIndexes && !recordVersion(migration)) {
+            m_db.rollback();
+            return false;
+        }
+        if (!m_db.commit()) {
+            qDebug() << "Ошибка фиксации миграции:" << m_db.lastError().text();
+            m_db.rollback();
+            return false;
+        }
+    }
+
+    // Если сборка индекса прервется, версия не запишется и миграция повторится
+    // при следующем запуске; уже построенные индексы будут пропущены
+    for (const ConcurrentIndex &index : migration.indexes) {
+        if (!createIndexConcurrently(index)) {
+            return false;
+        }
+    }
+    return !hasIndexes || recordVersion(migration);
+}
+
+bool SchemaMigrator::recordVersion(const SchemaMigration &migration)
+{
+    QSqlQuery query(m_db);
+    query.prepare("INSERT INTO schema_version (version, description) VALUES (?, ?) "
+                  "ON CONFLICT (version) DO NOTHING;");
+    query.addBindValue(migration.version);
+    query.addBindValue(migration.description);
+    if (!query.exec()) {
+        qDebug() << "Ошибка записи версии схемы:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SchemaMigrator::createIndexConcurrently(const ConcurrentIndex &index)
+{
+    // Прерванный CREATE INDEX CONCURRENTLY оставляет невалидный индекс, который
+    // IF NOT EXISTS не пересоздаст: такой индекс сначала удаляется
+    QSqlQuery query(m_db);
+    query.prepare("SELECT indisvalid FROM pg_index WHERE indexrelid = to_regclass(CAST(? AS TEXT));");
+    query.addBindValue(index.name);
+    if (!query.exec()) {
+        qDebug() << "Ошибка проверки индекса" << index.name << ":" << query.lastError().text();
+        return false;
+    }
+    if (query.next()) {
+        if (query.value(0).toBool()) {
+            return true;
+        }
+        if (!exec("DROP INDEX CONCURRENTLY IF EXISTS " + index.name + ";")) {
+            return false;
+        }
+    }
+    return exec("CREATE INDEX CONCURRENTLY IF NOT EXISTS " + index.name + " " + index.definition + ";");
+}
+
+bool SchemaMigrator::createExtension(const QString &name)
+{
+    // Расширение, которого нет на сервере, — не ошибка; отказ в правах на CREATE попадет в журнал
+    QSqlQuery query(m_db);
+    query.prepare("SELECT 1 FROM pg_available_extensions WHERE name = ?;");
+    query.addBindValue(name);
+    if (!query.exec() || !query.next()) {
+        return false;
+    }
+    return exec("CREATE EXTENSION IF NOT EXISTS " + name + ";");
+}
@@ -0,0 +1,61 @@
+#ifndef SCHEMA_MIGRATOR_H
+#define SCHEMA_MIGRATOR_H
+
+#include <QList>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+
+// Индекс, который строится CREATE INDEX CONCURRENTLY — без блокировки записи в таблицу
+struct ConcurrentIndex {
+    QString name;
+    QString definition; // все после имени: "ON Table (columns)"
+};
+
+// Одна версия схемы. statements выполняются в одной транзакции вместе с записью
+// в schema_version. CONCURRENTLY внутри транзакции невозможен, поэтому индексы
+// строятся после нее по одному, а версия записывается, когда построены все.
+// Миграция с extension применяется, только если расширение удалось установить; иначе
+// она пропускается без записи версии и повторяется при следующем запуске
+struct SchemaMigration {
+    int version;
+    QString description;
+    QStringList statements;
+    QList<ConcurrentIndex> indexes;
+    QString extension; // например, "pg_trgm"; пусто — без расширения
+};
+
+// Приводит схему БД к последней версии. Текущая версия хранится в таблице
+// schema_version; новые миграции добавляются в конец списка migrations() со следующим
+// номером, уже выпущенные не меняются. Одновременный запуск нескольких копий программы
+// сериализуется рекомендательной блокировкой PostgreSQL. Для SQLite свой список миграций
+// (по драйверу соединения) с базовой схемой в версии 7 и теми же номерами дальше
+class SchemaMigrator
+{
+public:
+    explicit SchemaMigrator(const QSqlDatabase &db);
+
+    const QList<SchemaMigration> &migrations() const;
+    int latestVersion() const;
+
+    // -1 — ошибка чтения; 0 — схема еще не создавалась
+    int currentVersion();
+    // Записанные в schema_version версии; пропущенные миграции в них отсутствуют
+    QSet<int> appliedVersions(bool *ok = nullptr);
+    bool migrate();
+
+private:
+    bool lockMigrations();
+    bool applyPending();
+    bool apply(const SchemaMigration &migration);
+    bool recordVersion(const SchemaMigration &migration);
+    bool createIndexConcurrently(const ConcurrentIndex &index);
+    bool createExtension(const QString &name);
+    bool exec(const QString &sql);
+
+    QSqlDatabase m_db;
+    bool m_sqlite;
+};
+
+#endif // SCHEMA_MIGRATOR_H
@@ -0,0 +1,350 @@
+#include "search_index.h"
+
+#include <QSet>
+#include <QStringList>
+#include <QVarLengthArray>
+#include <algorithm>
+
+namespace {
+
+using PostingLists = QVarLengthArray<const QVector<int> *, 32>;
+
+void sortBySize(PostingLists &lists)
+{
+    std::sort(lists.begin(), lists.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->size() < b->size();
+    });
+}
+
+// Первый элемент не меньше slot, начиная с from: шагами удваивающейся длины, затем
+// двоичным поиском. Проход по возрастающим слотам стоит не больше слияния списков
+const int *advanceTo(const int *from, const int *end, int slot)
+{
+    qsizetype step = 1;
+    while (step < end - from && from[step] < slot) {
+        from += step;
+        step *= 2;
+    }
+    return std::lower_bound(from, from + qMin<qsizetype>(step + 1, end - from), slot);
+}
+
+void insertSorted(QVector<int> &list, int slot)
+{
+    if (list.isEmpty() || list.last() < slot) {
+        list.append(slot);
+        return;
+    }
+    const auto it = std::lower_bound(list.begin(), list.end(), slot);
+    if (it == list.end() || *it != slot) {
+        list.insert(it, slot);
+    }
+}
+
+} // namespace
+
+QString SearchIndex::normalize(const QString &text)
+{
+    // Разложение NFD отделяет диакритику от букв: "é" -> "e" + знак, "ё" -> "е" + знак.
+    // Исключение — "й": это отдельная буква, и бреве возвращается на место
+    const QString decomposed = text.toCaseFolded().normalized(QString::NormalizationForm_D);
+    QString result;
+    result.reserve(decomposed.size());
+    for (const QChar ch : decomposed) {
+        if (ch.category() == QChar::Mark_NonSpacing) {
+            if (ch == QChar(0x0306) && !result.isEmpty() && result.back() == QChar(0x0438)) {
+                result.back() = QChar(0x0439);
+            }
+            continue;
+        }
+        if (ch.isLetterOrNumber()) {
+            result.append(ch);
+        } else if (!result.isEmpty() && result.back() != u' ') {
+            result.append(u' ');
+        }
+    }
+    if (result.endsWith(u' ')) {
+        result.chop(1);
+    }
+    return result;
+}
+
+quint64 SearchIndex::key(QChar a, QChar b, QChar c)
+{
+    return (quint64(a.unicode()) << 32) | (quint64(b.unicode()) << 16) | c.unicode();
+}
+
+QVector<quint64> SearchIndex::keysFor(const Entry &entry)
+{
+    QVector<quint64> keys;
+    keys.reserve(entry.text.size() + 8);
+    // Поле рассматривается с пробелом впереди, поэтому триграммы " ab" означают начало
+    // слова; отдельно хранится ключ первой буквы каждого слова
+    QChar previous2 = u' ';
+    QChar previous1 = u' ';
+    for (const QChar ch : entry.text) {
+        if (ch == Separator) {
+            previous2 = previous1 = u' ';
+            continue;
+        }
+        if (ch != u' ') {
+            if (previous1 == u' ') {
+                keys.append(key(u' ', ch, QChar()));
+            }
+            if (previous1 != u' ' || previous2 != u' ') {
+                keys.append(key(previous2, previous1, ch));
+            }
+        }
+        previous2 = previous1;
+        previous1 = ch;
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+QVector<quint64> SearchIndex::queryKeys(const QString &word)
+{
+    QVector<quint64> keys;
+    if (word.size() == 1) {
+        keys.append(key(u' ', word.at(0), QChar()));
+    } else if (word.size() == 2) {
+        keys.append(key(u' ', word.at(0), word.at(1)));
+    } else {
+        for (qsizetype i = 0; i + 2 < word.size(); ++i) {
+            keys.append(key(word.at(i), word.at(i + 1), word.at(i + 2)));
+        }
+    }
+    return keys;
+}
+
+QStringView SearchIndex::titleOf(const Entry &entry)
+{
+    return QStringView(entry.text).left(entry.artistStart - 1);
+}
+
+void SearchIndex::reserve(qsizetype songs)
+{
+    m_entries.reserve(songs);
+    m_slotById.reserve(songs);
+    m_slotsByTitle.reserve(songs);
+}
+
+void SearchIndex::addOrUpdate(int songId, const QString &title, const QString &artist, const QString &album)
+{
+    int slot = m_slotById.value(songId, -1);
+    if (slot != -1) {
+        unindexSlot(slot);
+    } else if (!m_freeSlots.isEmpty()) {
+        slot = m_freeSlots.takeLast();
+    } else {
+        slot = int(m_entries.size());
+        m_entries.append(Entry());
+    }
+
+    Entry &entry = m_entries[slot];
+    entry.songId = songId;
+    const QString normalizedTitle = normalize(title);
+    const QString normalizedArtist = normalize(artist);
+    entry.artistStart = int(normalizedTitle.size()) + 1;
+    entry.albumStart = entry.artistStart + int(normalizedArtist.size()) + 1;
+    entry.text = normalizedTitle + Separator + normalizedArtist + Separator + normalize(album);
+    m_slotById.insert(songId, slot);
+    indexSlot(slot);
+}
+
+void SearchIndex::remove(int songId)
+{
+    const auto found = m_slotById.constFind(songId);
+    if (found == m_slotById.constEnd()) {
+        return;
+    }
+    const int slot = found.value();
+    m_slotById.erase(found);
+    unindexSlot(slot);
+    m_entries[slot] = Entry();
+    m_freeSlots.append(slot);
+}
+
+void SearchIndex::indexSlot(int slot)
+{
+    const Entry &entry = m_entries.at(slot);
+    m_slotsByTitle.insert(qHash(titleOf(entry)), slot);
+    for (quint64 k : keysFor(entry)) {
+        insertSorted(m_postings[k], slot);
+    }
+}
+
+void SearchIndex::unindexSlot(int slot)
+{
+    const Entry &entry = m_entries.at(slot);
+    m_slotsByTitle.remove(qHash(titleOf(entry)), slot);
+    for (quint64 k : keysFor(entry)) {
+        const auto posting = m_postings.find(k);
+        if (posting == m_postings.end()) {
+            continue;
+        }
+        QVector<int> &list = posting.value();
+        const auto it = std::lower_bound(list.begin(), list.end(), slot);
+        if (it != list.end() && *it == slot) {
+            list.erase(it);
+        }
+        if (list.isEmpty()) {
+            m_postings.erase(posting);
+        }
+    }
+}
+
+int SearchIndex::score(const Entry &entry, const QStringList &words, const QString &normalizedQuery)
+{
+    int total = 0;
+    for (const QString &word : words) {
+        int best = 0;
+        for (qsizetype pos = entry.text.indexOf(word); pos >= 0; pos = entry.text.indexOf(word, pos + 1)) {
+            const QChar before = pos > 0 ? entry.text.at(pos - 1) : QChar(u' ');
+            const bool wordStart = before == u' ' || before == Separator;
+            if (word.size() <= 2 && !wordStart) {
+                continue;
+            }
+            const int fieldWeight = pos < entry.artistStart ? 3 : (pos < entry.albumStart ? 2 : 1);
+            best = qMax(best, fieldWeight * (wordStart ? 2 : 1));
+            if (best == 6) {
+                break;
+            }
+        }
+        if (best == 0) {
+            return 0;
+        }
+        total += best;
+    }
+    // Точное совпадение названия — выше всего
+    if (titleOf(entry) == normalizedQuery) {
+        total += 10;
+    }
+    return total;
+}
+
+QList<int> SearchIndex::search(const QString &query, int limit) const
+{
+    const QString normalizedQuery = normalize(query);
+    const QStringList words = normalizedQuery.split(u' ', Qt::SkipEmptyParts);
+    if (words.isEmpty() || limit <= 0) {
+        return {};
+    }
+
+    // Для каждого слова — самый короткий из списков его ключей: пересечение только отбирает
+    // кандидатов, точную проверку делает score(). Нет хотя бы одного ключа — нет и результатов.
+    // Второй набор — те же списки и начало каждого слова длиннее двух букв: песни из этого
+    // пересечения совпадают со всеми словами с начала слова и получают больше очков
+    PostingLists lists;
+    PostingLists prefixLists;
+    bool prefixesFound = true;
+    for (const QString &word : words) {
+        const QVector<int> *shortest = nullptr;
+        for (quint64 k : queryKeys(word)) {
+            const auto posting = m_postings.constFind(k);
+            if (posting == m_postings.constEnd()) {
+                return {};
+            }
+            if (!shortest || posting.value().size() < shortest->size()) {
+                shortest = &posting.value();
+            }
+        }
+        lists.append(shortest);
+        if (word.size() > 2) {
+            const auto prefix = m_postings.constFind(key(u' ', word.at(0), word.at(1)));
+            if (prefix == m_postings.constEnd()) {
+                prefixesFound = false;
+            } else {
+                prefixLists.append(&prefix.value());
+            }
+        }
+    }
+    // Слова из одной-двух букв и так ищутся с начала слова: отдельный проход не нужен
+    const bool prefixTier = prefixesFound && !prefixLists.isEmpty();
+    prefixLists.append(lists.cbegin(), lists.size());
+    sortBySize(lists);
+    sortBySize(prefixLists);
+
+    struct Scored {
+        int score;
+        int length;
+        int songId;
+    };
+    // Кандидаты проверяются по убыванию ранга — точное название, совпадения с начала слов,
+    // остальные, — пока не найдено budget совпадений
+    const qsizetype budget = qsizetype(limit) * CandidatesPerResult;
+    QVector<Scored> scored;
+    scored.reserve(qMin<qsizetype>(budget, lists.first()->size()));
+    QSet<int> checked;
+    const auto check = [&](int slot) {
+        if (checked.contains(slot)) {
+            return;
+        }
+        checked.insert(slot);
+        const Entry &entry = m_entries.at(slot);
+        const int points = score(entry, words, normalizedQuery);
+        if (points > 0) {
+            scored.append({points, int(entry.text.size()), entry.songId});
+        }
+    };
+    // Пересечение без копирования: каждый список догоняет текущий слот (advanceTo), а больший
+    // найденный слот становится следующим кандидатом. Редкое пересечение длинных списков так
+    // проходится прыжками, а не поэлементно
+    const auto collect = [&](const PostingLists &tier) {
+        QVarLengthArray<const int *, 32> at;
+        QVarLengthArray<const int *, 32> end;
+        for (const QVector<int> *list : tier) {
+            at.append(list->constData());
+            end.append(list->constData() + list->size());
+        }
+        while (scored.size() < budget && at[0] != end[0]) {
+            const int slot = *at[0];
+            bool inAll = true;
+            for (qsizetype i = 1; i < tier.size(); ++i) {
+                at[i] = advanceTo(at[i], end[i], slot);
+                if (at[i] == end[i]) {
+                    return;
+                }
+                if (*at[i] > slot) {
+                    at[0] = advanceTo(at[0], end[0], *at[i]);
+                    inAll = false;
+                    break;
+                }
+            }
+            if (inAll) {
+                check(slot);
+                ++at[0];
+            }
+        }
+    };
+
+    const size_t titleHash = qHash(QStringView(normalizedQuery));
+    for (auto it = m_slotsByTitle.constFind(titleHash); it != m_slotsByTitle.constEnd() && it.key() == titleHash; ++it) {
+        if (titleOf(m_entries.at(it.value())) == normalizedQuery) {
+            check(it.value());
+        }
+    }
+    if (prefixTier) {
+        collect(prefixLists);
+    }
+    collect(lists);
+
+    // Равные по очкам — более короткие (точнее совпавшие) строки выше
+    const qsizetype count = qMin<qsizetype>(limit, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + count, scored.end(), [](const Scored &a, const Scored &b) {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        if (a.length != b.length) {
+            return a.length < b.length;
+        }
+        return a.songId < b.songId;
+    });
+
+    QList<int> ids;
+    ids.reserve(count);
+    for (qsizetype i = 0; i < count; ++i) {
+        ids.append(scored.at(i).songId);
+    }
+    return ids;
+}
@@ -0,0 +1,58 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+// Индекс для мгновенного поиска по названию, исполнителю и альбому в памяти.
+// Строки нормализуются (регистр, диакритика, ё -> е, пунктуация -> пробел); ключи —
+// триграммы полей и начала слов. Списки песен по ключу отсортированы, поэтому запрос
+// идет по самому короткому из них и проверяет вхождение в остальные. Кандидаты берутся
+// по убыванию ранга (точное название, совпадения с начала слов, остальные) и не больше
+// limit * CandidatesPerResult: у частого слова работа не растет с размером библиотеки.
+// Обновляется по одной песне; не потокобезопасен.
+class SearchIndex
+{
+public:
+    static QString normalize(const QString &text);
+
+    void reserve(qsizetype songs);
+    void addOrUpdate(int songId, const QString &title, const QString &artist, const QString &album);
+    void remove(int songId);
+    qsizetype size() const { return m_slotById.size(); }
+
+    // ID лучших limit песен, в которых встречается каждое слово запроса: слова из одной
+    // или двух букв — как начало слова, длиннее — как подстрока. Выше ранжируются
+    // совпадения в названии, затем в исполнителе и альбоме, и совпадения с начала слова
+    QList<int> search(const QString &query, int limit) const;
+
+private:
+    static constexpr QChar Separator = QChar(0x1f); // между полями в Entry::text
+    static constexpr int CandidatesPerResult = 2;
+
+    struct Entry {
+        int songId = -1;             // -1 — слот свободен
+        QString text;                // нормализованные "название\x1fисполнитель\x1fальбом"
+        int artistStart = 0;
+        int albumStart = 0;
+    };
+
+    static quint64 key(QChar a, QChar b, QChar c);
+    static QVector<quint64> keysFor(const Entry &entry);
+    static QVector<quint64> queryKeys(const QString &word);
+    static int score(const Entry &entry, const QStringList &words, const QString &normalizedQuery);
+    static QStringView titleOf(const Entry &entry);
+
+    void indexSlot(int slot);
+    void unindexSlot(int slot);
+
+    QVector<Entry> m_entries;
+    QVector<int> m_freeSlots;
+    QHash<int, int> m_slotById;
+    QHash<quint64, QVector<int>> m_postings; // ключ -> отсортированные слоты
+    QMultiHash<size_t, int> m_slotsByTitle;   // хэш названия -> слоты, для точных совпадений
+};
+
+#endif // SEARCH_INDEX_H
@@ -0,0 +1,430 @@
+#include "song_list_model.h"
+#include <QDataStream>
+#include <QHash>
+#include <QMimeData>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+
+// ID перетаскиваемых песен в порядке строк
+const QString songIdsMimeType = QStringLiteral("application/x-musicplayer-song-ids");
+
+// Ключ порядка тоже сравнивается: по последней строке догружается следующая страница
+bool sameSong(const SongInfo &a, const SongInfo &b)
+{
+    return a.id == b.id && a.title == b.title && a.artist == b.artist
+           && a.album == b.album && a.filePath == b.filePath && a.durationMs == b.durationMs
+           && a.playlistOrder == b.playlistOrder;
+}
+
+} // namespace
+
+SongListModel::SongListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int SongListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(m_songs.size());
+}
+
+QVariant SongListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_songs.size()) {
+        return QVariant();
+    }
+    const SongInfo &song = m_songs.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        // Сначала исполнитель; если его нет, просто название
+        return song.artist.isEmpty() ? song.title : song.artist + " - " + song.title;
+    case SongIdRole:
+        return song.id;
+    case FilePathRole:
+        return song.filePath;
+    default:
+        return QVariant();
+    }
+}
+
+bool SongListModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && m_hasMorePages && !isLoading();
+}
+
+void SongListModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid() || !m_hasMorePages || !m_pageFetcher || isLoading()) {
+        return;
+    }
+    requestPage(m_songs.isEmpty() ? nullptr : &m_songs.constLast(), m_pageSize, false);
+}
+
+Qt::ItemFlags SongListModel::flags(const QModelIndex &index) const
+{
+    Qt::ItemFlags result = QAbstractListModel::flags(index);
+    if (m_reorderable) {
+        // Строки не принимают бросок "на себя": представление кладет его между строками
+        result |= index.isValid() ? Qt::ItemIsDragEnabled : Qt::ItemIsDropEnabled;
+    }
+    return result;
+}
+
+Qt::DropActions SongListModel::supportedDropActions() const
+{
+    return Qt::MoveAction;
+}
+
+QStringList SongListModel::mimeTypes() const
+{
+    return {songIdsMimeType};
+}
+
+QMimeData *SongListModel::mimeData(const QModelIndexList &indexes) const
+{
+    QList<int> rows;
+    for (const QModelIndex &index : indexes) {
+        if (index.isValid() && index.row() < m_songs.size()) {
+            rows.append(index.row());
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    QList<int> songIds;
+    songIds.reserve(rows.size());
+    for (int row : std::as_const(rows)) {
+        songIds.append(m_songs.at(row).id);
+    }
+    QByteArray encoded;
+    QDataStream stream(&encoded, QIODevice::WriteOnly);
+    stream << songIds;
+
+    auto *data = new QMimeData();
+    data->setData(songIdsMimeType, encoded);
+    return data;
+}
+
+bool SongListModel::canDropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column,
+                                    const QModelIndex &parent) const
+{
+    Q_UNUSED(column);
+    if (!m_reorderable || action != Qt::MoveAction || !data || !data->hasFormat(songIdsMimeType)) {
+        return false;
+    }
+    // Конец загруженной части — еще не конец списка: туда бросать нельзя
+    const int targetRow = parent.isValid() ? parent.row() : row;
+    return !(m_hasMorePages && (targetRow < 0 || targetRow >= m_songs.size()));
+}
+
+bool SongListModel::dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column,
+                                 const QModelIndex &parent)
+{
+    if (!canDropMimeData(data, action, row, column, parent)) {
+        return false;
+    }
+    QList<int> songIds;
+    QDataStream stream(data->data(songIdsMimeType));
+    stream >> songIds;
+    if (songIds.isEmpty()) {
+        return false;
+    }
+
+    // Место броска — перед первой неперемещаемой строкой, начиная с целевой
+    const QSet<int> moved(songIds.cbegin(), songIds.cend());
+    int targetRow = parent.isValid() ? parent.row() : row;
+    if (targetRow < 0 || targetRow > m_songs.size()) {
+        targetRow = int(m_songs.size());
+    }
+    while (targetRow < m_songs.size() && moved.contains(m_songs.at(targetRow).id)) {
+        ++targetRow;
+    }
+    if (targetRow == m_songs.size() && m_hasMorePages) {
+        return false;
+    }
+
+    // Строки уже стоят подряд и в том же порядке прямо перед целью — писать нечего
+    bool inPlace = targetRow >= songIds.size();
+    for (int i = 0; inPlace && i < songIds.size(); ++i) {
+        inPlace = m_songs.at(targetRow - int(songIds.size()) + i).id == songIds.at(i);
+    }
+    if (!inPlace) {
+        emit songsMoveRequested(songIds, targetRow < m_songs.size() ? m_songs.at(targetRow).id : -1);
+    }
+    // Порядок меняет владелец модели через moveSongs(); true заставило бы
+    // представление удалить исходные строки
+    return false;
+}
+
+void SongListModel::setPageFetcher(const PageFetcher &fetcher, int pageSize)
+{
+    cancelPendingLoad();
+    beginResetModel();
+    m_pageFetcher = fetcher;
+    m_pageSize = pageSize;
+    m_songs.clear();
+    invalidateIndex();
+    m_hasMorePages = false;
+    endResetModel();
+    requestPage(nullptr, m_pageSize, false);
+}
+
+void SongListModel::reloadPages()
+{
+    if (!m_pageFetcher) {
+        return;
+    }
+    cancelPendingLoad();
+    // Берем столько строк, сколько уже показано, чтобы не терять позицию прокрутки
+    requestPage(nullptr, qMax(int(m_songs.size()), m_pageSize), true);
+}
+
+void SongListModel::replacePageFetcher(const PageFetcher &fetcher)
+{
+    m_pageFetcher = fetcher;
+    reloadPages();
+}
+
+bool SongListModel::hasPageFetcher() const
+{
+    return bool(m_pageFetcher);
+}
+
+bool SongListModel::hasMorePages() const
+{
+    return m_hasMorePages;
+}
+
+bool SongListModel::isLoading() const
+{
+    // Флаг, а не m_pendingLoad.isFinished(): ответ применяется позже, в цикле событий
+    return m_loading;
+}
+
+void SongListModel::requestPage(const SongInfo *last, int limit, bool replace)
+{
+    const quint64 generation = ++m_loadGeneration;
+    m_loading = true;
+    m_pendingLoad = m_pageFetcher(last, limit);
+    m_pendingLoad.then(this, [this, generation, limit, replace](const QList<SongInfo> &songs) {
+        if (generation != m_loadGeneration) {
+            return; // источник сменился, пока запрос был в очереди
+        }
+        m_loading = false;
+        m_hasMorePages = songs.size() == limit;
+        if (replace) {
+            setSongs(songs);
+        } else {
+            appendSongs(songs);
+        }
+        emit loadFinished();
+    }).onCanceled(this, [this, generation]() {
+        if (generation == m_loadGeneration) {
+            m_loading = false; // исполнитель остановлен, ждать больше нечего
+        }
+    });
+}
+
+void SongListModel::cancelPendingLoad()
+{
+    // Запрос, который исполнитель БД еще не начал, не будет выполнен вовсе
+    ++m_loadGeneration;
+    if (m_loading) {
+        m_pendingLoad.cancel();
+        m_loading = false;
+    }
+    m_pendingLoad = QFuture<QList<SongInfo>>();
+}
+
+void SongListModel::appendSongs(const QList<SongInfo> &songs)
+{
+    if (songs.isEmpty()) {
+        return;
+    }
+    const int first = int(m_songs.size());
+    beginInsertRows(QModelIndex(), first, first + int(songs.size()) - 1);
+    m_songs.append(songs);
+    if (m_indexValid) {
+        for (int row = first; row < m_songs.size(); ++row) {
+            m_rowById.insert(m_songs.at(row).id, row);
+            m_rowByPath.insert(m_songs.at(row).filePath, row);
+        }
+    }
+    endInsertRows();
+}
+
+void SongListModel::setSongs(const QList<SongInfo> &songs)
+{
+    invalidateIndex();
+    QHash<int, int> newPositions;
+    newPositions.reserve(songs.size());
+    for (int i = 0; i < songs.size(); ++i) {
+        newPositions.insert(songs.at(i).id, i);
+    }
+
+    // 1. Удаляем исчезнувшие строки непрерывными диапазонами снизу вверх
+    for (int row = int(m_songs.size()) - 1; row >= 0;) {
+        if (newPositions.contains(m_songs.at(row).id)) {
+            --row;
+            continue;
+        }
+        const int last = row;
+        while (row >= 0 && !newPositions.contains(m_songs.at(row).id)) {
+            --row;
+        }
+        beginRemoveRows(QModelIndex(), row + 1, last);
+        m_songs.remove(row + 1, last - row);
+        endRemoveRows();
+    }
+
+    // 2. Если оставшиеся строки поменяли взаимный порядок, дешевле сбросить модель целиком
+    int previousPosition = -1;
+    for (const SongInfo &song : std::as_const(m_songs)) {
+        const int position = newPositions.value(song.id);
+        if (position <= previousPosition) {
+            beginResetModel();
+            m_songs = songs;
+            invalidateIndex();
+            endResetModel();
+            return;
+        }
+        previousPosition = position;
+    }
+
+    // 3. Проходим новый список: вставляем недостающие диапазоны, изменившиеся строки обновляем
+    int row = 0;
+    for (int i = 0; i < songs.size();) {
+        if (row < m_songs.size() && m_songs.at(row).id == songs.at(i).id) {
+            if (!sameSong(m_songs.at(row), songs.at(i))) {
+                m_songs[row] = songs.at(i);
+                emit dataChanged(index(row), index(row));
+            }
+            ++row;
+            ++i;
+            continue;
+        }
+
+        int runEnd = i;
+        while (runEnd < songs.size() && (row >= m_songs.size() || songs.at(runEnd).id != m_songs.at(row).id)) {
+            ++runEnd;
+        }
+        const int count = runEnd - i;
+        beginInsertRows(QModelIndex(), row, row + count - 1);
+        m_songs.insert(row, count, SongInfo());
+        for (int k = 0; k < count; ++k) {
+            m_songs[row + k] = songs.at(i + k);
+        }
+        endInsertRows();
+        row += count;
+        i = runEnd;
+    }
+    // Слоты представлений могли перестроить индекс по промежуточному состоянию
+    invalidateIndex();
+}
+
+void SongListModel::insertSong(int row, const SongInfo &song)
+{
+    row = qBound(0, row, int(m_songs.size()));
+    if (row == m_songs.size()) {
+        appendSongs({song});
+        return;
+    }
+    beginInsertRows(QModelIndex(), row, row);
+    m_songs.insert(row, song);
+    invalidateIndex();
+    endInsertRows();
+}
+
+void SongListModel::removeSongAt(int row)
+{
+    if (row < 0 || row >= m_songs.size()) {
+        return;
+    }
+    beginRemoveRows(QModelIndex(), row, row);
+    if (m_indexValid && row == m_songs.size() - 1) {
+        m_rowById.remove(m_songs.at(row).id);
+        m_rowByPath.remove(m_songs.at(row).filePath);
+    } else {
+        invalidateIndex();
+    }
+    m_songs.removeAt(row);
+    endRemoveRows();
+}
+
+bool SongListModel::updateSong(int row, const SongInfo &song)
+{
+    if (row < 0 || row >= m_songs.size() || sameSong(m_songs.at(row), song)) {
+        return false;
+    }
+    if (m_indexValid) {
+        const SongInfo &old = m_songs.at(row);
+        m_rowById.remove(old.id);
+        m_rowByPath.remove(old.filePath);
+        m_rowById.insert(song.id, row);
+        m_rowByPath.insert(song.filePath, row);
+    }
+    m_songs[row] = song;
+    emit dataChanged(index(row), index(row));
+    return true;
+}
+
+void SongListModel::moveSongs(const QList<int> &songIds, int beforeSongId)
+{
+    // По одной строке: каждая встает прямо перед целью, поэтому блок сохраняет порядок songIds
+    for (int songId : songIds) {
+        const int from = rowOfSongId(songId);
+        const int to = beforeSongId == -1 ? int(m_songs.size()) : rowOfSongId(beforeSongId);
+        if (from == -1 || to == -1 || to == from || to == from + 1) {
+            continue;
+        }
+        beginMoveRows(QModelIndex(), from, from, QModelIndex(), to);
+        m_songs.move(from, to > from ? to - 1 : to);
+        invalidateIndex();
+        endMoveRows();
+    }
+}
+
+void SongListModel::setReorderable(bool reorderable)
+{
+    m_reorderable = reorderable;
+}
+
+const SongInfo &SongListModel::songAt(int row) const
+{
+    return m_songs.at(row);
+}
+
+int SongListModel::rowOfSongId(int songId) const
+{
+    ensureIndex();
+    return m_rowById.value(songId, -1);
+}
+
+int SongListModel::rowOfFilePath(const QString &filePath) const
+{
+    ensureIndex();
+    return m_rowByPath.value(filePath, -1);
+}
+
+void SongListModel::invalidateIndex()
+{
+    m_indexValid = false;
+    m_rowById.clear();
+    m_rowByPath.clear();
+}
+
+void SongListModel::ensureIndex() const
+{
+    if (m_indexValid) {
+        return;
+    }
+    m_rowById.reserve(m_songs.size());
+    m_rowByPath.reserve(m_songs.size());
+    for (int row = 0; row < m_songs.size(); ++row) {
+        m_rowById.insert(m_songs.at(row).id, row);
+        m_rowByPath.insert(m_songs.at(row).filePath, row);
+    }
+    m_indexValid = true;
+}
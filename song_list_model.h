@@ -0,0 +1,103 @@
+#ifndef SONG_LIST_MODEL_H
+#define SONG_LIST_MODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QHash>
+#include <QFuture>
+#include <functional>
+#include "database_manager.h"
+
+// Модель списка песен поверх плотного массива SongInfo. Текст строк формируется
+// по запросу представления (только для видимых строк), а обновления применяются
+// минимальными изменениями, поэтому выделение и прокрутка сохраняются.
+// В постраничном режиме строки догружаются через canFetchMore/fetchMore по мере прокрутки;
+// страницы запрашиваются асинхронно, и о каждой примененной загрузке сообщает loadFinished().
+// В режиме setReorderable(true) строки можно перетаскивать: модель сама порядок не меняет,
+// а сообщает о запрошенном перемещении через songsMoveRequested().
+class SongListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum SongRoles {
+        SongIdRole = Qt::UserRole + 1,
+        FilePathRole = Qt::UserRole + 2
+    };
+
+    // Запрашивает до limit песен после last (nullptr — с начала списка). last действителен
+    // только во время вызова, поэтому нужные поля копируются до постановки запроса.
+    using PageFetcher = std::function<QFuture<QList<SongInfo>>(const SongInfo *last, int limit)>;
+
+    explicit SongListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    Qt::DropActions supportedDropActions() const override;
+    QStringList mimeTypes() const override;
+    QMimeData *mimeData(const QModelIndexList &indexes) const override;
+    bool canDropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column,
+                         const QModelIndex &parent) const override;
+    bool dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column,
+                      const QModelIndex &parent) override;
+
+    // Переключает модель на новый постраничный источник и загружает первую страницу
+    void setPageFetcher(const PageFetcher &fetcher, int pageSize = 200);
+    // Перечитывает уже загруженную часть текущего источника и применяет разницу
+    void reloadPages();
+    // То же, но через другой источник того же списка (например, снимок -> БД)
+    void replacePageFetcher(const PageFetcher &fetcher);
+    bool hasPageFetcher() const;
+    bool hasMorePages() const;  // загружена не вся выборка источника
+    bool isLoading() const; // ждем ответа на запрос страницы или перезагрузки
+
+    // Приводит содержимое к songs через удаления, вставки и dataChanged вместо полного сброса
+    void setSongs(const QList<SongInfo> &songs);
+    void insertSong(int row, const SongInfo &song);
+    void removeSongAt(int row);
+    // Возвращает false, если строка уже совпадает с song (ничего не изменилось)
+    bool updateSong(int row, const SongInfo &song);
+    // Ставит songIds по порядку перед beforeSongId (-1 — в конец) перемещением строк
+    void moveSongs(const QList<int> &songIds, int beforeSongId);
+    void setReorderable(bool reorderable);
+
+    const SongInfo &songAt(int row) const;
+    // Поиск строки по индексу в хэш-таблицах, без прохода по списку
+    int rowOfSongId(int songId) const;
+    int rowOfFilePath(const QString &filePath) const;
+
+signals:
+    // Результат setPageFetcher, reloadPages или fetchMore применен к модели
+    void loadFinished();
+    // Строки перетащили перед beforeSongId (-1 — в конец списка)
+    void songsMoveRequested(const QList<int> &songIds, int beforeSongId);
+
+private:
+    void requestPage(const SongInfo *last, int limit, bool replace);
+    void cancelPendingLoad();
+    void appendSongs(const QList<SongInfo> &songs);
+    void invalidateIndex();
+    void ensureIndex() const;
+
+    QList<SongInfo> m_songs;
+    PageFetcher m_pageFetcher;
+    int m_pageSize = 200;
+    bool m_hasMorePages = false;
+    bool m_reorderable = false;
+    QFuture<QList<SongInfo>> m_pendingLoad;
+    bool m_loading = false;
+    quint64 m_loadGeneration = 0; // ответы на устаревшие запросы отбрасываются
+
+    // Индексы ID/пути -> строка. Добавление страниц в конец обновляет их сразу,
+    // вставки и удаления в середине сдвигают строки, поэтому индекс перестраивается
+    // при следующем поиске
+    mutable QHash<int, int> m_rowById;
+    mutable QHash<QString, int> m_rowByPath;
+    mutable bool m_indexValid = false;
+};
+
+#endif // SONG_LIST_MODEL_H
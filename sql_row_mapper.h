@@ -0,0 +1,108 @@
+#ifndef SQL_ROW_MAPPER_H
+#define SQL_ROW_MAPPER_H
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QVariant>
+#include <QList>
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Колонка результата запроса и поле структуры, в которое она читается
+template <typename Struct, typename Field>
+struct SqlColumn {
+    const char *name;
+    Field Struct::*member;
+};
+
+template <typename Struct, typename Field>
+constexpr SqlColumn<Struct, Field> sqlColumn(const char *name, Field Struct::*member)
+{
+    return {name, member};
+}
+
+// Специализируется для каждой структуры один раз:
+//     template <> struct SqlRowMapping<SongInfo> {
+//         static constexpr auto columns = std::make_tuple(sqlColumn("id", &SongInfo::id), ...);
+//     };
+template <typename Struct>
+struct SqlRowMapping;
+
+namespace SqlRowMapper {
+
+template <typename Struct>
+constexpr std::size_t columnCount()
+{
+    return std::tuple_size_v<std::decay_t<decltype(SqlRowMapping<Struct>::columns)>>;
+}
+
+template <typename Struct>
+using ColumnIndexes = std::array<int, columnCount<Struct>()>;
+
+// Индексы колонок ищутся по имени один раз на запрос, а не для каждого поля каждой строки
+template <typename Struct>
+ColumnIndexes<Struct> resolveColumns(const QSqlQuery &query)
+{
+    ColumnIndexes<Struct> indexes{};
+    const QSqlRecord record = query.record();
+    std::apply([&](const auto &...column) {
+        std::size_t i = 0;
+        ((indexes[i++] = record.indexOf(QLatin1String(column.name))), ...);
+    }, SqlRowMapping<Struct>::columns);
+    return indexes;
+}
+
+template <typename Field>
+void assignField(Field &field, const QSqlQuery &query, int index)
+{
+    if (index >= 0) {
+        field = query.value(index).template value<Field>();
+    }
+}
+
+template <typename Struct>
+void readRow(const QSqlQuery &query, const ColumnIndexes<Struct> &indexes, Struct &row)
+{
+    std::apply([&](const auto &...column) {
+        std::size_t i = 0;
+        (assignField(row.*(column.member), query, indexes[i++]), ...);
+    }, SqlRowMapping<Struct>::columns);
+}
+
+// Читает все строки выполненного запроса. Запрос стоит переводить в setForwardOnly(true)
+// до prepare()/exec(): тогда драйвер не кэширует уже прочитанные строки.
+template <typename Struct>
+QList<Struct> readAll(QSqlQuery &query, qsizetype sizeHint = -1)
+{
+    QList<Struct> rows;
+    const int size = query.size();
+    if (size >= 0) {
+        rows.reserve(size);
+    } else if (sizeHint > 0) {
+        rows.reserve(sizeHint);
+    }
+    const ColumnIndexes<Struct> indexes = resolveColumns<Struct>(query);
+    while (query.next()) {
+        Struct row{};
+        readRow(query, indexes, row);
+        rows.append(std::move(row));
+    }
+    return rows;
+}
+
+// Читает одну строку; false, если строк нет
+template <typename Struct>
+bool readOne(QSqlQuery &query, Struct &row)
+{
+    if (!query.next()) {
+        return false;
+    }
+    readRow(query, resolveColumns<Struct>(query), row);
+    return true;
+}
+
+} // namespace SqlRowMapper
+
+#endif // SQL_ROW_MAPPER_H
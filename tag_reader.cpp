@@ -0,0 +1,581 @@
+#include "tag_reader.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cstring>
+
+namespace {
+
+quint32 readBE32(const uchar *p) { return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | p[3]; }
+quint32 readBE24(const uchar *p) { return (quint32(p[0]) << 16) | (quint32(p[1]) << 8) | p[2]; }
+quint16 readBE16(const uchar *p) { return quint16((p[0] << 8) | p[1]); }
+quint32 readLE32(const uchar *p) { return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24); }
+quint32 readSyncsafe(const uchar *p) { return (quint32(p[0] & 0x7F) << 21) | (quint32(p[1] & 0x7F) << 14) | (quint32(p[2] & 0x7F) << 7) | (p[3] & 0x7F); }
+
+void setIfEmpty(QString &field, const QString &value)
+{
+    if (field.isEmpty()) {
+        field = value.trimmed();
+    }
+}
+
+// --- ID3v2 ---
+
+QString decodeUtf16(const uchar *p, qint64 len, bool littleEndian)
+{
+    QString text;
+    text.reserve(int(len / 2));
+    for (qint64 i = 0; i + 1 < len; i += 2) {
+        const ushort unit = littleEndian ? ushort(p[i] | (p[i + 1] << 8)) : ushort((p[i] << 8) | p[i + 1]);
+        if (unit == 0) {
+            break; // в ID3v2.4 значения разделяются нулем, берем первое
+        }
+        text.append(QChar(unit));
+    }
+    return text;
+}
+
+QString decodeId3Text(const uchar *p, qint64 len)
+{
+    if (len < 1) {
+        return QString();
+    }
+    const uchar encoding = p[0];
+    ++p;
+    --len;
+    switch (encoding) {
+    case 1: // UTF-16 с BOM
+        if (len >= 2 && p[0] == 0xFE && p[1] == 0xFF) {
+            return decodeUtf16(p + 2, len - 2, false);
+        }
+        if (len >= 2 && p[0] == 0xFF && p[1] == 0xFE) {
+            return decodeUtf16(p + 2, len - 2, true);
+        }
+        return decodeUtf16(p, len, true);
+    case 2: // UTF-16BE без BOM
+        return decodeUtf16(p, len, false);
+    case 3: // UTF-8
+        return QString::fromUtf8(reinterpret_cast<const char *>(p), qstrnlen(reinterpret_cast<const char *>(p), uint(len)));
+    default: // ISO-8859-1
+        return QString::fromLatin1(reinterpret_cast<const char *>(p), qstrnlen(reinterpret_cast<const char *>(p), uint(len)));
+    }
+}
+
+// Длина строки, завершенной нулем, в кодировке ID3 (для UTF-16 — нулевая пара байт)
+qint64 id3TerminatedLength(uchar encoding, const uchar *p, qint64 len)
+{
+    if (encoding == 1 || encoding == 2) {
+        for (qint64 i = 0; i + 1 < len; i += 2) {
+            if (p[i] == 0 && p[i + 1] == 0) {
+                return i;
+            }
+        }
+        return len;
+    }
+    return qstrnlen(reinterpret_cast<const char *>(p), uint(len));
+}
+
+// iTunSMPB: " 00000000 00000840 000001C0 0000000000A1B2C0 ..." — задержка и добивка
+// в шестнадцатеричном виде, уже включающие задержку декодера
+void parseITunSmpb(const QString &value, TrackTags &tags)
+{
+    const QStringList fields = value.split(' ', Qt::SkipEmptyParts);
+    if (fields.size() < 3) {
+        return;
+    }
+    bool delayOk = false;
+    bool paddingOk = false;
+    const int delay = fields.at(1).toInt(&delayOk, 16);
+    const int padding = fields.at(2).toInt(&paddingOk, 16);
+    if (delayOk && paddingOk) {
+        tags.startPaddingSamples = delay;
+        tags.endPaddingSamples = padding;
+    }
+}
+
+// REPLAYGAIN_TRACK_GAIN = "-6.54 dB", REPLAYGAIN_TRACK_PEAK = "0.988831" и то же для альбома
+void parseReplayGain(const QString &key, const QString &value, TrackTags &tags)
+{
+    QString number = value.trimmed();
+    if (number.endsWith("dB", Qt::CaseInsensitive)) {
+        number.chop(2);
+    }
+    bool ok = false;
+    const float parsed = number.trimmed().toFloat(&ok);
+    if (!ok) {
+        return;
+    }
+    const QString upper = key.toUpper();
+    if (upper == "REPLAYGAIN_TRACK_GAIN") {
+        tags.trackGainDb = parsed;
+        tags.hasTrackGain = true;
+    } else if (upper == "REPLAYGAIN_TRACK_PEAK") {
+        tags.trackPeak = parsed;
+    } else if (upper == "REPLAYGAIN_ALBUM_GAIN") {
+        tags.albumGainDb = parsed;
+        tags.hasAlbumGain = true;
+    } else if (upper == "REPLAYGAIN_ALBUM_PEAK") {
+        tags.albumPeak = parsed;
+    }
+}
+
+// TXXX: кодировка, описание с нулем, значение (ReplayGain в MP3 пишется так)
+void parseId3UserText(const uchar *frame, qint64 len, TrackTags &tags)
+{
+    if (len < 2) {
+        return;
+    }
+    const uchar encoding = frame[0];
+    const uchar *description = frame + 1;
+    const qint64 available = len - 1;
+    const qint64 descriptionLen = id3TerminatedLength(encoding, description, available);
+    const qint64 terminator = (encoding == 1 || encoding == 2) ? 2 : 1;
+    if (descriptionLen + terminator > available) {
+        return;
+    }
+    QByteArray descriptionFrame(1, char(encoding));
+    descriptionFrame.append(reinterpret_cast<const char *>(description), int(descriptionLen));
+    const QString name = decodeId3Text(reinterpret_cast<const uchar *>(descriptionFrame.constData()), descriptionFrame.size());
+    if (!name.startsWith("REPLAYGAIN_", Qt::CaseInsensitive)) {
+        return;
+    }
+    QByteArray textFrame(1, char(encoding));
+    textFrame.append(reinterpret_cast<const char *>(description + descriptionLen + terminator),
+                     int(available - descriptionLen - terminator));
+    parseReplayGain(name, decodeId3Text(reinterpret_cast<const uchar *>(textFrame.constData()), textFrame.size()), tags);
+}
+
+// COMM: кодировка, язык (3 байта), описание с нулем, текст
+void parseId3Comment(const uchar *frame, qint64 len, TrackTags &tags)
+{
+    if (len < 5) {
+        return;
+    }
+    const uchar encoding = frame[0];
+    const uchar *description = frame + 4;
+    const qint64 available = len - 4;
+    const qint64 descriptionLen = id3TerminatedLength(encoding, description, available);
+    const qint64 terminator = (encoding == 1 || encoding == 2) ? 2 : 1;
+    QByteArray descriptionFrame(1, char(encoding));
+    descriptionFrame.append(reinterpret_cast<const char *>(description), int(descriptionLen));
+    const QString name = decodeId3Text(reinterpret_cast<const uchar *>(descriptionFrame.constData()), descriptionFrame.size());
+    if (name != "iTunSMPB" || descriptionLen + terminator > available) {
+        return;
+    }
+    QByteArray textFrame(1, char(encoding));
+    textFrame.append(reinterpret_cast<const char *>(description + descriptionLen + terminator),
+                     int(available - descriptionLen - terminator));
+    parseITunSmpb(decodeId3Text(reinterpret_cast<const uchar *>(textFrame.constData()), textFrame.size()), tags);
+}
+
+void handleId3Frame(const char *id, const uchar *frame, qint64 len, TrackTags &tags)
+{
+    if (!std::strcmp(id, "TIT2") || !std::strcmp(id, "TT2")) {
+        setIfEmpty(tags.title, decodeId3Text(frame, len));
+    } else if (!std::strcmp(id, "TPE1") || !std::strcmp(id, "TP1")) {
+        tags.artist = decodeId3Text(frame, len).trimmed();
+    } else if (!std::strcmp(id, "TPE2") || !std::strcmp(id, "TP2")) {
+        setIfEmpty(tags.artist, decodeId3Text(frame, len)); // исполнитель альбома как запасной вариант
+    } else if (!std::strcmp(id, "TALB") || !std::strcmp(id, "TAL")) {
+        setIfEmpty(tags.album, decodeId3Text(frame, len));
+    } else if (!std::strcmp(id, "TLEN") || !std::strcmp(id, "TLE")) {
+        if (tags.durationMs == 0) {
+            tags.durationMs = decodeId3Text(frame, len).trimmed().toInt();
+        }
+    } else if (!std::strcmp(id, "COMM") || !std::strcmp(id, "COM")) {
+        parseId3Comment(frame, len, tags);
+    } else if (!std::strcmp(id, "TXXX") || !std::strcmp(id, "TXX")) {
+        parseId3UserText(frame, len, tags);
+    }
+}
+
+// Снимает unsynchronisation (0xFF 0x00 -> 0xFF) для тегов ID3v2.2/2.3
+QByteArray removeUnsynchronisation(const uchar *p, qint64 len)
+{
+    QByteArray result;
+    result.reserve(int(len));
+    for (qint64 i = 0; i < len; ++i) {
+        result.append(char(p[i]));
+        if (p[i] == 0xFF && i + 1 < len && p[i + 1] == 0x00) {
+            ++i;
+        }
+    }
+    return result;
+}
+
+// Возвращает полный размер тега (0, если тега нет)
+qint64 parseId3v2(const uchar *data, qint64 size, TrackTags &tags)
+{
+    if (size < 10 || std::memcmp(data, "ID3", 3) != 0) {
+        return 0;
+    }
+    const int major = data[3];
+    const uchar flags = data[5];
+    qint64 tagSize = qint64(readSyncsafe(data + 6)) + 10;
+    if (major == 4 && (flags & 0x10)) {
+        tagSize += 10; // футер
+    }
+    if (tagSize > size) {
+        tagSize = size;
+    }
+    if (major < 2 || major > 4) {
+        return tagSize;
+    }
+
+    const uchar *body = data + 10;
+    qint64 bodySize = qMin<qint64>(readSyncsafe(data + 6), size - 10);
+    QByteArray unsynced;
+    if ((flags & 0x80) && major < 4) {
+        unsynced = removeUnsynchronisation(body, bodySize);
+        body = reinterpret_cast<const uchar *>(unsynced.constData());
+        bodySize = unsynced.size();
+    }
+
+    qint64 pos = 0;
+    if ((flags & 0x40) && major >= 3 && bodySize >= 4) {
+        // Расширенный заголовок: в 2.3 размер без учета самого поля, в 2.4 — syncsafe с учетом
+        pos = major == 3 ? 4 + qint64(readBE32(body)) : qint64(readSyncsafe(body));
+    }
+
+    const int headerSize = major == 2 ? 6 : 10;
+    char id[5] = {0, 0, 0, 0, 0};
+    while (pos + headerSize <= bodySize) {
+        const uchar *header = body + pos;
+        if (header[0] == 0) {
+            break; // дошли до паддинга
+        }
+        qint64 frameSize = 0;
+        quint16 frameFlags = 0;
+        if (major == 2) {
+            std::memcpy(id, header, 3);
+            id[3] = 0;
+            frameSize = readBE24(header + 3);
+        } else {
+            std::memcpy(id, header, 4);
+            frameSize = major == 4 ? readSyncsafe(header + 4) : readBE32(header + 4);
+            frameFlags = readBE16(header + 8);
+        }
+        pos += headerSize;
+        if (frameSize <= 0 || frameSize > bodySize - pos) {
+            break;
+        }
+
+        const uchar *frame = body + pos;
+        qint64 frameLen = frameSize;
+        bool skip = false;
+        if (major == 3) {
+            skip = frameFlags & 0x00C0; // сжатие или шифрование
+            if (!skip && (frameFlags & 0x0020) && frameLen > 1) { // группировка
+                ++frame;
+                --frameLen;
+            }
+        } else if (major == 4) {
+            skip = frameFlags & 0x000E; // сжатие, шифрование или покадровый unsync
+            if (!skip && (frameFlags & 0x0001) && frameLen > 4) { // индикатор длины данных
+                frame += 4;
+                frameLen -= 4;
+            }
+        }
+        if (!skip) {
+            handleId3Frame(id, frame, frameLen, tags);
+        }
+        pos += frameSize;
+    }
+    return tagSize;
+}
+
+bool parseId3v1(const uchar *data, qint64 size, TrackTags &tags)
+{
+    if (size < 128) {
+        return false;
+    }
+    const char *tag = reinterpret_cast<const char *>(data + size - 128);
+    if (std::memcmp(tag, "TAG", 3) != 0) {
+        return false;
+    }
+    setIfEmpty(tags.title, QString::fromLatin1(tag + 3, qstrnlen(tag + 3, 30)));
+    setIfEmpty(tags.artist, QString::fromLatin1(tag + 33, qstrnlen(tag + 33, 30)));
+    setIfEmpty(tags.album, QString::fromLatin1(tag + 63, qstrnlen(tag + 63, 30)));
+    return true;
+}
+
+// --- MPEG audio ---
+
+// Декодер MP3 дает на выходе 528 + 1 лишний сэмпл в начале потока
+const int mp3DecoderDelay = 529;
+
+struct MpegFrameHeader {
+    bool mpeg1 = false;
+    bool mono = false;
+    int layer = 0;
+    int bitrateKbps = 0;
+    int sampleRate = 0;
+    int samplesPerFrame = 0;
+    int frameLength = 0;
+};
+
+bool parseMpegFrameHeader(const uchar *p, MpegFrameHeader &header)
+{
+    static const int bitratesV1[3][16] = {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0},
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0}};
+    static const int bitratesV2[2][16] = {
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0}};
+    static const int sampleRates[3][3] = {
+        {44100, 48000, 32000},  // MPEG1
+        {22050, 24000, 16000},  // MPEG2
+        {11025, 12000, 8000}};  // MPEG2.5
+
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+    const int versionBits = (p[1] >> 3) & 0x03;
+    const int layerBits = (p[1] >> 1) & 0x03;
+    const int bitrateIndex = p[2] >> 4;
+    const int sampleRateIndex = (p[2] >> 2) & 0x03;
+    if (versionBits == 1 || layerBits == 0 || bitrateIndex == 0 || bitrateIndex == 15 || sampleRateIndex == 3) {
+        return false;
+    }
+
+    header.mpeg1 = versionBits == 3;
+    header.layer = 4 - layerBits;
+    header.mono = (p[3] >> 6) == 3;
+    header.bitrateKbps = header.mpeg1 ? bitratesV1[header.layer - 1][bitrateIndex]
+                                      : bitratesV2[header.layer == 1 ? 0 : 1][bitrateIndex];
+    header.sampleRate = sampleRates[versionBits == 3 ? 0 : (versionBits == 2 ? 1 : 2)][sampleRateIndex];
+    const int padding = (p[2] >> 1) & 0x01;
+    if (header.layer == 1) {
+        header.samplesPerFrame = 384;
+        header.frameLength = (12 * header.bitrateKbps * 1000 / header.sampleRate + padding) * 4;
+    } else {
+        header.samplesPerFrame = (header.layer == 3 && !header.mpeg1) ? 576 : 1152;
+        header.frameLength = header.samplesPerFrame / 8 * header.bitrateKbps * 1000 / header.sampleRate + padding;
+    }
+    return header.frameLength > 4;
+}
+
+void parseMpegDuration(const uchar *data, qint64 size, qint64 audioStart, TrackTags &tags)
+{
+    qint64 audioEnd = size;
+    if (size >= 128 && std::memcmp(data + size - 128, "TAG", 3) == 0) {
+        audioEnd -= 128;
+    }
+
+    // Ищем первый кадр; требуем, чтобы за ним сразу шел второй, иначе это ложная синхронизация
+    const qint64 scanLimit = qMin(audioEnd - 4, audioStart + 64 * 1024);
+    MpegFrameHeader header;
+    qint64 framePos = -1;
+    for (qint64 pos = audioStart; pos < scanLimit; ++pos) {
+        if (data[pos] != 0xFF || !parseMpegFrameHeader(data + pos, header)) {
+            continue;
+        }
+        MpegFrameHeader next;
+        const qint64 nextPos = pos + header.frameLength;
+        if (nextPos + 4 <= audioEnd && !parseMpegFrameHeader(data + nextPos, next)) {
+            continue;
+        }
+        framePos = pos;
+        break;
+    }
+    if (framePos < 0) {
+        return;
+    }
+    tags.sampleRate = header.sampleRate;
+
+    // Xing/Info находится сразу после side info первого кадра, VBRI — по фиксированному смещению 32
+    const int sideInfoSize = header.mpeg1 ? (header.mono ? 17 : 32) : (header.mono ? 9 : 17);
+    const qint64 xingPos = framePos + 4 + sideInfoSize;
+    const qint64 vbriPos = framePos + 4 + 32;
+    qint64 frameCount = 0;
+    if (xingPos + 12 <= audioEnd
+        && (std::memcmp(data + xingPos, "Xing", 4) == 0 || std::memcmp(data + xingPos, "Info", 4) == 0)) {
+        const quint32 flags = readBE32(data + xingPos + 4);
+        if (flags & 0x01) {
+            frameCount = readBE32(data + xingPos + 8);
+        }
+
+        // Расширение LAME идет за полями Xing, присутствующими по флагам.
+        // Смещение +21: 12 бит задержки кодера и 12 бит добивки
+        const qint64 lamePos = xingPos + 8 + ((flags & 0x01) ? 4 : 0) + ((flags & 0x02) ? 4 : 0)
+                               + ((flags & 0x04) ? 100 : 0) + ((flags & 0x08) ? 4 : 0);
+        if (lamePos + 24 <= audioEnd && tags.startPaddingSamples == 0 && tags.endPaddingSamples == 0
+            && (std::memcmp(data + lamePos, "LAME", 4) == 0 || std::memcmp(data + lamePos, "Lavc", 4) == 0
+                || std::memcmp(data + lamePos, "Lavf", 4) == 0)) {
+            const uchar *gapless = data + lamePos + 21;
+            const int encoderDelay = (gapless[0] << 4) | (gapless[1] >> 4);
+            const int encoderPadding = ((gapless[1] & 0x0F) << 8) | gapless[2];
+            tags.startPaddingSamples = encoderDelay + mp3DecoderDelay;
+            tags.endPaddingSamples = qMax(0, encoderPadding - mp3DecoderDelay);
+        }
+    } else if (vbriPos + 18 <= audioEnd && std::memcmp(data + vbriPos, "VBRI", 4) == 0) {
+        frameCount = readBE32(data + vbriPos + 14);
+    }
+
+    if (frameCount > 0) {
+        tags.durationMs = int(frameCount * header.samplesPerFrame * 1000 / header.sampleRate);
+    } else if (tags.durationMs == 0) {
+        // CBR без заголовка: длительность по размеру аудиоданных
+        tags.durationMs = int((audioEnd - framePos) * 8 / header.bitrateKbps);
+    }
+}
+
+// --- FLAC ---
+
+void parseVorbisComments(const uchar *p, qint64 len, TrackTags &tags)
+{
+    if (len < 8) {
+        return;
+    }
+    qint64 pos = 4 + qint64(readLE32(p));
+    if (pos + 4 > len) {
+        return;
+    }
+    const quint32 count = readLE32(p + pos);
+    pos += 4;
+    for (quint32 i = 0; i < count && pos + 4 <= len; ++i) {
+        const qint64 commentLen = readLE32(p + pos);
+        pos += 4;
+        if (commentLen > len - pos) {
+            break;
+        }
+        const QString comment = QString::fromUtf8(reinterpret_cast<const char *>(p + pos), int(commentLen));
+        pos += commentLen;
+
+        const int separator = comment.indexOf('=');
+        if (separator <= 0) {
+            continue;
+        }
+        const QString key = comment.left(separator).toUpper();
+        const QString value = comment.mid(separator + 1);
+        if (key == "TITLE") {
+            setIfEmpty(tags.title, value);
+        } else if (key == "ARTIST") {
+            setIfEmpty(tags.artist, value);
+        } else if (key == "ALBUM") {
+            setIfEmpty(tags.album, value);
+        } else if (key.startsWith("REPLAYGAIN_")) {
+            parseReplayGain(key, value, tags);
+        }
+    }
+}
+
+bool parseFlac(const uchar *data, qint64 size, qint64 offset, TrackTags &tags)
+{
+    if (offset + 4 > size || std::memcmp(data + offset, "fLaC", 4) != 0) {
+        return false;
+    }
+    qint64 pos = offset + 4;
+    bool lastBlock = false;
+    while (!lastBlock && pos + 4 <= size) {
+        lastBlock = data[pos] & 0x80;
+        const int type = data[pos] & 0x7F;
+        const qint64 blockLen = readBE24(data + pos + 1);
+        pos += 4;
+        if (blockLen > size - pos) {
+            break;
+        }
+        const uchar *block = data + pos;
+        if (type == 0 && blockLen >= 18) { // STREAMINFO
+            const int sampleRate = (block[10] << 12) | (block[11] << 4) | (block[12] >> 4);
+            const quint64 totalSamples = (quint64(block[13] & 0x0F) << 32) | readBE32(block + 14);
+            if (sampleRate > 0) {
+                tags.sampleRate = sampleRate;
+                tags.durationMs = int(totalSamples * 1000 / quint64(sampleRate));
+            }
+        } else if (type == 4) { // VORBIS_COMMENT
+            parseVorbisComments(block, blockLen, tags);
+        }
+        pos += blockLen;
+    }
+    return true;
+}
+
+// --- WAV ---
+
+void parseRiffInfo(const uchar *p, qint64 len, TrackTags &tags)
+{
+    qint64 pos = 0;
+    while (pos + 8 <= len) {
+        const qint64 chunkSize = readLE32(p + pos + 4);
+        const qint64 textPos = pos + 8;
+        if (chunkSize > len - textPos) {
+            break;
+        }
+        const char *text = reinterpret_cast<const char *>(p + textPos);
+        const QString value = QString::fromUtf8(text, qstrnlen(text, uint(chunkSize)));
+        if (std::memcmp(p + pos, "INAM", 4) == 0) {
+            setIfEmpty(tags.title, value);
+        } else if (std::memcmp(p + pos, "IART", 4) == 0) {
+            setIfEmpty(tags.artist, value);
+        } else if (std::memcmp(p + pos, "IPRD", 4) == 0) {
+            setIfEmpty(tags.album, value);
+        }
+        pos = textPos + chunkSize + (chunkSize & 1);
+    }
+}
+
+bool parseWav(const uchar *data, qint64 size, TrackTags &tags)
+{
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    quint32 byteRate = 0;
+    qint64 dataSize = 0;
+    qint64 pos = 12;
+    while (pos + 8 <= size) {
+        const uchar *chunk = data + pos;
+        const qint64 chunkSize = readLE32(chunk + 4);
+        const qint64 bodyPos = pos + 8;
+        const qint64 available = qMin(chunkSize, size - bodyPos);
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            tags.sampleRate = int(readLE32(data + bodyPos + 4));
+            byteRate = readLE32(data + bodyPos + 8);
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            dataSize = available; // у обрезанных файлов заявленный размер больше реального
+        } else if (std::memcmp(chunk, "LIST", 4) == 0 && available >= 4
+                   && std::memcmp(data + bodyPos, "INFO", 4) == 0) {
+            parseRiffInfo(data + bodyPos + 4, available - 4, tags);
+        }
+        pos = bodyPos + chunkSize + (chunkSize & 1);
+    }
+    if (byteRate > 0) {
+        tags.durationMs = int(dataSize * 1000 / byteRate);
+    }
+    return true;
+}
+
+} // namespace
+
+TrackTags TagReader::read(const QString &filePath)
+{
+    TrackTags tags;
+    QFile file(filePath);
+    if (file.open(QIODevice::ReadOnly) && file.size() > 0) {
+        const qint64 size = file.size();
+        // Отображение ленивое: с диска подгружаются только затронутые страницы (заголовки и хвост)
+        if (uchar *data = file.map(0, size)) {
+            const qint64 id3Size = parseId3v2(data, size, tags);
+            if (!parseFlac(data, size, id3Size, tags) && !parseWav(data, size, tags)) {
+                parseMpegDuration(data, size, id3Size, tags);
+                parseId3v1(data, size, tags);
+            }
+            file.unmap(data);
+        } else {
+            qDebug() << "Не удалось отобразить файл в память:" << filePath << file.errorString();
+        }
+    }
+
+    // Если заголовок отсутствует в тегах, используем базовое имя файла
+    if (tags.title.isEmpty()) {
+        tags.title = QFileInfo(filePath).baseName();
+    }
+    return tags;
+}
+
+QList<TrackTags> TagReader::readAll(const QStringList &filePaths)
+{
+    return QtConcurrent::blockingMapped<QList<TrackTags>>(filePaths, &TagReader::read);
+}
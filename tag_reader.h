@@ -0,0 +1,40 @@
+#ifndef TAG_READER_H
+#define TAG_READER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+// Метаданные, прочитанные напрямую из заголовков файла (без запуска воспроизведения)
+struct TrackTags {
+    QString title;
+    QString artist;
+    QString album;
+    int durationMs = 0;
+    int sampleRate = 0;
+    // Для бесшовного воспроизведения: сколько сэмплов в начале и в конце декодированного
+    // потока не относятся к записи (задержка кодера/декодера и добивка последнего кадра)
+    int startPaddingSamples = 0;
+    int endPaddingSamples = 0;
+    // ReplayGain: поправка громкости в дБ и пиковая амплитуда (1.0 — полная шкала)
+    float trackGainDb = 0.0f;
+    float trackPeak = 0.0f;
+    float albumGainDb = 0.0f;
+    float albumPeak = 0.0f;
+    bool hasTrackGain = false;
+    bool hasAlbumGain = false;
+};
+
+// Разбор ID3v2/ID3v1 (+ Xing/VBRI для длительности MP3, LAME и iTunSMPB для задержки
+// и добивки, TXXX для ReplayGain), FLAC (STREAMINFO и Vorbis comments) и WAV (fmt/data и LIST INFO)
+// из отображенного в память файла.
+class TagReader
+{
+public:
+    static TrackTags read(const QString &filePath);
+
+    // Параллельное чтение на глобальном пуле потоков; порядок результатов совпадает с filePaths
+    static QList<TrackTags> readAll(const QStringList &filePaths);
+};
+
+#endif // TAG_READER_H
@@ -0,0 +1,216 @@
+#include "waveform_data.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const char magic[4] = {'W', 'F', 'M', '1'};
+const int headerSize = 40;
+const int maxLevels = 24;
+
+struct Header {
+    quint32 sampleRate = 0;
+    qint64 fileMtime = 0;
+    qint64 fileSize = 0;
+    qint64 totalFrames = 0;
+    quint32 baseFramesPerBucket = 0;
+    quint32 levelCount = 0;
+};
+
+bool readHeader(const uchar *data, qint64 size, Header &header)
+{
+    if (size < headerSize || memcmp(data, magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    header.sampleRate = qFromLittleEndian<quint32>(data + 4);
+    header.fileMtime = qFromLittleEndian<qint64>(data + 8);
+    header.fileSize = qFromLittleEndian<qint64>(data + 16);
+    header.totalFrames = qFromLittleEndian<qint64>(data + 24);
+    header.baseFramesPerBucket = qFromLittleEndian<quint32>(data + 32);
+    header.levelCount = qFromLittleEndian<quint32>(data + 36);
+    return header.sampleRate > 0 && header.baseFramesPerBucket > 0
+           && header.levelCount > 0 && header.levelCount <= maxLevels;
+}
+
+qint8 toPeak(float value)
+{
+    return qint8(qBound(-127, int(std::lround(value * 127.0f)), 127));
+}
+
+} // namespace
+
+WaveformData::~WaveformData()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+    }
+}
+
+QString WaveformData::sidecarPath(int songId)
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+        .filePath(QString("waveforms/%1.wfm").arg(songId));
+}
+
+bool WaveformData::isUpToDate(int songId, qint64 fileMtime, qint64 fileSize)
+{
+    QFile file(sidecarPath(songId));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray data = file.read(headerSize);
+    Header header;
+    return readHeader(reinterpret_cast<const uchar *>(data.constData()), data.size(), header)
+           && header.fileMtime == fileMtime && header.fileSize == fileSize;
+}
+
+std::shared_ptr<const WaveformData> WaveformData::open(int songId, const QString &audioPath)
+{
+    const QFileInfo audio(audioPath);
+    std::shared_ptr<WaveformData> waveform(new WaveformData());
+    waveform->m_file.setFileName(sidecarPath(songId));
+    if (!audio.isFile() || !waveform->m_file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    const qint64 size = waveform->m_file.size();
+    waveform->m_map = waveform->m_file.map(0, size);
+    if (!waveform->m_map) {
+        qDebug() << "Не удалось отобразить в память обзор формы волны:" << waveform->m_file.fileName();
+        return nullptr;
+    }
+
+    Header header;
+    if (!readHeader(waveform->m_map, size, header)
+        || header.fileMtime != audio.lastModified().toMSecsSinceEpoch() || header.fileSize != audio.size()) {
+        return nullptr;
+    }
+    waveform->m_sampleRate = int(header.sampleRate);
+    waveform->m_totalFrames = header.totalFrames;
+
+    qint64 offset = headerSize + qint64(header.levelCount) * 4;
+    for (quint32 i = 0; i < header.levelCount; ++i) {
+        Level level;
+        level.framesPerBucket = qint64(header.baseFramesPerBucket) << i;
+        level.bucketCount = qFromLittleEndian<quint32>(waveform->m_map + headerSize + i * 4);
+        level.peaks = reinterpret_cast<const qint8 *>(waveform->m_map + offset);
+        offset += level.bucketCount * 2;
+        if (offset > size) {
+            qDebug() << "Поврежден обзор формы волны:" << waveform->m_file.fileName();
+            return nullptr;
+        }
+        waveform->m_levels.append(level);
+    }
+    return waveform;
+}
+
+WaveformData::Level WaveformData::levelForColumns(int columns) const
+{
+    // Уровни идут от подробного к грубому
+    for (int i = m_levels.size() - 1; i > 0; --i) {
+        if (m_levels.at(i).bucketCount >= columns) {
+            return m_levels.at(i);
+        }
+    }
+    return m_levels.first();
+}
+
+void WaveformData::peaks(const Level &level, qint64 fromFrame, qint64 toFrame, float *min, float *max) const
+{
+    qint64 first = qBound<qint64>(0, fromFrame / level.framesPerBucket, level.bucketCount);
+    qint64 last = qBound<qint64>(first, (toFrame + level.framesPerBucket - 1) / level.framesPerBucket, level.bucketCount);
+    // Столбец уже корзины: берем ту, в которую он попал
+    if (first == last && first < level.bucketCount) {
+        ++last;
+    }
+    int low = 0;
+    int high = 0;
+    for (qint64 i = first; i < last; ++i) {
+        low = qMin<int>(low, level.peaks[i * 2]);
+        high = qMax<int>(high, level.peaks[i * 2 + 1]);
+    }
+    *min = low / 127.0f;
+    *max = high / 127.0f;
+}
+
+WaveformBuilder::WaveformBuilder(int channels, int sampleRate)
+    : m_channels(qMax(1, channels))
+    , m_sampleRate(sampleRate)
+{
+}
+
+void WaveformBuilder::addFrames(const float *data, qsizetype frames)
+{
+    for (qsizetype f = 0; f < frames; ++f) {
+        const float *frame = data + f * m_channels;
+        for (int c = 0; c < m_channels; ++c) {
+            m_min = qMin(m_min, frame[c]);
+            m_max = qMax(m_max, frame[c]);
+        }
+        if (++m_bucketFrames == BaseFramesPerBucket) {
+            m_peaks.append(toPeak(m_min));
+            m_peaks.append(toPeak(m_max));
+            m_min = m_max = 0.0f;
+            m_bucketFrames = 0;
+        }
+    }
+    m_totalFrames += frames;
+}
+
+bool WaveformBuilder::save(int songId, qint64 fileMtime, qint64 fileSize) const
+{
+    if (m_sampleRate <= 0 || m_totalFrames == 0) {
+        return false;
+    }
+
+    // Уровень 0 с недобранной последней корзиной, затем попарное сворачивание
+    QList<QVector<qint8>> levels;
+    levels.append(m_peaks);
+    if (m_bucketFrames > 0) {
+        levels.first().append(toPeak(m_min));
+        levels.first().append(toPeak(m_max));
+    }
+    while (levels.size() < maxLevels && levels.last().size() / 2 > MinBuckets) {
+        const QVector<qint8> &finer = levels.last();
+        QVector<qint8> coarser;
+        coarser.reserve(finer.size() / 2 + 2);
+        for (qsizetype i = 0; i < finer.size(); i += 4) {
+            const bool pair = i + 2 < finer.size();
+            coarser.append(pair ? qMin(finer[i], finer[i + 2]) : finer[i]);
+            coarser.append(pair ? qMax(finer[i + 1], finer[i + 3]) : finer[i + 1]);
+        }
+        levels.append(coarser);
+    }
+
+    QByteArray header(headerSize + levels.size() * 4, '\0');
+    uchar *out = reinterpret_cast<uchar *>(header.data());
+    memcpy(out, magic, sizeof(magic));
+    qToLittleEndian<quint32>(quint32(m_sampleRate), out + 4);
+    qToLittleEndian<qint64>(fileMtime, out + 8);
+    qToLittleEndian<qint64>(fileSize, out + 16);
+    qToLittleEndian<qint64>(m_totalFrames, out + 24);
+    qToLittleEndian<quint32>(quint32(BaseFramesPerBucket), out + 32);
+    qToLittleEndian<quint32>(quint32(levels.size()), out + 36);
+    for (int i = 0; i < levels.size(); ++i) {
+        qToLittleEndian<quint32>(quint32(levels.at(i).size() / 2), out + headerSize + i * 4);
+    }
+
+    const QString path = WaveformData::sidecarPath(songId);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Не удалось сохранить обзор формы волны:" << path;
+        return false;
+    }
+    file.write(header);
+    for (const QVector<qint8> &level : levels) {
+        file.write(reinterpret_cast<const char *>(level.constData()), level.size());
+    }
+    return file.commit();
+}
@@ -0,0 +1,79 @@
+#ifndef WAVEFORM_DATA_H
+#define WAVEFORM_DATA_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include <memory>
+
+// Обзор формы волны трека: пары (мин, макс) по корзинам фиксированной длины на
+// нескольких уровнях масштаба, каждый следующий вдвое грубее. Хранится в файле-спутнике
+// <кэш>/waveforms/<id песни>.wfm и открывается отображением в память: открытие трека
+// не требует ни декодирования, ни чтения файла целиком.
+//
+// Формат (little-endian): "WFM1", частота дискретизации (u32), mtime и размер
+// аудиофайла (i64, i64), число кадров (i64), кадров в корзине уровня 0 (u32),
+// число уровней (u32), число корзин каждого уровня (u32), затем пары int8 уровней подряд.
+class WaveformData
+{
+public:
+    struct Level {
+        qint64 framesPerBucket = 0;
+        qint64 bucketCount = 0;
+        const qint8 *peaks = nullptr; // bucketCount пар (мин, макс) в диапазоне -127..127
+    };
+
+    ~WaveformData();
+    Q_DISABLE_COPY(WaveformData)
+
+    // nullptr, если обзора нет или он построен для другой версии аудиофайла
+    static std::shared_ptr<const WaveformData> open(int songId, const QString &audioPath);
+    // Проверка по заголовку без отображения файла (поток анализа библиотеки)
+    static bool isUpToDate(int songId, qint64 fileMtime, qint64 fileSize);
+    static QString sidecarPath(int songId);
+
+    int sampleRate() const { return m_sampleRate; }
+    qint64 totalFrames() const { return m_totalFrames; }
+    int levelCount() const { return int(m_levels.size()); }
+    Level level(int index) const { return m_levels.at(index); }
+    // Самый грубый уровень, у которого на каждый из columns столбцов приходится хотя бы одна корзина
+    Level levelForColumns(int columns) const;
+    // Пик на отрезке кадров [fromFrame, toFrame), значения в [-1, 1]
+    void peaks(const Level &level, qint64 fromFrame, qint64 toFrame, float *min, float *max) const;
+
+private:
+    WaveformData() = default;
+
+    QFile m_file;
+    uchar *m_map = nullptr;
+    int m_sampleRate = 0;
+    qint64 m_totalFrames = 0;
+    QVector<Level> m_levels;
+};
+
+// Построение обзора по декодированному звуку (поток анализа библиотеки)
+class WaveformBuilder
+{
+public:
+    static constexpr int BaseFramesPerBucket = 2048;
+    static constexpr int MinBuckets = 64;  // грубее уровни не строятся
+
+    WaveformBuilder(int channels, int sampleRate);
+
+    // Чередующиеся каналы, float в [-1, 1]; каналы сводятся в общий пик
+    void addFrames(const float *data, qsizetype frames);
+    // Атомарная запись файла-спутника
+    bool save(int songId, qint64 fileMtime, qint64 fileSize) const;
+
+private:
+    int m_channels;
+    int m_sampleRate;
+    qint64 m_totalFrames = 0;
+    int m_bucketFrames = 0;
+    float m_min = 0.0f;
+    float m_max = 0.0f;
+    QVector<qint8> m_peaks; // уровень 0
+};
+
+#endif // WAVEFORM_DATA_H
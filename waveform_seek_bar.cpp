@@ -0,0 +1,123 @@
+#include "waveform_seek_bar.h"
+
+#include <QLine>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QStyle>
+#include <QVector>
+
+WaveformSeekBar::WaveformSeekBar(QWidget *parent)
+    : QSlider(Qt::Horizontal, parent)
+{
+}
+
+void WaveformSeekBar::setWaveform(std::shared_ptr<const WaveformData> waveform)
+{
+    m_waveform = std::move(waveform);
+    m_playheadX = -1;
+    update();
+}
+
+int WaveformSeekBar::positionToX(int value) const
+{
+    if (maximum() <= minimum()) {
+        return 0;
+    }
+    return int(qint64(value - minimum()) * (width() - 1) / (maximum() - minimum()));
+}
+
+int WaveformSeekBar::xToValue(qreal x) const
+{
+    return QStyle::sliderValueFromPosition(minimum(), maximum(), qBound(0, int(x), width() - 1), width() - 1);
+}
+
+void WaveformSeekBar::paintEvent(QPaintEvent *event)
+{
+    if (!m_waveform) {
+        QSlider::paintEvent(event);
+        return;
+    }
+
+    // Ось времени общая со значением слайдера (мс); пока длительность неизвестна,
+    // на всю ширину растягивается весь обзор
+    const int columns = qMax(1, width());
+    const qint64 spanFrames = maximum() > 0 ? qint64(maximum()) * m_waveform->sampleRate() / 1000
+                                            : m_waveform->totalFrames();
+    const WaveformData::Level level = m_waveform->levelForColumns(columns);
+    const int playheadX = positionToX(sliderPosition());
+    const int middle = height() / 2;
+    const float half = qMax(1, height() / 2 - 1);
+
+    const QRect dirty = event->rect().intersected(rect());
+    QVector<QLine> played;
+    QVector<QLine> remaining;
+    played.reserve(dirty.width());
+    remaining.reserve(dirty.width());
+    for (int x = dirty.left(); x <= dirty.right(); ++x) {
+        float low = 0.0f;
+        float high = 0.0f;
+        m_waveform->peaks(level, spanFrames * x / columns, spanFrames * (x + 1) / columns, &low, &high);
+        const int top = middle - int(high * half);
+        const int bottom = qMax(top, middle - int(low * half));
+        (x <= playheadX ? played : remaining).append(QLine(x, top, x, bottom));
+    }
+
+    const QPalette::ColorGroup group = isEnabled() ? QPalette::Active : QPalette::Disabled;
+    QPainter painter(this);
+    painter.setPen(palette().color(group, QPalette::Highlight));
+    painter.drawLines(played);
+    painter.setPen(palette().color(group, QPalette::Mid));
+    painter.drawLines(remaining);
+    if (playheadX >= dirty.left() && playheadX <= dirty.right()) {
+        painter.setPen(palette().color(group, QPalette::WindowText));
+        painter.drawLine(playheadX, 0, playheadX, height() - 1);
+    }
+    m_playheadX = playheadX;
+}
+
+void WaveformSeekBar::sliderChange(SliderChange change)
+{
+    // Позиция воспроизведения меняется несколько раз в секунду: перерисовываем
+    // только столбцы между старым и новым положением указателя
+    if (m_waveform && change == SliderValueChange && m_playheadX >= 0) {
+        const int x = positionToX(sliderPosition());
+        if (x != m_playheadX) {
+            update(QRect(QPoint(qMin(x, m_playheadX) - 1, 0), QPoint(qMax(x, m_playheadX) + 1, height() - 1)));
+        }
+        return;
+    }
+    QSlider::sliderChange(change);
+}
+
+void WaveformSeekBar::mousePressEvent(QMouseEvent *event)
+{
+    // По форме волны щелчок сразу переносит позицию в точку, а не шагает страницей
+    if (!m_waveform || event->button() != Qt::LeftButton || maximum() <= minimum()) {
+        QSlider::mousePressEvent(event);
+        return;
+    }
+    setSliderDown(true);
+    setSliderPosition(xToValue(event->position().x()));
+    event->accept();
+}
+
+void WaveformSeekBar::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!m_waveform || !isSliderDown()) {
+        QSlider::mouseMoveEvent(event);
+        return;
+    }
+    setSliderPosition(xToValue(event->position().x()));
+    event->accept();
+}
+
+void WaveformSeekBar::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (!m_waveform || !isSliderDown()) {
+        QSlider::mouseReleaseEvent(event);
+        return;
+    }
+    setSliderDown(false);
+    event->accept();
+}
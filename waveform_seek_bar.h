@@ -0,0 +1,37 @@
+#ifndef WAVEFORM_SEEK_BAR_H
+#define WAVEFORM_SEEK_BAR_H
+
+#include "waveform_data.h"
+
+#include <QSlider>
+#include <memory>
+
+// Полоса перемотки с обзором формы волны. Без обзора ведет себя как обычный QSlider.
+// Рисуются только столбцы из области перерисовки, а при движении позиции
+// перерисовывается лишь полоса между старым и новым положением указателя.
+class WaveformSeekBar : public QSlider
+{
+    Q_OBJECT
+
+public:
+    explicit WaveformSeekBar(QWidget *parent = nullptr);
+
+    void setWaveform(std::shared_ptr<const WaveformData> waveform);
+    bool hasWaveform() const { return m_waveform != nullptr; }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void sliderChange(SliderChange change) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    int positionToX(int value) const;
+    int xToValue(qreal x) const;
+
+    std::shared_ptr<const WaveformData> m_waveform;
+    int m_playheadX = -1; // где указатель нарисован сейчас
+};
+
+#endif // WAVEFORM_SEEK_BAR_H